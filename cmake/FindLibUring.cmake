@@ -0,0 +1,36 @@
+#********************************************************************
+#        _       _         _
+#  _ __ | |_  _ | |  __ _ | |__   ___
+# | '__|| __|(_)| | / _` || '_ \ / __|
+# | |   | |_  _ | || (_| || |_) |\__ \
+# |_|    \__|(_)|_| \__,_||_.__/ |___/
+#
+# www.rt-labs.com
+# Copyright 2020 rt-labs AB, Sweden.
+#
+# This software is dual-licensed under GPLv3 and a commercial
+# license. See the file LICENSE.md distributed with this software for
+# full license information.
+#*******************************************************************/
+
+
+include(FindPackageHandleStandardArgs)
+
+# Find liburing
+
+find_path(LibUring_INCLUDE_DIR liburing.h)
+find_library(LibUring_LIBRARY uring)
+mark_as_advanced(LibUring_INCLUDE_DIR LibUring_LIBRARY)
+
+find_package_handle_standard_args(LibUring
+  REQUIRED_VARS LibUring_LIBRARY LibUring_INCLUDE_DIR
+  )
+
+if (LibUring_FOUND AND NOT TARGET LibUring::LibUring)
+  add_library(LibUring::LibUring UNKNOWN IMPORTED)
+  set_target_properties(LibUring::LibUring PROPERTIES
+    IMPORTED_LINK_INTERFACE_LANGUAGES "C"
+    IMPORTED_LOCATION "${LibUring_LIBRARY}"
+    INTERFACE_INCLUDE_DIRECTORIES "${LibUring_INCLUDE_DIR}"
+    )
+endif()
@@ -18,6 +18,19 @@ if (PNET_OPTION_SNMP)
   find_package(NetSNMPAgent REQUIRED)
 endif()
 
+if (LOGGER_OPTION_IO_URING)
+  find_package(LibUring REQUIRED)
+endif()
+
+if (LOGGER_OPTION_ZSTD)
+  # Optional: without libzstd, pn_dev archives days with tar as before
+  find_package(Zstd)
+  if (NOT Zstd_FOUND)
+    message(STATUS "libzstd not found, days are archived as .tgz with tar")
+    set(LOGGER_OPTION_ZSTD OFF)
+  endif()
+endif()
+
 target_include_directories(profinet
   PRIVATE
   src/ports/linux
@@ -77,7 +90,24 @@ target_sources(pn_dev
   pn_logger/app_gsdml.c
   pn_logger/app_data.c
   src/ports/linux/app_filelogger.c
+  src/ports/linux/app_fileutils.c
+  src/ports/linux/app_logformat.c
+  src/ports/linux/app_logcatalog.c
   src/ports/linux/logger_main.c
+  $<$<BOOL:${LOGGER_OPTION_IO_URING}>:src/ports/linux/app_filelogger_uring.c>
+  $<$<BOOL:${LOGGER_OPTION_ZSTD}>:src/ports/linux/app_filelogger_zstd.c>
+  )
+
+target_compile_definitions(pn_dev
+  PRIVATE
+  LOGGER_USE_IO_URING=$<BOOL:${LOGGER_OPTION_IO_URING}>
+  LOGGER_USE_ZSTD=$<BOOL:${LOGGER_OPTION_ZSTD}>
+  )
+
+target_link_libraries(pn_dev
+  PRIVATE
+  $<$<BOOL:${LOGGER_OPTION_IO_URING}>:LibUring::LibUring>
+  $<$<BOOL:${LOGGER_OPTION_ZSTD}>:Zstd::Zstd>
   )
 
 target_compile_options(pn_dev
@@ -111,5 +141,79 @@ if (BUILD_TESTING)
   target_include_directories(pf_test
     PRIVATE
     src/ports/linux
+    pn_logger
+    pnet2csv
+    logbench
+    )
+
+  # The record decode kernels of pnet2csv, checked against each other
+  target_sources(pf_test
+    PRIVATE
+    test/test_record_decode.cpp
+    pnet2csv/record_decode.c
+    pnet2csv/record_decode_x86.c
+    pnet2csv/record_decode_neon.c
+    )
+
+  # Its projection and predicates, and resampling
+  target_sources(pf_test
+    PRIVATE
+    test/test_entry_filter.cpp
+    test/test_resample.cpp
+    pnet2csv/entry_filter.c
+    pnet2csv/resample.c
+    pnet2csv/column_table.c
+    )
+
+  # The Parquet and Arrow files it writes, read back
+  target_sources(pf_test
+    PRIVATE
+    test/test_parquet_writer.cpp
+    test/test_arrow_writer.cpp
+    pnet2csv/byte_buffer.c
+    pnet2csv/parquet_writer.c
+    pnet2csv/arrow_writer.c
+    )
+
+  # The compact log format, encoded and decoded again
+  target_sources(pf_test
+    PRIVATE
+    test/test_log_format.cpp
+    src/ports/linux/app_logformat.c
+    )
+
+  # Finding a time in a log, with or without its index
+  target_sources(pf_test
+    PRIVATE
+    test/test_log_reader.cpp
+    pnet2csv/log_reader.c
+    )
+
+  # The catalog of the log directory
+  target_sources(pf_test
+    PRIVATE
+    test/test_log_catalog.cpp
+    src/ports/linux/app_logcatalog.c
+    src/ports/linux/app_fileutils.c
+    )
+
+  # The work pool it scans and converts its inputs on
+  target_sources(pf_test
+    PRIVATE
+    test/test_work_pool.cpp
+    pnet2csv/work_pool.c
+    )
+
+  # The frame buffer pool of the port
+  target_sources(pf_test
+    PRIVATE
+    test/test_buf_pool.cpp
+    )
+
+  # The percentiles logbench reports
+  target_sources(pf_test
+    PRIVATE
+    test/test_latency_histogram.cpp
+    logbench/latency_histogram.c
     )
 endif()
@@ -672,6 +672,28 @@ typedef int (*pnet_sm_released_ind) (
    uint16_t subslot_number,
    pnet_result_t * p_result);
 
+/**
+ * Indication to the application that RPC datagrams have arrived.
+ *
+ * This application call-back function is called by the Profinet stack when a
+ * datagram has arrived on one of the sockets used for RPC (connect, read,
+ * write etc). That is from a thread of its own, watching the sockets, or,
+ * when more datagrams are waiting than are handled at once, from within
+ * \a pnet_handle_rpc() on the thread running the stack.
+ * Either way the application should wake the thread running the stack and
+ * have it call \a pnet_handle_rpc() (again). It must not call that or any
+ * other function of the stack from this callback.
+ *
+ * It is optional to implement this callback. If it is given, and the
+ * operating system port supports it, the RPC sockets are read only when the
+ * application calls \a pnet_handle_rpc(), and no longer on every call to
+ * \a pnet_handle_periodic(). Otherwise they are polled on every tick.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param arg              InOut: User-defined data (not used by p-net)
+ */
+typedef void (*pnet_rpc_ready_ind) (pnet_t * net, void * arg);
+
 /**
  * Indication to the application that a CControl confirmation was received from
  * the controller. Typically this means that the controller has received our
@@ -1335,6 +1357,7 @@ typedef struct pnet_cfg
    pnet_reset_ind reset_cb;
    pnet_signal_led_ind signal_led_cb;
    pnet_sm_released_ind sm_released_cb;
+   pnet_rpc_ready_ind rpc_ready_cb;
 
    /** User data passed to callbacks, not used by stack */
    void * cb_arg;
@@ -1425,6 +1448,18 @@ PNET_EXPORT pnet_t * pnet_init (const pnet_cfg_t * p_cfg);
  */
 PNET_EXPORT void pnet_handle_periodic (pnet_t * net);
 
+/**
+ * Handle the RPC datagrams that have arrived.
+ *
+ * This function shall be called by the application after the
+ * \a pnet_rpc_ready_ind() user callback, from the thread that calls
+ * \a pnet_handle_periodic(). If more datagrams are waiting than are handled
+ * in one call, the callback is called again.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+PNET_EXPORT void pnet_handle_rpc (pnet_t * net);
+
 /**
  * Application signals ready to exchange data.
  *
@@ -0,0 +1,112 @@
+#include "latency_histogram.h"
+
+#include <string.h>
+
+/* which bucket a value goes in */
+static int bucketOf(uint64_t value)
+{
+	if(value < HISTOGRAM_SUB_COUNT)
+		return (int)value;
+	
+	int exponent = 63 - __builtin_clzll(value);
+	int shift = exponent - HISTOGRAM_SUB_BITS;
+	int sub = (int)(value >> shift) & (HISTOGRAM_SUB_COUNT - 1);
+	
+	return (shift + 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+/* the largest value that goes in a bucket */
+static uint64_t bucketTop(int bucket)
+{
+	if(bucket < HISTOGRAM_SUB_COUNT)
+		return (uint64_t)bucket;
+	
+	int shift = bucket / HISTOGRAM_SUB_COUNT - 1;
+	uint64_t sub = (uint64_t)(bucket % HISTOGRAM_SUB_COUNT);
+	uint64_t bottom = (HISTOGRAM_SUB_COUNT + sub) << shift;
+	
+	return bottom + ((uint64_t)1 << shift) - 1;
+}
+
+void histogramInit(latency_histogram_t *histogram)
+{
+	memset(histogram, 0, sizeof(*histogram));
+	histogram->min = INT64_MAX;
+}
+
+void histogramAdd(latency_histogram_t *histogram, int64_t value)
+{
+	if(value < 0)
+		value = 0;
+	
+	histogram->counts[bucketOf((uint64_t)value)]++;
+	histogram->total++;
+	histogram->sum += (double)value;
+	
+	if(value < histogram->min)
+		histogram->min = value;
+	if(value > histogram->max)
+		histogram->max = value;
+}
+
+int64_t histogramPercentile(const latency_histogram_t *histogram, double percent)
+{
+	if(histogram->total == 0)
+		return 0;
+	
+	/* the rank of the value wanted, counting from 1 */
+	uint64_t rank = (uint64_t)((double)histogram->total * percent / 100.0 + 0.999999);
+	if(rank < 1)
+		rank = 1;
+	if(rank > histogram->total)
+		rank = histogram->total;
+	
+	uint64_t seen = 0;
+	for(int bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+		seen += histogram->counts[bucket];
+		if(seen >= rank) {
+			uint64_t top = bucketTop(bucket);
+			return (top < (uint64_t)histogram->max) ? (int64_t)top : histogram->max;
+		}
+	}
+	
+	return histogram->max;
+}
+
+double histogramMean(const latency_histogram_t *histogram)
+{
+	return (histogram->total != 0) ? histogram->sum / (double)histogram->total : 0.0;
+}
+
+void histogramPrint(const latency_histogram_t *histogram, FILE *out, const char *unit, int64_t scale)
+{
+	if(histogram->total == 0) {
+		fprintf(out, "   (none)\n");
+		return;
+	}
+	
+	int precision = (scale > 1) ? 1 : 0;
+	uint64_t seen = 0;
+	/* the linear buckets are the first power of two's worth, then one row per power of two */
+	for(int row = 0; row <= 64 - HISTOGRAM_SUB_BITS && seen < histogram->total; row++) {
+		int first = row * HISTOGRAM_SUB_COUNT;
+		uint64_t count = 0;
+		for(int bucket = first; bucket < first + HISTOGRAM_SUB_COUNT; bucket++) {
+			count += histogram->counts[bucket];
+		}
+		if(count == 0)
+			continue;
+		
+		seen += count;
+		uint64_t bottom = (row == 0) ? 0 : (uint64_t)HISTOGRAM_SUB_COUNT << (row - 1);
+		uint64_t top = bucketTop(first + HISTOGRAM_SUB_COUNT - 1);
+		
+		/* whole numbers are all there is to show of values not scaled */
+		fprintf(out, "   %12.*f - %12.*f %-3s %12llu %8.4f%%\n",
+			precision, (double)bottom / (double)scale,
+			precision, (double)(top + 1) / (double)scale,
+			unit,
+			(unsigned long long)count,
+			100.0 * (double)seen / (double)histogram->total);
+	}
+}
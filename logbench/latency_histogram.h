@@ -0,0 +1,83 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+/**
+ * @file
+ * @brief Histogram of latencies, for percentiles of millions of them
+ *
+ * Values are counted in buckets rather than kept, so adding one costs the
+ * same however many there are. Below 2^HISTOGRAM_SUB_BITS every value has
+ * a bucket of its own; above, each power of two is split into that many,
+ * so a percentile is within about 3% of the value it stands for.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+/* the linear buckets, then HISTOGRAM_SUB_COUNT for each power of two above them */
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+typedef struct latency_histogram
+{
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	uint64_t total;
+	int64_t min;
+	int64_t max;
+	/* for the mean */
+	double sum;
+} latency_histogram_t;
+
+/**
+ * Start with no values
+ *
+ * @param histogram        Out
+ */
+void histogramInit(latency_histogram_t *histogram);
+
+/**
+ * Count a value
+ *
+ * @param histogram        InOut
+ * @param value            In:    counted as 0 if negative
+ */
+void histogramAdd(latency_histogram_t *histogram, int64_t value);
+
+/**
+ * The value that percent of them are at or below
+ *
+ * @param histogram        In
+ * @param percent          In:    0-100, as 99.9
+ * @return the top of the bucket it is in, at most the largest value;
+ *         0 if there are none
+ */
+int64_t histogramPercentile(const latency_histogram_t *histogram, double percent);
+
+/**
+ * Mean of the values
+ *
+ * @param histogram        In
+ * @return the mean, 0 if there are none
+ */
+double histogramMean(const latency_histogram_t *histogram);
+
+/**
+ * Write how many values fell in each power of two, as a table
+ *
+ * @param histogram        In
+ * @param out              In:    where to
+ * @param unit             In:    name of what the values are divided into
+ * @param scale            In:    values in one unit, as 1000 for us of ns
+ */
+void histogramPrint(const latency_histogram_t *histogram, FILE *out, const char *unit, int64_t scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_HISTOGRAM_H */
@@ -0,0 +1,910 @@
+#define _GNU_SOURCE /* For mkdtemp(), nftw() and CLOCK_THREAD_CPUTIME_ID */
+
+#include "app_filelogger.h"
+#include "app_log.h"
+#include "latency_histogram.h"
+#include "write_faults.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <limits.h>
+
+#include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <time.h>
+
+#define NS_PER_S 1000000000LL
+
+#define RATE_MAX       100000
+#define RATES_MAX      16
+#define DEFAULT_RATE   1000
+#define DEFAULT_TIME_S 10
+
+/* below this period the producer spins rather than sleeps, as sleeps this short overshoot */
+#define SPIN_BELOW_NS 200000
+
+/* how often the monitor looks at how far the logger has got, which end to end latencies are only as fine as */
+#define MONITOR_INTERVAL_NS 50000
+
+/*
+When each entry was offered, by its number. Only ENTRY_BUFFER_COUNT of them
+can be pending, so this many leaves the monitor plenty of time to catch up.
+*/
+#define OFFERED_RING (1 << 20)
+
+/* longest to wait for the logger to write what is left once a run is over */
+#define DRAIN_TIMEOUT_S 10
+
+#define WORD_COUNT (APP_GSDML_VAR64_DATA_DIGITAL_SIZE / 2)
+
+typedef enum change_pattern
+{
+	PATTERN_STATIC,  /* the words never change */
+	PATTERN_COUNTER, /* word 0 counts up every entry */
+	PATTERN_WALK,    /* one word changes every entry, each in turn */
+	PATTERN_RANDOM   /* every word changes every entry */
+} change_pattern_t;
+
+static const char *pattern_names[] = { "static", "counter", "walk", "random" };
+
+typedef struct bench_options
+{
+	long rates[RATES_MAX];
+	int rate_count;
+	double seconds;
+	change_pattern_t pattern;
+	/* how much faster than real time the PLC clock runs */
+	int accelerate;
+	/* seconds into each run, and for how long, writes fail with ENOSPC */
+	double no_space_start;
+	double no_space_length;
+	int old_days;
+	int priority;
+	const char *directory;
+	bool keep;
+
+	/* 0 for no limit */
+	unsigned long max_drops;
+	int64_t max_enqueue_ns;
+	int64_t max_latency_ns;
+} bench_options_t;
+
+typedef struct run_result
+{
+	long rate;
+	double seconds;
+	uint64_t offered;
+	uint64_t dropped;
+	/* of those taken in, written by the time the logger was given up on */
+	uint64_t unwritten;
+	size_t peak_pending;
+	unsigned int low_space;
+	latency_histogram_t enqueue;
+	latency_histogram_t latency;
+	/* seconds of CPU time */
+	double producer_cpu;
+	double monitor_cpu;
+	double process_cpu;
+	write_faults_stats_t faults;
+} run_result_t;
+
+/* shared between the producer, the monitor and the main thread for a run */
+static struct
+{
+	const bench_options_t *options;
+	long rate;
+
+	/* CLOCK_MONOTONIC when each entry was offered, by its number in the entry buffer */
+	int64_t *offered_at;
+
+	/* the PLC clock, carried on from run to run, in nanoseconds since 1970 */
+	int64_t plc_time;
+
+	atomic_bool monitoring;
+
+	run_result_t *result;
+} bench;
+
+static int64_t monotonicNow(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t)now.tv_sec * NS_PER_S + now.tv_nsec;
+}
+
+static double threadCpuSeconds(void)
+{
+	struct timespec cpu;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+
+	return (double)cpu.tv_sec + (double)cpu.tv_nsec / NS_PER_S;
+}
+
+static double processCpuSeconds(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+		+ (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+static void sleepUntil(int64_t deadline)
+{
+	struct timespec time = { .tv_sec = deadline / NS_PER_S, .tv_nsec = deadline % NS_PER_S };
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) == EINTR)
+		;
+}
+
+/* the DTL of a time, the date and time of day only worked out again when the second changes */
+static void plcTimestamp(int64_t time, DTL_data_t *timestamp)
+{
+	static time_t second = -1;
+	static DTL_data_t civil_time;
+	time_t now = (time_t)(time / NS_PER_S);
+
+	if(now != second) {
+		struct tm civil;
+		gmtime_r(&now, &civil);
+
+		civil_time.year    = (uint16_t)(civil.tm_year + 1900);
+		civil_time.month   = (uint8_t)(civil.tm_mon + 1);
+		civil_time.day     = (uint8_t)civil.tm_mday;
+		/* DTL counts from Sunday as 1 */
+		civil_time.weekday = (uint8_t)(civil.tm_wday + 1);
+		civil_time.hour    = (uint8_t)civil.tm_hour;
+		civil_time.minute  = (uint8_t)civil.tm_min;
+		civil_time.second  = (uint8_t)civil.tm_sec;
+		second = now;
+	}
+
+	*timestamp = civil_time;
+	timestamp->nanosecond = (uint32_t)(time % NS_PER_S);
+}
+
+/* xorshift, as anything will do for words that change at random */
+static uint32_t randomWord(void)
+{
+	static uint32_t state = 2463534242u;
+
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+
+	return state;
+}
+
+static void changeWords(change_pattern_t pattern, uint64_t entry, uint16_t *words)
+{
+	switch(pattern) {
+	case PATTERN_STATIC:
+		break;
+	case PATTERN_COUNTER:
+		words[0]++;
+		break;
+	case PATTERN_WALK:
+		words[entry % WORD_COUNT]++;
+		break;
+	case PATTERN_RANDOM:
+		for(int i = 0; i < WORD_COUNT; i++) {
+			words[i] = (uint16_t)randomWord();
+		}
+		break;
+	}
+}
+
+/*
+Offer entries at the rate until the run is over, as the cyclic thread
+would, timing each call to addLogEntry
+*/
+static void *producerMain(void *arg)
+{
+	const bench_options_t *options = bench.options;
+	run_result_t *result = bench.result;
+
+	/* its wakeups of the logging thread are not disk writes */
+	writeFaultsExempt();
+
+	int64_t period = NS_PER_S / bench.rate;
+	int64_t plc_step = period * options->accelerate;
+	bool spin = period < SPIN_BELOW_NS;
+
+	static uint16_t words[WORD_COUNT];
+	DTL_data_t timestamp;
+
+	log_buffer_stats_t stats;
+	getLogBufferStats(&stats);
+	/* the number the next entry taken in will have */
+	size_t next_entry = stats.added;
+
+	double cpu_start = threadCpuSeconds();
+	int64_t start = monotonicNow();
+	int64_t end = start + (int64_t)(options->seconds * NS_PER_S);
+	int64_t due = start;
+
+	while(due < end) {
+		if(spin) {
+			while(monotonicNow() < due)
+				;
+		}
+		else {
+			sleepUntil(due);
+		}
+
+		changeWords(options->pattern, result->offered, words);
+		bench.plc_time += plc_step;
+		plcTimestamp(bench.plc_time, &timestamp);
+
+		/* noted before it is offered, as the logger may have written it by the time the call returns */
+		int64_t before = monotonicNow();
+		bench.offered_at[next_entry % OFFERED_RING] = before;
+		int ret = addLogEntry(&timestamp, (const uint8_t *)words, WORD_COUNT);
+		int64_t after = monotonicNow();
+
+		histogramAdd(&result->enqueue, after - before);
+		result->offered++;
+
+		if(ret == 0) {
+			next_entry++;
+		}
+		else {
+			result->dropped++;
+		}
+
+		/* if it fell behind, the entries due meanwhile go back to back, so the rate holds over the run */
+		due += period;
+	}
+
+	result->seconds = (double)(monotonicNow() - start) / NS_PER_S;
+	result->producer_cpu = threadCpuSeconds() - cpu_start;
+
+
+	return NULL;
+}
+
+/*
+Follow how far the logger has got, timing each entry from being offered
+to being handed to the kernel
+*/
+static void *monitorMain(void *arg)
+{
+	run_result_t *result = bench.result;
+
+	log_buffer_stats_t stats;
+	getLogBufferStats(&stats);
+	size_t written = stats.written;
+
+	double cpu_start = threadCpuSeconds();
+	int64_t due = monotonicNow();
+
+	while(atomic_load(&bench.monitoring)) {
+		due += MONITOR_INTERVAL_NS;
+		sleepUntil(due);
+
+		getLogBufferStats(&stats);
+		int64_t now = monotonicNow();
+
+		for(; written != stats.written; written++) {
+			histogramAdd(&result->latency, now - bench.offered_at[written % OFFERED_RING]);
+		}
+
+		if(stats.added - stats.written > result->peak_pending) {
+			result->peak_pending = stats.added - stats.written;
+		}
+
+		/* if it fell behind it carries on from now, rather than trying to make up the samples */
+		if(due < now) {
+			due = now;
+		}
+	}
+
+	result->monitor_cpu = threadCpuSeconds() - cpu_start;
+
+	return NULL;
+}
+
+static int startProducer(pthread_t *thread, int priority)
+{
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+
+	if(priority > 0) {
+		struct sched_param param = { .sched_priority = priority };
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+	}
+
+	int ret = pthread_create(thread, &attr, producerMain, NULL);
+	pthread_attr_destroy(&attr);
+
+	if(ret != 0) {
+		printf("Error: Could not start the producer%s (%s).\n",
+			(priority > 0) ? " with SCHED_FIFO" : "", strerror(ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* wait for the logger to write all it has taken in, 0 once it has, -1 if it gave up */
+static int drain(int64_t deadline)
+{
+	log_buffer_stats_t stats;
+
+	do {
+		getLogBufferStats(&stats);
+		if(stats.written == stats.added)
+			return 0;
+
+		sleepUntil(monotonicNow() + 1000000);
+	} while(monotonicNow() < deadline);
+
+	return -1;
+}
+
+static int runRate(const bench_options_t *options, long rate, run_result_t *result)
+{
+	memset(result, 0, sizeof(*result));
+	result->rate = rate;
+	histogramInit(&result->enqueue);
+	histogramInit(&result->latency);
+
+	bench.rate = rate;
+	bench.result = result;
+
+	log_buffer_stats_t before;
+	getLogBufferStats(&before);
+	write_faults_stats_t faults_before;
+	writeFaultsStats(&faults_before);
+	double process_start = processCpuSeconds();
+
+	int64_t start = monotonicNow();
+	int64_t no_space_end = start;
+	if(options->no_space_length > 0) {
+		int64_t from = start + (int64_t)(options->no_space_start * NS_PER_S);
+		no_space_end = from + (int64_t)(options->no_space_length * NS_PER_S);
+		writeFaultsNoSpace(from, no_space_end);
+	}
+
+	atomic_store(&bench.monitoring, true);
+
+	pthread_t monitor;
+	if(pthread_create(&monitor, NULL, monitorMain, NULL) != 0) {
+		printf("Error: Could not start the monitor.\n");
+		return -1;
+	}
+
+	pthread_t producer;
+	if(startProducer(&producer, options->priority) == -1) {
+		atomic_store(&bench.monitoring, false);
+		pthread_join(monitor, NULL);
+		return -1;
+	}
+	pthread_join(producer, NULL);
+
+	/* the entries still pending are part of the run, however long they take */
+	int64_t deadline = ((no_space_end > monotonicNow()) ? no_space_end : monotonicNow()) + DRAIN_TIMEOUT_S * NS_PER_S;
+	drain(deadline);
+
+	atomic_store(&bench.monitoring, false);
+	pthread_join(monitor, NULL);
+	writeFaultsNoSpace(0, 0);
+
+	log_buffer_stats_t after;
+	getLogBufferStats(&after);
+	write_faults_stats_t faults_after;
+	writeFaultsStats(&faults_after);
+
+	result->process_cpu = processCpuSeconds() - process_start;
+	result->unwritten = after.added - after.written;
+	result->low_space = after.low_space - before.low_space;
+	result->faults.calls = faults_after.calls - faults_before.calls;
+	result->faults.stalls = faults_after.stalls - faults_before.stalls;
+	result->faults.no_space = faults_after.no_space - faults_before.no_space;
+
+	return 0;
+}
+
+static void printPercentiles(const char *name, const latency_histogram_t *histogram, const char *unit, double scale)
+{
+	printf("   %-15s p50 %.1f, p99 %.1f, p99.9 %.1f, p99.99 %.1f, max %.1f %s\n",
+		name,
+		(double)histogramPercentile(histogram, 50.0) / scale,
+		(double)histogramPercentile(histogram, 99.0) / scale,
+		(double)histogramPercentile(histogram, 99.9) / scale,
+		(double)histogramPercentile(histogram, 99.99) / scale,
+		(double)histogram->max / scale,
+		unit);
+}
+
+static void printResult(const bench_options_t *options, const run_result_t *result)
+{
+	double seconds = (result->seconds > 0) ? result->seconds : 1;
+
+	printf("\n%ld Hz for %.1f s, %s words: %llu entries offered, at %.1f Hz\n",
+		result->rate,
+		result->seconds,
+		pattern_names[options->pattern],
+		(unsigned long long)result->offered,
+		(double)result->offered / seconds);
+	printf("   %-15s %llu (%.3f%%)",
+		"dropped",
+		(unsigned long long)result->dropped,
+		(result->offered != 0) ? 100.0 * (double)result->dropped / (double)result->offered : 0.0);
+	if(result->unwritten != 0) {
+		printf(", and %llu never written", (unsigned long long)result->unwritten);
+	}
+	printf("\n");
+	printf("   %-15s peak %zu of %d pending, ran low %u times\n",
+		"entry buffer", result->peak_pending, ENTRY_BUFFER_COUNT, result->low_space);
+	printPercentiles("enqueue", &result->enqueue, "ns", 1.0);
+	printPercentiles("end to end", &result->latency, "us", 1000.0);
+
+	/* the logger is whatever the process used that the producer and monitor did not */
+	double logger_cpu = result->process_cpu - result->producer_cpu - result->monitor_cpu;
+	printf("   %-15s producer %.1f%%, logger %.1f%%, whole process %.1f%% of a core\n",
+		"cpu",
+		100.0 * result->producer_cpu / seconds,
+		100.0 * (logger_cpu > 0 ? logger_cpu : 0) / seconds,
+		100.0 * result->process_cpu / seconds);
+	printf("   %-15s %llu calls, %llu stalled, %llu failed with ENOSPC\n",
+		"writes",
+		(unsigned long long)result->faults.calls,
+		(unsigned long long)result->faults.stalls,
+		(unsigned long long)result->faults.no_space);
+
+	printf("   enqueue time:\n");
+	histogramPrint(&result->enqueue, stdout, "ns", 1);
+	printf("   end to end latency:\n");
+	histogramPrint(&result->latency, stdout, "us", 1000);
+
+	/* one line to pick out in scripts */
+	printf("result rate=%ld offered=%llu dropped=%llu unwritten=%llu enqueue_p999_ns=%lld latency_p999_us=%.1f"
+		" producer_cpu=%.1f logger_cpu=%.1f\n",
+		result->rate,
+		(unsigned long long)result->offered,
+		(unsigned long long)result->dropped,
+		(unsigned long long)result->unwritten,
+		(long long)histogramPercentile(&result->enqueue, 99.9),
+		(double)histogramPercentile(&result->latency, 99.9) / 1000.0,
+		100.0 * result->producer_cpu / seconds,
+		100.0 * (logger_cpu > 0 ? logger_cpu : 0) / seconds);
+}
+
+/* whether a run stayed within the limits, saying which it went over */
+static bool withinLimits(const bench_options_t *options, const run_result_t *result)
+{
+	bool within = true;
+
+	if(options->max_drops != 0 && result->dropped + result->unwritten > options->max_drops) {
+		printf("Over the limit: %llu entries lost at %ld Hz, at most %lu allowed\n",
+			(unsigned long long)(result->dropped + result->unwritten), result->rate, options->max_drops);
+		within = false;
+	}
+
+	int64_t enqueue = histogramPercentile(&result->enqueue, 99.9);
+	if(options->max_enqueue_ns != 0 && enqueue > options->max_enqueue_ns) {
+		printf("Over the limit: p99.9 enqueue %lld ns at %ld Hz, at most %lld allowed\n",
+			(long long)enqueue, result->rate, (long long)options->max_enqueue_ns);
+		within = false;
+	}
+
+	int64_t latency = histogramPercentile(&result->latency, 99.9);
+	if(options->max_latency_ns != 0 && latency > options->max_latency_ns) {
+		printf("Over the limit: p99.9 end to end %.1f us at %ld Hz, at most %.1f allowed\n",
+			(double)latency / 1000.0, result->rate, (double)options->max_latency_ns / 1000.0);
+		within = false;
+	}
+
+	return within;
+}
+
+/* days before today, each with a log's worth of bytes, for running out of space to clear */
+static int makeOldDays(const char *directory, int count, int64_t today)
+{
+	static uint8_t filler[ENTRY_RECORD_SIZE * 1024];
+
+	for(int i = count; i > 0; i--) {
+		time_t day = (time_t)(today / NS_PER_S) - (time_t)i * 86400;
+		struct tm civil;
+		gmtime_r(&day, &civil);
+
+		char path[PATH_MAX];
+		int length = snprintf(path, sizeof(path), "%s/%04d%02d%02d",
+			directory, civil.tm_year + 1900, civil.tm_mon + 1, civil.tm_mday);
+		if(length < 0 || (size_t)length + sizeof("/00-00.bin") > sizeof(path))
+			return -1;
+
+		if(mkdir(path, 0755) == -1 && errno != EEXIST)
+			return -1;
+
+		strcat(path, "/00-00.bin");
+		int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd == -1)
+			return -1;
+
+		int ret = (write(fd, filler, sizeof(filler)) == (ssize_t)sizeof(filler)) ? 0 : -1;
+		close(fd);
+		if(ret == -1)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int removeEntry(const char *path, const struct stat *statbuf, int type, struct FTW *ftw)
+{
+	return remove(path);
+}
+
+/* HZ[,HZ...], 0 on success, -1 on error */
+static int parseRates(const char *text, bench_options_t *options)
+{
+	options->rate_count = 0;
+
+	while(true) {
+		char *end;
+		errno = 0;
+		long rate = strtol(text, &end, 10);
+		if(end == text || errno != 0 || rate < 1 || rate > RATE_MAX || options->rate_count == RATES_MAX)
+			return -1;
+
+		options->rates[options->rate_count++] = rate;
+
+		if(*end == '\0')
+			return 0;
+		if(*end != ',')
+			return -1;
+		text = end + 1;
+	}
+}
+
+/* A:B as two numbers, 0 on success, -1 on error */
+static int parsePair(const char *text, double *first, double *second)
+{
+	char *end;
+
+	*first = strtod(text, &end);
+	if(end == text || *end != ':' || *first < 0)
+		return -1;
+
+	text = end + 1;
+	*second = strtod(text, &end);
+	if(end == text || *end != '\0' || *second <= 0)
+		return -1;
+
+	return 0;
+}
+
+static void showUsage(void)
+{
+	printf("Benchmark the logger, from addLogEntry to disk\n");
+	printf("\n");
+	printf("Usage:\n");
+	printf("   logbench [-r HZ[,HZ...]] [-t SECONDS] [-p PATTERN] [-a FACTOR]\n");
+	printf("            [-d US] [--stall EVERY:MS] [--no-space START:LENGTH] [-k DAYS]\n");
+	printf("            [-w ENTRIES] [-l MS] [-u] [-o BYTES] [-y KIB] [-c]\n");
+	printf("            [-P PRIORITY] [-D DIR [--keep]] [--max-drops N]\n");
+	printf("            [--max-enqueue NS] [--max-latency US] [-v]\n");
+	printf("\n");
+	printf("   -r, --rate HZ[,HZ...]\n");
+	printf("                Offer entries at HZ, 1 to %d, one run at each.\n", RATE_MAX);
+	printf("                Defaults to %d\n", DEFAULT_RATE);
+	printf("   -t, --time SECONDS\n");
+	printf("                How long each run lasts. Defaults to %d\n", DEFAULT_TIME_S);
+	printf("   -p, --pattern PATTERN\n");
+	printf("                How the words change from entry to entry: static,\n");
+	printf("                counter (word 0 counts up), walk (one word each\n");
+	printf("                entry, each in turn) or random (all of them).\n");
+	printf("                Defaults to walk\n");
+	printf("   -a, --accelerate FACTOR\n");
+	printf("                Run the PLC clock FACTOR times as fast, so logs\n");
+	printf("                are started every %d/FACTOR s. Defaults to 1\n", LOG_FILE_PERIOD_S);
+	printf("   -d, --delay US\n");
+	printf("                Hold up every write and sync of the logger by US\n");
+	printf("   --stall EVERY:MS\n");
+	printf("                Hold up every EVERYth one by MS more, as a card\n");
+	printf("                does now and then\n");
+	printf("   --no-space START:LENGTH\n");
+	printf("                Fail writes with ENOSPC for LENGTH seconds, from\n");
+	printf("                START seconds into each run\n");
+	printf("   -k, --old-days DAYS\n");
+	printf("                Start with DAYS days of logs before today, for\n");
+	printf("                running out of space to clear\n");
+	printf("   -w ENTRIES   Wake the logging thread when this many entries are\n");
+	printf("                pending. Defaults to %d\n", LOG_WAKE_ENTRIES);
+	printf("   -l MS        Longest time an entry may wait before the logging\n");
+	printf("                thread picks it up. Defaults to %d\n", LOG_MAX_LATENCY_MS);
+#if LOGGER_USE_IO_URING
+	printf("   -u           Write log files through io_uring. Writes are then\n");
+	printf("                not held up or failed\n");
+#endif
+	printf("   -o BYTES     Write log files with O_DIRECT, in blocks of BYTES\n");
+	printf("   -y KIB       Start writing out log data every KIB kilobytes\n");
+	printf("   -c           Write compact logs\n");
+	printf("   -P, --priority PRIORITY\n");
+	printf("                Offer entries from a SCHED_FIFO thread of this\n");
+	printf("                priority, as the cyclic thread is\n");
+	printf("   -D, --dir DIR\n");
+	printf("                Write logs to DIR, which must exist. Defaults to a\n");
+	printf("                new directory here, removed afterwards unless --keep\n");
+	printf("   --max-drops N, --max-enqueue NS, --max-latency US\n");
+	printf("                Fail if a run loses more than N entries, or its\n");
+	printf("                p99.9 enqueue time or end to end latency is longer\n");
+	printf("   -v           Increase verbosity of the logger, which only reports\n");
+	printf("                errors otherwise. -v adds the warnings of dropped\n");
+	printf("                entries\n");
+	printf("   -h           Show this help\n");
+	printf("\n");
+	printf("Each run offers entries to addLogEntry from a thread of their own,\n");
+	printf("at the rate, the way the cyclic thread does. The enqueue time is how\n");
+	printf("long addLogEntry took; the end to end latency, how long from being\n");
+	printf("offered until the logger had handed the entry to the kernel, to\n");
+	printf("within %d us. The logger's CPU time is what the process used besides\n", MONITOR_INTERVAL_NS / 1000);
+	printf("the producer and the thread timing it. The runs share a logger, one\n");
+	printf("after another, as it can not be stopped.\n");
+	printf("\n");
+	printf("Exits with 1 if any run went over a limit, so it can stand guard in\n");
+	printf("continuous integration.\n");
+}
+
+int main(int argc, char *argv[])
+{
+	bench_options_t options = {
+		.rates = { DEFAULT_RATE },
+		.rate_count = 1,
+		.seconds = DEFAULT_TIME_S,
+		.pattern = PATTERN_WALK,
+		.accelerate = 1,
+	};
+	log_policy_t policy = {
+		.wake_entries = LOG_WAKE_ENTRIES,
+		.max_latency_ms = LOG_MAX_LATENCY_MS,
+		.compression_level = LOG_COMPRESSION_LEVEL,
+		.format = LOG_FORMAT_PLAIN,
+	};
+	write_faults_t faults = {0};
+	int verbosity = 0;
+	int option;
+
+	enum {
+		OPTION_STALL = 256,
+		OPTION_NO_SPACE,
+		OPTION_KEEP,
+		OPTION_MAX_DROPS,
+		OPTION_MAX_ENQUEUE,
+		OPTION_MAX_LATENCY,
+	};
+
+	static const struct option long_options[] = {
+		{"rate", required_argument, NULL, 'r'},
+		{"time", required_argument, NULL, 't'},
+		{"pattern", required_argument, NULL, 'p'},
+		{"accelerate", required_argument, NULL, 'a'},
+		{"delay", required_argument, NULL, 'd'},
+		{"stall", required_argument, NULL, OPTION_STALL},
+		{"no-space", required_argument, NULL, OPTION_NO_SPACE},
+		{"old-days", required_argument, NULL, 'k'},
+		{"priority", required_argument, NULL, 'P'},
+		{"dir", required_argument, NULL, 'D'},
+		{"keep", no_argument, NULL, OPTION_KEEP},
+		{"max-drops", required_argument, NULL, OPTION_MAX_DROPS},
+		{"max-enqueue", required_argument, NULL, OPTION_MAX_ENQUEUE},
+		{"max-latency", required_argument, NULL, OPTION_MAX_LATENCY},
+		{NULL, 0, NULL, 0},
+	};
+
+	while((option = getopt_long(argc, argv, "hvr:t:p:a:d:k:w:l:uo:y:cP:D:", long_options, NULL)) != -1) {
+		double first, second;
+
+		switch(option) {
+		case 'r':
+			if(parseRates(optarg, &options) == -1) {
+				printf("Error: The argument to -r must be rates of 1-%d Hz, as 1000,10000.\n", RATE_MAX);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 't':
+			options.seconds = atof(optarg);
+			if(options.seconds <= 0) {
+				printf("Error: The argument to -t must be positive.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'p':
+			options.pattern = (change_pattern_t)-1;
+			for(size_t i = 0; i < sizeof(pattern_names) / sizeof(pattern_names[0]); i++) {
+				if(strcmp(optarg, pattern_names[i]) == 0) {
+					options.pattern = (change_pattern_t)i;
+				}
+			}
+			if(options.pattern == (change_pattern_t)-1) {
+				printf("Error: The argument to -p must be static, counter, walk or random.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'a':
+			options.accelerate = atoi(optarg);
+			if(options.accelerate < 1) {
+				printf("Error: The argument to -a must be positive.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'd':
+			faults.delay_ns = (int64_t)atol(optarg) * 1000;
+			if(faults.delay_ns < 0) {
+				printf("Error: The argument to -d must not be negative.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case OPTION_STALL:
+			if(parsePair(optarg, &first, &second) == -1 || first < 1 || first > UINT32_MAX) {
+				printf("Error: The argument to --stall must be EVERY:MS, as 1000:50.\n");
+				return EXIT_FAILURE;
+			}
+			faults.stall_every = (uint32_t)first;
+			faults.stall_ns = (int64_t)(second * 1000000);
+			break;
+		case OPTION_NO_SPACE:
+			if(parsePair(optarg, &options.no_space_start, &options.no_space_length) == -1) {
+				printf("Error: The argument to --no-space must be START:LENGTH in seconds, as 2:0.5.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'k':
+			options.old_days = atoi(optarg);
+			if(options.old_days < 1) {
+				printf("Error: The argument to -k must be positive.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'w':
+			policy.wake_entries = (size_t)atoi(optarg);
+			if(policy.wake_entries < 1 || policy.wake_entries > ENTRY_BUFFER_COUNT) {
+				printf("Error: The argument to -w must be 1-%d.\n", ENTRY_BUFFER_COUNT);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'l':
+			if(atoi(optarg) < 1) {
+				printf("Error: The argument to -l must be positive.\n");
+				return EXIT_FAILURE;
+			}
+			policy.max_latency_ms = (uint32_t)atoi(optarg);
+			break;
+#if LOGGER_USE_IO_URING
+		case 'u':
+			policy.use_io_uring = true;
+			break;
+#endif
+		case 'o':
+			policy.direct_block_size = (size_t)atol(optarg);
+			break;
+		case 'y':
+			if(atoi(optarg) < 1) {
+				printf("Error: The argument to -y must be positive.\n");
+				return EXIT_FAILURE;
+			}
+			policy.sync_interval = (size_t)atoi(optarg) * 1024;
+			break;
+		case 'c':
+			policy.format = LOG_FORMAT_COMPACT;
+			break;
+		case 'P':
+			options.priority = atoi(optarg);
+			if(options.priority < sched_get_priority_min(SCHED_FIFO)
+				|| options.priority > sched_get_priority_max(SCHED_FIFO)) {
+				printf("Error: The argument to -P must be %d-%d.\n",
+					sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'D':
+			options.directory = optarg;
+			break;
+		case OPTION_KEEP:
+			options.keep = true;
+			break;
+		case OPTION_MAX_DROPS:
+			options.max_drops = strtoul(optarg, NULL, 10);
+			break;
+		case OPTION_MAX_ENQUEUE:
+			options.max_enqueue_ns = atol(optarg);
+			break;
+		case OPTION_MAX_LATENCY:
+			options.max_latency_ns = (int64_t)atol(optarg) * 1000;
+			break;
+		case 'v':
+			verbosity++;
+			break;
+		case 'h':
+		default:
+			showUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(optind != argc) {
+		showUsage();
+		return EXIT_FAILURE;
+	}
+
+	/* errors from the start, as a benchmark that hides them is no use */
+	app_log_set_log_level((verbosity <= APP_LOG_LEVEL_ERROR) ? APP_LOG_LEVEL_ERROR - verbosity : APP_LOG_LEVEL_DEBUG);
+
+	/* the default leaves the logs of a run behind only when asked to */
+	char made[] = "logbench-XXXXXX";
+	const char *directory = options.directory;
+	if(directory == NULL) {
+		directory = mkdtemp(made);
+		if(directory == NULL) {
+			printf("Error: Could not make a directory for the logs (%s).\n", strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	struct timespec wall;
+	clock_gettime(CLOCK_REALTIME, &wall);
+	/* the PLC clock starts now, by UTC, on a whole second */
+	bench.plc_time = (int64_t)wall.tv_sec * NS_PER_S;
+
+	if(options.old_days > 0 && makeOldDays(directory, options.old_days, bench.plc_time) == -1) {
+		printf("Error: Could not make the old days in %s (%s).\n", directory, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if(setLogDirectory(directory) == -1 || setLogPolicy(&policy) == -1 || startLogger() == -1) {
+		return EXIT_FAILURE;
+	}
+	writeFaultsSet(&faults);
+
+	bench.options = &options;
+	bench.offered_at = calloc(OFFERED_RING, sizeof(*bench.offered_at));
+	if(bench.offered_at == NULL) {
+		printf("Error: Out of memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	/* the first entry starts the first log, which is no part of a run */
+	DTL_data_t timestamp;
+	static const uint8_t first_words[APP_GSDML_VAR64_DATA_DIGITAL_SIZE];
+	plcTimestamp(bench.plc_time, &timestamp);
+	if(addLogEntry(&timestamp, first_words, WORD_COUNT) == -1 || drain(monotonicNow() + DRAIN_TIMEOUT_S * NS_PER_S) == -1) {
+		printf("Error: The logger did not start, see -v.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Logging to %s\n", directory);
+
+	bool within = true;
+	for(int i = 0; i < options.rate_count; i++) {
+		run_result_t result;
+
+		if(runRate(&options, options.rates[i], &result) == -1)
+			return EXIT_FAILURE;
+
+		printResult(&options, &result);
+		within = withinLimits(&options, &result) && within;
+	}
+
+	/* the logger is still running, but gets no more entries */
+	if(options.directory == NULL && !options.keep) {
+		nftw(directory, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+	}
+
+	free(bench.offered_at);
+
+	return within ? EXIT_SUCCESS : EXIT_FAILURE;
+}
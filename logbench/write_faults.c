@@ -0,0 +1,144 @@
+#define _GNU_SOURCE /* For __thread */
+
+#include "write_faults.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include <unistd.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <time.h>
+
+/* the calls --wrap stands in for */
+ssize_t __real_write(int fd, const void *data, size_t length);
+ssize_t __real_writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t __real_pwrite(int fd, const void *data, size_t length, off_t offset);
+int __real_fsync(int fd);
+int __real_fdatasync(int fd);
+
+ssize_t __wrap_write(int fd, const void *data, size_t length);
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t __wrap_pwrite(int fd, const void *data, size_t length, off_t offset);
+int __wrap_fsync(int fd);
+int __wrap_fdatasync(int fd);
+
+static write_faults_t faults;
+static atomic_llong noSpaceFrom;
+static atomic_llong noSpaceUntil;
+
+static atomic_ullong calls;
+static atomic_ullong stalls;
+static atomic_ullong noSpace;
+
+static __thread bool exempt = false;
+
+void writeFaultsSet(const write_faults_t *new_faults)
+{
+	faults = *new_faults;
+}
+
+void writeFaultsNoSpace(int64_t from, int64_t until)
+{
+	/* closed first, so the window is never briefly open at the wrong times */
+	atomic_store(&noSpaceUntil, 0);
+	atomic_store(&noSpaceFrom, from);
+	atomic_store(&noSpaceUntil, until);
+}
+
+void writeFaultsExempt(void)
+{
+	exempt = true;
+}
+
+void writeFaultsStats(write_faults_stats_t *stats)
+{
+	stats->calls    = atomic_load_explicit(&calls, memory_order_relaxed);
+	stats->stalls   = atomic_load_explicit(&stalls, memory_order_relaxed);
+	stats->no_space = atomic_load_explicit(&noSpace, memory_order_relaxed);
+}
+
+static void sleepFor(int64_t ns)
+{
+	struct timespec time = { .tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000 };
+	
+	while(clock_nanosleep(CLOCK_MONOTONIC, 0, &time, &time) == EINTR)
+		;
+}
+
+/* hold the call up as set, returning whether it should fail for want of space */
+static bool holdUp(bool writing)
+{
+	if(exempt)
+		return false;
+	
+	uint64_t call = atomic_fetch_add_explicit(&calls, 1, memory_order_relaxed) + 1;
+	int64_t delay = faults.delay_ns;
+	
+	if(faults.stall_every != 0 && call % faults.stall_every == 0) {
+		atomic_fetch_add_explicit(&stalls, 1, memory_order_relaxed);
+		delay += faults.stall_ns;
+	}
+	
+	if(delay > 0) {
+		sleepFor(delay);
+	}
+	
+	if(!writing)
+		return false;
+	
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long ns = (long long)now.tv_sec * 1000000000 + now.tv_nsec;
+	
+	if(ns >= atomic_load(&noSpaceFrom) && ns < atomic_load(&noSpaceUntil)) {
+		atomic_fetch_add_explicit(&noSpace, 1, memory_order_relaxed);
+		return true;
+	}
+	
+	return false;
+}
+
+ssize_t __wrap_write(int fd, const void *data, size_t length)
+{
+	if(holdUp(true)) {
+		errno = ENOSPC;
+		return -1;
+	}
+	
+	return __real_write(fd, data, length);
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	if(holdUp(true)) {
+		errno = ENOSPC;
+		return -1;
+	}
+	
+	return __real_writev(fd, iov, iovcnt);
+}
+
+ssize_t __wrap_pwrite(int fd, const void *data, size_t length, off_t offset)
+{
+	if(holdUp(true)) {
+		errno = ENOSPC;
+		return -1;
+	}
+	
+	return __real_pwrite(fd, data, length, offset);
+}
+
+int __wrap_fsync(int fd)
+{
+	holdUp(false);
+	
+	return __real_fsync(fd);
+}
+
+int __wrap_fdatasync(int fd)
+{
+	holdUp(false);
+	
+	return __real_fdatasync(fd);
+}
@@ -0,0 +1,71 @@
+#ifndef WRITE_FAULTS_H
+#define WRITE_FAULTS_H
+
+/**
+ * @file
+ * @brief Slow and failing writes, for the logger to run into
+ *
+ * logbench is linked with --wrap for write, writev, pwrite, fsync and fdatasync,
+ * so the logger's calls to them come here first. Each is held up by the
+ * delay, and every so often by a longer stall, as a slow card would;
+ * within the no space window, writes fail with ENOSPC as on a full disk.
+ * Only blocking I/O is covered, not io_uring's.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct write_faults
+{
+	/* added to every call */
+	int64_t delay_ns;
+	/* every this many calls, 0 for never, one is held up stall_ns more */
+	uint32_t stall_every;
+	int64_t stall_ns;
+} write_faults_t;
+
+typedef struct write_faults_stats
+{
+	uint64_t calls;
+	uint64_t stalls;
+	/* writes failed with ENOSPC */
+	uint64_t no_space;
+} write_faults_stats_t;
+
+/**
+ * Set how writes are held up, before any are made
+ *
+ * @param faults           In
+ */
+void writeFaultsSet(const write_faults_t *faults);
+
+/**
+ * Fail writes with ENOSPC between two times. Safe to call while writes
+ * are being made.
+ *
+ * @param from             In:    CLOCK_MONOTONIC, in nanoseconds
+ * @param until            In:    as from; from == until for no window
+ */
+void writeFaultsNoSpace(int64_t from, int64_t until);
+
+/**
+ * Let the calling thread's writes through untouched, as the producer's
+ * wakeups of the logging thread should be
+ */
+void writeFaultsExempt(void);
+
+/**
+ * Read what has been done to writes so far
+ *
+ * @param stats            Out
+ */
+void writeFaultsStats(write_faults_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WRITE_FAULTS_H */
@@ -174,11 +174,11 @@ int app_data_read_parameter (
 }
 
 int app_read_log_data(
-	DTL_data_t *data_timestamp,
-	uint8_t data_variables[APP_GSDML_VAR64_DATA_DIGITAL_SIZE])
+	const DTL_data_t **data_timestamp,
+	const uint8_t **data_variables)
 {
-	*data_timestamp = PLCtimestamp;
-	memcpy(data_variables, variabledata, APP_GSDML_VAR64_DATA_DIGITAL_SIZE);
+	*data_timestamp = &PLCtimestamp;
+	*data_variables = variabledata;
 	
 	return 0;
 }
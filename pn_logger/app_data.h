@@ -145,12 +145,16 @@ int app_data_read_parameter (
 /**
  * Read out log data
  *
- * @param data_timestamp   Out
- * @param data_variables   Out
+ * Gives the latest data in place rather than copying it, so it is only
+ * valid until the next call to app_data_set_output_data.
+ *
+ * @param data_timestamp   Out:   Latest PLC timestamp
+ * @param data_variables   Out:   Latest variables,
+ *                                APP_GSDML_VAR64_DATA_DIGITAL_SIZE bytes
  */
 int app_read_log_data(
-	DTL_data_t *data_timestamp,
-	uint8_t data_variables[APP_GSDML_VAR64_DATA_DIGITAL_SIZE]);
+	const DTL_data_t **data_timestamp,
+	const uint8_t **data_variables);
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,7 @@
 #define APP_EVENT_TIMER          BIT (1)
 #define APP_EVENT_ALARM          BIT (2)
 #define APP_EVENT_SM_RELEASED    BIT (3)
+#define APP_EVENT_RPC            BIT (4)
 #define APP_EVENT_ABORT          BIT (15)
 
 /* Defines used for alarm demo functionality */
@@ -191,6 +192,9 @@ int app_start (app_data_t * app, app_run_in_separate_task_t task_config)
       return -1;
    }
 
+   /* Datagrams may have arrived since pnet_init(), with no one to tell */
+   os_event_set (app->main_events, APP_EVENT_RPC);
+
    if (task_config == RUN_IN_SEPARATE_THREAD)
    {
       os_thread_create (
@@ -568,6 +572,22 @@ static int app_signal_led_ind (pnet_t * net, void * arg, bool led_state)
    return 0;
 }
 
+/**
+ * Callback for RPC datagrams that have arrived.
+ *
+ * Called from a thread of p-net, or from pnet_handle_rpc() in the main
+ * loop when there is more to handle, so it only wakes the main loop.
+ */
+static void app_rpc_ready_ind (pnet_t * net, void * arg)
+{
+   app_data_t * app = (app_data_t *)arg;
+
+   if (app->main_events != NULL)
+   {
+      os_event_set (app->main_events, APP_EVENT_RPC);
+   }
+}
+
 static int app_exp_module_ind (
    pnet_t * net,
    void * arg,
@@ -1221,16 +1241,17 @@ static void app_handle_cyclic_data (app_data_t * app)
 
    app_utils_cyclic_data_poll (&app->main_api);
    
-   DTL_data_t PLCtimestamp;
-   uint8_t variabledata[APP_GSDML_VAR64_DATA_DIGITAL_SIZE];
+   const DTL_data_t *PLCtimestamp;
+   const uint8_t *variabledata;
    
-   app_read_log_data(&PLCtimestamp, variabledata);
+   /* no copy; the entry is serialised straight into the log buffer */
+   app_read_log_data(&PLCtimestamp, &variabledata);
    
    /*
    Probably a better way to check that there is real data,
    which wouldn't require reading this at all
    */
-   if(PLCtimestamp.year == 0) {
+   if(PLCtimestamp->year == 0) {
 	   return;
    }
    
@@ -1238,7 +1259,7 @@ static void app_handle_cyclic_data (app_data_t * app)
    static uint8_t  last_data[APP_GSDML_VAR64_DATA_DIGITAL_SIZE] = {0};
    static bool logged_last = false;
    
-   if(PLCtimestamp.nanosecond == last_ts.nanosecond) {
+   if(PLCtimestamp->nanosecond == last_ts.nanosecond) {
 	   /* reasonable to assume we haven't gone an entire second+
 	   without data then just happened upon the same nanosecond...
 	   This is not new data. */
@@ -1256,10 +1277,10 @@ static void app_handle_cyclic_data (app_data_t * app)
 	if(data_changed) {
 		if( ! logged_last )
 			addLogEntry(&last_ts, last_data, 64);
-		addLogEntry(&PLCtimestamp, variabledata, 64);
+		addLogEntry(PLCtimestamp, variabledata, 64);
 		
 		logged_last = true;
-		last_ts = PLCtimestamp;
+		last_ts = *PLCtimestamp;
 		memcpy(last_data, variabledata, APP_GSDML_VAR64_DATA_DIGITAL_SIZE);
 	}
 	else {
@@ -1287,6 +1308,7 @@ void app_pnet_cfg_init_default (pnet_cfg_t * pnet_cfg)
    pnet_cfg->reset_cb = app_reset_ind;
    pnet_cfg->signal_led_cb = app_signal_led_ind;
    pnet_cfg->sm_released_cb = app_sm_released_ind;
+   pnet_cfg->rpc_ready_cb = app_rpc_ready_ind;
 
    pnet_cfg->cb_arg = (void *)&app_state;
 }
@@ -1306,6 +1328,13 @@ static void app_handle_event_timer (app_data_t * app)
    pnet_handle_periodic (app->net);
 }
 
+static void app_handle_event_rpc (app_data_t * app)
+{
+   os_event_clr (app->main_events, APP_EVENT_RPC);
+
+   pnet_handle_rpc (app->net);
+}
+
 /**
  * Handle AR specific events.
  *
@@ -1438,7 +1467,8 @@ void app_loop_forever (void * arg)
 {
    app_data_t * app = (app_data_t *)arg;
    uint32_t mask = APP_EVENT_READY_FOR_DATA | APP_EVENT_TIMER |
-                   APP_EVENT_ALARM | APP_EVENT_SM_RELEASED | APP_EVENT_ABORT;
+                   APP_EVENT_ALARM | APP_EVENT_SM_RELEASED | APP_EVENT_RPC |
+                   APP_EVENT_ABORT;
    uint32_t flags = 0;
 
    app_set_led (APP_DATA_LED_ID, false);
@@ -1460,6 +1490,10 @@ void app_loop_forever (void * arg)
       {
          app_handle_event_ar (app, APP_EVENT_ALARM, app_ar_alarm_handler);
       }
+      if (flags & APP_EVENT_RPC)
+      {
+         app_handle_event_rpc (app);
+      }
       if (flags & APP_EVENT_TIMER)
       {
          app_handle_event_timer (app);
@@ -59,6 +59,14 @@ typedef struct app_args
    bool factory_reset;
    bool remove_files;
    app_mode_t mode;
+   int log_wake_entries;   /** Pending entries that wake the logging thread */
+   int log_max_latency_ms; /** Longest an entry waits to be picked up */
+   bool log_use_io_uring;  /** Write log files through io_uring */
+   int log_direct_block_size; /** O_DIRECT block size in bytes, 0 if off */
+   int log_sync_interval_kib; /** Start writeback this often, 0 if off */
+   int log_compression_level; /** zstd level for archiving finished days */
+   bool log_compact;          /** Write compact (version 2) logs */
+   bool eth_recv_ring;        /** Receive through a TPACKET_V3 ring */
 } app_args_t;
 
 typedef enum
@@ -0,0 +1,119 @@
+#ifndef ARCHIVE_READER_H
+#define ARCHIVE_READER_H
+
+/**
+ * @file
+ * @brief Readers for the day archives written by pn_dev
+ *
+ * Logs come out of an archive into memory, ready for logReaderInit,
+ * so nothing is extracted to disk.
+ *
+ * A .zst archive (app_filelogger_zstd.h) holds each log in a frame of its
+ * own behind an index, so any one of them can be decompressed on its own,
+ * and several at once on different threads. Only built when
+ * LOGGER_USE_ZSTD is enabled.
+ *
+ * A .tgz archive is a single gzip stream, so its logs can only be had one
+ * after another, in the order tar stored them, by streaming through it
+ * with a tgz_reader_t.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zlib.h>
+
+#include "app_filelogger_zstd.h"
+
+/* compressed data read from a .tgz at a time */
+#define TGZ_CHUNK_SIZE (128 * 1024)
+
+typedef struct tgz_reader
+{
+	const char *path;
+	int fd;
+	z_stream stream;
+	/* no more compressed data in the file */
+	bool eof;
+	/* the tar end blocks, or the end of the data, were reached */
+	bool finished;
+	uint8_t in[TGZ_CHUNK_SIZE];
+} tgz_reader_t;
+
+#if LOGGER_USE_ZSTD
+/**
+ * List the logs of a .zst archive
+ *
+ * @param path             In:    archive
+ * @param entries          Out:   its index in host byte order, to be freed
+ * @param count            Out:   number of entries
+ * @return 0 on success, -1 on error
+ */
+int zstdArchiveList(const char *path, zstd_archive_entry_t **entries, uint32_t *count);
+
+/**
+ * Decompress the start of a log in a .zst archive, or all of it
+ *
+ * @param path             In:    archive
+ * @param entry            In:    of the log, as from zstdArchiveList
+ * @param limit            In:    bytes wanted, at most entry->size are given
+ * @param data             Out:   the log, to be freed
+ * @param size             Out:   bytes in data
+ * @return 0 on success, -1 on error
+ */
+int zstdArchiveRead(
+	const char *path,
+	const zstd_archive_entry_t *entry,
+	size_t limit,
+	uint8_t **data,
+	size_t *size);
+#endif
+
+/**
+ * Start streaming a .tgz archive
+ *
+ * @param reader           Out
+ * @param path             In:    archive, kept as the name for messages
+ * @return 0 on success, -1 on error
+ */
+int tgzOpen(tgz_reader_t *reader, const char *path);
+
+/**
+ * Decompress the next log of a .tgz archive, skipping anything else
+ *
+ * Only the first limit bytes of the log are kept; the rest of it is
+ * decompressed and dropped, as the stream has to go through it anyway.
+ *
+ * @param reader           InOut
+ * @param name             Out:   of the log within the archive
+ * @param name_size        In:    room in name
+ * @param limit            In:    bytes wanted
+ * @param data             Out:   the log, to be freed
+ * @param size             Out:   bytes in data
+ * @return 1 if a log was read, 0 at the end of the archive, -1 on error
+ */
+int tgzNextLog(
+	tgz_reader_t *reader,
+	char *name,
+	size_t name_size,
+	size_t limit,
+	uint8_t **data,
+	size_t *size);
+
+/**
+ * Close a .tgz archive
+ *
+ * @param reader           In
+ */
+void tgzClose(tgz_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARCHIVE_READER_H */
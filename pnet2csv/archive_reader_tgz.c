@@ -0,0 +1,295 @@
+#include "archive_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#define TAR_BLOCK_SIZE 512
+
+/* longest name taken from a GNU long name or pax header */
+#define TAR_NAME_MAX 1024
+
+/* fields of a ustar header */
+#define TAR_NAME      0
+#define TAR_SIZE      124
+#define TAR_CHECKSUM  148
+#define TAR_TYPE      156
+#define TAR_MAGIC     257
+#define TAR_PREFIX    345
+
+/* exactly length bytes of the tar stream into out, or dropped if out is NULL; 0 on success */
+static int inflateExactly(tgz_reader_t *reader, uint8_t *out, uint64_t length)
+{
+	z_stream *stream = &reader->stream;
+	uint8_t scratch[16 * 1024];
+
+	while(length > 0) {
+		uint8_t *target = (out != NULL) ? out : scratch;
+		uint64_t room = (out != NULL) ? length : sizeof(scratch);
+		if(room > length) {
+			room = length;
+		}
+		if(room > (1U << 30)) {
+			room = 1U << 30;
+		}
+
+		stream->next_out = target;
+		stream->avail_out = room;
+
+		while(stream->avail_out > 0) {
+			if(stream->avail_in == 0) {
+				if(reader->eof) {
+					fprintf(stderr, "%s: Cut short\n", reader->path);
+					return -1;
+				}
+
+				ssize_t got = read(reader->fd, reader->in, sizeof(reader->in));
+				if(got == -1) {
+					if(errno == EINTR)
+						continue;
+					fprintf(stderr, "%s: %s\n", reader->path, strerror(errno));
+					return -1;
+				}
+				reader->eof = (got == 0);
+				stream->next_in = reader->in;
+				stream->avail_in = got;
+				continue;
+			}
+
+			int z = inflate(stream, Z_NO_FLUSH);
+			if(z == Z_STREAM_END) {
+				/* gzip members may follow one another */
+				inflateReset(stream);
+			}
+			else if(z != Z_OK) {
+				fprintf(stderr, "%s: %s\n", reader->path, stream->msg ? stream->msg : "Not gzip data");
+				return -1;
+			}
+		}
+
+		length -= room;
+		if(out != NULL) {
+			out += room;
+		}
+	}
+
+	return 0;
+}
+
+/* octal, or base 256 for large ones as GNU tar writes them */
+static uint64_t tarNumber(const uint8_t *field, size_t length)
+{
+	uint64_t value = 0;
+
+	if(field[0] & 0x80) {
+		value = field[0] & 0x3F;
+		for(size_t i = 1; i < length; i++) {
+			value = value << 8 | field[i];
+		}
+		return value;
+	}
+
+	size_t i = 0;
+	while(i < length && field[i] == ' ') {
+		i++;
+	}
+	while(i < length && field[i] >= '0' && field[i] <= '7') {
+		value = value << 3 | (field[i] - '0');
+		i++;
+	}
+
+	return value;
+}
+
+static bool checksumMatches(const uint8_t *header)
+{
+	uint64_t sum = 0;
+
+	for(int i = 0; i < TAR_BLOCK_SIZE; i++) {
+		bool in_field = (i >= TAR_CHECKSUM && i < TAR_CHECKSUM + 8);
+		sum += in_field ? ' ' : header[i];
+	}
+
+	return sum == tarNumber(header + TAR_CHECKSUM, 8);
+}
+
+static bool isZeroBlock(const uint8_t *header)
+{
+	for(int i = 0; i < TAR_BLOCK_SIZE; i++) {
+		if(header[i] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/* the path record of pax extended header data, if it has one */
+static void paxPath(const char *data, size_t length, char *name, size_t name_size)
+{
+	const char *next = data;
+	const char *end = data + length;
+
+	/* records are "LENGTH KEY=VALUE\n", LENGTH counting the whole record */
+	while(next < end) {
+		char *space;
+		unsigned long record = strtoul(next, &space, 10);
+		if(*space != ' ' || record == 0 || record > (size_t)(end - next))
+			return;
+
+		const char *key = space + 1;
+		const char *last = next + record - 1;
+		if(last > key + 5 && strncmp(key, "path=", 5) == 0) {
+			size_t value = last - (key + 5);
+			if(value >= name_size) {
+				value = name_size - 1;
+			}
+			memcpy(name, key + 5, value);
+			name[value] = '\0';
+		}
+
+		next += record;
+	}
+}
+
+/* name of a ustar header, put together from its prefix and name fields */
+static void headerName(const uint8_t *header, char *name, size_t name_size)
+{
+	char prefix[156] = "";
+	char base[101];
+
+	if(memcmp(header + TAR_MAGIC, "ustar", 5) == 0) {
+		memcpy(prefix, header + TAR_PREFIX, 155);
+		prefix[155] = '\0';
+	}
+	memcpy(base, header + TAR_NAME, 100);
+	base[100] = '\0';
+
+	snprintf(name, name_size, "%s%s%s", prefix, prefix[0] ? "/" : "", base);
+}
+
+static bool isLogName(const char *name)
+{
+	size_t length = strlen(name);
+
+	return length > 4 && strcmp(name + length - 4, ".bin") == 0;
+}
+
+int tgzOpen(tgz_reader_t *reader, const char *path)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->path = path;
+
+	reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(reader->fd == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	posix_fadvise(reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	/* 32 has zlib tell gzip from zlib headers by itself */
+	if(inflateInit2(&reader->stream, 15 + 32) != Z_OK) {
+		fprintf(stderr, "%s: Out of memory\n", path);
+		close(reader->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+int tgzNextLog(
+	tgz_reader_t *reader,
+	char *name,
+	size_t name_size,
+	size_t limit,
+	uint8_t **data,
+	size_t *size)
+{
+	/* from a GNU long name or pax header, for the member that follows it */
+	char long_name[TAR_NAME_MAX] = "";
+	char member[TAR_NAME_MAX];
+
+	while(!reader->finished) {
+		uint8_t header[TAR_BLOCK_SIZE];
+
+		if(inflateExactly(reader, header, sizeof(header)) == -1)
+			return -1;
+
+		if(isZeroBlock(header)) {
+			reader->finished = true;
+			break;
+		}
+
+		if(!checksumMatches(header)) {
+			fprintf(stderr, "%s: Not a tar archive, or a damaged one\n", reader->path);
+			return -1;
+		}
+
+		uint64_t length = tarNumber(header + TAR_SIZE, 12);
+		uint64_t padding = (TAR_BLOCK_SIZE - length % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+		char type = header[TAR_TYPE];
+
+		if(type == 'L' || type == 'x') {
+			char text[TAR_NAME_MAX + 64];
+			size_t kept = (length < sizeof(text) - 1) ? length : sizeof(text) - 1;
+
+			if(inflateExactly(reader, (uint8_t *)text, kept) == -1
+				|| inflateExactly(reader, NULL, length - kept + padding) == -1)
+				return -1;
+			text[kept] = '\0';
+
+			if(type == 'L') {
+				size_t copied = (kept < sizeof(long_name) - 1) ? kept : sizeof(long_name) - 1;
+				memcpy(long_name, text, copied);
+				long_name[copied] = '\0';
+			}
+			else {
+				paxPath(text, kept, long_name, sizeof(long_name));
+			}
+			continue;
+		}
+
+		if(long_name[0] != '\0') {
+			snprintf(member, sizeof(member), "%s", long_name);
+			long_name[0] = '\0';
+		}
+		else {
+			headerName(header, member, sizeof(member));
+		}
+
+		if((type != '0' && type != '\0') || !isLogName(member)) {
+			if(inflateExactly(reader, NULL, length + padding) == -1)
+				return -1;
+			continue;
+		}
+
+		size_t kept = (length < limit) ? length : limit;
+		uint8_t *log = malloc(kept > 0 ? kept : 1);
+		if(log == NULL) {
+			fprintf(stderr, "%s: Out of memory\n", reader->path);
+			return -1;
+		}
+
+		if(inflateExactly(reader, log, kept) == -1
+			|| inflateExactly(reader, NULL, length - kept + padding) == -1) {
+			free(log);
+			return -1;
+		}
+
+		snprintf(name, name_size, "%s", member);
+		*data = log;
+		*size = kept;
+		return 1;
+	}
+
+	return 0;
+}
+
+void tgzClose(tgz_reader_t *reader)
+{
+	inflateEnd(&reader->stream);
+	close(reader->fd);
+}
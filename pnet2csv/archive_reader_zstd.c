@@ -0,0 +1,187 @@
+#include "archive_reader.h"
+
+#include <zstd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+/* skippable frame header, then count and magic after the entries */
+#define INDEX_HEADER_SIZE 8
+#define INDEX_FOOTER_SIZE 8
+
+/* all of length at offset, 0 on success */
+static int readAt(int fd, void *data, size_t length, off_t offset)
+{
+	uint8_t *next = data;
+
+	while(length > 0) {
+		ssize_t got = pread(fd, next, length, offset);
+		if(got == -1) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		if(got == 0) {
+			errno = EIO;
+			return -1;
+		}
+		next += got;
+		length -= got;
+		offset += got;
+	}
+
+	return 0;
+}
+
+int zstdArchiveList(const char *path, zstd_archive_entry_t **entries, uint32_t *count)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	int ret = -1;
+	zstd_archive_entry_t *index = NULL;
+	struct stat statbuf;
+	uint32_t footer[2];
+	uint32_t header[2];
+
+	if(fstat(fd, &statbuf) == -1 || readAt(fd, footer, sizeof(footer), statbuf.st_size - INDEX_FOOTER_SIZE) == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		goto cleanup;
+	}
+
+	uint32_t entry_count = le32toh(footer[0]);
+	off_t index_size = (off_t)entry_count * sizeof(zstd_archive_entry_t);
+	off_t index_start = statbuf.st_size - INDEX_FOOTER_SIZE - index_size;
+	off_t frames_end = index_start - INDEX_HEADER_SIZE;
+
+	if(le32toh(footer[1]) != ZSTD_ARCHIVE_INDEX_MAGIC || frames_end < 0) {
+		fprintf(stderr, "%s: No index, not an archive written by pn_dev\n", path);
+		goto cleanup;
+	}
+
+	index = malloc(index_size > 0 ? index_size : 1);
+	if(index == NULL) {
+		fprintf(stderr, "%s: Out of memory\n", path);
+		goto cleanup;
+	}
+
+	if(readAt(fd, header, sizeof(header), frames_end) == -1 || readAt(fd, index, index_size, index_start) == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		goto cleanup;
+	}
+
+	if(le32toh(header[0]) != ZSTD_ARCHIVE_SKIPPABLE_MAGIC
+		|| le32toh(header[1]) != index_size + INDEX_FOOTER_SIZE) {
+		fprintf(stderr, "%s: Damaged index\n", path);
+		goto cleanup;
+	}
+
+	for(uint32_t i = 0; i < entry_count; i++) {
+		zstd_archive_entry_t *entry = &index[i];
+		entry->name[sizeof(entry->name) - 1] = '\0';
+		entry->offset = le64toh(entry->offset);
+		entry->compressed_size = le32toh(entry->compressed_size);
+		entry->size = le32toh(entry->size);
+
+		if(entry->offset > (uint64_t)frames_end || entry->compressed_size > frames_end - entry->offset) {
+			fprintf(stderr, "%s: Damaged index\n", path);
+			goto cleanup;
+		}
+	}
+
+	*entries = index;
+	*count = entry_count;
+	index = NULL;
+	ret = 0;
+
+cleanup:
+	free(index);
+	close(fd);
+	return ret;
+}
+
+int zstdArchiveRead(
+	const char *path,
+	const zstd_archive_entry_t *entry,
+	size_t limit,
+	uint8_t **data,
+	size_t *size)
+{
+	size_t wanted = (limit < entry->size) ? limit : entry->size;
+	size_t in_size = ZSTD_DStreamInSize();
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	uint8_t *in_buffer = malloc(in_size);
+	uint8_t *out_buffer = malloc(wanted > 0 ? wanted : 1);
+	ZSTD_DCtx *dctx = ZSTD_createDCtx();
+
+	int ret = -1;
+
+	if(fd == -1 || in_buffer == NULL || out_buffer == NULL || dctx == NULL) {
+		fprintf(stderr, "%s: Could not read %s: %s\n", path, entry->name, (fd == -1) ? strerror(errno) : "Out of memory");
+		goto cleanup;
+	}
+
+	/* the whole log is only wanted when it is about to be read through */
+	if(wanted == entry->size) {
+		posix_fadvise(fd, entry->offset, entry->compressed_size, POSIX_FADV_SEQUENTIAL);
+	}
+
+	ZSTD_outBuffer output = { out_buffer, wanted, 0 };
+	uint64_t consumed = 0;
+	size_t pending = 1;
+
+	while(output.pos < wanted && pending != 0) {
+		if(consumed == entry->compressed_size) {
+			fprintf(stderr, "%s: %s is cut short\n", path, entry->name);
+			goto cleanup;
+		}
+
+		size_t length = (entry->compressed_size - consumed < in_size) ? entry->compressed_size - consumed : in_size;
+		if(readAt(fd, in_buffer, length, entry->offset + consumed) == -1) {
+			fprintf(stderr, "%s: %s\n", path, strerror(errno));
+			goto cleanup;
+		}
+		consumed += length;
+
+		ZSTD_inBuffer input = { in_buffer, length, 0 };
+		while(input.pos < input.size && output.pos < wanted) {
+			pending = ZSTD_decompressStream(dctx, &output, &input);
+			if(ZSTD_isError(pending)) {
+				fprintf(stderr, "%s: %s: %s\n", path, entry->name, ZSTD_getErrorName(pending));
+				goto cleanup;
+			}
+			if(pending == 0)
+				break;
+		}
+	}
+
+	if(output.pos != wanted) {
+		fprintf(stderr, "%s: %s is shorter than its index says\n", path, entry->name);
+		goto cleanup;
+	}
+
+	*data = out_buffer;
+	*size = output.pos;
+	out_buffer = NULL;
+	ret = 0;
+
+cleanup:
+	ZSTD_freeDCtx(dctx);
+	free(out_buffer);
+	free(in_buffer);
+	if(fd != -1) {
+		close(fd);
+	}
+	return ret;
+}
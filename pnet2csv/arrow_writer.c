@@ -0,0 +1,382 @@
+#include "arrow_writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include "app_logformat.h"
+
+#define ARROW_MAGIC "ARROW1"
+/* marks an encapsulated message */
+#define ARROW_CONTINUATION 0xFFFFFFFF
+
+/* Schema.fbs and Message.fbs, the values used */
+#define METADATA_V5 4
+#define HEADER_SCHEMA 1
+#define HEADER_RECORD_BATCH 3
+#define TYPE_INT 2
+#define TYPE_TIMESTAMP 10
+#define TIME_UNIT_NANOSECOND 3
+
+/* of each buffer in a record batch body */
+#define BODY_ALIGNMENT 64
+
+/*
+A flatbuffer written front to back rather than back to front as the
+flatbuffers library does: a table's vtable, then the table, then what
+its offsets point to, which has to come after them. Positions are from
+the start of the flatbuffer, which is kept 8-aligned in the file, and
+fields are aligned to their size from there.
+*/
+
+typedef struct fb_table
+{
+	size_t vtable;
+	size_t start;
+} fb_table_t;
+
+static void fbTableStart(byte_buffer_t *fb, fb_table_t *table, int fields)
+{
+	bufferAlign(fb, 2);
+	table->vtable = fb->size;
+	bufferLe16(fb, 4 + 2 * fields);
+	/* size of the table, once it is known */
+	bufferLe16(fb, 0);
+	/* absent fields are 0 */
+	bufferPut(fb, NULL, 2 * fields);
+
+	bufferAlign(fb, 4);
+	table->start = fb->size;
+	bufferLe32(fb, table->start - table->vtable);
+}
+
+static void fbTableEnd(byte_buffer_t *fb, const fb_table_t *table)
+{
+	bufferSetLe16(fb, table->vtable + 2, fb->size - table->start);
+}
+
+static void fbField(byte_buffer_t *fb, const fb_table_t *table, int id, size_t alignment)
+{
+	bufferAlign(fb, alignment);
+	bufferSetLe16(fb, table->vtable + 4 + 2 * id, fb->size - table->start);
+}
+
+static void fbAddByte(byte_buffer_t *fb, const fb_table_t *table, int id, uint8_t value)
+{
+	fbField(fb, table, id, 1);
+	bufferByte(fb, value);
+}
+
+static void fbAddShort(byte_buffer_t *fb, const fb_table_t *table, int id, uint16_t value)
+{
+	fbField(fb, table, id, 2);
+	bufferLe16(fb, value);
+}
+
+static void fbAddInt(byte_buffer_t *fb, const fb_table_t *table, int id, uint32_t value)
+{
+	fbField(fb, table, id, 4);
+	bufferLe32(fb, value);
+}
+
+static void fbAddLong(byte_buffer_t *fb, const fb_table_t *table, int id, uint64_t value)
+{
+	fbField(fb, table, id, 8);
+	bufferLe64(fb, value);
+}
+
+/* an offset to something written later, returning where it is to set it with fbPoint */
+static size_t fbAddOffset(byte_buffer_t *fb, const fb_table_t *table, int id)
+{
+	fbField(fb, table, id, 4);
+	size_t slot = fb->size;
+	bufferLe32(fb, 0);
+
+	return slot;
+}
+
+static void fbPoint(byte_buffer_t *fb, size_t slot, size_t target)
+{
+	bufferSetLe32(fb, slot, target - slot);
+}
+
+static size_t fbString(byte_buffer_t *fb, const char *text)
+{
+	size_t length = strlen(text);
+
+	bufferAlign(fb, 4);
+	size_t start = fb->size;
+	bufferLe32(fb, length);
+	bufferPut(fb, text, length + 1);
+
+	return start;
+}
+
+/* the length of a vector, placed so that its elements are 8-aligned */
+static size_t fbVector(byte_buffer_t *fb, size_t count)
+{
+	bufferAlign(fb, 4);
+	if(fb->size % 8 == 0) {
+		bufferLe32(fb, 0);
+	}
+	size_t start = fb->size;
+	bufferLe32(fb, count);
+
+	return start;
+}
+
+static void columnName(char *name, int column, const projection_t *projection)
+{
+	if(column == 0) {
+		strcpy(name, "time");
+	}
+	else {
+		projectionColumnName(projection, column - 1, name);
+	}
+}
+
+/* the Schema table, returning where it starts */
+static size_t writeSchema(byte_buffer_t *fb, const projection_t *projection)
+{
+	int columns = 1 + projection->count;
+	fb_table_t schema;
+
+	fbTableStart(fb, &schema, 2);
+	size_t fields_slot = fbAddOffset(fb, &schema, 1);
+	fbTableEnd(fb, &schema);
+
+	size_t fields = fbVector(fb, columns);
+	bufferPut(fb, NULL, 4 * columns);
+	fbPoint(fb, fields_slot, fields);
+
+	for(int c = 0; c < columns; c++) {
+		fb_table_t field;
+		fb_table_t type;
+		char name[16];
+
+		fbTableStart(fb, &field, 6);
+		fbPoint(fb, fields + 4 + 4 * c, field.start);
+		size_t name_slot = fbAddOffset(fb, &field, 0);
+		size_t type_slot = fbAddOffset(fb, &field, 3);
+		size_t children_slot = fbAddOffset(fb, &field, 5);
+		fbAddByte(fb, &field, 1, false);
+		fbAddByte(fb, &field, 2, (c == 0) ? TYPE_TIMESTAMP : TYPE_INT);
+		fbTableEnd(fb, &field);
+
+		columnName(name, c, projection);
+		fbPoint(fb, name_slot, fbString(fb, name));
+
+		/* a timestamp without a time zone, or a uint16 */
+		fbTableStart(fb, &type, 2);
+		if(c == 0) {
+			fbAddShort(fb, &type, 0, TIME_UNIT_NANOSECOND);
+		}
+		else {
+			fbAddInt(fb, &type, 0, 16);
+			fbAddByte(fb, &type, 1, false);
+		}
+		fbTableEnd(fb, &type);
+		fbPoint(fb, type_slot, type.start);
+
+		/* readers want the children even when there are none */
+		fbPoint(fb, children_slot, fbVector(fb, 0));
+	}
+
+	return schema.start;
+}
+
+/* a Message flatbuffer, with its header table left to the caller */
+static size_t startMessage(byte_buffer_t *fb, uint8_t header_type, uint64_t body_size)
+{
+	fb_table_t message;
+
+	/* the root offset */
+	bufferLe32(fb, 0);
+
+	fbTableStart(fb, &message, 4);
+	fbPoint(fb, 0, message.start);
+	fbAddShort(fb, &message, 0, METADATA_V5);
+	fbAddByte(fb, &message, 1, header_type);
+	size_t header_slot = fbAddOffset(fb, &message, 2);
+	fbAddLong(fb, &message, 3, body_size);
+	fbTableEnd(fb, &message);
+
+	return header_slot;
+}
+
+/* a message's flatbuffer with its continuation marker and size, 8-aligned; returns the bytes taken */
+static size_t appendMessage(byte_buffer_t *out, const byte_buffer_t *fb)
+{
+	size_t padded = (fb->size + 7) & ~(size_t)7;
+
+	bufferLe32(out, ARROW_CONTINUATION);
+	bufferLe32(out, padded);
+	bufferPut(out, fb->data, fb->size);
+	bufferPut(out, NULL, padded - fb->size);
+
+	if(fb->failed) {
+		out->failed = true;
+	}
+
+	return 8 + padded;
+}
+
+int arrowFileStart(arrow_file_t *file, const projection_t *projection, byte_buffer_t *out)
+{
+	byte_buffer_t fb = {0};
+	size_t start = out->size;
+
+	memset(file, 0, sizeof(*file));
+	file->projection = *projection;
+
+	bufferPut(out, ARROW_MAGIC, 6);
+	bufferPut(out, NULL, 2);
+
+	size_t header_slot = startMessage(&fb, HEADER_SCHEMA, 0);
+	fbPoint(&fb, header_slot, writeSchema(&fb, projection));
+	appendMessage(out, &fb);
+	bufferFree(&fb);
+
+	file->offset = out->size - start;
+
+	return out->failed ? -1 : 0;
+}
+
+static size_t paddedSize(size_t size)
+{
+	return (size + BODY_ALIGNMENT - 1) / BODY_ALIGNMENT * BODY_ALIGNMENT;
+}
+
+/* the values of a column, little endian, padded */
+static void putColumn(byte_buffer_t *out, const void *values, size_t count, size_t size)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	bufferPut(out, values, count * size);
+#else
+	for(size_t i = 0; i < count; i++) {
+		if(size == 8) {
+			bufferLe64(out, ((const int64_t *)values)[i]);
+		}
+		else {
+			bufferLe16(out, ((const uint16_t *)values)[i]);
+		}
+	}
+#endif
+	bufferPut(out, NULL, paddedSize(count * size) - count * size);
+}
+
+int arrowEncodeBatch(const column_table_t *table, byte_buffer_t *out, arrow_block_t *block)
+{
+	byte_buffer_t fb = {0};
+	size_t rows = table->count;
+	int columns = 1 + table->word_count;
+
+	block->offset = 0;
+	block->body_size = paddedSize(rows * sizeof(int64_t)) + table->word_count * paddedSize(rows * sizeof(uint16_t));
+
+	size_t header_slot = startMessage(&fb, HEADER_RECORD_BATCH, block->body_size);
+
+	fb_table_t batch;
+	fbTableStart(&fb, &batch, 3);
+	fbPoint(&fb, header_slot, batch.start);
+	fbAddLong(&fb, &batch, 0, rows);
+	size_t nodes_slot = fbAddOffset(&fb, &batch, 1);
+	size_t buffers_slot = fbAddOffset(&fb, &batch, 2);
+	fbTableEnd(&fb, &batch);
+
+	/* length and null count of each column */
+	fbPoint(&fb, nodes_slot, fbVector(&fb, columns));
+	for(int c = 0; c < columns; c++) {
+		bufferLe64(&fb, rows);
+		bufferLe64(&fb, 0);
+	}
+
+	/* an empty validity buffer, as nothing is null, then the values */
+	fbPoint(&fb, buffers_slot, fbVector(&fb, 2 * columns));
+	uint64_t offset = 0;
+	for(int c = 0; c < columns; c++) {
+		size_t size = rows * ((c == 0) ? sizeof(int64_t) : sizeof(uint16_t));
+
+		bufferLe64(&fb, offset);
+		bufferLe64(&fb, 0);
+		bufferLe64(&fb, offset);
+		bufferLe64(&fb, size);
+		offset += paddedSize(size);
+	}
+
+	block->metadata_size = appendMessage(out, &fb);
+	bufferFree(&fb);
+
+	putColumn(out, table->time, rows, sizeof(int64_t));
+	for(int k = 0; k < table->word_count; k++) {
+		putColumn(out, table->words[k], rows, sizeof(uint16_t));
+	}
+
+	return out->failed ? -1 : 0;
+}
+
+int arrowFileAdd(arrow_file_t *file, const arrow_block_t *block)
+{
+	if(file->block_count == file->block_capacity) {
+		size_t capacity = file->block_capacity ? 2 * file->block_capacity : 64;
+		arrow_block_t *grown = realloc(file->blocks, capacity * sizeof(arrow_block_t));
+		if(grown == NULL)
+			return -1;
+		file->blocks = grown;
+		file->block_capacity = capacity;
+	}
+
+	arrow_block_t *added = &file->blocks[file->block_count++];
+	*added = *block;
+	added->offset += file->offset;
+
+	file->offset += block->metadata_size + block->body_size;
+
+	return 0;
+}
+
+int arrowFileFinish(arrow_file_t *file, byte_buffer_t *out)
+{
+	byte_buffer_t fb = {0};
+	fb_table_t footer;
+
+	/* end of stream, for readers of the messages alone */
+	bufferLe32(out, ARROW_CONTINUATION);
+	bufferLe32(out, 0);
+
+	bufferLe32(&fb, 0);
+	fbTableStart(&fb, &footer, 4);
+	fbPoint(&fb, 0, footer.start);
+	fbAddShort(&fb, &footer, 0, METADATA_V5);
+	size_t schema_slot = fbAddOffset(&fb, &footer, 1);
+	size_t dictionaries_slot = fbAddOffset(&fb, &footer, 2);
+	size_t batches_slot = fbAddOffset(&fb, &footer, 3);
+	fbTableEnd(&fb, &footer);
+
+	fbPoint(&fb, schema_slot, writeSchema(&fb, &file->projection));
+	fbPoint(&fb, dictionaries_slot, fbVector(&fb, 0));
+	fbPoint(&fb, batches_slot, fbVector(&fb, file->block_count));
+	for(size_t b = 0; b < file->block_count; b++) {
+		bufferLe64(&fb, file->blocks[b].offset);
+		bufferLe32(&fb, file->blocks[b].metadata_size);
+		bufferLe32(&fb, 0);
+		bufferLe64(&fb, file->blocks[b].body_size);
+	}
+
+	bufferPut(out, fb.data, fb.size);
+	bufferLe32(out, fb.size);
+	bufferPut(out, ARROW_MAGIC, 6);
+
+	if(fb.failed) {
+		out->failed = true;
+	}
+	bufferFree(&fb);
+
+	return out->failed ? -1 : 0;
+}
+
+void arrowFileFree(arrow_file_t *file)
+{
+	free(file->blocks);
+	memset(file, 0, sizeof(*file));
+}
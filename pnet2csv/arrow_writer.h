@@ -0,0 +1,97 @@
+#ifndef ARROW_WRITER_H
+#define ARROW_WRITER_H
+
+/**
+ * @file
+ * @brief Arrow IPC file (Feather version 2) export of log entries
+ *
+ * The same columns as the Parquet export: "time", a timestamp in
+ * nanoseconds without a time zone, and "word0" to "word63" as uint16.
+ * One record batch per row group, with no nulls and no compression, so
+ * that readers can map the file and use the columns where they lie.
+ *
+ * Record batches are encoded independently of each other, on any thread,
+ * and then added to the file in order; the footer listing them is written
+ * last.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "byte_buffer.h"
+#include "column_table.h"
+#include "entry_filter.h"
+
+/* where a record batch is, for the footer */
+typedef struct arrow_block
+{
+	uint64_t offset;
+	uint32_t metadata_size;
+	uint64_t body_size;
+} arrow_block_t;
+
+typedef struct arrow_file
+{
+	/* the words, for the schema */
+	projection_t projection;
+	/* bytes of the file so far */
+	uint64_t offset;
+	arrow_block_t *blocks;
+	size_t block_count;
+	size_t block_capacity;
+} arrow_file_t;
+
+/**
+ * Start a file with its schema
+ *
+ * @param file             Out
+ * @param projection       In:    the words written
+ * @param out              InOut: the first bytes of the file are appended
+ * @return 0 on success, -1 if out of memory
+ */
+int arrowFileStart(arrow_file_t *file, const projection_t *projection, byte_buffer_t *out);
+
+/**
+ * Encode entries as a record batch
+ *
+ * @param table            In:    with the words of the projection
+ * @param out              InOut: the record batch is appended
+ * @param block            Out:   for arrowFileAdd
+ * @return 0 on success, -1 if out of memory
+ */
+int arrowEncodeBatch(const column_table_t *table, byte_buffer_t *out, arrow_block_t *block);
+
+/**
+ * Account for a record batch written after everything before it
+ *
+ * @param file             InOut
+ * @param block            In:    as arrowEncodeBatch left it
+ * @return 0 on success, -1 if out of memory
+ */
+int arrowFileAdd(arrow_file_t *file, const arrow_block_t *block);
+
+/**
+ * Finish a file with its footer
+ *
+ * @param file             InOut
+ * @param out              InOut: the last bytes of the file are appended
+ * @return 0 on success, -1 if out of memory
+ */
+int arrowFileFinish(arrow_file_t *file, byte_buffer_t *out);
+
+/**
+ * Free what a file keeps for its footer
+ *
+ * @param file             InOut
+ */
+void arrowFileFree(arrow_file_t *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARROW_WRITER_H */
@@ -0,0 +1,114 @@
+#include "byte_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+bool bufferReserve(byte_buffer_t *buffer, size_t length)
+{
+	if(buffer->failed)
+		return false;
+
+	if(buffer->capacity - buffer->size >= length)
+		return true;
+
+	size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+	while(capacity - buffer->size < length) {
+		capacity *= 2;
+	}
+
+	uint8_t *grown = realloc(buffer->data, capacity);
+	if(grown == NULL) {
+		buffer->failed = true;
+		return false;
+	}
+
+	buffer->data = grown;
+	buffer->capacity = capacity;
+
+	return true;
+}
+
+void bufferPut(byte_buffer_t *buffer, const void *data, size_t length)
+{
+	if(!bufferReserve(buffer, length))
+		return;
+
+	if(data != NULL) {
+		memcpy(buffer->data + buffer->size, data, length);
+	}
+	else {
+		memset(buffer->data + buffer->size, 0, length);
+	}
+	buffer->size += length;
+}
+
+void bufferByte(byte_buffer_t *buffer, uint8_t value)
+{
+	bufferPut(buffer, &value, 1);
+}
+
+void bufferLe16(byte_buffer_t *buffer, uint16_t value)
+{
+	value = htole16(value);
+	bufferPut(buffer, &value, sizeof(value));
+}
+
+void bufferLe32(byte_buffer_t *buffer, uint32_t value)
+{
+	value = htole32(value);
+	bufferPut(buffer, &value, sizeof(value));
+}
+
+void bufferLe64(byte_buffer_t *buffer, uint64_t value)
+{
+	value = htole64(value);
+	bufferPut(buffer, &value, sizeof(value));
+}
+
+void bufferVarint(byte_buffer_t *buffer, uint64_t value)
+{
+	uint8_t bytes[10];
+	size_t length = 0;
+
+	while(value >= 0x80) {
+		bytes[length++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	bytes[length++] = value;
+
+	bufferPut(buffer, bytes, length);
+}
+
+void bufferAlign(byte_buffer_t *buffer, size_t alignment)
+{
+	size_t remainder = buffer->size % alignment;
+
+	if(remainder != 0) {
+		bufferPut(buffer, NULL, alignment - remainder);
+	}
+}
+
+void bufferSetLe16(byte_buffer_t *buffer, size_t position, uint16_t value)
+{
+	if(buffer->failed)
+		return;
+
+	value = htole16(value);
+	memcpy(buffer->data + position, &value, sizeof(value));
+}
+
+void bufferSetLe32(byte_buffer_t *buffer, size_t position, uint32_t value)
+{
+	if(buffer->failed)
+		return;
+
+	value = htole32(value);
+	memcpy(buffer->data + position, &value, sizeof(value));
+}
+
+void bufferFree(byte_buffer_t *buffer)
+{
+	free(buffer->data);
+	memset(buffer, 0, sizeof(*buffer));
+}
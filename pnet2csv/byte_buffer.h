@@ -0,0 +1,73 @@
+#ifndef BYTE_BUFFER_H
+#define BYTE_BUFFER_H
+
+/**
+ * @file
+ * @brief Growable byte buffer for the columnar writers
+ *
+ * Appending never fails outright; a failed allocation marks the buffer
+ * failed and later appends do nothing, so a whole encoding can be checked
+ * once at the end.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct byte_buffer
+{
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	bool failed;
+} byte_buffer_t;
+
+/**
+ * Make room for more, so that size + length fits
+ *
+ * @param buffer           InOut
+ * @param length           In:    bytes about to be appended
+ * @return true if there is room
+ */
+bool bufferReserve(byte_buffer_t *buffer, size_t length);
+
+/**
+ * Append bytes
+ *
+ * @param buffer           InOut
+ * @param data             In:    NULL for zeros
+ * @param length           In
+ */
+void bufferPut(byte_buffer_t *buffer, const void *data, size_t length);
+
+void bufferByte(byte_buffer_t *buffer, uint8_t value);
+void bufferLe16(byte_buffer_t *buffer, uint16_t value);
+void bufferLe32(byte_buffer_t *buffer, uint32_t value);
+void bufferLe64(byte_buffer_t *buffer, uint64_t value);
+
+/* unsigned LEB128 */
+void bufferVarint(byte_buffer_t *buffer, uint64_t value);
+
+/* zeros up to a multiple of alignment */
+void bufferAlign(byte_buffer_t *buffer, size_t alignment);
+
+/* overwrite a little endian value written earlier */
+void bufferSetLe16(byte_buffer_t *buffer, size_t position, uint16_t value);
+void bufferSetLe32(byte_buffer_t *buffer, size_t position, uint32_t value);
+
+/**
+ * Free the data and empty the buffer
+ *
+ * @param buffer           InOut
+ */
+void bufferFree(byte_buffer_t *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BYTE_BUFFER_H */
@@ -0,0 +1,117 @@
+#include "column_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NANOS_PER_DAY (86400ULL * 1000000000ULL)
+
+/* days since 1970-01-01 of a date in the proleptic Gregorian calendar */
+static int64_t daysFromCivil(int64_t year, unsigned int month, unsigned int day)
+{
+	year -= (month <= 2);
+	int64_t era = (year >= 0 ? year : year - 399) / 400;
+	unsigned int year_of_era = (unsigned int)(year - era * 400);
+	unsigned int day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	unsigned int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+	return era * 146097 + (int64_t)day_of_era - 719468;
+}
+
+/* and back */
+static void civilFromDays(int64_t days, uint16_t *year, uint8_t *month, uint8_t *day)
+{
+	days += 719468;
+	int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+	unsigned int day_of_era = (unsigned int)(days - era * 146097);
+	unsigned int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	unsigned int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	unsigned int shifted_month = (5 * day_of_year + 2) / 153;
+
+	*day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+	*month = (shifted_month < 10) ? shifted_month + 3 : shifted_month - 9;
+	*year = (uint16_t)(year_of_era + era * 400 + (*month <= 2));
+}
+
+int columnTableInit(column_table_t *table, size_t capacity, int word_count)
+{
+	memset(table, 0, sizeof(*table));
+	table->capacity = capacity;
+	table->word_count = word_count;
+
+	/* the words in one allocation, a column after another */
+	table->time = malloc(capacity * sizeof(int64_t));
+	table->words[0] = malloc(capacity * (word_count > 0 ? word_count : 1) * sizeof(uint16_t));
+	if(table->time == NULL || table->words[0] == NULL) {
+		columnTableFree(table);
+		return -1;
+	}
+
+	for(int w = 1; w < word_count; w++) {
+		table->words[w] = table->words[0] + w * capacity;
+	}
+
+	return 0;
+}
+
+int64_t columnTableTime(const record_block_t *block, size_t entry)
+{
+	uint64_t days = daysFromCivil(block->year[entry], block->month[entry], block->day[entry]);
+	uint64_t seconds = (block->hour[entry] * 60 + block->minute[entry]) * 60 + block->second[entry];
+
+	/* unsigned, so that a nonsense date wraps rather than overflows */
+	return (int64_t)(days * NANOS_PER_DAY + seconds * 1000000000ULL + block->nano[entry]);
+}
+
+int64_t columnTableDateTime(uint32_t date, uint64_t time_ns)
+{
+	uint64_t days = daysFromCivil(date >> 16, date >> 8 & 0xFF, date & 0xFF);
+
+	return (int64_t)(days * NANOS_PER_DAY + time_ns);
+}
+
+void columnTableSetTime(record_block_t *block, size_t entry, int64_t time)
+{
+	int64_t days = time / (int64_t)NANOS_PER_DAY;
+	uint64_t time_ns = time % (int64_t)NANOS_PER_DAY;
+
+	civilFromDays(days, &block->year[entry], &block->month[entry], &block->day[entry]);
+	block->hour[entry] = time_ns / 3600000000000ULL;
+	block->minute[entry] = time_ns / 60000000000ULL % 60;
+	block->second[entry] = time_ns / 1000000000ULL % 60;
+	block->nano[entry] = time_ns % 1000000000ULL;
+}
+
+void columnTableAppend(
+	column_table_t *table,
+	const record_block_t *block,
+	const uint16_t *selected,
+	size_t count,
+	const projection_t *projection)
+{
+	for(size_t i = 0; i < count; i++) {
+		table->time[table->count + i] = columnTableTime(block, selected[i]);
+	}
+
+	for(int k = 0; k < table->word_count; k++) {
+		const uint16_t *column = block->words[projection->words[k]];
+		uint16_t *to = table->words[k] + table->count;
+
+		/* all of them, most of the time */
+		if(count == block->count) {
+			memcpy(to, column, count * sizeof(uint16_t));
+			continue;
+		}
+		for(size_t i = 0; i < count; i++) {
+			to[i] = column[selected[i]];
+		}
+	}
+
+	table->count += count;
+}
+
+void columnTableFree(column_table_t *table)
+{
+	free(table->time);
+	free(table->words[0]);
+	memset(table, 0, sizeof(*table));
+}
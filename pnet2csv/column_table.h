@@ -0,0 +1,100 @@
+#ifndef COLUMN_TABLE_H
+#define COLUMN_TABLE_H
+
+/**
+ * @file
+ * @brief Entries gathered column by column for the columnar writers
+ *
+ * The DTL timestamp becomes a single count of nanoseconds since
+ * 1970-01-01T00:00:00, and each word a column of its own. The DTL carries
+ * no time zone, so the count is of the clock as the PLC had it, the same
+ * as the CSV shows it. Years outside 1678-2261 do not fit.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_logformat.h"
+#include "entry_filter.h"
+#include "record_decode.h"
+
+typedef struct column_table
+{
+	size_t count;
+	size_t capacity;
+
+	int64_t *time;
+	/* those of the projection, in its order */
+	int word_count;
+	uint16_t *words[LOG_WORD_COUNT];
+} column_table_t;
+
+/**
+ * Allocate room for the entries of a row group
+ *
+ * @param table            Out
+ * @param capacity         In:    entries
+ * @param word_count       In:    words of each
+ * @return 0 on success, -1 if out of memory
+ */
+int columnTableInit(column_table_t *table, size_t capacity, int word_count);
+
+/**
+ * Add entries decoded by decodeRecords at the end
+ *
+ * @param table            InOut: with room for them
+ * @param block            In
+ * @param selected         In:    which of its entries, in order
+ * @param count            In:    how many of them
+ * @param projection       In:    the words wanted, as many as the table has
+ */
+void columnTableAppend(
+	column_table_t *table,
+	const record_block_t *block,
+	const uint16_t *selected,
+	size_t count,
+	const projection_t *projection);
+
+/**
+ * Nanoseconds since 1970-01-01T00:00:00 of a DTL timestamp
+ *
+ * @param block            In
+ * @param entry            In:    which of its entries
+ * @return nanoseconds
+ */
+int64_t columnTableTime(const record_block_t *block, size_t entry);
+
+/**
+ * Nanoseconds since 1970-01-01T00:00:00 of a date and time of day
+ *
+ * @param date             In:    year << 16 | month << 8 | day
+ * @param time_ns          In:    since midnight
+ * @return nanoseconds
+ */
+int64_t columnTableDateTime(uint32_t date, uint64_t time_ns);
+
+/**
+ * Set the DTL timestamp of an entry, the other way from columnTableTime
+ *
+ * @param block            InOut
+ * @param entry            In:    which of its entries
+ * @param time             In:    nanoseconds since 1970-01-01T00:00:00, not before
+ */
+void columnTableSetTime(record_block_t *block, size_t entry, int64_t time);
+
+/**
+ * Free a table
+ *
+ * @param table            InOut
+ */
+void columnTableFree(column_table_t *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COLUMN_TABLE_H */
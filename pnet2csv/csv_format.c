@@ -0,0 +1,96 @@
+#include "csv_format.h"
+
+#include <string.h>
+
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/* exactly two digits */
+static inline char *put2(char *out, unsigned int value)
+{
+	memcpy(out, digit_pairs + 2*value, 2);
+	return out + 2;
+}
+
+/* a word, in as many digits as it takes */
+static inline char *putWord(char *out, unsigned int value)
+{
+	if(value < 10) {
+		*out = '0' + value;
+		return out + 1;
+	}
+	if(value < 100) {
+		return put2(out, value);
+	}
+	if(value < 1000) {
+		*out++ = '0' + value / 100;
+		return put2(out, value % 100);
+	}
+	if(value >= 10000) {
+		*out++ = '0' + value / 10000;
+		value %= 10000;
+	}
+	out = put2(out, value / 100);
+	return put2(out, value % 100);
+}
+
+size_t formatCsvHeader(char *out, const projection_t *projection)
+{
+	char *next = out;
+
+	memcpy(next, "time", 4);
+	next += 4;
+
+	for(int k = 0; k < projection->count; k++) {
+		*next++ = ',';
+		next += projectionColumnName(projection, k, next);
+	}
+	*next++ = '\n';
+
+	return next - out;
+}
+
+size_t formatCsvEntry(char *out, const record_block_t *block, size_t entry, const projection_t *projection)
+{
+	char *next = out;
+
+	/* a PLC can not produce anything longer, but keep within CSV_TIMESTAMP_SIZE regardless */
+	unsigned int year = block->year[entry] % 10000;
+	uint32_t nano = block->nano[entry] % 1000000000;
+
+	next = put2(next, year / 100);
+	next = put2(next, year % 100);
+	*next++ = '-';
+	next = put2(next, block->month[entry] % 100);
+	*next++ = '-';
+	next = put2(next, block->day[entry] % 100);
+	*next++ = 'T';
+	next = put2(next, block->hour[entry] % 100);
+	*next++ = ':';
+	next = put2(next, block->minute[entry] % 100);
+	*next++ = ':';
+	next = put2(next, block->second[entry] % 100);
+	*next++ = '.';
+	*next++ = '0' + nano / 100000000;
+	next = put2(next, nano / 1000000 % 100);
+	next = put2(next, nano / 10000 % 100);
+	next = put2(next, nano / 100 % 100);
+	next = put2(next, nano % 100);
+
+	for(int k = 0; k < projection->count; k++) {
+		*next++ = ',';
+		next = putWord(next, block->words[projection->words[k]][entry]);
+	}
+	*next++ = '\n';
+
+	return next - out;
+}
@@ -0,0 +1,55 @@
+#ifndef CSV_FORMAT_H
+#define CSV_FORMAT_H
+
+/**
+ * @file
+ * @brief CSV formatting of log entries
+ *
+ * One line per entry: the timestamp as 2024-03-01T10:00:00.123456789,
+ * then each word as an unsigned decimal. Numbers are formatted by hand,
+ * two digits at a time, as printf would be most of the conversion time.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_logformat.h"
+#include "entry_filter.h"
+#include "record_decode.h"
+
+#define CSV_TIMESTAMP_SIZE 29
+/* longest line, including its newline */
+#define CSV_LINE_MAX (CSV_TIMESTAMP_SIZE + LOG_WORD_COUNT * (1 + 5) + 1)
+/* longest header line */
+#define CSV_HEADER_MAX (4 + LOG_WORD_COUNT * COLUMN_NAME_MAX + 1)
+
+/**
+ * Format the column names
+ *
+ * @param out              Out:   at least CSV_HEADER_MAX bytes
+ * @param projection       In:    the words written
+ * @return bytes written
+ */
+size_t formatCsvHeader(char *out, const projection_t *projection);
+
+/**
+ * Format one entry as a line
+ *
+ * @param out              Out:   at least CSV_LINE_MAX bytes
+ * @param block            In:    entries decoded by decodeRecords
+ * @param entry            In:    which of them
+ * @param projection       In:    the words written
+ * @return bytes written
+ */
+size_t formatCsvEntry(char *out, const record_block_t *block, size_t entry, const projection_t *projection);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CSV_FORMAT_H */
@@ -0,0 +1,275 @@
+#include "entry_filter.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void filterInit(entry_filter_t *filter)
+{
+	memset(filter, 0, sizeof(*filter));
+
+	filter->projection.count = LOG_WORD_COUNT;
+	for(int w = 0; w < LOG_WORD_COUNT; w++) {
+		filter->projection.words[w] = w;
+	}
+}
+
+/* a number in C syntax, up to max; NULL if there is none */
+static const char *parseNumber(const char *text, unsigned long max, unsigned long *value)
+{
+	char *end;
+
+	if(!isdigit((unsigned char)*text))
+		return NULL;
+
+	*value = strtoul(text, &end, 0);
+	if(*value > max)
+		return NULL;
+
+	return end;
+}
+
+static const char *skipSpace(const char *text)
+{
+	while(isspace((unsigned char)*text)) {
+		text++;
+	}
+
+	return text;
+}
+
+int filterParseWords(entry_filter_t *filter, const char *text)
+{
+	projection_t projection = {0};
+
+	for(;;) {
+		unsigned long first, last;
+
+		text = parseNumber(skipSpace(text), LOG_WORD_COUNT - 1, &first);
+		if(text == NULL)
+			return -1;
+		last = first;
+
+		text = skipSpace(text);
+		if(*text == '-') {
+			text = parseNumber(skipSpace(text + 1), LOG_WORD_COUNT - 1, &last);
+			if(text == NULL || last < first)
+				return -1;
+			text = skipSpace(text);
+		}
+
+		for(unsigned long w = first; w <= last; w++) {
+			if(projection.count == LOG_WORD_COUNT)
+				return -1;
+			projection.words[projection.count++] = w;
+		}
+
+		if(*text == '\0')
+			break;
+		if(*text++ != ',')
+			return -1;
+	}
+
+	filter->projection = projection;
+
+	return 0;
+}
+
+int projectionColumnName(const projection_t *projection, int column, char *name)
+{
+	static const char *const suffixes[] = {
+		[AGGREGATE_NONE] = "",
+		[AGGREGATE_MIN] = "_min",
+		[AGGREGATE_MAX] = "_max",
+		[AGGREGATE_LAST] = "_last",
+	};
+
+	return sprintf(name, "word%d%s", projection->words[column], suffixes[projection->aggregates[column]]);
+}
+
+int filterParsePredicate(entry_filter_t *filter, const char *text)
+{
+	static const struct
+	{
+		const char *text;
+		predicate_op_t op;
+	} ops[] = {
+		/* the longer ones first, so that <= is not taken for < */
+		{"==", PREDICATE_EQUAL},
+		{"!=", PREDICATE_NOT_EQUAL},
+		{"<=", PREDICATE_LESS_EQUAL},
+		{">=", PREDICATE_GREATER_EQUAL},
+		{"<", PREDICATE_LESS},
+		{">", PREDICATE_GREATER},
+		{"&", PREDICATE_BITS},
+	};
+	predicate_t predicate = {0};
+	unsigned long number;
+
+	if(filter->predicate_count == FILTER_PREDICATES_MAX)
+		return -1;
+
+	text = skipSpace(text);
+	if(*text != 'W' && *text != 'w')
+		return -1;
+	text = parseNumber(text + 1, LOG_WORD_COUNT - 1, &number);
+	if(text == NULL)
+		return -1;
+	predicate.word = number;
+
+	text = skipSpace(text);
+	size_t o;
+	for(o = 0; o < sizeof(ops) / sizeof(ops[0]); o++) {
+		if(strncmp(text, ops[o].text, strlen(ops[o].text)) == 0)
+			break;
+	}
+	if(o == sizeof(ops) / sizeof(ops[0]))
+		return -1;
+	predicate.op = ops[o].op;
+	text = skipSpace(text + strlen(ops[o].text));
+
+	if(strncmp(text, "prev", 4) == 0 && predicate.op != PREDICATE_BITS) {
+		predicate.previous = true;
+		text += 4;
+	}
+	else {
+		text = parseNumber(text, 0xFFFF, &number);
+		if(text == NULL)
+			return -1;
+		predicate.value = number;
+	}
+
+	if(*skipSpace(text) != '\0')
+		return -1;
+
+	filter->predicates[filter->predicate_count++] = predicate;
+	filter->uses_previous = filter->uses_previous || predicate.previous;
+
+	return 0;
+}
+
+static bool compare(predicate_op_t op, uint16_t word, uint16_t value)
+{
+	switch(op) {
+	case PREDICATE_EQUAL:
+		return word == value;
+	case PREDICATE_NOT_EQUAL:
+		return word != value;
+	case PREDICATE_LESS:
+		return word < value;
+	case PREDICATE_LESS_EQUAL:
+		return word <= value;
+	case PREDICATE_GREATER:
+		return word > value;
+	case PREDICATE_GREATER_EQUAL:
+		return word >= value;
+	case PREDICATE_BITS:
+		return (word & value) != 0;
+	}
+
+	return false;
+}
+
+/*
+One predicate over the whole column at a time, narrowing down a mask of
+the entries still in, with the switch outside the loop so that each loop
+is a plain comparison of two arrays.
+*/
+#define NARROW(op) \
+	for(size_t i = 0; i < count; i++) { \
+		keep[i] &= (column[i] op against[i]); \
+	}
+
+static void narrow(const predicate_t *predicate, const uint16_t *column, const uint16_t *against, size_t count, uint8_t *keep)
+{
+	switch(predicate->op) {
+	case PREDICATE_EQUAL:
+		NARROW(==)
+		break;
+	case PREDICATE_NOT_EQUAL:
+		NARROW(!=)
+		break;
+	case PREDICATE_LESS:
+		NARROW(<)
+		break;
+	case PREDICATE_LESS_EQUAL:
+		NARROW(<=)
+		break;
+	case PREDICATE_GREATER:
+		NARROW(>)
+		break;
+	case PREDICATE_GREATER_EQUAL:
+		NARROW(>=)
+		break;
+	case PREDICATE_BITS:
+		for(size_t i = 0; i < count; i++) {
+			keep[i] &= ((column[i] & against[i]) != 0);
+		}
+		break;
+	}
+}
+
+size_t filterEntries(
+	const entry_filter_t *filter,
+	const record_block_t *block,
+	previous_entry_t *previous,
+	uint16_t *selected)
+{
+	size_t count = block->count;
+	size_t kept = 0;
+
+	if(filter->predicate_count == 0) {
+		for(size_t i = 0; i < count; i++) {
+			selected[i] = i;
+		}
+		kept = count;
+	}
+	else if(count > 0) {
+		uint8_t keep[RECORD_BLOCK];
+		uint16_t constant[RECORD_BLOCK];
+
+		memset(keep, 1, count);
+		for(int p = 0; p < filter->predicate_count; p++) {
+			const predicate_t *predicate = &filter->predicates[p];
+			const uint16_t *column = block->words[predicate->word];
+
+			if(predicate->previous) {
+				/* the entry before each is the one before it in the column, but for the first */
+				if(previous->set && !compare(predicate->op, column[0], previous->words[predicate->word])) {
+					keep[0] = 0;
+				}
+				narrow(predicate, column + 1, column, count - 1, keep + 1);
+			}
+			else {
+				for(size_t i = 0; i < count; i++) {
+					constant[i] = predicate->value;
+				}
+				narrow(predicate, column, constant, count, keep);
+			}
+		}
+
+		for(size_t i = 0; i < count; i++) {
+			selected[kept] = i;
+			kept += keep[i];
+		}
+	}
+
+	if(count > 0) {
+		previous->set = true;
+		for(int w = 0; w < LOG_WORD_COUNT; w++) {
+			previous->words[w] = block->words[w][count - 1];
+		}
+	}
+
+	return kept;
+}
+
+void previousEntrySet(previous_entry_t *previous, const uint8_t *words, bool bigendian)
+{
+	previous->set = true;
+	for(int w = 0; w < LOG_WORD_COUNT; w++) {
+		const uint8_t *bytes = words + 2 * w;
+		previous->words[w] = bigendian ? (bytes[0] << 8 | bytes[1]) : (bytes[1] << 8 | bytes[0]);
+	}
+}
@@ -0,0 +1,156 @@
+#ifndef ENTRY_FILTER_H
+#define ENTRY_FILTER_H
+
+/**
+ * @file
+ * @brief Choosing the words and entries that are written
+ *
+ * A projection is the words written, in the order asked for. Predicates
+ * are conditions on a word that every entry written has to meet, such as
+ * W7 != prev (the word changed since the entry before) or W3 & 0x10 (a
+ * bit of it is set). Both work on entries already decoded into columns,
+ * so the words not asked for are never formatted, nor are the entries
+ * left out.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_logformat.h"
+#include "record_decode.h"
+
+#define FILTER_PREDICATES_MAX 16
+/* longest column name, word63_last, and its terminator */
+#define COLUMN_NAME_MAX 12
+
+/* what a column of resampled entries holds of its word over each period */
+typedef enum aggregate
+{
+	/* not resampled, or only the value at the end of the period */
+	AGGREGATE_NONE,
+	AGGREGATE_MIN,
+	AGGREGATE_MAX,
+	/* the value at the end of the period, named as such */
+	AGGREGATE_LAST,
+} aggregate_t;
+
+/* the words written, in order */
+typedef struct projection
+{
+	int count;
+	uint8_t words[LOG_WORD_COUNT];
+	/* aggregate_t of each */
+	uint8_t aggregates[LOG_WORD_COUNT];
+} projection_t;
+
+typedef enum predicate_op
+{
+	PREDICATE_EQUAL,
+	PREDICATE_NOT_EQUAL,
+	PREDICATE_LESS,
+	PREDICATE_LESS_EQUAL,
+	PREDICATE_GREATER,
+	PREDICATE_GREATER_EQUAL,
+	/* any of the bits of value set */
+	PREDICATE_BITS,
+} predicate_op_t;
+
+typedef struct predicate
+{
+	uint8_t word;
+	predicate_op_t op;
+	/* against the same word of the entry before rather than value */
+	bool previous;
+	uint16_t value;
+} predicate_t;
+
+typedef struct entry_filter
+{
+	projection_t projection;
+	predicate_t predicates[FILTER_PREDICATES_MAX];
+	int predicate_count;
+	/* some predicate needs the entry before */
+	bool uses_previous;
+} entry_filter_t;
+
+/*
+The words of the entry before those being filtered. The first entry read
+of a log has none before it, and meets every predicate against prev.
+*/
+typedef struct previous_entry
+{
+	bool set;
+	uint16_t words[LOG_WORD_COUNT];
+} previous_entry_t;
+
+/**
+ * Every word and every entry
+ *
+ * @param filter           Out
+ */
+void filterInit(entry_filter_t *filter);
+
+/**
+ * Write only some words
+ *
+ * @param filter           InOut
+ * @param text             In:    word numbers and ranges, as 1,7,12 or 0-3,9
+ * @return 0 on success, -1 if it could not be parsed
+ */
+int filterParseWords(entry_filter_t *filter, const char *text);
+
+/**
+ * Name of a column: word7, or word7_min and the like when resampled
+ *
+ * @param projection       In
+ * @param column           In:    which of its words
+ * @param name             Out:   at least COLUMN_NAME_MAX bytes
+ * @return length of the name
+ */
+int projectionColumnName(const projection_t *projection, int column, char *name);
+
+/**
+ * Add a predicate that every entry written has to meet
+ *
+ * @param filter           InOut
+ * @param text             In:    W<n> OP VALUE, where OP is one of
+ *                                == != < <= > >= and VALUE a number or
+ *                                prev; or W<n> & MASK
+ * @return 0 on success, -1 if it could not be parsed or there are too many
+ */
+int filterParsePredicate(entry_filter_t *filter, const char *text);
+
+/**
+ * Find the entries of a block that meet every predicate
+ *
+ * @param filter           In
+ * @param block            In
+ * @param previous         InOut: the entry before the block, then its last
+ * @param selected         Out:   the entries, at least block->count of them
+ * @return number of entries selected
+ */
+size_t filterEntries(
+	const entry_filter_t *filter,
+	const record_block_t *block,
+	previous_entry_t *previous,
+	uint16_t *selected);
+
+/**
+ * Take the entry before from a record, or what a compact log's codec kept of it
+ *
+ * @param previous         Out
+ * @param words            In:    the words as stored in the log
+ * @param bigendian        In:    byte order of the log
+ */
+void previousEntrySet(previous_entry_t *previous, const uint8_t *words, bool bigendian);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ENTRY_FILTER_H */
@@ -0,0 +1,320 @@
+#include "log_reader.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+static const uint8_t magic[4] = { 0x61, 0x0B, 0xE7, 0xEC };
+
+/* take the index from after the end marker, which then ends the data */
+static void findIndex(log_reader_t *reader)
+{
+	const uint8_t *data = reader->data;
+	size_t size = reader->size;
+
+	if(size < LOG_HEADER_SIZE + 1 + LOG_INDEX_FOOTER_SIZE)
+		return;
+
+	uint32_t footer[2];
+	memcpy(footer, data + size - LOG_INDEX_FOOTER_SIZE, sizeof(footer));
+	if(le32toh(footer[1]) != LOG_INDEX_MAGIC)
+		return;
+
+	size_t count = le32toh(footer[0]);
+	if(count > LOG_INDEX_MAX)
+		return;
+
+	size_t index_size = count * sizeof(log_index_entry_t);
+	if(size < LOG_HEADER_SIZE + 1 + index_size + LOG_INDEX_FOOTER_SIZE)
+		return;
+
+	const uint8_t *index = data + size - LOG_INDEX_FOOTER_SIZE - index_size;
+	if(index[-1] != LOG_END)
+		return;
+
+	reader->index = index;
+	reader->index_count = count;
+	reader->end = index;
+}
+
+int logReaderInit(log_reader_t *reader, const char *name, const uint8_t *data, size_t size)
+{
+	memset(reader, 0, sizeof(*reader));
+	reader->name = name;
+	reader->data = data;
+	reader->size = size;
+
+	if(size < LOG_HEADER_SIZE || memcmp(data, magic, sizeof(magic)) != 0) {
+		fprintf(stderr, "%s: Not a log\n", name);
+		return -1;
+	}
+
+	if(data[4] == 0x50 && data[5] == 0x4E) {
+		reader->bigendian = true;
+	}
+	else if(data[4] == 0x4E && data[5] == 0x50) {
+		reader->bigendian = false;
+	}
+	else {
+		fprintf(stderr, "%s: Unknown byte order\n", name);
+		return -1;
+	}
+
+	reader->format = data[6];
+	if(reader->format != LOG_FORMAT_PLAIN && reader->format != LOG_FORMAT_COMPACT) {
+		fprintf(stderr, "%s: Unknown format version %u\n", name, reader->format);
+		return -1;
+	}
+
+	if(data[7] != LOG_WORD_COUNT) {
+		fprintf(stderr, "%s: %u words per entry, expected %u\n", name, data[7], LOG_WORD_COUNT);
+		return -1;
+	}
+
+	reader->next = data + LOG_HEADER_SIZE;
+	reader->end = data + size;
+	logCodecReset(&reader->codec);
+
+	findIndex(reader);
+
+	return 0;
+}
+
+int logReaderOpen(log_reader_t *reader, const char *path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	struct stat statbuf;
+	if(fstat(fd, &statbuf) == -1) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	/* mmap refuses empty files, and they are not logs anyway */
+	if(statbuf.st_size < LOG_HEADER_SIZE) {
+		fprintf(stderr, "%s: Not a log\n", path);
+		close(fd);
+		return -1;
+	}
+
+	void *data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	/* read front to back exactly once */
+	madvise(data, statbuf.st_size, MADV_SEQUENTIAL);
+
+	if(logReaderInit(reader, path, data, statbuf.st_size) == -1) {
+		munmap(data, statbuf.st_size);
+		return -1;
+	}
+	reader->mapped = true;
+
+	return 0;
+}
+
+const uint8_t *logReaderNext(log_reader_t *reader)
+{
+	if(reader->finished || reader->failed || reader->next == reader->end)
+		return NULL;
+
+	if(*reader->next == LOG_END) {
+		reader->finished = true;
+		return NULL;
+	}
+
+	if(reader->format == LOG_FORMAT_PLAIN) {
+		const uint8_t *record = reader->next;
+
+		if(record[0] != 0) {
+			fprintf(stderr, "%s: Bad record at offset %zu\n", reader->name, (size_t)(record - reader->data));
+			reader->failed = true;
+			return NULL;
+		}
+
+		/* a log still being written may end part way through one */
+		if((size_t)(reader->end - record) < LOG_RECORD_SIZE)
+			return NULL;
+
+		reader->next += LOG_RECORD_SIZE;
+		return record;
+	}
+
+	int used = logDecodeRecord(&reader->codec, reader->next, reader->end - reader->next,
+		reader->bigendian, reader->record);
+	if(used <= 0) {
+		/* can only be cut short at the very end of the file */
+		if(reader->end - reader->next >= LOG_RECORD_SIZE) {
+			fprintf(stderr, "%s: Bad record at offset %zu\n", reader->name, (size_t)(reader->next - reader->data));
+			reader->failed = true;
+		}
+		return NULL;
+	}
+
+	reader->next += used;
+	return reader->record;
+}
+
+void logRecordTime(const uint8_t *record, bool bigendian, log_time_t *time)
+{
+	const uint8_t *dtl = record + 1;
+	uint16_t year;
+	uint32_t nano;
+	memcpy(&year, dtl, 2);
+	memcpy(&nano, dtl + 8, 4);
+	year = bigendian ? be16toh(year) : le16toh(year);
+	nano = bigendian ? be32toh(nano) : le32toh(nano);
+
+	time->date = (uint32_t)year << 16 | dtl[2] << 8 | dtl[3];
+	time->time_ns = ((dtl[5] * 60 + dtl[6]) * 60 + dtl[7]) * 1000000000ULL + nano;
+}
+
+int logTimeCompare(const log_time_t *a, const log_time_t *b)
+{
+	if(a->date != b->date)
+		return (a->date < b->date) ? -1 : 1;
+	if(a->time_ns != b->time_ns)
+		return (a->time_ns < b->time_ns) ? -1 : 1;
+
+	return 0;
+}
+
+static void readIndex(const log_reader_t *reader, long i, log_index_entry_t *entry)
+{
+	memcpy(entry, reader->index + i * sizeof(log_index_entry_t), sizeof(*entry));
+	entry->second = le32toh(entry->second);
+	entry->offset = le32toh(entry->offset);
+}
+
+/* last index entry at or before the second, -1 if there is none */
+static long searchIndex(const log_reader_t *reader, uint32_t second)
+{
+	long low = 0;
+	long high = (long)reader->index_count - 1;
+	long found = -1;
+
+	while(low <= high) {
+		long middle = low + (high - low) / 2;
+		log_index_entry_t entry;
+		readIndex(reader, middle, &entry);
+		if(entry.second <= second) {
+			found = middle;
+			low = middle + 1;
+		}
+		else {
+			high = middle - 1;
+		}
+	}
+
+	return found;
+}
+
+/* first whole record of a plain log at or after the time */
+static const uint8_t *searchRecords(const log_reader_t *reader, const log_time_t *time)
+{
+	const uint8_t *first = reader->data + LOG_HEADER_SIZE;
+	size_t low = 0;
+	size_t high = (reader->end - first) / LOG_RECORD_SIZE;
+
+	while(low < high) {
+		size_t middle = low + (high - low) / 2;
+		const uint8_t *record = first + middle * LOG_RECORD_SIZE;
+		log_time_t middle_time;
+		logRecordTime(record, reader->bigendian, &middle_time);
+
+		/* the end marker sorts after everything */
+		if(record[0] == 0 && logTimeCompare(&middle_time, time) < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return first + low * LOG_RECORD_SIZE;
+}
+
+void logReaderSeek(log_reader_t *reader, const log_time_t *time)
+{
+	reader->next = reader->data + LOG_HEADER_SIZE;
+	reader->finished = false;
+	reader->failed = false;
+	logCodecReset(&reader->codec);
+
+	if(reader->next == reader->end || *reader->next == LOG_END)
+		return;
+
+	/* every entry of a log has the date of its first, see DTLs_for_same_log */
+	log_time_t first;
+	logRecordTime(reader->next, reader->bigendian, &first);
+
+	if(first.date > time->date)
+		return;
+
+	if(first.date < time->date) {
+		/* all of it is before; leave only the end marker to read */
+		if(reader->index != NULL) {
+			reader->next = reader->end - 1;
+		}
+		else if(reader->format == LOG_FORMAT_PLAIN) {
+			log_time_t last = { .date = first.date, .time_ns = UINT64_MAX };
+			reader->next = searchRecords(reader, &last);
+		}
+		/* a compact log without an index can only be read through */
+	}
+	else if(reader->index != NULL) {
+		long found = searchIndex(reader, time->time_ns / 1000000000ULL);
+		if(found != -1) {
+			log_index_entry_t entry;
+			readIndex(reader, found, &entry);
+			/* an indexed entry of a compact log is a key, so the codec needs nothing from before */
+			if(entry.offset >= LOG_HEADER_SIZE && reader->data + entry.offset < reader->end) {
+				reader->next = reader->data + entry.offset;
+			}
+		}
+	}
+	else if(reader->format == LOG_FORMAT_PLAIN) {
+		reader->next = searchRecords(reader, time);
+		return;
+	}
+
+	/* step up to the time itself */
+	for(;;) {
+		const uint8_t *at = reader->next;
+		log_codec_t codec = reader->codec;
+
+		const uint8_t *record = logReaderNext(reader);
+		if(record == NULL)
+			return;
+
+		log_time_t record_time;
+		logRecordTime(record, reader->bigendian, &record_time);
+		if(logTimeCompare(&record_time, time) >= 0) {
+			reader->next = at;
+			reader->codec = codec;
+			return;
+		}
+	}
+}
+
+void logReaderClose(log_reader_t *reader)
+{
+	if(reader->mapped) {
+		munmap((void *)reader->data, reader->size);
+		reader->mapped = false;
+	}
+}
@@ -0,0 +1,135 @@
+#ifndef LOG_READER_H
+#define LOG_READER_H
+
+/**
+ * @file
+ * @brief Reader for the log files written by pn_dev
+ *
+ * Maps a log into memory and steps through its entries. Either format
+ * comes out as version 1 records (see app_logformat.h); those of plain
+ * logs are straight out of the mapping, so nothing is copied.
+ *
+ * logReaderSeek finds a time through the index finished logs carry,
+ * or by bisecting the fixed-size records of a plain log without one.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_logformat.h"
+
+/* when an entry was logged, ordered by date and then time */
+typedef struct log_time
+{
+	/* year << 16 | month << 8 | day */
+	uint32_t date;
+	/* since midnight */
+	uint64_t time_ns;
+} log_time_t;
+
+typedef struct log_reader
+{
+	const char *name;
+	/* whole file, or whatever was handed to logReaderInit */
+	const uint8_t *data;
+	size_t size;
+	/* whether data is our own mapping */
+	bool mapped;
+
+	bool bigendian;
+	uint8_t format;
+
+	/* next record */
+	const uint8_t *next;
+	const uint8_t *end;
+	/* end marker reached */
+	bool finished;
+	/* stopped on something that is not a record */
+	bool failed;
+
+	/* log_index_entry_t found after the end marker, else NULL; may be unaligned */
+	const uint8_t *index;
+	uint32_t index_count;
+
+	/* compact logs decode into this */
+	log_codec_t codec;
+	uint8_t record[LOG_RECORD_SIZE];
+} log_reader_t;
+
+/**
+ * Map a log file and check its header
+ *
+ * @param reader           Out
+ * @param path             In:    log file, kept as the name for messages
+ * @return 0 on success, -1 on error
+ */
+int logReaderOpen(log_reader_t *reader, const char *path);
+
+/**
+ * Read a log already in memory, checking its header.
+ * The memory must stay valid while the reader is used.
+ *
+ * @param reader           Out
+ * @param name             In:    for messages
+ * @param data             In:    the log
+ * @param size             In:    its length
+ * @return 0 on success, -1 on error
+ */
+int logReaderInit(log_reader_t *reader, const char *name, const uint8_t *data, size_t size);
+
+/**
+ * Step to the next entry
+ *
+ * A log that was never finished ends at its last whole record.
+ *
+ * @param reader           InOut
+ * @return version 1 record, valid until the next call,
+ *         NULL at the end of the log or on error (see failed)
+ */
+const uint8_t *logReaderNext(log_reader_t *reader);
+
+/**
+ * Move to the first entry at or after a time, so logReaderNext gives it.
+ *
+ * Takes a binary search through the index, or through the entries of
+ * a plain log without one, then at most a second's worth of entries.
+ * A compact log without an index is read from the start.
+ *
+ * @param reader           InOut
+ * @param time             In
+ */
+void logReaderSeek(log_reader_t *reader, const log_time_t *time);
+
+/**
+ * Read the time of an entry
+ *
+ * @param record           In:    version 1 record
+ * @param bigendian        In:    byte order of the log
+ * @param time             Out
+ */
+void logRecordTime(const uint8_t *record, bool bigendian, log_time_t *time);
+
+/**
+ * Order two times
+ *
+ * @return <0, 0 or >0 as a is before, at or after b
+ */
+int logTimeCompare(const log_time_t *a, const log_time_t *b);
+
+/**
+ * Unmap the log, if logReaderOpen mapped it
+ *
+ * @param reader           In
+ */
+void logReaderClose(log_reader_t *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOG_READER_H */
@@ -0,0 +1,655 @@
+#include "parquet_writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PARQUET_MAGIC "PAR1"
+
+/* parquet.thrift enums, the values used */
+#define TYPE_INT32 1
+#define TYPE_INT64 2
+#define REPETITION_REQUIRED 0
+#define CONVERTED_UINT_16 12
+#define LOGICAL_TIMESTAMP 8
+#define LOGICAL_INTEGER 10
+#define TIME_UNIT_NANOS 3
+#define CODEC_UNCOMPRESSED 0
+#define PAGE_DATA 0
+#define PAGE_DICTIONARY 2
+#define ENCODING_PLAIN 0
+#define ENCODING_RLE 3
+#define ENCODING_DELTA_BINARY_PACKED 5
+#define ENCODING_RLE_DICTIONARY 8
+
+/* values a delta-encoded block covers, and the miniblocks it is cut into */
+#define DELTA_BLOCK 128
+#define DELTA_MINIBLOCKS 4
+#define DELTA_MINIBLOCK (DELTA_BLOCK / DELTA_MINIBLOCKS)
+
+/* values in a bit-packed run of the RLE/bit-packing hybrid, a multiple of 8 */
+#define HYBRID_LITERAL_MAX 504
+
+/* values a word can take */
+#define WORD_VALUES 0x10000
+
+/*
+The Thrift compact protocol, as much of it as the footer and the page
+headers need. Field ids are written as the difference from the previous
+one in the same struct, so the last one is kept for each open struct.
+*/
+
+#define THRIFT_DEPTH 8
+
+#define THRIFT_TRUE 1
+#define THRIFT_FALSE 2
+#define THRIFT_BYTE 3
+#define THRIFT_I32 5
+#define THRIFT_I64 6
+#define THRIFT_BINARY 8
+#define THRIFT_LIST 9
+#define THRIFT_STRUCT 12
+
+typedef struct thrift
+{
+	byte_buffer_t *out;
+	int depth;
+	int16_t last[THRIFT_DEPTH];
+} thrift_t;
+
+static uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static void thriftStart(thrift_t *thrift, byte_buffer_t *out)
+{
+	thrift->out = out;
+	thrift->depth = 0;
+	thrift->last[0] = 0;
+}
+
+static void thriftField(thrift_t *thrift, int16_t id, uint8_t type)
+{
+	int delta = id - thrift->last[thrift->depth];
+
+	if(delta > 0 && delta <= 15) {
+		bufferByte(thrift->out, delta << 4 | type);
+	}
+	else {
+		bufferByte(thrift->out, type);
+		bufferVarint(thrift->out, zigzag(id));
+	}
+	thrift->last[thrift->depth] = id;
+}
+
+static void thriftI32(thrift_t *thrift, int16_t id, int32_t value)
+{
+	thriftField(thrift, id, THRIFT_I32);
+	bufferVarint(thrift->out, zigzag(value));
+}
+
+static void thriftI64(thrift_t *thrift, int16_t id, int64_t value)
+{
+	thriftField(thrift, id, THRIFT_I64);
+	bufferVarint(thrift->out, zigzag(value));
+}
+
+static void thriftByte(thrift_t *thrift, int16_t id, int8_t value)
+{
+	thriftField(thrift, id, THRIFT_BYTE);
+	bufferByte(thrift->out, (uint8_t)value);
+}
+
+static void thriftBool(thrift_t *thrift, int16_t id, bool value)
+{
+	thriftField(thrift, id, value ? THRIFT_TRUE : THRIFT_FALSE);
+}
+
+static void thriftBinary(thrift_t *thrift, int16_t id, const void *data, size_t length)
+{
+	thriftField(thrift, id, THRIFT_BINARY);
+	bufferVarint(thrift->out, length);
+	bufferPut(thrift->out, data, length);
+}
+
+static void thriftString(thrift_t *thrift, int16_t id, const char *text)
+{
+	thriftBinary(thrift, id, text, strlen(text));
+}
+
+static void thriftList(thrift_t *thrift, int16_t id, uint8_t type, size_t count)
+{
+	thriftField(thrift, id, THRIFT_LIST);
+	if(count < 15) {
+		bufferByte(thrift->out, count << 4 | type);
+	}
+	else {
+		bufferByte(thrift->out, 0xF0 | type);
+		bufferVarint(thrift->out, count);
+	}
+}
+
+/* a struct, either as a field or, with no field header, as an element of a list */
+static void thriftBegin(thrift_t *thrift)
+{
+	thrift->depth++;
+	thrift->last[thrift->depth] = 0;
+}
+
+static void thriftStruct(thrift_t *thrift, int16_t id)
+{
+	thriftField(thrift, id, THRIFT_STRUCT);
+	thriftBegin(thrift);
+}
+
+static void thriftEnd(thrift_t *thrift)
+{
+	bufferByte(thrift->out, 0);
+	thrift->depth--;
+}
+
+/* scratch space of an encoding, for one column at a time */
+typedef struct encoder
+{
+	/* where each word value is in the dictionary, if stamp matches the column */
+	uint32_t *stamp;
+	uint16_t *slot;
+	uint32_t stamp_now;
+
+	uint32_t *dictionary;
+	uint32_t *indices;
+	byte_buffer_t page;
+
+	/* the words widened, and delta-encoded */
+	int64_t *values;
+	byte_buffer_t delta;
+} encoder_t;
+
+static int bitWidth(uint64_t value)
+{
+	return (value == 0) ? 0 : 64 - __builtin_clzll(value);
+}
+
+/* values of width bits each, the lowest bits first */
+static void packBits(byte_buffer_t *out, const uint64_t *values, size_t count, int width)
+{
+	size_t length = (count * width + 7) / 8;
+
+	if(width == 0 || !bufferReserve(out, length))
+		return;
+
+	uint8_t *bytes = out->data + out->size;
+	uint64_t pending = 0;
+	int bits = 0;
+
+	/* whole 64-bit words of bits while there are, then what is left */
+	for(size_t i = 0; i < count; i++) {
+		pending |= values[i] << bits;
+		bits += width;
+		if(bits >= 64) {
+			for(int b = 0; b < 8; b++) {
+				*bytes++ = pending >> (8 * b);
+			}
+			bits -= 64;
+			pending = (bits > 0) ? values[i] >> (width - bits) : 0;
+		}
+	}
+	for(int b = 0; b < bits; b += 8) {
+		*bytes++ = pending >> b;
+	}
+
+	out->size += length;
+}
+
+/* up to 8 of the same value from position i */
+static size_t shortRun(const uint32_t *values, size_t i, size_t count)
+{
+	size_t run = 1;
+
+	while(run < 8 && i + run < count && values[i + run] == values[i]) {
+		run++;
+	}
+
+	return run;
+}
+
+/*
+The RLE/bit-packing hybrid: a run of eight or more of the same value is
+written once with its length, anything else bit-packed in groups of eight.
+A bit-packed run can only be padded at the very end, so one that comes
+before a repeated value takes as many of its repeats as it needs to fill
+its last group.
+*/
+static void encodeHybrid(byte_buffer_t *out, const uint32_t *values, size_t count, int width)
+{
+	size_t i = 0;
+
+	while(i < count) {
+		if(shortRun(values, i, count) == 8) {
+			size_t run = 8;
+			while(i + run < count && values[i + run] == values[i]) {
+				run++;
+			}
+
+			uint32_t value = values[i];
+			bufferVarint(out, run << 1);
+			for(int b = 0; b < width; b += 8) {
+				bufferByte(out, value >> b);
+			}
+			i += run;
+			continue;
+		}
+
+		size_t end = i + 1;
+		while(end < count && end - i < HYBRID_LITERAL_MAX && shortRun(values, end, count) < 8) {
+			end++;
+		}
+
+		size_t groups = (end - i + 7) / 8;
+		uint64_t literal[HYBRID_LITERAL_MAX] = {0};
+		size_t taken = (count - i < groups * 8) ? count - i : groups * 8;
+		for(size_t k = 0; k < taken; k++) {
+			literal[k] = values[i + k];
+		}
+
+		bufferVarint(out, groups << 1 | 1);
+		packBits(out, literal, groups * 8, width);
+		i += taken;
+	}
+}
+
+/* DELTA_BINARY_PACKED: the first value, then blocks of differences from it on */
+static void encodeDelta(byte_buffer_t *out, const int64_t *values, size_t count)
+{
+	bufferVarint(out, DELTA_BLOCK);
+	bufferVarint(out, DELTA_MINIBLOCKS);
+	bufferVarint(out, count);
+	bufferVarint(out, zigzag(values[0]));
+
+	for(size_t i = 1; i < count; i += DELTA_BLOCK) {
+		size_t n = (count - i < DELTA_BLOCK) ? count - i : DELTA_BLOCK;
+		uint64_t deltas[DELTA_BLOCK] = {0};
+		int64_t min = INT64_MAX;
+
+		/* unsigned, as readers undo it, so any difference wraps the same way */
+		for(size_t k = 0; k < n; k++) {
+			deltas[k] = (uint64_t)values[i + k] - (uint64_t)values[i + k - 1];
+			if((int64_t)deltas[k] < min) {
+				min = (int64_t)deltas[k];
+			}
+		}
+		for(size_t k = 0; k < n; k++) {
+			deltas[k] -= (uint64_t)min;
+		}
+
+		bufferVarint(out, zigzag(min));
+
+		size_t miniblocks = (n + DELTA_MINIBLOCK - 1) / DELTA_MINIBLOCK;
+		int widths[DELTA_MINIBLOCKS] = {0};
+		for(size_t m = 0; m < miniblocks; m++) {
+			uint64_t bits = 0;
+			for(size_t k = 0; k < DELTA_MINIBLOCK; k++) {
+				bits |= deltas[m * DELTA_MINIBLOCK + k];
+			}
+			widths[m] = bitWidth(bits);
+		}
+		for(size_t m = 0; m < DELTA_MINIBLOCKS; m++) {
+			bufferByte(out, widths[m]);
+		}
+
+		/* the miniblocks not needed in the last block are left out */
+		for(size_t m = 0; m < miniblocks; m++) {
+			packBits(out, deltas + m * DELTA_MINIBLOCK, DELTA_MINIBLOCK, widths[m]);
+		}
+	}
+}
+
+/* the page header, then the page */
+static void writePage(byte_buffer_t *out, int type, int encoding, size_t values, const byte_buffer_t *page)
+{
+	thrift_t thrift;
+
+	thriftStart(&thrift, out);
+	thriftI32(&thrift, 1, type);
+	/* uncompressed and compressed size */
+	thriftI32(&thrift, 2, page->size);
+	thriftI32(&thrift, 3, page->size);
+	if(type == PAGE_DICTIONARY) {
+		thriftStruct(&thrift, 7);
+		thriftI32(&thrift, 1, values);
+		thriftI32(&thrift, 2, encoding);
+		thriftEnd(&thrift);
+	}
+	else {
+		thriftStruct(&thrift, 5);
+		thriftI32(&thrift, 1, values);
+		thriftI32(&thrift, 2, encoding);
+		/* of the definition and repetition levels, of which there are none */
+		thriftI32(&thrift, 3, ENCODING_RLE);
+		thriftI32(&thrift, 4, ENCODING_RLE);
+		thriftEnd(&thrift);
+	}
+	thriftEnd(&thrift);
+
+	bufferPut(out, page->data, page->size);
+}
+
+static void encodeTime(encoder_t *encoder, const int64_t *time, size_t rows, byte_buffer_t *out, parquet_chunk_t *chunk)
+{
+	chunk->min = chunk->max = time[0];
+	for(size_t i = 1; i < rows; i++) {
+		if(time[i] < chunk->min) {
+			chunk->min = time[i];
+		}
+		if(time[i] > chunk->max) {
+			chunk->max = time[i];
+		}
+	}
+
+	encoder->page.size = 0;
+	encodeDelta(&encoder->page, time, rows);
+
+	chunk->data_offset = out->size;
+	writePage(out, PAGE_DATA, ENCODING_DELTA_BINARY_PACKED, rows, &encoder->page);
+}
+
+static void encodeWord(encoder_t *encoder, const uint16_t *words, size_t rows, byte_buffer_t *out, parquet_chunk_t *chunk)
+{
+	chunk->min = chunk->max = words[0];
+	for(size_t i = 0; i < rows; i++) {
+		if(words[i] < chunk->min) {
+			chunk->min = words[i];
+		}
+		if(words[i] > chunk->max) {
+			chunk->max = words[i];
+		}
+		encoder->values[i] = words[i];
+	}
+
+	/* words that change all the time take less as differences from one to the next */
+	encoder->delta.size = 0;
+	encodeDelta(&encoder->delta, encoder->values, rows);
+
+	/* the dictionary is given up on as soon as it alone is bigger than that */
+	size_t distinct = 0;
+	size_t limit = encoder->delta.size / sizeof(uint32_t);
+
+	encoder->stamp_now++;
+	for(size_t i = 0; i < rows && distinct <= limit; i++) {
+		uint16_t word = words[i];
+
+		if(encoder->stamp[word] != encoder->stamp_now) {
+			encoder->stamp[word] = encoder->stamp_now;
+			encoder->slot[word] = distinct;
+			encoder->dictionary[distinct++] = word;
+		}
+		encoder->indices[i] = encoder->slot[word];
+	}
+
+	encoder->page.size = 0;
+	if(distinct <= limit) {
+		/* a single value still takes one bit, which some readers insist on */
+		int width = bitWidth(distinct - 1);
+		if(width == 0) {
+			width = 1;
+		}
+
+		bufferByte(&encoder->page, width);
+		encodeHybrid(&encoder->page, encoder->indices, rows, width);
+	}
+
+	chunk->dictionary = (distinct <= limit && encoder->page.size + distinct * sizeof(uint32_t) <= encoder->delta.size);
+	if(chunk->dictionary) {
+		byte_buffer_t values = {0};
+		for(size_t k = 0; k < distinct; k++) {
+			bufferLe32(&values, encoder->dictionary[k]);
+		}
+		writePage(out, PAGE_DICTIONARY, ENCODING_PLAIN, distinct, &values);
+		out->failed = out->failed || values.failed;
+		bufferFree(&values);
+
+		chunk->data_offset = out->size;
+		writePage(out, PAGE_DATA, ENCODING_RLE_DICTIONARY, rows, &encoder->page);
+	}
+	else {
+		chunk->data_offset = out->size;
+		writePage(out, PAGE_DATA, ENCODING_DELTA_BINARY_PACKED, rows, &encoder->delta);
+	}
+}
+
+void parquetFileStart(parquet_file_t *file, const projection_t *projection, byte_buffer_t *out)
+{
+	memset(file, 0, sizeof(*file));
+	file->projection = *projection;
+
+	bufferPut(out, PARQUET_MAGIC, 4);
+	file->offset = 4;
+}
+
+int parquetEncodeRowGroup(const column_table_t *table, byte_buffer_t *out, parquet_row_group_t *group)
+{
+	encoder_t encoder = {0};
+	size_t start = out->size;
+
+	memset(group, 0, sizeof(*group));
+	group->rows = table->count;
+	group->column_count = 1 + table->word_count;
+
+	encoder.stamp = calloc(WORD_VALUES, sizeof(uint32_t));
+	encoder.slot = malloc(WORD_VALUES * sizeof(uint16_t));
+	encoder.dictionary = malloc(WORD_VALUES * sizeof(uint32_t));
+	encoder.indices = malloc(table->count * sizeof(uint32_t));
+	encoder.values = malloc(table->count * sizeof(int64_t));
+
+	int ret = -1;
+	if(encoder.stamp != NULL && encoder.slot != NULL && encoder.dictionary != NULL && encoder.indices != NULL
+		&& encoder.values != NULL) {
+		for(int c = 0; c < group->column_count; c++) {
+			parquet_chunk_t *chunk = &group->columns[c];
+			size_t chunk_start = out->size;
+
+			if(c == 0) {
+				encodeTime(&encoder, table->time, table->count, out, chunk);
+			}
+			else {
+				encodeWord(&encoder, table->words[c - 1], table->count, out, chunk);
+			}
+
+			chunk->offset = chunk_start - start;
+			chunk->data_offset -= start;
+			chunk->size = out->size - chunk_start;
+		}
+
+		group->size = out->size - start;
+		ret = (out->failed || encoder.page.failed || encoder.delta.failed) ? -1 : 0;
+	}
+
+	free(encoder.stamp);
+	free(encoder.slot);
+	free(encoder.dictionary);
+	free(encoder.indices);
+	free(encoder.values);
+	bufferFree(&encoder.page);
+	bufferFree(&encoder.delta);
+
+	return ret;
+}
+
+int parquetFileAdd(parquet_file_t *file, const parquet_row_group_t *group)
+{
+	if(file->group_count == file->group_capacity) {
+		size_t capacity = file->group_capacity ? 2 * file->group_capacity : 64;
+		parquet_row_group_t *grown = realloc(file->groups, capacity * sizeof(parquet_row_group_t));
+		if(grown == NULL)
+			return -1;
+		file->groups = grown;
+		file->group_capacity = capacity;
+	}
+
+	parquet_row_group_t *added = &file->groups[file->group_count++];
+	*added = *group;
+	for(int c = 0; c < added->column_count; c++) {
+		added->columns[c].offset += file->offset;
+		added->columns[c].data_offset += file->offset;
+	}
+
+	file->offset += group->size;
+	file->rows += group->rows;
+
+	return 0;
+}
+
+static void columnName(char *name, int column, const projection_t *projection)
+{
+	if(column == 0) {
+		strcpy(name, "time");
+	}
+	else {
+		projectionColumnName(projection, column - 1, name);
+	}
+}
+
+static void writeSchema(thrift_t *thrift, const projection_t *projection)
+{
+	int columns = 1 + projection->count;
+	char name[16];
+
+	thriftList(thrift, 2, THRIFT_STRUCT, 1 + columns);
+
+	thriftBegin(thrift);
+	thriftString(thrift, 4, "schema");
+	thriftI32(thrift, 5, columns);
+	thriftEnd(thrift);
+
+	for(int c = 0; c < columns; c++) {
+		columnName(name, c, projection);
+
+		thriftBegin(thrift);
+		thriftI32(thrift, 1, (c == 0) ? TYPE_INT64 : TYPE_INT32);
+		thriftI32(thrift, 3, REPETITION_REQUIRED);
+		thriftString(thrift, 4, name);
+		if(c == 0) {
+			thriftStruct(thrift, 10);
+			thriftStruct(thrift, LOGICAL_TIMESTAMP);
+			/* isAdjustedToUTC: the DTL has no time zone */
+			thriftBool(thrift, 1, false);
+			thriftStruct(thrift, 2);
+			thriftStruct(thrift, TIME_UNIT_NANOS);
+			thriftEnd(thrift);
+			thriftEnd(thrift);
+			thriftEnd(thrift);
+			thriftEnd(thrift);
+		}
+		else {
+			thriftI32(thrift, 6, CONVERTED_UINT_16);
+			thriftStruct(thrift, 10);
+			thriftStruct(thrift, LOGICAL_INTEGER);
+			thriftByte(thrift, 1, 16);
+			thriftBool(thrift, 2, false);
+			thriftEnd(thrift);
+			thriftEnd(thrift);
+		}
+		thriftEnd(thrift);
+	}
+}
+
+static void writeChunk(thrift_t *thrift, int column, const parquet_row_group_t *group, const projection_t *projection)
+{
+	const parquet_chunk_t *chunk = &group->columns[column];
+	char name[16];
+	uint8_t min[8];
+	uint8_t max[8];
+	size_t value_size = (column == 0) ? 8 : 4;
+
+	columnName(name, column, projection);
+	for(size_t b = 0; b < value_size; b++) {
+		min[b] = (uint64_t)chunk->min >> (8 * b);
+		max[b] = (uint64_t)chunk->max >> (8 * b);
+	}
+
+	thriftBegin(thrift);
+	thriftI64(thrift, 2, chunk->offset);
+	thriftStruct(thrift, 3);
+
+	thriftI32(thrift, 1, (column == 0) ? TYPE_INT64 : TYPE_INT32);
+	if(chunk->dictionary) {
+		thriftList(thrift, 2, THRIFT_I32, 2);
+		bufferVarint(thrift->out, zigzag(ENCODING_PLAIN));
+		bufferVarint(thrift->out, zigzag(ENCODING_RLE_DICTIONARY));
+	}
+	else {
+		thriftList(thrift, 2, THRIFT_I32, 1);
+		bufferVarint(thrift->out, zigzag(ENCODING_DELTA_BINARY_PACKED));
+	}
+	thriftList(thrift, 3, THRIFT_BINARY, 1);
+	bufferVarint(thrift->out, strlen(name));
+	bufferPut(thrift->out, name, strlen(name));
+	thriftI32(thrift, 4, CODEC_UNCOMPRESSED);
+	thriftI64(thrift, 5, group->rows);
+	thriftI64(thrift, 6, chunk->size);
+	thriftI64(thrift, 7, chunk->size);
+	thriftI64(thrift, 9, chunk->data_offset);
+	if(chunk->dictionary) {
+		thriftI64(thrift, 11, chunk->offset);
+	}
+
+	/* null count, then max_value and min_value, plain-encoded */
+	thriftStruct(thrift, 12);
+	thriftI64(thrift, 3, 0);
+	thriftBinary(thrift, 5, max, value_size);
+	thriftBinary(thrift, 6, min, value_size);
+	thriftEnd(thrift);
+
+	thriftEnd(thrift);
+	thriftEnd(thrift);
+}
+
+int parquetFileFinish(parquet_file_t *file, byte_buffer_t *out)
+{
+	thrift_t thrift;
+	size_t start = out->size;
+
+	thriftStart(&thrift, out);
+	thriftI32(&thrift, 1, 1);
+	writeSchema(&thrift, &file->projection);
+	thriftI64(&thrift, 3, file->rows);
+
+	thriftList(&thrift, 4, THRIFT_STRUCT, file->group_count);
+	for(size_t g = 0; g < file->group_count; g++) {
+		const parquet_row_group_t *group = &file->groups[g];
+
+		thriftBegin(&thrift);
+		thriftList(&thrift, 1, THRIFT_STRUCT, group->column_count);
+		for(int c = 0; c < group->column_count; c++) {
+			writeChunk(&thrift, c, group, &file->projection);
+		}
+		thriftI64(&thrift, 2, group->size);
+		thriftI64(&thrift, 3, group->rows);
+		thriftI64(&thrift, 5, group->columns[0].offset);
+		thriftI64(&thrift, 6, group->size);
+		thriftEnd(&thrift);
+	}
+
+	thriftString(&thrift, 6, "pnet2csv");
+
+	/* statistics ordered as the logical types say, unsigned for the words */
+	thriftList(&thrift, 7, THRIFT_STRUCT, 1 + file->projection.count);
+	for(int c = 0; c < 1 + file->projection.count; c++) {
+		thriftBegin(&thrift);
+		thriftStruct(&thrift, 1);
+		thriftEnd(&thrift);
+		thriftEnd(&thrift);
+	}
+	thriftEnd(&thrift);
+
+	bufferLe32(out, out->size - start);
+	bufferPut(out, PARQUET_MAGIC, 4);
+
+	return out->failed ? -1 : 0;
+}
+
+void parquetFileFree(parquet_file_t *file)
+{
+	free(file->groups);
+	memset(file, 0, sizeof(*file));
+}
@@ -0,0 +1,123 @@
+#ifndef PARQUET_WRITER_H
+#define PARQUET_WRITER_H
+
+/**
+ * @file
+ * @brief Parquet export of log entries
+ *
+ * A column "time" of INT64 timestamps in nanoseconds, without a time zone,
+ * and columns "word0" to "word63" of 16-bit unsigned integers (INT32 with
+ * an unsigned 16-bit logical type, as Parquet has no narrower type).
+ * Every column chunk is a single page, not compressed:
+ * - the time delta-encoded (DELTA_BINARY_PACKED), which takes regularly
+ *   spaced timestamps down to almost nothing
+ * - each word dictionary-encoded with runs of the same value run-length
+ *   encoded, which takes words that change slowly down to almost nothing,
+ *   or delta-encoded as well if that is smaller, for those that do not
+ *
+ * Every chunk has its minimum and maximum, so that a reader can skip the
+ * row groups out of the time range it wants.
+ *
+ * Row groups are encoded independently of each other, on any thread, and
+ * then added to the file in order; the footer describing them is written
+ * last.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_logformat.h"
+#include "byte_buffer.h"
+#include "column_table.h"
+#include "entry_filter.h"
+
+/* at most, with every word */
+#define PARQUET_COLUMNS (1 + LOG_WORD_COUNT)
+
+/* what the footer needs of a column chunk */
+typedef struct parquet_chunk
+{
+	/* from the start of the row group, until it is added to the file */
+	uint64_t offset;
+	/* of the data page, after the dictionary page if there is one */
+	uint64_t data_offset;
+	uint64_t size;
+	bool dictionary;
+	int64_t min;
+	int64_t max;
+} parquet_chunk_t;
+
+typedef struct parquet_row_group
+{
+	size_t rows;
+	uint64_t size;
+	int column_count;
+	parquet_chunk_t columns[PARQUET_COLUMNS];
+} parquet_row_group_t;
+
+typedef struct parquet_file
+{
+	/* the words, for the schema */
+	projection_t projection;
+	/* bytes of the file so far */
+	uint64_t offset;
+	uint64_t rows;
+	parquet_row_group_t *groups;
+	size_t group_count;
+	size_t group_capacity;
+} parquet_file_t;
+
+/**
+ * Start a file
+ *
+ * @param file             Out
+ * @param projection       In:    the words written
+ * @param out              InOut: the first bytes of the file are appended
+ */
+void parquetFileStart(parquet_file_t *file, const projection_t *projection, byte_buffer_t *out);
+
+/**
+ * Encode entries as a row group
+ *
+ * @param table            In:    at least one entry, with the words of the projection
+ * @param out              InOut: the row group is appended
+ * @param group            Out:   for parquetFileAdd
+ * @return 0 on success, -1 if out of memory
+ */
+int parquetEncodeRowGroup(const column_table_t *table, byte_buffer_t *out, parquet_row_group_t *group);
+
+/**
+ * Account for a row group written after everything before it
+ *
+ * @param file             InOut
+ * @param group            In:    as parquetEncodeRowGroup left it
+ * @return 0 on success, -1 if out of memory
+ */
+int parquetFileAdd(parquet_file_t *file, const parquet_row_group_t *group);
+
+/**
+ * Finish a file with its footer
+ *
+ * @param file             InOut
+ * @param out              InOut: the last bytes of the file are appended
+ * @return 0 on success, -1 if out of memory
+ */
+int parquetFileFinish(parquet_file_t *file, byte_buffer_t *out);
+
+/**
+ * Free what a file keeps for its footer
+ *
+ * @param file             InOut
+ */
+void parquetFileFree(parquet_file_t *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PARQUET_WRITER_H */
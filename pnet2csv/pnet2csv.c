@@ -0,0 +1,1692 @@
+#include "app_logcatalog.h"
+#include "archive_reader.h"
+#include "arrow_writer.h"
+#include "byte_buffer.h"
+#include "column_table.h"
+#include "csv_format.h"
+#include "entry_filter.h"
+#include "log_reader.h"
+#include "parquet_writer.h"
+#include "record_decode.h"
+#include "resample.h"
+#include "work_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <time.h>
+
+/*
+Entries per piece of work. Logs are cut into pieces of this many entries,
+so one long log keeps all the cores as busy as many short ones; a piece
+of a plain log is about 1 MB of it and up to 3.4 MB of CSV.
+*/
+#define PIECE_ENTRIES 8192
+
+/*
+For Arrow and Parquet each piece is a record batch or row group, so it
+is as many entries as one of those; about a minute of a log at 1 kHz by
+default. A piece of this many takes 136 bytes an entry while it is
+encoded.
+*/
+#define ROW_GROUP_ENTRIES 65536
+#define ROW_GROUP_MAX (1024 * 1024)
+
+/* pieces that may be converted ahead of the one being written, per worker */
+#define PIECES_AHEAD 2
+
+/*
+Logs out of a .zst archive are decompressed into memory and kept there
+until converted, so they are taken in batches of about this much
+*/
+#define BATCH_MEMORY (1024UL * 1024 * 1024)
+
+/* enough of an archive log for its header and first entry */
+#define PROBE_SIZE (LOG_HEADER_SIZE + LOG_RECORD_SIZE)
+
+/* where the entries of an input come from */
+typedef enum input_source
+{
+	/* a log file, mapped */
+	SOURCE_LOG,
+	/* a log in a .zst archive, decompressed when its batch comes up */
+	SOURCE_ZSTD,
+	/* a whole .tgz archive, streamed one log at a time */
+	SOURCE_TGZ,
+} input_source_t;
+
+typedef enum output_format
+{
+	OUTPUT_CSV,
+	/* an Arrow IPC file, also known as Feather version 2 */
+	OUTPUT_ARROW,
+	OUTPUT_PARQUET,
+} output_format_t;
+
+/* where decoding a piece of a compact log starts */
+typedef struct checkpoint
+{
+	const uint8_t *next;
+	log_codec_t codec;
+} checkpoint_t;
+
+/* entries wanted, from <= time < to */
+typedef struct range
+{
+	bool from_set;
+	bool to_set;
+	log_time_t from;
+	log_time_t to;
+	/* otherwise the date of each log is used */
+	bool from_dated;
+	bool to_dated;
+} range_t;
+
+typedef struct input
+{
+	/* for messages; that of a log in an archive is ARCHIVE:LOG */
+	char *path;
+	input_source_t source;
+	/* SOURCE_ZSTD only */
+	char *archive;
+	zstd_archive_entry_t entry;
+	/* the log decompressed, for logs out of archives */
+	uint8_t *data;
+
+	log_reader_t reader;
+	bool usable;
+	/* position on the command line, to keep the order of logs that start together */
+	size_t order;
+	/* of the first entry, to put the logs in time order */
+	log_time_t first;
+
+	/* first entry in range */
+	const uint8_t *start;
+	size_t entries;
+	/* end marker found, or the range ended first */
+	bool finished;
+	/* compact logs only, one per piece */
+	checkpoint_t *checkpoints;
+} input_t;
+
+typedef struct piece
+{
+	input_t *input;
+	/* entries of the input this covers */
+	size_t first;
+	size_t count;
+
+	/* CSV lines, or a record batch or row group */
+	byte_buffer_t out;
+	/* what the footer of an Arrow or Parquet file needs of it */
+	arrow_block_t block;
+	parquet_row_group_t *group;
+	/* when resampling, the entries instead, for the writer to resample */
+	column_table_t table;
+	/* stopped early, so nothing after it in the same log is any good */
+	bool cut_short;
+	/* last piece of its input */
+	bool last;
+} piece_t;
+
+typedef struct conversion
+{
+	range_t range;
+	entry_filter_t filter;
+	/* as written; the words of the filter, or their aggregates when resampling */
+	projection_t columns;
+	output_format_t format;
+	/* entries per piece */
+	size_t piece_entries;
+
+	/* the entries of the pieces are resampled in order as they are written */
+	bool resampling;
+	int64_t period;
+	aggregate_t aggregates[RESAMPLE_AGGREGATES];
+	int aggregate_count;
+	resampler_t resampler;
+	/* where the columns are in its rows */
+	projection_t row_layout;
+	/* rows gathered into a row group or record batch, which is the size of this */
+	column_table_t rows;
+
+	/* of the file being written, for its footer */
+	arrow_file_t arrow;
+	parquet_file_t parquet;
+	input_t *inputs;
+	size_t input_count;
+	/* inputs being converted, as many as fit in memory */
+	input_t *batch;
+	size_t batch_count;
+	piece_t *pieces;
+	size_t piece_count;
+} conversion_t;
+
+/* what the catalog of a log directory says */
+typedef struct data_dir
+{
+	log_catalog_t catalog;
+	/* the logs of days not deleted, by name, so by time */
+	log_catalog_record_t *logs;
+	size_t log_count;
+} data_dir_t;
+
+static void showUsage(void)
+{
+	printf("Convert data logs to CSV, Arrow or Parquet\n");
+	printf("\n");
+	printf("Usage:\n");
+	printf("   pnet2csv [-n] [-f FORMAT] [-g ROWS] [-j THREADS] [-s TIME] [-e TIME]\n");
+	printf("            [-w WORDS] [-c CONDITION]... [-r PERIOD [-a AGGREGATES]]\n");
+	printf("            [-o FILE] LOG|DAY|ARCHIVE|DATA...\n");
+	printf("   pnet2csv -l [-n] [-s TIME] [-e TIME] DATA...\n");
+	printf("\n");
+	printf("   -o FILE      Write to FILE rather than standard output\n");
+	printf("   -s TIME      Only entries from TIME on\n");
+	printf("   -e TIME      Only entries before TIME\n");
+	printf("   -w, --words WORDS\n");
+	printf("                Only these words, as 1,7,12 or 0-3,9, in that order\n");
+	printf("   -c, --where CONDITION\n");
+	printf("                Only entries meeting CONDITION. May be given more\n");
+	printf("                than once, for entries meeting all of them\n");
+	printf("   -r, --resample PERIOD\n");
+	printf("                A row every PERIOD, as 1ms, 250us or 10s, holding\n");
+	printf("                the words of the latest entry at that time\n");
+	printf("   -a, --aggregate AGGREGATES\n");
+	printf("                Some of min, max and last, as min,max: what each\n");
+	printf("                word of a row holds of the PERIOD ending there\n");
+	printf("   -f FORMAT    csv (the default), arrow for an Arrow IPC file\n");
+	printf("                (Feather version 2), or parquet\n");
+	printf("   -g ROWS      Entries per Parquet row group or Arrow record\n");
+	printf("                batch, at most %d. Defaults to %d\n", ROW_GROUP_MAX, ROW_GROUP_ENTRIES);
+	printf("   -l, --list   List the logs of DATA from its catalog: the times\n");
+	printf("                of their first and last entries, how many there\n");
+	printf("                are and were dropped, and the archive they are in\n");
+	printf("   -n           Leave out the line of column names of CSV\n");
+	printf("   -j THREADS   Convert on this many threads. Defaults to one\n");
+	printf("                per core\n");
+	printf("   -h           Show this help\n");
+	printf("\n");
+	printf("Entries of all the logs are written one after another, in the\n");
+	printf("order of their first entries. Logs of either format version can\n");
+	printf("be read. A DAY directory stands for all the logs in it, as does an\n");
+	printf("ARCHIVE of one (DAY.zst or DAY.tgz), which is read without being\n");
+	printf("extracted. The logs of a .tgz are taken in the order they were\n");
+	printf("archived.\n");
+	printf("\n");
+	printf("DATA is the log directory, holding days and the catalog the logger\n");
+	printf("keeps of them, and stands for all of its days. Logs and archives the\n");
+	printf("catalog has as out of a dated -s and -e are left unopened.\n");
+	printf("\n");
+	printf("TIME is [YYYY-MM-DDT]HH:MM:SS[.FRACTION]; without a date it applies\n");
+	printf("to the date of each log. Finished logs are indexed, so only the\n");
+	printf("entries in range are read.\n");
+	printf("\n");
+	printf("CONDITION is W<n> OP VALUE, where OP is one of == != < <= > >= and\n");
+	printf("VALUE a number or prev, the same word of the entry before; or\n");
+	printf("W<n> & MASK, for any of the bits of MASK set. So W7 != prev keeps\n");
+	printf("the entries where word 7 changed. The first entry read of a log has\n");
+	printf("none before it, and meets every condition against prev.\n");
+	printf("\n");
+	printf("Entries are only logged when the data changes, so -r fills in the\n");
+	printf("rows in between: one at every whole multiple of PERIOD, from -s, or\n");
+	printf("the first entry, up to -e, or through the last entry. A row holds the\n");
+	printf("latest entry at or before its time, across the gaps between logs.\n");
+	printf("With -a, word7 becomes word7_min, word7_max and word7_last, the\n");
+	printf("least, greatest and latest value of the word over the PERIOD up to\n");
+	printf("the row. A TIME without a date takes that of the first log here.\n");
+	printf("\n");
+	printf("Arrow and Parquet have a column time, in nanoseconds since 1970\n");
+	printf("without a time zone, and a column of uint16 for each word, word0\n");
+	printf("to word63 or those of -w. Row groups and record batches do not span\n");
+	printf("logs, unless resampled. Parquet row groups hold the minimum and maximum of each\n");
+	printf("column, so readers can skip those out of the time range they want.\n");
+}
+
+/* 0 on success, -1 on error */
+static int writeAll(int fd, const char *data, size_t length)
+{
+	while(length > 0) {
+		ssize_t written = write(fd, data, length);
+		if(written == -1) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += written;
+		length -= written;
+	}
+
+	return 0;
+}
+
+/* write what has been put together and free it, 0 on success, -1 on error */
+static int writeOut(byte_buffer_t *out, int fd, const char *name)
+{
+	int ret = 0;
+
+	if(out->failed) {
+		fprintf(stderr, "Out of memory\n");
+		ret = -1;
+	}
+	else if(writeAll(fd, (const char *)out->data, out->size) == -1) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		ret = -1;
+	}
+	bufferFree(out);
+
+	return ret;
+}
+
+/* [YYYY-MM-DDT]HH:MM:SS[.FRACTION], as written by formatCsvEntry; 0 on success */
+static int parseTime(const char *text, log_time_t *time, bool *dated)
+{
+	unsigned int year, month, day, hour, minute, second;
+	int used = 0;
+
+	*dated = false;
+	time->date = 0;
+	if(sscanf(text, "%u-%u-%uT%n", &year, &month, &day, &used) == 3 && used > 0) {
+		if(year > 0xFFFF || month > 12 || day > 31)
+			return -1;
+		time->date = year << 16 | month << 8 | day;
+		*dated = true;
+		text += used;
+	}
+
+	used = 0;
+	if(sscanf(text, "%2u:%2u:%2u%n", &hour, &minute, &second, &used) != 3 || used == 0)
+		return -1;
+	if(hour > 23 || minute > 59 || second > 59)
+		return -1;
+	text += used;
+
+	uint64_t nano = 0;
+	if(*text == '.') {
+		text++;
+		for(int digit = 0; digit < 9; digit++) {
+			nano *= 10;
+			if(*text >= '0' && *text <= '9') {
+				nano += *text++ - '0';
+			}
+		}
+		/* beyond nanoseconds */
+		while(*text >= '0' && *text <= '9') {
+			text++;
+		}
+	}
+
+	if(*text != '\0')
+		return -1;
+
+	time->time_ns = ((hour * 60 + minute) * 60 + second) * 1000000000ULL + nano;
+
+	return 0;
+}
+
+static int compareInputs(const void *a, const void *b)
+{
+	const input_t *x = a;
+	const input_t *y = b;
+
+	int order = logTimeCompare(&x->first, &y->first);
+	if(order != 0)
+		return order;
+
+	return (x->order < y->order) ? -1 : (x->order > y->order);
+}
+
+/* time of the first entry, a key record in compact logs so read the same way */
+static void findFirst(input_t *input)
+{
+	log_reader_t *reader = &input->reader;
+
+	if(reader->end - reader->next >= LOG_RECORD_SIZE && *reader->next != LOG_END) {
+		logRecordTime(reader->next, reader->bigendian, &input->first);
+	}
+}
+
+/*
+Open an input and find its first entry, to put the inputs in order.
+Of a log in an archive only enough to go by is decompressed for now.
+*/
+static void probeInput(void *context, size_t task)
+{
+	conversion_t *conversion = context;
+	input_t *input = &conversion->inputs[task];
+	log_reader_t *reader = &input->reader;
+	uint8_t *start = NULL;
+	size_t size = 0;
+
+	/* ones that can not be read are left out, and the rest carry on */
+	switch(input->source) {
+	case SOURCE_LOG:
+		input->usable = (logReaderOpen(reader, input->path) == 0);
+		if(input->usable) {
+			findFirst(input);
+		}
+		return;
+	case SOURCE_ZSTD:
+#if LOGGER_USE_ZSTD
+		input->usable = (zstdArchiveRead(input->archive, &input->entry, PROBE_SIZE, &start, &size) == 0);
+#endif
+		break;
+	case SOURCE_TGZ:
+		{
+			tgz_reader_t *archive = malloc(sizeof(tgz_reader_t));
+			char name[NAME_MAX];
+			input->usable = (archive != NULL && tgzOpen(archive, input->path) == 0);
+			if(input->usable) {
+				input->usable = (tgzNextLog(archive, name, sizeof(name), PROBE_SIZE, &start, &size) == 1);
+				tgzClose(archive);
+			}
+			free(archive);
+		}
+		break;
+	}
+
+	input->usable = input->usable && logReaderInit(reader, input->path, start, size) == 0;
+	if(input->usable) {
+		findFirst(input);
+	}
+
+	/* the reader is set up again on the whole log once it is wanted */
+	free(start);
+}
+
+/*
+Find where the range starts in an input and how many entries it holds,
+and for compact logs where each piece starts, as decoding has to run
+through the whole range for that.
+*/
+static void scanInput(void *context, size_t task)
+{
+	conversion_t *conversion = context;
+	range_t *range = &conversion->range;
+	input_t *input = &conversion->batch[task];
+	log_reader_t *reader = &input->reader;
+
+#if LOGGER_USE_ZSTD
+	if(input->source == SOURCE_ZSTD && input->usable) {
+		size_t size;
+		input->usable = (zstdArchiveRead(input->archive, &input->entry, SIZE_MAX, &input->data, &size) == 0
+			&& logReaderInit(reader, input->path, input->data, size) == 0);
+	}
+#endif
+
+	if(!input->usable)
+		return;
+
+	findFirst(input);
+
+	log_time_t from = range->from;
+	log_time_t to = range->to;
+	if(!range->from_dated) {
+		from.date = input->first.date;
+	}
+	if(!range->to_dated) {
+		to.date = input->first.date;
+	}
+
+	if(range->from_set) {
+		logReaderSeek(reader, &from);
+	}
+	input->start = reader->next;
+
+	if(reader->format == LOG_FORMAT_PLAIN) {
+		const uint8_t *body = reader->data + LOG_HEADER_SIZE;
+		size_t length = reader->end - body;
+		size_t total = length / LOG_RECORD_SIZE;
+		size_t first = (input->start - body) / LOG_RECORD_SIZE;
+		size_t last = total;
+
+		input->finished = (length % LOG_RECORD_SIZE == 1 && reader->end[-1] == LOG_END);
+
+		if(range->to_set) {
+			log_reader_t end_reader = *reader;
+			logReaderSeek(&end_reader, &to);
+			size_t before = (end_reader.next - body) / LOG_RECORD_SIZE;
+			if(before < total) {
+				last = before;
+				input->finished = true;
+			}
+		}
+
+		input->entries = (last > first) ? last - first : 0;
+	}
+	else {
+		size_t capacity = 0;
+
+		for(;;) {
+			if(input->entries % conversion->piece_entries == 0) {
+				size_t piece = input->entries / conversion->piece_entries;
+				if(piece == capacity) {
+					capacity = capacity ? 2*capacity : 16;
+					checkpoint_t *grown = realloc(input->checkpoints, capacity * sizeof(checkpoint_t));
+					if(grown == NULL) {
+						fprintf(stderr, "%s: Out of memory\n", input->path);
+						break;
+					}
+					input->checkpoints = grown;
+				}
+				input->checkpoints[piece].next = reader->next;
+				input->checkpoints[piece].codec = reader->codec;
+			}
+
+			const uint8_t *record = logReaderNext(reader);
+			if(record == NULL)
+				break;
+
+			if(range->to_set) {
+				log_time_t time;
+				logRecordTime(record, reader->bigendian, &time);
+				if(logTimeCompare(&time, &to) >= 0) {
+					reader->finished = true;
+					break;
+				}
+			}
+
+			input->entries++;
+		}
+
+		/* one that failed part way has already been reported */
+		input->finished = reader->finished || reader->failed;
+	}
+}
+
+/* the entries of a piece as a record batch or row group, 0 on success, -1 if out of memory */
+static int encodePiece(conversion_t *conversion, piece_t *piece, const column_table_t *table)
+{
+	if(conversion->format == OUTPUT_ARROW)
+		return arrowEncodeBatch(table, &piece->out, &piece->block);
+
+	piece->group = malloc(sizeof(parquet_row_group_t));
+	if(piece->group == NULL)
+		return -1;
+
+	return parquetEncodeRowGroup(table, &piece->out, piece->group);
+}
+
+static void freePiece(piece_t *piece)
+{
+	bufferFree(&piece->out);
+	free(piece->group);
+	piece->group = NULL;
+	columnTableFree(&piece->table);
+}
+
+static void convertPiece(void *context, size_t task)
+{
+	conversion_t *conversion = context;
+	piece_t *piece = &conversion->pieces[task];
+	input_t *input = piece->input;
+
+	if(piece->count == 0)
+		return;
+
+	/* a copy of the input's reader, moved to where the piece starts */
+	log_reader_t reader = input->reader;
+	reader.mapped = false;
+	reader.finished = false;
+	reader.failed = false;
+
+	/* the entry before the piece, for predicates against it; none before the first read */
+	const entry_filter_t *filter = &conversion->filter;
+	previous_entry_t previous = {0};
+
+	if(reader.format == LOG_FORMAT_PLAIN) {
+		reader.next = input->start + piece->first * LOG_RECORD_SIZE;
+		reader.end = reader.next + piece->count * LOG_RECORD_SIZE;
+		if(piece->first > 0) {
+			previousEntrySet(&previous, reader.next - LOG_RECORD_SIZE + 1 + LOG_DTL_SIZE, reader.bigendian);
+		}
+	}
+	else {
+		checkpoint_t *checkpoint = &input->checkpoints[piece->first / conversion->piece_entries];
+		reader.next = checkpoint->next;
+		reader.codec = checkpoint->codec;
+		if(piece->first > 0 && reader.codec.started) {
+			previousEntrySet(&previous, reader.codec.words, reader.bigendian);
+		}
+	}
+
+	/* the lines are formatted straight into the output, the columns gathered first */
+	column_table_t table;
+	bool csv = (conversion->format == OUTPUT_CSV && !conversion->resampling);
+	if(csv ? !bufferReserve(&piece->out, piece->count * CSV_LINE_MAX)
+		: columnTableInit(&table, piece->count, filter->projection.count) == -1) {
+		fprintf(stderr, "%s: Out of memory\n", input->path);
+		piece->cut_short = true;
+		return;
+	}
+
+	/* compact logs decode one record at a time, so they are gathered here */
+	uint8_t staged[RECORD_BLOCK * LOG_RECORD_SIZE];
+	record_block_t block;
+	uint16_t selected[RECORD_BLOCK];
+
+	for(size_t done = 0; done < piece->count && !piece->cut_short; done += block.count) {
+		size_t wanted = (piece->count - done < RECORD_BLOCK) ? piece->count - done : RECORD_BLOCK;
+		const uint8_t *run = staged;
+		size_t got;
+
+		for(got = 0; got < wanted; got++) {
+			const uint8_t *record = logReaderNext(&reader);
+			if(record == NULL) {
+				piece->cut_short = true;
+				break;
+			}
+
+			/* those of plain logs lie one after another in the log already */
+			if(reader.format == LOG_FORMAT_PLAIN) {
+				if(got == 0) {
+					run = record;
+				}
+			}
+			else {
+				memcpy(staged + got * LOG_RECORD_SIZE, record, LOG_RECORD_SIZE);
+			}
+		}
+
+		decodeRecords(run, got, reader.bigendian, &block);
+
+		/* only what is selected goes any further */
+		size_t kept = filterEntries(filter, &block, &previous, selected);
+		if(csv) {
+			for(size_t i = 0; i < kept; i++) {
+				piece->out.size += formatCsvEntry((char *)piece->out.data + piece->out.size, &block, selected[i], &filter->projection);
+			}
+		}
+		else {
+			columnTableAppend(&table, &block, selected, kept, &filter->projection);
+		}
+	}
+
+	if(conversion->resampling) {
+		/* left for the writer, which resamples the pieces in order */
+		piece->table = table;
+	}
+	else if(!csv) {
+		/* what was decoded of one cut short is kept, as with CSV */
+		if(table.count > 0 && encodePiece(conversion, piece, &table) == -1) {
+			fprintf(stderr, "%s: Out of memory\n", input->path);
+			piece->cut_short = true;
+			freePiece(piece);
+		}
+		columnTableFree(&table);
+	}
+}
+
+/*
+Cut the inputs of the batch into pieces, 0 on success, -1 on error.
+When resampling, one with no entries in range still gets an empty piece,
+for the entry before the range.
+*/
+static int planPieces(conversion_t *conversion)
+{
+	size_t count = 0;
+	for(size_t i = 0; i < conversion->batch_count; i++) {
+		count += (conversion->batch[i].entries + conversion->piece_entries - 1) / conversion->piece_entries;
+		count += (conversion->resampling && conversion->batch[i].entries == 0);
+	}
+
+	conversion->pieces = calloc(count > 0 ? count : 1, sizeof(piece_t));
+	conversion->piece_count = 0;
+	if(conversion->pieces == NULL)
+		return -1;
+
+	for(size_t i = 0; i < conversion->batch_count; i++) {
+		input_t *input = &conversion->batch[i];
+
+		for(size_t first = 0; first < input->entries; first += conversion->piece_entries) {
+			piece_t *piece = &conversion->pieces[conversion->piece_count++];
+			piece->input = input;
+			piece->first = first;
+			piece->count = (input->entries - first < conversion->piece_entries) ? input->entries - first : conversion->piece_entries;
+			piece->last = (first + piece->count == input->entries);
+		}
+
+		if(conversion->resampling && input->entries == 0 && input->usable) {
+			piece_t *piece = &conversion->pieces[conversion->piece_count++];
+			piece->input = input;
+			piece->last = true;
+		}
+	}
+
+	return 0;
+}
+
+/* account for a piece written, for the footer; 0 on success, -1 if out of memory */
+static int placePiece(conversion_t *conversion, const piece_t *piece)
+{
+	if(piece->out.size == 0)
+		return 0;
+
+	switch(conversion->format) {
+	case OUTPUT_ARROW:
+		return arrowFileAdd(&conversion->arrow, &piece->block);
+	case OUTPUT_PARQUET:
+		return parquetFileAdd(&conversion->parquet, piece->group);
+	default:
+		return 0;
+	}
+}
+
+/* the rows of the table as a row group or record batch, 0 on success, -1 on error */
+static int writeRowGroup(conversion_t *conversion, int fd, const char *name)
+{
+	piece_t piece = {0};
+	int ret = 0;
+
+	if(encodePiece(conversion, &piece, &conversion->rows) == -1) {
+		fprintf(stderr, "Out of memory\n");
+		ret = -1;
+	}
+	else if(writeAll(fd, (const char *)piece.out.data, piece.out.size) == -1) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		ret = -1;
+	}
+	else if(placePiece(conversion, &piece) == -1) {
+		fprintf(stderr, "Out of memory\n");
+		ret = -1;
+	}
+
+	freePiece(&piece);
+	conversion->rows.count = 0;
+
+	return ret;
+}
+
+/*
+Take the rows the resampler made: lines are written straight away, the
+columns once they make up a row group; 0 on success, -1 on error
+*/
+static int takeRows(conversion_t *conversion, int fd, const char *name)
+{
+	record_block_t *rows = &conversion->resampler.rows;
+	column_table_t *table = &conversion->rows;
+	uint16_t all[RECORD_BLOCK];
+	int ret = 0;
+
+	for(size_t i = 0; i < rows->count; i++) {
+		all[i] = i;
+	}
+
+	if(conversion->format == OUTPUT_CSV) {
+		byte_buffer_t out = {0};
+
+		if(bufferReserve(&out, rows->count * CSV_LINE_MAX)) {
+			for(size_t i = 0; i < rows->count; i++) {
+				out.size += formatCsvEntry((char *)out.data + out.size, rows, i, &conversion->row_layout);
+			}
+		}
+		ret = writeOut(&out, fd, name);
+	}
+	else {
+		for(size_t done = 0; done < rows->count && ret == 0;) {
+			size_t count = rows->count - done;
+			if(count > table->capacity - table->count) {
+				count = table->capacity - table->count;
+			}
+
+			columnTableAppend(table, rows, all + done, count, &conversion->row_layout);
+			done += count;
+
+			if(table->count == table->capacity) {
+				ret = writeRowGroup(conversion, fd, name);
+			}
+		}
+	}
+
+	rows->count = 0;
+
+	return ret;
+}
+
+/* the entry just before the first in range, where that is part way into a log; true if there is one */
+static bool entryBefore(const input_t *input, int64_t *time, previous_entry_t *previous)
+{
+	const log_reader_t *reader = &input->reader;
+	log_time_t when;
+
+	if(reader->format == LOG_FORMAT_PLAIN) {
+		if(input->start == reader->data + LOG_HEADER_SIZE)
+			return false;
+
+		const uint8_t *record = input->start - LOG_RECORD_SIZE;
+		logRecordTime(record, reader->bigendian, &when);
+		previousEntrySet(previous, record + 1 + LOG_DTL_SIZE, reader->bigendian);
+	}
+	else {
+		/* what the codec kept of it, if decoding did not start right there */
+		if(input->checkpoints == NULL || !input->checkpoints[0].codec.started)
+			return false;
+
+		const log_codec_t *codec = &input->checkpoints[0].codec;
+		unsigned int year = reader->bigendian ? (codec->date[0] << 8 | codec->date[1]) : (codec->date[1] << 8 | codec->date[0]);
+		when.date = year << 16 | codec->date[2] << 8 | codec->date[3];
+		when.time_ns = codec->time_ns;
+		previousEntrySet(previous, codec->words, reader->bigendian);
+	}
+
+	*time = columnTableDateTime(when.date, when.time_ns);
+
+	return true;
+}
+
+/* run the entries of a piece through the resampler, 0 on success, -1 if the output failed */
+static int resamplePiece(conversion_t *conversion, const piece_t *piece, int fd, const char *name)
+{
+	resampler_t *resampler = &conversion->resampler;
+	const projection_t *projection = &conversion->filter.projection;
+	const column_table_t *table = &piece->table;
+	uint16_t words[LOG_WORD_COUNT];
+
+	/*
+	What the words were when the range started. Those of later logs
+	are later still, until the entries in range begin.
+	*/
+	previous_entry_t previous;
+	int64_t time;
+	if(piece->first == 0 && conversion->filter.predicate_count == 0 && entryBefore(piece->input, &time, &previous)
+		&& (!resampler->held || time > resampler->last)) {
+		for(int k = 0; k < projection->count; k++) {
+			words[k] = previous.words[projection->words[k]];
+		}
+		resamplerTake(resampler, time, words);
+	}
+
+	for(size_t i = 0; i < table->count; i++) {
+		while(resamplerFill(resampler, table->time[i])) {
+			if(takeRows(conversion, fd, name) == -1)
+				return -1;
+		}
+
+		for(int k = 0; k < table->word_count; k++) {
+			words[k] = table->words[k][i];
+		}
+		resamplerTake(resampler, table->time[i], words);
+	}
+
+	return 0;
+}
+
+/* the rows after the last entry, and those not written yet; 0 on success, -1 on error */
+static int finishResampling(conversion_t *conversion, int fd, const char *name)
+{
+	bool more;
+
+	do {
+		more = resamplerFinish(&conversion->resampler);
+		if(takeRows(conversion, fd, name) == -1)
+			return -1;
+	} while(more);
+
+	if(conversion->rows.count > 0)
+		return writeRowGroup(conversion, fd, name);
+
+	return 0;
+}
+
+/* write the pieces out in order as they are converted, 0 on success, -1 if the output failed */
+static int writePieces(conversion_t *conversion, work_pool_t *pool, int fd, const char *name)
+{
+	int ret = 0;
+	/* a piece of this log was cut short */
+	input_t *skipping = NULL;
+
+	for(size_t k = 0; k < conversion->piece_count; k++) {
+		piece_t *piece = &conversion->pieces[k];
+		input_t *input = piece->input;
+
+		workPoolWaitFor(pool, k);
+
+		if(input != skipping) {
+			if(conversion->resampling) {
+				ret = resamplePiece(conversion, piece, fd, name);
+			}
+			else if(writeAll(fd, (const char *)piece->out.data, piece->out.size) == -1) {
+				fprintf(stderr, "%s: %s\n", name, strerror(errno));
+				ret = -1;
+			}
+			else if(placePiece(conversion, piece) == -1) {
+				fprintf(stderr, "Out of memory\n");
+				ret = -1;
+			}
+
+			if(piece->cut_short) {
+				skipping = input;
+			}
+			else if(piece->last && !input->finished) {
+				fprintf(stderr, "%s: No end marker, the log may still be in use\n", input->path);
+			}
+		}
+
+		freePiece(piece);
+		workPoolRetire(pool, k);
+
+		if(ret == -1) {
+			workPoolCancel(pool);
+			break;
+		}
+	}
+
+	return ret;
+}
+
+/* free what a batch needed of an input */
+static void releaseInput(input_t *input)
+{
+	if(input->usable) {
+		logReaderClose(&input->reader);
+	}
+	input->usable = false;
+
+	free(input->data);
+	input->data = NULL;
+	free(input->checkpoints);
+	input->checkpoints = NULL;
+}
+
+/*
+Convert a batch of inputs, already in order, after whatever has been
+written; 0 on success, -1 if the output failed
+*/
+static int convertBatch(conversion_t *conversion, input_t *batch, size_t count, int workers, int fd, const char *name)
+{
+	work_pool_t pool;
+	int ret = 0;
+
+	conversion->batch = batch;
+	conversion->batch_count = count;
+
+	if(workPoolStart(&pool, count, workers, 0, scanInput, conversion) == -1) {
+		fprintf(stderr, "Could not start threads\n");
+		return -1;
+	}
+	workPoolFinish(&pool);
+
+	if(planPieces(conversion) == -1) {
+		fprintf(stderr, "Out of memory\n");
+		ret = -1;
+	}
+	else if(workPoolStart(&pool, conversion->piece_count, workers, PIECES_AHEAD * workers, convertPiece, conversion) == -1) {
+		fprintf(stderr, "Could not start threads\n");
+		ret = -1;
+	}
+	else {
+		ret = writePieces(conversion, &pool, fd, name);
+		workPoolFinish(&pool);
+	}
+
+	if(conversion->pieces != NULL) {
+		for(size_t k = 0; k < conversion->piece_count; k++) {
+			freePiece(&conversion->pieces[k]);
+		}
+	}
+	free(conversion->pieces);
+	conversion->pieces = NULL;
+	conversion->piece_count = 0;
+
+	for(size_t i = 0; i < count; i++) {
+		releaseInput(&batch[i]);
+	}
+
+	return ret;
+}
+
+/*
+Convert the logs of a .tgz one at a time as they come out of it, as
+the archive can only be read from the start; 0 on success, -1 if the
+output failed
+*/
+static int convertTgz(conversion_t *conversion, input_t *archive, int workers, int fd, const char *name)
+{
+	tgz_reader_t *reader = malloc(sizeof(tgz_reader_t));
+	int ret = 0;
+
+	if(reader == NULL) {
+		fprintf(stderr, "%s: Out of memory\n", archive->path);
+		return 0;
+	}
+	if(tgzOpen(reader, archive->path) == -1) {
+		free(reader);
+		return 0;
+	}
+
+	for(;;) {
+		char member[NAME_MAX];
+		input_t input = {0};
+		size_t size;
+
+		/* an archive that turns out to be damaged has been reported, and ends there */
+		if(tgzNextLog(reader, member, sizeof(member), SIZE_MAX, &input.data, &size) != 1)
+			break;
+
+		input.source = SOURCE_TGZ;
+		input.order = archive->order;
+		input.path = malloc(strlen(archive->path) + 1 + strlen(member) + 1);
+		if(input.path != NULL) {
+			sprintf(input.path, "%s:%s", archive->path, member);
+			input.usable = (logReaderInit(&input.reader, input.path, input.data, size) == 0);
+		}
+		else {
+			fprintf(stderr, "%s: Out of memory\n", archive->path);
+		}
+
+		ret = convertBatch(conversion, &input, 1, workers, fd, name);
+		releaseInput(&input);
+		free(input.path);
+
+		if(ret == -1)
+			break;
+	}
+
+	tgzClose(reader);
+	free(reader);
+
+	return ret;
+}
+
+static bool hasSuffix(const char *name, const char *suffix)
+{
+	size_t length = strlen(name);
+	size_t suffix_length = strlen(suffix);
+
+	return length > suffix_length && strcmp(name + length - suffix_length, suffix) == 0;
+}
+
+static int isLog(const struct dirent *entry)
+{
+	return hasSuffix(entry->d_name, ".bin");
+}
+
+/* room for one more input, NULL if out of memory */
+static input_t *newInput(conversion_t *conversion, size_t *capacity)
+{
+	if(conversion->input_count == *capacity) {
+		size_t grown_capacity = *capacity ? 2 * *capacity : 64;
+		input_t *grown = realloc(conversion->inputs, grown_capacity * sizeof(input_t));
+		if(grown == NULL)
+			return NULL;
+		conversion->inputs = grown;
+		*capacity = grown_capacity;
+	}
+
+	input_t *input = &conversion->inputs[conversion->input_count];
+	memset(input, 0, sizeof(*input));
+	input->order = conversion->input_count++;
+
+	return input;
+}
+
+/* add the logs of a .zst archive, 0 on success */
+static int addZstdArchive(conversion_t *conversion, size_t *capacity, const char *path)
+{
+#if LOGGER_USE_ZSTD
+	zstd_archive_entry_t *entries;
+	uint32_t count;
+
+	/* one that can not be read is left out, and the rest carry on */
+	if(zstdArchiveList(path, &entries, &count) == -1)
+		return 0;
+
+	int ret = 0;
+	for(uint32_t i = 0; i < count; i++) {
+		input_t *input = newInput(conversion, capacity);
+		if(input == NULL) {
+			ret = -1;
+			break;
+		}
+
+		input->source = SOURCE_ZSTD;
+		input->entry = entries[i];
+		input->archive = strdup(path);
+		input->path = malloc(strlen(path) + 1 + strlen(entries[i].name) + 1);
+		if(input->archive == NULL || input->path == NULL) {
+			ret = -1;
+			break;
+		}
+		sprintf(input->path, "%s:%s", path, entries[i].name);
+	}
+
+	free(entries);
+	return ret;
+#else
+	fprintf(stderr, "%s: Built without zstd, so .zst archives can not be read\n", path);
+	return 0;
+#endif
+}
+
+static int compareLogNames(const void *a, const void *b)
+{
+	return strcmp(((const log_catalog_record_t *)a)->name, ((const log_catalog_record_t *)b)->name);
+}
+
+/* 0 on success, 1 if the directory has no catalog, -1 if out of memory */
+static int loadCatalog(data_dir_t *data, const char *path)
+{
+	log_catalog_record_t *records;
+	size_t count;
+
+	logCatalogInit(&data->catalog);
+	data->logs = NULL;
+	data->log_count = 0;
+
+	int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(dir_fd == -1)
+		return 1;
+
+	int ret = logCatalogRead(dir_fd, &records, &count);
+	close(dir_fd);
+	if(ret == -1)
+		return 1;
+
+	for(size_t i = 0; i < count && ret == 0; i++) {
+		ret = logCatalogApply(&data->catalog, &records[i]);
+	}
+
+	/* only the logs since their day was last deleted are still there */
+	for(size_t i = 0; i < count && ret == 0; i++) {
+		const log_catalog_day_t *day = logCatalogFindDay(&data->catalog, logCatalogDate(records[i].name));
+
+		if(records[i].type == LOG_CATALOG_LOG && day != NULL && day->state != LOG_CATALOG_DELETED && i >= day->since) {
+			records[data->log_count++] = records[i];
+		}
+	}
+	qsort(records, data->log_count, sizeof(log_catalog_record_t), compareLogNames);
+	data->logs = records;
+
+	return ret;
+}
+
+static void freeCatalog(data_dir_t *data)
+{
+	logCatalogFree(&data->catalog);
+	free(data->logs);
+}
+
+/* the log of a day in the catalog, NULL if it has none */
+static const log_catalog_record_t *findLog(const data_dir_t *data, const char *day, const char *file)
+{
+	log_catalog_record_t key;
+
+	/* too long to be one the logger wrote */
+	int length = snprintf(key.name, sizeof(key.name), "%s/%s", day, file);
+	if(length < 0 || (size_t)length >= sizeof(key.name))
+		return NULL;
+
+	return bsearch(&key, data->logs, data->log_count, sizeof(log_catalog_record_t), compareLogNames);
+}
+
+/*
+The range as nanoseconds since 1970, for telling which logs are out of it.
+Without a date it could be on any day, so that end is left open. When
+resampling, the entry before the range is wanted as well, so it starts
+at the end of the last log before it.
+*/
+static void catalogRange(const conversion_t *conversion, const data_dir_t *data, int64_t *from, int64_t *to)
+{
+	const range_t *range = &conversion->range;
+
+	*from = INT64_MIN;
+	*to = INT64_MAX;
+	if(range->from_set && range->from_dated) {
+		*from = columnTableDateTime(range->from.date, range->from.time_ns);
+	}
+	if(range->to_set && range->to_dated) {
+		*to = columnTableDateTime(range->to.date, range->to.time_ns);
+	}
+
+	if(conversion->resampling && *from != INT64_MIN) {
+		int64_t before = INT64_MIN;
+		for(size_t i = 0; i < data->log_count; i++) {
+			const log_catalog_record_t *log = &data->logs[i];
+			if(log->entries > 0 && log->last < *from && log->last > before) {
+				before = log->last;
+			}
+		}
+		*from = before;
+	}
+}
+
+static bool logInRange(const log_catalog_record_t *log, int64_t from, int64_t to)
+{
+	return log->entries > 0 && log->last >= from && log->first < to;
+}
+
+/* add the logs of a day's directory, leaving out those the catalog has as out of range; 0 on success */
+static int addDayLogs(conversion_t *conversion, size_t *capacity, const char *path, const log_catalog_day_t *day,
+	const data_dir_t *data, int64_t from, int64_t to)
+{
+	struct dirent **logs;
+	char *day_path = malloc(strlen(path) + 1 + strlen(day->name) + 1);
+	if(day_path == NULL)
+		return -1;
+	sprintf(day_path, "%s/%s", path, day->name);
+
+	/* one being written is not in the catalog yet, so the directory has the say in which there are */
+	int count = scandir(day_path, &logs, isLog, alphasort);
+	if(count == -1) {
+		fprintf(stderr, "%s: %s\n", day_path, strerror(errno));
+		free(day_path);
+		return 0;
+	}
+
+	int ret = 0;
+	for(int i = 0; i < count; i++) {
+		const log_catalog_record_t *log = findLog(data, day->name, logs[i]->d_name);
+
+		if(ret == 0 && (log == NULL || logInRange(log, from, to))) {
+			input_t *input = newInput(conversion, capacity);
+			if(input != NULL) {
+				input->path = malloc(strlen(day_path) + 1 + strlen(logs[i]->d_name) + 1);
+			}
+			if(input == NULL || input->path == NULL) {
+				ret = -1;
+			}
+			else {
+				sprintf(input->path, "%s/%s", day_path, logs[i]->d_name);
+			}
+		}
+		free(logs[i]);
+	}
+	free(logs);
+	free(day_path);
+
+	return ret;
+}
+
+/*
+Add the days of a log directory, as its catalog has them: the logs of
+each day's directory, or its archive. Those the catalog has as out of a
+dated range are left out without being opened. 0 on success, 1 if the
+directory has no catalog.
+*/
+static int addDataDir(conversion_t *conversion, size_t *capacity, const char *path)
+{
+	data_dir_t data;
+	int64_t from, to;
+
+	int ret = loadCatalog(&data, path);
+	if(ret != 0) {
+		freeCatalog(&data);
+		return ret;
+	}
+	catalogRange(conversion, &data, &from, &to);
+
+	for(size_t d = 0; d < data.catalog.day_count && ret == 0; d++) {
+		const log_catalog_day_t *day = &data.catalog.days[d];
+
+		if(day->state == LOG_CATALOG_DAY) {
+			ret = addDayLogs(conversion, capacity, path, day, &data, from, to);
+			continue;
+		}
+
+		/* an archive is read for any of its logs, unless the catalog knows them all */
+		if(day->state != LOG_CATALOG_ARCHIVED
+			|| (!day->partial && day->logs > 0 && (day->first >= to || day->last < from))) {
+			continue;
+		}
+
+		char *archive = malloc(strlen(path) + 1 + strlen(day->name) + 1);
+		if(archive == NULL) {
+			ret = -1;
+			break;
+		}
+		sprintf(archive, "%s/%s", path, day->name);
+
+		if(hasSuffix(archive, ZSTD_ARCHIVE_SUFFIX)) {
+			ret = addZstdArchive(conversion, capacity, archive);
+			free(archive);
+			continue;
+		}
+
+		input_t *input = newInput(conversion, capacity);
+		if(input == NULL) {
+			free(archive);
+			ret = -1;
+			break;
+		}
+		input->source = SOURCE_TGZ;
+		input->path = archive;
+	}
+
+	freeCatalog(&data);
+	return ret;
+}
+
+/* as CSV_TIMESTAMP_SIZE, and the terminator */
+static void formatTime(int64_t time, char *out)
+{
+	time_t seconds = time / 1000000000;
+	struct tm tm;
+
+	gmtime_r(&seconds, &tm);
+	sprintf(out, "%04d-%02d-%02dT%02d:%02d:%02d.%09d",
+		tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+		(int)(time % 1000000000));
+}
+
+/* list the logs of a log directory from its catalog, those in a dated range; 0 on success */
+static int listCatalog(conversion_t *conversion, const char *path, bool header)
+{
+	data_dir_t data;
+	int64_t from, to;
+	char first[CSV_TIMESTAMP_SIZE + 1];
+	char last[CSV_TIMESTAMP_SIZE + 1];
+
+	int ret = loadCatalog(&data, path);
+	if(ret != 0) {
+		if(ret == 1) {
+			fprintf(stderr, "%s: No %s there\n", path, LOG_CATALOG_NAME);
+		}
+		freeCatalog(&data);
+		return -1;
+	}
+	catalogRange(conversion, &data, &from, &to);
+
+	if(header) {
+		printf("log,first,last,entries,dropped,archive\n");
+	}
+
+	for(size_t i = 0; i < data.log_count; i++) {
+		const log_catalog_record_t *log = &data.logs[i];
+		const log_catalog_day_t *day = logCatalogFindDay(&data.catalog, logCatalogDate(log->name));
+
+		if(!logInRange(log, from, to))
+			continue;
+
+		formatTime(log->first, first);
+		formatTime(log->last, last);
+		printf("%s/%s,%s,%s,%u,%u,%s\n", path, log->name, first, last,
+			(unsigned int)log->entries, (unsigned int)log->dropped,
+			(day->state == LOG_CATALOG_ARCHIVED) ? day->name : "");
+	}
+
+	freeCatalog(&data);
+	return 0;
+}
+
+/* add a log, all the logs of a directory, or an archive, 0 on success */
+static int addInput(conversion_t *conversion, size_t *capacity, const char *path)
+{
+	struct stat statbuf;
+	struct dirent **logs = NULL;
+	int count = 1;
+
+	if(hasSuffix(path, ZSTD_ARCHIVE_SUFFIX))
+		return addZstdArchive(conversion, capacity, path);
+
+	if(stat(path, &statbuf) == 0 && S_ISDIR(statbuf.st_mode)) {
+		int ret = addDataDir(conversion, capacity, path);
+		if(ret != 1)
+			return ret;
+
+		count = scandir(path, &logs, isLog, alphasort);
+		if(count == -1) {
+			fprintf(stderr, "%s: %s\n", path, strerror(errno));
+			return 0;
+		}
+	}
+
+	int ret = 0;
+	for(int i = 0; i < count; i++) {
+		input_t *input = newInput(conversion, capacity);
+		if(input == NULL) {
+			ret = -1;
+			break;
+		}
+
+		if(logs == NULL) {
+			input->source = (hasSuffix(path, ".tgz") || hasSuffix(path, ".tar.gz")) ? SOURCE_TGZ : SOURCE_LOG;
+			input->path = strdup(path);
+		}
+		else {
+			input->path = malloc(strlen(path) + 1 + strlen(logs[i]->d_name) + 1);
+			if(input->path != NULL) {
+				sprintf(input->path, "%s/%s", path, logs[i]->d_name);
+			}
+		}
+		if(input->path == NULL) {
+			ret = -1;
+			break;
+		}
+	}
+
+	if(logs != NULL) {
+		for(int i = 0; i < count; i++) {
+			free(logs[i]);
+		}
+		free(logs);
+	}
+
+	return ret;
+}
+
+/* what comes before the entries: the column names, or the start of the file; 0 on success */
+static int startOutput(conversion_t *conversion, bool header, int fd, const char *name)
+{
+	byte_buffer_t out = {0};
+
+	switch(conversion->format) {
+	case OUTPUT_CSV:
+		if(header && bufferReserve(&out, CSV_HEADER_MAX)) {
+			out.size = formatCsvHeader((char *)out.data, &conversion->columns);
+		}
+		break;
+	case OUTPUT_ARROW:
+		arrowFileStart(&conversion->arrow, &conversion->columns, &out);
+		break;
+	case OUTPUT_PARQUET:
+		parquetFileStart(&conversion->parquet, &conversion->columns, &out);
+		break;
+	}
+
+	return writeOut(&out, fd, name);
+}
+
+/* the footer of an Arrow or Parquet file, 0 on success */
+static int finishOutput(conversion_t *conversion, int fd, const char *name)
+{
+	byte_buffer_t out = {0};
+
+	switch(conversion->format) {
+	case OUTPUT_CSV:
+		break;
+	case OUTPUT_ARROW:
+		arrowFileFinish(&conversion->arrow, &out);
+		break;
+	case OUTPUT_PARQUET:
+		parquetFileFinish(&conversion->parquet, &out);
+		break;
+	}
+
+	return writeOut(&out, fd, name);
+}
+
+/* the window the rows are made over, once the inputs are in order */
+static void startResampling(conversion_t *conversion)
+{
+	range_t *range = &conversion->range;
+	int64_t from = 0;
+	int64_t to = INT64_MAX;
+
+	/* a time without a date takes that of the first log */
+	uint32_t date = 0;
+	for(size_t i = 0; i < conversion->input_count; i++) {
+		if(conversion->inputs[i].usable) {
+			date = conversion->inputs[i].first.date;
+			break;
+		}
+	}
+
+	if(range->from_set) {
+		from = columnTableDateTime(range->from_dated ? range->from.date : date, range->from.time_ns);
+	}
+	if(range->to_set) {
+		to = columnTableDateTime(range->to_dated ? range->to.date : date, range->to.time_ns);
+	}
+
+	resamplerInit(&conversion->resampler, conversion->period, conversion->filter.projection.count,
+		conversion->aggregates, conversion->aggregate_count, from, to);
+}
+
+static int availableCores(void)
+{
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (cores > 0) ? (int)cores : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output_path = NULL;
+	bool header = true;
+	bool listing = false;
+	long row_group = ROW_GROUP_ENTRIES;
+	int workers = availableCores();
+	int option;
+
+	static const struct option long_options[] = {
+		{"words", required_argument, NULL, 'w'},
+		{"where", required_argument, NULL, 'c'},
+		{"resample", required_argument, NULL, 'r'},
+		{"aggregate", required_argument, NULL, 'a'},
+		{"list", no_argument, NULL, 'l'},
+		{NULL, 0, NULL, 0},
+	};
+
+	conversion_t conversion = {0};
+	range_t *range = &conversion.range;
+
+	filterInit(&conversion.filter);
+	conversion.aggregates[0] = AGGREGATE_NONE;
+	conversion.aggregate_count = 1;
+	bool aggregated = false;
+
+	while((option = getopt_long(argc, argv, "hlno:f:g:j:s:e:w:c:r:a:", long_options, NULL)) != -1) {
+		switch(option) {
+		case 'w':
+			if(filterParseWords(&conversion.filter, optarg) == -1) {
+				printf("Error: The argument to -w must be word numbers and ranges, as 1,7,12 or 0-3.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'c':
+			if(filterParsePredicate(&conversion.filter, optarg) == -1) {
+				printf("Error: Could not make out the condition \"%s\".\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'r':
+			if(resampleParsePeriod(optarg, &conversion.period) == -1) {
+				printf("Error: The argument to -r must be a positive time, as 1ms, 250us or 10s.\n");
+				return EXIT_FAILURE;
+			}
+			conversion.resampling = true;
+			break;
+		case 'a':
+			if(resampleParseAggregates(optarg, conversion.aggregates, &conversion.aggregate_count) == -1) {
+				printf("Error: The argument to -a must be some of min, max and last, as min,max.\n");
+				return EXIT_FAILURE;
+			}
+			aggregated = true;
+			break;
+		case 'l':
+			listing = true;
+			break;
+		case 'n':
+			header = false;
+			break;
+		case 'f':
+			if(strcmp(optarg, "csv") == 0) {
+				conversion.format = OUTPUT_CSV;
+			}
+			else if(strcmp(optarg, "arrow") == 0) {
+				conversion.format = OUTPUT_ARROW;
+			}
+			else if(strcmp(optarg, "parquet") == 0) {
+				conversion.format = OUTPUT_PARQUET;
+			}
+			else {
+				printf("Error: The argument to -f must be csv, arrow or parquet.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'g':
+			row_group = atol(optarg);
+			if(row_group < 1 || row_group > ROW_GROUP_MAX) {
+				printf("Error: The argument to -g must be from 1 to %d.\n", ROW_GROUP_MAX);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		case 'j':
+			workers = atoi(optarg);
+			if(workers < 1) {
+				printf("Error: The argument to -j must be positive.\n");
+				return EXIT_FAILURE;
+			}
+			break;
+		case 's':
+			if(parseTime(optarg, &range->from, &range->from_dated) == -1) {
+				printf("Error: The argument to -s must be [YYYY-MM-DDT]HH:MM:SS[.FRACTION].\n");
+				return EXIT_FAILURE;
+			}
+			range->from_set = true;
+			break;
+		case 'e':
+			if(parseTime(optarg, &range->to, &range->to_dated) == -1) {
+				printf("Error: The argument to -e must be [YYYY-MM-DDT]HH:MM:SS[.FRACTION].\n");
+				return EXIT_FAILURE;
+			}
+			range->to_set = true;
+			break;
+		case 'h':
+		default:
+			showUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(optind == argc) {
+		showUsage();
+		return EXIT_FAILURE;
+	}
+
+	if(listing) {
+		int ret = 0;
+		for(int i = optind; i < argc; i++) {
+			if(listCatalog(&conversion, argv[i], header && i == optind) == -1) {
+				ret = -1;
+			}
+		}
+		return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	conversion.columns = conversion.filter.projection;
+	if(aggregated && !conversion.resampling) {
+		printf("Error: -a only goes with -r.\n");
+		return EXIT_FAILURE;
+	}
+	if(conversion.resampling) {
+		if(resampleColumns(&conversion.columns, &conversion.filter.projection, conversion.aggregates, conversion.aggregate_count) == -1) {
+			printf("Error: At most %d columns of words can be written; pick fewer words with -w.\n", LOG_WORD_COUNT);
+			return EXIT_FAILURE;
+		}
+
+		/* the resampler makes its rows with the columns in order */
+		conversion.row_layout.count = conversion.columns.count;
+		for(int c = 0; c < conversion.columns.count; c++) {
+			conversion.row_layout.words[c] = c;
+		}
+
+		if(conversion.format != OUTPUT_CSV && columnTableInit(&conversion.rows, row_group, conversion.columns.count) == -1) {
+			fprintf(stderr, "Out of memory\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* entries are only gathered for the writer when resampling, so pieces of them need not be row groups */
+	conversion.piece_entries = (conversion.format == OUTPUT_CSV || conversion.resampling) ? PIECE_ENTRIES : (size_t)row_group;
+
+	int fd = STDOUT_FILENO;
+	const char *name = "standard output";
+	if(output_path != NULL) {
+		fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		name = output_path;
+		if(fd == -1) {
+			fprintf(stderr, "%s: %s\n", output_path, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	size_t capacity = 0;
+	for(int i = optind; i < argc; i++) {
+		if(addInput(&conversion, &capacity, argv[i]) == -1) {
+			fprintf(stderr, "Out of memory\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	int ret = 0;
+	work_pool_t pool;
+
+	if(workPoolStart(&pool, conversion.input_count, workers, 0, probeInput, &conversion) == -1) {
+		fprintf(stderr, "Could not start threads\n");
+		return EXIT_FAILURE;
+	}
+	workPoolFinish(&pool);
+
+	qsort(conversion.inputs, conversion.input_count, sizeof(input_t), compareInputs);
+
+	if(conversion.resampling) {
+		startResampling(&conversion);
+	}
+
+	ret = startOutput(&conversion, header, fd, name);
+
+	size_t next = 0;
+	while(ret == 0 && next < conversion.input_count) {
+		input_t *input = &conversion.inputs[next];
+
+		if(input->source == SOURCE_TGZ) {
+			if(input->usable) {
+				ret = convertTgz(&conversion, input, workers, fd, name);
+			}
+			next++;
+			continue;
+		}
+
+		/* as many as fit in memory, and at least one */
+		size_t count = 0;
+		size_t memory = 0;
+		while(next + count < conversion.input_count) {
+			input_t *candidate = &conversion.inputs[next + count];
+			size_t needed = (candidate->source == SOURCE_ZSTD) ? candidate->entry.size : 0;
+
+			if(candidate->source == SOURCE_TGZ || (count > 0 && memory + needed > BATCH_MEMORY))
+				break;
+			memory += needed;
+			count++;
+		}
+
+		ret = convertBatch(&conversion, input, count, workers, fd, name);
+		next += count;
+	}
+
+	if(ret == 0 && conversion.resampling) {
+		ret = finishResampling(&conversion, fd, name);
+	}
+	if(ret == 0) {
+		ret = finishOutput(&conversion, fd, name);
+	}
+	columnTableFree(&conversion.rows);
+	arrowFileFree(&conversion.arrow);
+	parquetFileFree(&conversion.parquet);
+
+	for(size_t i = 0; i < conversion.input_count; i++) {
+		releaseInput(&conversion.inputs[i]);
+		free(conversion.inputs[i].archive);
+		free(conversion.inputs[i].path);
+	}
+	free(conversion.inputs);
+
+	if(fd != STDOUT_FILENO && close(fd) == -1) {
+		fprintf(stderr, "%s: %s\n", name, strerror(errno));
+		ret = -1;
+	}
+
+	return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
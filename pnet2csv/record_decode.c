@@ -0,0 +1,112 @@
+#include "record_decode.h"
+#include "record_decode_kernels.h"
+
+#include <string.h>
+#include <endian.h>
+
+static const char *const decoder_names[RECORD_DECODER_COUNT] = {
+	[RECORD_DECODER_SCALAR] = "scalar",
+	[RECORD_DECODER_SSSE3] = "SSSE3",
+	[RECORD_DECODER_AVX2] = "AVX2",
+	[RECORD_DECODER_NEON] = "NEON",
+};
+
+/* the timestamps, which every kernel leaves to this */
+static void decodeTimestamps(const uint8_t *records, size_t count, bool bigendian, record_block_t *block)
+{
+	for(size_t r = 0; r < count; r++) {
+		const uint8_t *dtl = records + r * LOG_RECORD_SIZE + 1;
+		uint16_t year;
+		uint32_t nano;
+		memcpy(&year, dtl, 2);
+		memcpy(&nano, dtl + 8, 4);
+
+		block->year[r] = bigendian ? be16toh(year) : le16toh(year);
+		block->month[r] = dtl[2];
+		block->day[r] = dtl[3];
+		block->hour[r] = dtl[5];
+		block->minute[r] = dtl[6];
+		block->second[r] = dtl[7];
+		block->nano[r] = bigendian ? be32toh(nano) : le32toh(nano);
+	}
+}
+
+void decodeWordsScalar(const uint8_t *records, size_t first, size_t count, bool bigendian, record_block_t *block)
+{
+	for(size_t r = first; r < count; r++) {
+		const uint8_t *words = records + r * LOG_RECORD_SIZE + RECORD_WORDS_OFFSET;
+
+		for(int w = 0; w < LOG_WORD_COUNT; w++) {
+			uint16_t word;
+			memcpy(&word, words + 2*w, 2);
+			block->words[w][r] = bigendian ? be16toh(word) : le16toh(word);
+		}
+	}
+}
+
+bool recordDecoderAvailable(record_decoder_t decoder)
+{
+	switch(decoder) {
+	case RECORD_DECODER_SCALAR:
+		return true;
+#if defined(__x86_64__) || defined(__i386__)
+	case RECORD_DECODER_SSSE3:
+		return __builtin_cpu_supports("ssse3");
+	case RECORD_DECODER_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+#if RECORD_DECODE_NEON
+	/* built only when the compiler may use it everywhere anyway */
+	case RECORD_DECODER_NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+const char *recordDecoderName(record_decoder_t decoder)
+{
+	return (decoder < RECORD_DECODER_COUNT) ? decoder_names[decoder] : "unknown";
+}
+
+void decodeRecordsWith(
+	record_decoder_t decoder,
+	const uint8_t *records,
+	size_t count,
+	bool bigendian,
+	record_block_t *block)
+{
+	block->count = count;
+	decodeTimestamps(records, count, bigendian, block);
+
+	switch(decoder) {
+#if defined(__x86_64__) || defined(__i386__)
+	case RECORD_DECODER_SSSE3:
+		decodeWordsSsse3(records, count, bigendian, block);
+		break;
+	case RECORD_DECODER_AVX2:
+		decodeWordsAvx2(records, count, bigendian, block);
+		break;
+#endif
+#if RECORD_DECODE_NEON
+	case RECORD_DECODER_NEON:
+		decodeWordsNeon(records, count, bigendian, block);
+		break;
+#endif
+	default:
+		decodeWordsScalar(records, 0, count, bigendian, block);
+		break;
+	}
+}
+
+void decodeRecords(const uint8_t *records, size_t count, bool bigendian, record_block_t *block)
+{
+	/* checking is a load of what the CPU was found to support, so no need to keep the answer */
+	record_decoder_t decoder = RECORD_DECODER_COUNT - 1;
+	while(!recordDecoderAvailable(decoder)) {
+		decoder--;
+	}
+
+	decodeRecordsWith(decoder, records, count, bigendian, block);
+}
@@ -0,0 +1,102 @@
+#ifndef RECORD_DECODE_H
+#define RECORD_DECODE_H
+
+/**
+ * @file
+ * @brief Decoding of log entries into columns
+ *
+ * Turns a run of version 1 records, as they lie in a plain log, into one
+ * native-endian array per field, ready to be formatted or exported column
+ * by column. The words are the bulk of it, so there are kernels that
+ * byte-swap and transpose them eight entries at a time: SSSE3 and AVX2 on
+ * x86, picked by what the CPU supports, and NEON where the compiler
+ * targets it. The scalar one is the reference they are checked against,
+ * and is used anywhere else.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_logformat.h"
+
+/* entries decoded at a time */
+#define RECORD_BLOCK 256
+
+typedef enum record_decoder
+{
+	RECORD_DECODER_SCALAR,
+	RECORD_DECODER_SSSE3,
+	RECORD_DECODER_AVX2,
+	RECORD_DECODER_NEON,
+	RECORD_DECODER_COUNT,
+} record_decoder_t;
+
+/* a block of entries, field by field, in native byte order */
+typedef struct record_block
+{
+	size_t count;
+
+	/* the DTL timestamp; the weekday is left out */
+	uint16_t year[RECORD_BLOCK];
+	uint8_t month[RECORD_BLOCK];
+	uint8_t day[RECORD_BLOCK];
+	uint8_t hour[RECORD_BLOCK];
+	uint8_t minute[RECORD_BLOCK];
+	uint8_t second[RECORD_BLOCK];
+	uint32_t nano[RECORD_BLOCK];
+
+	uint16_t words[LOG_WORD_COUNT][RECORD_BLOCK];
+} record_block_t;
+
+/**
+ * Decode consecutive records with the fastest kernel this CPU can run
+ *
+ * @param records          In:    count version 1 records, back to back
+ * @param count            In:    at most RECORD_BLOCK
+ * @param bigendian        In:    byte order of the log
+ * @param block            Out
+ */
+void decodeRecords(const uint8_t *records, size_t count, bool bigendian, record_block_t *block);
+
+/**
+ * Decode consecutive records with a particular kernel
+ *
+ * @param decoder          In:    one for which recordDecoderAvailable is true
+ * @param records          In:    count version 1 records, back to back
+ * @param count            In:    at most RECORD_BLOCK
+ * @param bigendian        In:    byte order of the log
+ * @param block            Out
+ */
+void decodeRecordsWith(
+	record_decoder_t decoder,
+	const uint8_t *records,
+	size_t count,
+	bool bigendian,
+	record_block_t *block);
+
+/**
+ * Whether a kernel was built in and this CPU can run it
+ *
+ * @param decoder          In
+ * @return true if it can be used
+ */
+bool recordDecoderAvailable(record_decoder_t decoder);
+
+/**
+ * Name of a kernel, for messages
+ *
+ * @param decoder          In
+ * @return name
+ */
+const char *recordDecoderName(record_decoder_t decoder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECORD_DECODE_H */
@@ -0,0 +1,38 @@
+#ifndef RECORD_DECODE_KERNELS_H
+#define RECORD_DECODE_KERNELS_H
+
+/**
+ * @file
+ * @brief Word kernels behind decodeRecords, for record_decode*.c only
+ *
+ * Each takes count records back to back, like decodeRecords, and fills
+ * in only the words of the block. The vector ones leave the entries
+ * beyond the last whole group of eight to decodeWordsScalar.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "record_decode.h"
+
+/* offset of the words in a version 1 record */
+#define RECORD_WORDS_OFFSET (1 + LOG_DTL_SIZE)
+
+void decodeWordsScalar(const uint8_t *records, size_t first, size_t count, bool bigendian, record_block_t *block);
+
+#if defined(__x86_64__) || defined(__i386__)
+void decodeWordsSsse3(const uint8_t *records, size_t count, bool bigendian, record_block_t *block);
+void decodeWordsAvx2(const uint8_t *records, size_t count, bool bigendian, record_block_t *block);
+#endif
+
+#if defined(__ARM_NEON) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define RECORD_DECODE_NEON 1
+void decodeWordsNeon(const uint8_t *records, size_t count, bool bigendian, record_block_t *block);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECORD_DECODE_KERNELS_H */
@@ -0,0 +1,68 @@
+#include "record_decode_kernels.h"
+
+#if RECORD_DECODE_NEON
+
+#include <arm_neon.h>
+
+/*
+Eight entries at a time, as on x86: a row of eight words of each of
+eight records, byte-swapped with vrev16 if need be, then the 8x8 square
+transposed by swapping 16-bit and then 32-bit pairs between rows, and
+finally pairing up the 64-bit halves.
+*/
+
+static inline uint16x8_t loadRow(const uint8_t *row, bool bigendian)
+{
+	uint8x16_t bytes = vld1q_u8(row);
+	if(bigendian) {
+		bytes = vrev16q_u8(bytes);
+	}
+	return vreinterpretq_u16_u8(bytes);
+}
+
+static inline uint32x4x2_t transposePairs(uint16x8_t a, uint16x8_t b)
+{
+	return vtrnq_u32(vreinterpretq_u32_u16(a), vreinterpretq_u32_u16(b));
+}
+
+void decodeWordsNeon(const uint8_t *records, size_t count, bool bigendian, record_block_t *block)
+{
+	size_t r = 0;
+
+	for(; r + 8 <= count; r += 8) {
+		const uint8_t *words = records + r * LOG_RECORD_SIZE + RECORD_WORDS_OFFSET;
+
+		for(int g = 0; g < LOG_WORD_COUNT; g += 8) {
+			const uint8_t *row = words + 2*g;
+
+			uint16x8x2_t t0 = vtrnq_u16(loadRow(row, bigendian), loadRow(row + LOG_RECORD_SIZE, bigendian));
+			uint16x8x2_t t1 = vtrnq_u16(loadRow(row + 2 * LOG_RECORD_SIZE, bigendian), loadRow(row + 3 * LOG_RECORD_SIZE, bigendian));
+			uint16x8x2_t t2 = vtrnq_u16(loadRow(row + 4 * LOG_RECORD_SIZE, bigendian), loadRow(row + 5 * LOG_RECORD_SIZE, bigendian));
+			uint16x8x2_t t3 = vtrnq_u16(loadRow(row + 6 * LOG_RECORD_SIZE, bigendian), loadRow(row + 7 * LOG_RECORD_SIZE, bigendian));
+
+			/* s0 holds words 0, 4 and 2, 6 of records 0-3, s2 the same of records 4-7 */
+			uint32x4x2_t s0 = transposePairs(t0.val[0], t1.val[0]);
+			uint32x4x2_t s1 = transposePairs(t0.val[1], t1.val[1]);
+			uint32x4x2_t s2 = transposePairs(t2.val[0], t3.val[0]);
+			uint32x4x2_t s3 = transposePairs(t2.val[1], t3.val[1]);
+
+			uint32x4_t column[8];
+			column[0] = vcombine_u32(vget_low_u32(s0.val[0]), vget_low_u32(s2.val[0]));
+			column[4] = vcombine_u32(vget_high_u32(s0.val[0]), vget_high_u32(s2.val[0]));
+			column[2] = vcombine_u32(vget_low_u32(s0.val[1]), vget_low_u32(s2.val[1]));
+			column[6] = vcombine_u32(vget_high_u32(s0.val[1]), vget_high_u32(s2.val[1]));
+			column[1] = vcombine_u32(vget_low_u32(s1.val[0]), vget_low_u32(s3.val[0]));
+			column[5] = vcombine_u32(vget_high_u32(s1.val[0]), vget_high_u32(s3.val[0]));
+			column[3] = vcombine_u32(vget_low_u32(s1.val[1]), vget_low_u32(s3.val[1]));
+			column[7] = vcombine_u32(vget_high_u32(s1.val[1]), vget_high_u32(s3.val[1]));
+
+			for(int k = 0; k < 8; k++) {
+				vst1q_u16(&block->words[g + k][r], vreinterpretq_u16_u32(column[k]));
+			}
+		}
+	}
+
+	decodeWordsScalar(records, r, count, bigendian, block);
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "record_decode_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/*
+Eight entries at a time: each row of eight words (16 bytes) of eight
+records is loaded, byte-swapped if need be, and the 8x8 square of words
+transposed with three rounds of unpacks, giving eight words of each of
+eight columns. AVX2 does the same in both halves of its registers at
+once, on the next eight records in the upper half.
+*/
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2  __attribute__((target("avx2")))
+
+static SSSE3 inline void transpose8x8(__m128i *row)
+{
+	__m128i t0 = _mm_unpacklo_epi16(row[0], row[1]);
+	__m128i t1 = _mm_unpackhi_epi16(row[0], row[1]);
+	__m128i t2 = _mm_unpacklo_epi16(row[2], row[3]);
+	__m128i t3 = _mm_unpackhi_epi16(row[2], row[3]);
+	__m128i t4 = _mm_unpacklo_epi16(row[4], row[5]);
+	__m128i t5 = _mm_unpackhi_epi16(row[4], row[5]);
+	__m128i t6 = _mm_unpacklo_epi16(row[6], row[7]);
+	__m128i t7 = _mm_unpackhi_epi16(row[6], row[7]);
+
+	__m128i u0 = _mm_unpacklo_epi32(t0, t2);
+	__m128i u1 = _mm_unpackhi_epi32(t0, t2);
+	__m128i u2 = _mm_unpacklo_epi32(t1, t3);
+	__m128i u3 = _mm_unpackhi_epi32(t1, t3);
+	__m128i u4 = _mm_unpacklo_epi32(t4, t6);
+	__m128i u5 = _mm_unpackhi_epi32(t4, t6);
+	__m128i u6 = _mm_unpacklo_epi32(t5, t7);
+	__m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+	row[0] = _mm_unpacklo_epi64(u0, u4);
+	row[1] = _mm_unpackhi_epi64(u0, u4);
+	row[2] = _mm_unpacklo_epi64(u1, u5);
+	row[3] = _mm_unpackhi_epi64(u1, u5);
+	row[4] = _mm_unpacklo_epi64(u2, u6);
+	row[5] = _mm_unpackhi_epi64(u2, u6);
+	row[6] = _mm_unpacklo_epi64(u3, u7);
+	row[7] = _mm_unpackhi_epi64(u3, u7);
+}
+
+/* records r..r+7 */
+static SSSE3 inline void decodeEightSsse3(const uint8_t *records, size_t r, bool bigendian, record_block_t *block)
+{
+	const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	const uint8_t *words = records + r * LOG_RECORD_SIZE + RECORD_WORDS_OFFSET;
+
+	for(int g = 0; g < LOG_WORD_COUNT; g += 8) {
+		__m128i row[8];
+
+		for(int k = 0; k < 8; k++) {
+			row[k] = _mm_loadu_si128((const __m128i *)(words + k * LOG_RECORD_SIZE + 2*g));
+			if(bigendian) {
+				row[k] = _mm_shuffle_epi8(row[k], swap);
+			}
+		}
+
+		transpose8x8(row);
+
+		for(int k = 0; k < 8; k++) {
+			_mm_storeu_si128((__m128i *)&block->words[g + k][r], row[k]);
+		}
+	}
+}
+
+SSSE3 void decodeWordsSsse3(const uint8_t *records, size_t count, bool bigendian, record_block_t *block)
+{
+	size_t r = 0;
+
+	for(; r + 8 <= count; r += 8) {
+		decodeEightSsse3(records, r, bigendian, block);
+	}
+
+	decodeWordsScalar(records, r, count, bigendian, block);
+}
+
+static AVX2 inline void transpose8x8Twice(__m256i *row)
+{
+	__m256i t0 = _mm256_unpacklo_epi16(row[0], row[1]);
+	__m256i t1 = _mm256_unpackhi_epi16(row[0], row[1]);
+	__m256i t2 = _mm256_unpacklo_epi16(row[2], row[3]);
+	__m256i t3 = _mm256_unpackhi_epi16(row[2], row[3]);
+	__m256i t4 = _mm256_unpacklo_epi16(row[4], row[5]);
+	__m256i t5 = _mm256_unpackhi_epi16(row[4], row[5]);
+	__m256i t6 = _mm256_unpacklo_epi16(row[6], row[7]);
+	__m256i t7 = _mm256_unpackhi_epi16(row[6], row[7]);
+
+	__m256i u0 = _mm256_unpacklo_epi32(t0, t2);
+	__m256i u1 = _mm256_unpackhi_epi32(t0, t2);
+	__m256i u2 = _mm256_unpacklo_epi32(t1, t3);
+	__m256i u3 = _mm256_unpackhi_epi32(t1, t3);
+	__m256i u4 = _mm256_unpacklo_epi32(t4, t6);
+	__m256i u5 = _mm256_unpackhi_epi32(t4, t6);
+	__m256i u6 = _mm256_unpacklo_epi32(t5, t7);
+	__m256i u7 = _mm256_unpackhi_epi32(t5, t7);
+
+	row[0] = _mm256_unpacklo_epi64(u0, u4);
+	row[1] = _mm256_unpackhi_epi64(u0, u4);
+	row[2] = _mm256_unpacklo_epi64(u1, u5);
+	row[3] = _mm256_unpackhi_epi64(u1, u5);
+	row[4] = _mm256_unpacklo_epi64(u2, u6);
+	row[5] = _mm256_unpackhi_epi64(u2, u6);
+	row[6] = _mm256_unpacklo_epi64(u3, u7);
+	row[7] = _mm256_unpackhi_epi64(u3, u7);
+}
+
+AVX2 void decodeWordsAvx2(const uint8_t *records, size_t count, bool bigendian, record_block_t *block)
+{
+	const __m256i swap = _mm256_setr_epi8(
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+		1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+	size_t r = 0;
+
+	for(; r + 16 <= count; r += 16) {
+		const uint8_t *low = records + r * LOG_RECORD_SIZE + RECORD_WORDS_OFFSET;
+		const uint8_t *high = low + 8 * LOG_RECORD_SIZE;
+
+		for(int g = 0; g < LOG_WORD_COUNT; g += 8) {
+			__m256i row[8];
+
+			for(int k = 0; k < 8; k++) {
+				__m128i lower = _mm_loadu_si128((const __m128i *)(low + k * LOG_RECORD_SIZE + 2*g));
+				__m128i upper = _mm_loadu_si128((const __m128i *)(high + k * LOG_RECORD_SIZE + 2*g));
+				row[k] = _mm256_inserti128_si256(_mm256_castsi128_si256(lower), upper, 1);
+				if(bigendian) {
+					row[k] = _mm256_shuffle_epi8(row[k], swap);
+				}
+			}
+
+			transpose8x8Twice(row);
+
+			for(int k = 0; k < 8; k++) {
+				_mm256_storeu_si256((__m256i *)&block->words[g + k][r], row[k]);
+			}
+		}
+	}
+
+	/* what is left may still hold a group of eight */
+	if(r + 8 <= count) {
+		decodeEightSsse3(records, r, bigendian, block);
+		r += 8;
+	}
+
+	decodeWordsScalar(records, r, count, bigendian, block);
+}
+
+#endif
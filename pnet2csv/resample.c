@@ -0,0 +1,205 @@
+#include "resample.h"
+#include "column_table.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+int resampleParsePeriod(const char *text, int64_t *period)
+{
+	static const struct
+	{
+		const char *text;
+		int64_t nanos;
+	} units[] = {
+		{"ns", 1},
+		{"us", 1000},
+		{"ms", 1000000},
+		{"s", 1000000000},
+		{"", 1000000},
+	};
+	char *end;
+
+	if(!isdigit((unsigned char)*text))
+		return -1;
+
+	unsigned long long value = strtoull(text, &end, 10);
+	for(size_t u = 0; u < sizeof(units) / sizeof(units[0]); u++) {
+		if(strcmp(end, units[u].text) == 0) {
+			if(value == 0 || value > (unsigned long long)(INT64_MAX / units[u].nanos))
+				return -1;
+			*period = (int64_t)value * units[u].nanos;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int resampleParseAggregates(const char *text, aggregate_t *aggregates, int *count)
+{
+	static const struct
+	{
+		const char *text;
+		aggregate_t aggregate;
+	} names[] = {
+		{"min", AGGREGATE_MIN},
+		{"max", AGGREGATE_MAX},
+		{"last", AGGREGATE_LAST},
+	};
+
+	*count = 0;
+	for(;;) {
+		size_t length = strcspn(text, ",");
+		size_t n;
+
+		for(n = 0; n < sizeof(names) / sizeof(names[0]); n++) {
+			if(strlen(names[n].text) == length && strncmp(text, names[n].text, length) == 0)
+				break;
+		}
+		if(n == sizeof(names) / sizeof(names[0]))
+			return -1;
+
+		for(int a = 0; a < *count; a++) {
+			if(aggregates[a] == names[n].aggregate)
+				return -1;
+		}
+		aggregates[(*count)++] = names[n].aggregate;
+
+		if(text[length] == '\0')
+			break;
+		text += length + 1;
+	}
+
+	return 0;
+}
+
+int resampleColumns(projection_t *columns, const projection_t *words, const aggregate_t *aggregates, int count)
+{
+	if(words->count * count > LOG_WORD_COUNT)
+		return -1;
+
+	columns->count = 0;
+	for(int k = 0; k < words->count; k++) {
+		for(int a = 0; a < count; a++) {
+			columns->words[columns->count] = words->words[k];
+			columns->aggregates[columns->count] = aggregates[a];
+			columns->count++;
+		}
+	}
+
+	return 0;
+}
+
+/* the first grid point at or after a time */
+static int64_t gridPoint(int64_t period, int64_t time)
+{
+	return (time + period - 1) / period * period;
+}
+
+void resamplerInit(
+	resampler_t *resampler,
+	int64_t period,
+	int word_count,
+	const aggregate_t *aggregates,
+	int count,
+	int64_t from,
+	int64_t to)
+{
+	memset(resampler, 0, sizeof(*resampler));
+
+	resampler->period = period;
+	resampler->next = gridPoint(period, from);
+	resampler->end = to;
+	resampler->word_count = word_count;
+	memcpy(resampler->aggregates, aggregates, count * sizeof(aggregate_t));
+	resampler->aggregate_count = count;
+}
+
+bool resamplerFill(resampler_t *resampler, int64_t until)
+{
+	record_block_t *rows = &resampler->rows;
+	int aggregate_count = resampler->aggregate_count;
+
+	/* no rows until there is something to fill them with */
+	if(!resampler->held)
+		return false;
+
+	if(until > resampler->end) {
+		until = resampler->end;
+	}
+
+	while(resampler->next < until) {
+		if(rows->count == RECORD_BLOCK)
+			return true;
+
+		size_t row = rows->count++;
+		columnTableSetTime(rows, row, resampler->next);
+
+		for(int a = 0; a < aggregate_count; a++) {
+			const uint16_t *from = resampler->value;
+			if(resampler->aggregates[a] == AGGREGATE_MIN) {
+				from = resampler->min;
+			}
+			else if(resampler->aggregates[a] == AGGREGATE_MAX) {
+				from = resampler->max;
+			}
+
+			for(int k = 0; k < resampler->word_count; k++) {
+				rows->words[k * aggregate_count + a][row] = from[k];
+			}
+		}
+
+		/* the next period starts out with only the value held */
+		if(resampler->gathered) {
+			memcpy(resampler->min, resampler->value, resampler->word_count * sizeof(uint16_t));
+			memcpy(resampler->max, resampler->value, resampler->word_count * sizeof(uint16_t));
+			resampler->gathered = false;
+		}
+
+		resampler->next += resampler->period;
+	}
+
+	return false;
+}
+
+void resamplerTake(resampler_t *resampler, int64_t time, const uint16_t *words)
+{
+	int word_count = resampler->word_count;
+
+	memcpy(resampler->value, words, word_count * sizeof(uint16_t));
+
+	/* before the period of the next grid point only what is held when it starts counts */
+	if(!resampler->held || time <= resampler->next - resampler->period) {
+		memcpy(resampler->min, words, word_count * sizeof(uint16_t));
+		memcpy(resampler->max, words, word_count * sizeof(uint16_t));
+	}
+	else {
+		for(int k = 0; k < word_count; k++) {
+			resampler->min[k] = (words[k] < resampler->min[k]) ? words[k] : resampler->min[k];
+			resampler->max[k] = (words[k] > resampler->max[k]) ? words[k] : resampler->max[k];
+		}
+		resampler->gathered = true;
+	}
+
+	if(!resampler->held) {
+		int64_t first = gridPoint(resampler->period, time);
+		if(first > resampler->next) {
+			resampler->next = first;
+		}
+		resampler->held = true;
+		resampler->last = time;
+	}
+	else if(time > resampler->last) {
+		resampler->last = time;
+	}
+}
+
+bool resamplerFinish(resampler_t *resampler)
+{
+	/* through the last entry, its own grid point included */
+	if(resampler->end == INT64_MAX)
+		return resamplerFill(resampler, resampler->last + 1);
+
+	return resamplerFill(resampler, resampler->end);
+}
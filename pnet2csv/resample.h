@@ -0,0 +1,150 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+/**
+ * @file
+ * @brief Entries on a regular timeline
+ *
+ * Logs only hold an entry when the data changed, and the one before it.
+ * Resampling turns that back into a row at every grid point, the times
+ * that are whole multiples of a period, by holding each entry's words
+ * until the next entry. A row may also hold the least or greatest value
+ * a word had over the period ending at it, for plotting long stretches
+ * at a coarser period.
+ *
+ * Entries are taken one at a time in order, and rows made a block at a
+ * time as the entries pass their grid points, so however many rows come
+ * out only one block of them is ever held.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_logformat.h"
+#include "entry_filter.h"
+#include "record_decode.h"
+
+/* min, max and last */
+#define RESAMPLE_AGGREGATES 3
+
+typedef struct resampler
+{
+	/* between grid points */
+	int64_t period;
+	/* rows only for grid points before this, INT64_MAX through the last entry */
+	int64_t end;
+	/* the next grid point, which ends the period being gathered */
+	int64_t next;
+
+	/* an entry has been taken, so there is something to hold */
+	bool held;
+	/* of the latest entry */
+	int64_t last;
+	/* entries taken since the last row, so min and max may differ from value */
+	bool gathered;
+
+	/* as many words as the projection the entries came through */
+	int word_count;
+	uint16_t value[LOG_WORD_COUNT];
+	uint16_t min[LOG_WORD_COUNT];
+	uint16_t max[LOG_WORD_COUNT];
+
+	/* of each word, so the columns are word_count * aggregate_count */
+	aggregate_t aggregates[RESAMPLE_AGGREGATES];
+	int aggregate_count;
+
+	/* rows made and not yet taken */
+	record_block_t rows;
+} resampler_t;
+
+/**
+ * Read a period
+ *
+ * @param text             In:    a number with ns, us, ms or s after it, or
+ *                                without for milliseconds
+ * @param period           Out:   nanoseconds
+ * @return 0 on success, -1 if it could not be parsed or is not positive
+ */
+int resampleParsePeriod(const char *text, int64_t *period);
+
+/**
+ * Read which aggregates each word gets
+ *
+ * @param text             In:    some of min, max and last, as min,max
+ * @param aggregates       Out:   at least RESAMPLE_AGGREGATES of them
+ * @param count            Out
+ * @return 0 on success, -1 if it could not be parsed or repeats one
+ */
+int resampleParseAggregates(const char *text, aggregate_t *aggregates, int *count);
+
+/**
+ * The columns written for the words, every aggregate of a word after another
+ *
+ * @param columns          Out
+ * @param words            In
+ * @param aggregates       In
+ * @param count            In:    of aggregates
+ * @return 0 on success, -1 if there would be more than LOG_WORD_COUNT
+ */
+int resampleColumns(projection_t *columns, const projection_t *words, const aggregate_t *aggregates, int count);
+
+/**
+ * Start with nothing held
+ *
+ * @param resampler        Out
+ * @param period           In:    nanoseconds
+ * @param word_count       In:    words of each entry
+ * @param aggregates       In:    as for resampleColumns
+ * @param count            In:    of aggregates
+ * @param from             In:    nanoseconds since 1970 of the first grid
+ *                                point, or 0 for that of the first entry
+ * @param to               In:    no grid points from here on, or INT64_MAX
+ *                                for through the last entry
+ */
+void resamplerInit(
+	resampler_t *resampler,
+	int64_t period,
+	int word_count,
+	const aggregate_t *aggregates,
+	int count,
+	int64_t from,
+	int64_t to);
+
+/**
+ * Make the rows of the grid points before a time. Call it before
+ * resamplerTake with the time of the entry.
+ *
+ * @param resampler        InOut
+ * @param until            In:    nanoseconds since 1970
+ * @return true if it stopped with rows full, to be taken before calling
+ *         it again; false once done
+ */
+bool resamplerFill(resampler_t *resampler, int64_t until);
+
+/**
+ * Take the next entry
+ *
+ * @param resampler        InOut
+ * @param time             In:    nanoseconds since 1970
+ * @param words            In:    word_count of them
+ */
+void resamplerTake(resampler_t *resampler, int64_t time, const uint16_t *words);
+
+/**
+ * Make the rows left once every entry is taken, as resamplerFill
+ *
+ * @param resampler        InOut
+ * @return true if it stopped with rows full
+ */
+bool resamplerFinish(resampler_t *resampler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RESAMPLE_H */
@@ -0,0 +1,203 @@
+#include "work_pool.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct worker_start
+{
+	work_pool_t *pool;
+	int index;
+} worker_start_t;
+
+/* front of the deque if it may start yet, SIZE_MAX if not */
+static size_t takeFront(work_deque_t *deque, size_t limit)
+{
+	size_t task = SIZE_MAX;
+
+	pthread_mutex_lock(&deque->lock);
+	if(deque->head != deque->tail && deque->tasks[deque->head] < limit) {
+		task = deque->tasks[deque->head++];
+	}
+	pthread_mutex_unlock(&deque->lock);
+
+	return task;
+}
+
+/* next task for this worker, SIZE_MAX once there are none left */
+static size_t takeTask(work_pool_t *pool, int index)
+{
+	for(;;) {
+		pthread_mutex_lock(&pool->lock);
+		bool cancelled = pool->cancelled;
+		size_t retired = pool->retired;
+		pthread_mutex_unlock(&pool->lock);
+
+		if(cancelled || atomic_load(&pool->unstarted) == 0)
+			return SIZE_MAX;
+
+		size_t limit = (pool->window != 0) ? retired + pool->window : SIZE_MAX;
+
+		/* our own first, then steal, starting from our neighbour */
+		for(int i = 0; i < pool->deque_count; i++) {
+			work_deque_t *deque = &pool->deques[(index + i) % pool->deque_count];
+			size_t task = takeFront(deque, limit);
+			if(task != SIZE_MAX) {
+				atomic_fetch_sub(&pool->unstarted, 1);
+				return task;
+			}
+		}
+
+		/* everything left is beyond the window, wait for it to move */
+		pthread_mutex_lock(&pool->lock);
+		while(pool->retired == retired && !pool->cancelled && atomic_load(&pool->unstarted) != 0) {
+			pthread_cond_wait(&pool->changed, &pool->lock);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+static void *workerMain(void *arg)
+{
+	worker_start_t *start = arg;
+	work_pool_t *pool = start->pool;
+	int index = start->index;
+	free(start);
+
+	size_t task;
+	while((task = takeTask(pool, index)) != SIZE_MAX) {
+		pool->function(pool->context, task);
+
+		pthread_mutex_lock(&pool->lock);
+		pool->done[task] = true;
+		pthread_cond_broadcast(&pool->changed);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	/* others may be waiting on a window that will never move now */
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+int workPoolStart(
+	work_pool_t *pool,
+	size_t count,
+	int workers,
+	size_t window,
+	work_function_t function,
+	void *context)
+{
+	int locks = 0;
+
+	memset(pool, 0, sizeof(*pool));
+	pool->function = function;
+	pool->context = context;
+	pool->count = count;
+	pool->workers = (workers > 0) ? workers : 1;
+	pool->window = window;
+	atomic_init(&pool->unstarted, count);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->changed, NULL);
+
+	pool->deque_count = pool->workers;
+	pool->threads = calloc(pool->workers, sizeof(pthread_t));
+	pool->deques = calloc(pool->deque_count, sizeof(work_deque_t));
+	pool->done = calloc(count > 0 ? count : 1, sizeof(bool));
+	if(pool->threads == NULL || pool->deques == NULL || pool->done == NULL)
+		goto error;
+
+	for(int w = 0; w < pool->deque_count; w++) {
+		work_deque_t *deque = &pool->deques[w];
+		pthread_mutex_init(&deque->lock, NULL);
+		locks++;
+		deque->tasks = malloc((count / pool->deque_count + 1) * sizeof(size_t));
+		if(deque->tasks == NULL)
+			goto error;
+	}
+
+	for(size_t task = 0; task < count; task++) {
+		work_deque_t *deque = &pool->deques[task % pool->deque_count];
+		deque->tasks[deque->tail++] = task;
+	}
+
+	int started = 0;
+	for(int w = 0; w < pool->workers; w++) {
+		worker_start_t *start = malloc(sizeof(worker_start_t));
+		if(start == NULL)
+			break;
+		start->pool = pool;
+		start->index = w;
+
+		if(pthread_create(&pool->threads[w], NULL, workerMain, start) != 0) {
+			free(start);
+			break;
+		}
+		started++;
+	}
+
+	/* the ones we have steal the rest */
+	pool->workers = started;
+	if(started == 0)
+		goto error;
+
+	return 0;
+
+error:
+	for(int w = 0; w < locks; w++) {
+		pthread_mutex_destroy(&pool->deques[w].lock);
+		free(pool->deques[w].tasks);
+	}
+	pthread_cond_destroy(&pool->changed);
+	pthread_mutex_destroy(&pool->lock);
+
+	free(pool->deques);
+	free(pool->threads);
+	free(pool->done);
+	return -1;
+}
+
+void workPoolWaitFor(work_pool_t *pool, size_t task)
+{
+	pthread_mutex_lock(&pool->lock);
+	while(!pool->done[task]) {
+		pthread_cond_wait(&pool->changed, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void workPoolRetire(work_pool_t *pool, size_t task)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->retired = task + 1;
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void workPoolCancel(work_pool_t *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->cancelled = true;
+	pthread_cond_broadcast(&pool->changed);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void workPoolFinish(work_pool_t *pool)
+{
+	for(int w = 0; w < pool->workers; w++) {
+		pthread_join(pool->threads[w], NULL);
+	}
+
+	for(int w = 0; w < pool->deque_count; w++) {
+		pthread_mutex_destroy(&pool->deques[w].lock);
+		free(pool->deques[w].tasks);
+	}
+	pthread_cond_destroy(&pool->changed);
+	pthread_mutex_destroy(&pool->lock);
+
+	free(pool->deques);
+	free(pool->threads);
+	free(pool->done);
+}
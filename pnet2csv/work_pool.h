@@ -0,0 +1,125 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+/**
+ * @file
+ * @brief Work-stealing thread pool for numbered tasks
+ *
+ * Tasks 0..count-1 are dealt round-robin onto one deque per worker.
+ * Each worker takes from the front of its own deque, and once that is
+ * empty steals from the front of the others, so the pool keeps every core
+ * busy however unevenly the tasks are sized.
+ *
+ * Every deque is in ascending order, so the lowest task not yet started
+ * is always at the front of one of them. That lets a window hold workers
+ * back to a fixed number of tasks ahead of the oldest one the caller has
+ * not retired, so results can be consumed in order without all of them
+ * piling up in memory.
+ */
+
+#ifdef __cplusplus
+/* the same type as in C, as the stdatomic.h of C++23 has it */
+#include <atomic>
+typedef std::atomic<size_t> atomic_size_t;
+
+extern "C" {
+#else
+#include <stdatomic.h>
+#endif
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*work_function_t)(void *context, size_t task);
+
+typedef struct work_deque
+{
+	pthread_mutex_t lock;
+	/* tasks[head..tail) are not started yet */
+	size_t *tasks;
+	size_t head;
+	size_t tail;
+} work_deque_t;
+
+typedef struct work_pool
+{
+	work_function_t function;
+	void *context;
+	size_t count;
+	int workers;
+	/* tasks that may be started beyond retired, 0 for no limit */
+	size_t window;
+
+	pthread_t *threads;
+	/* one per worker asked for, even if fewer could be started */
+	work_deque_t *deques;
+	int deque_count;
+	/* tasks not yet taken by any worker */
+	atomic_size_t unstarted;
+
+	/* guards the rest, changed signals any of them changing */
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	bool *done;
+	size_t retired;
+	bool cancelled;
+} work_pool_t;
+
+/**
+ * Start the workers on tasks 0..count-1
+ *
+ * @param pool             Out
+ * @param count            In:    number of tasks
+ * @param workers          In:    number of threads
+ * @param window           In:    how far ahead of the oldest task not yet
+ *                                retired tasks may start, 0 for no limit
+ * @param function         In:    run for each task, on any worker
+ * @param context          In:    passed to function
+ * @return 0 on success, -1 on error
+ */
+int workPoolStart(
+	work_pool_t *pool,
+	size_t count,
+	int workers,
+	size_t window,
+	work_function_t function,
+	void *context);
+
+/**
+ * Wait until a task has been run
+ *
+ * @param pool             InOut
+ * @param task             In
+ */
+void workPoolWaitFor(work_pool_t *pool, size_t task);
+
+/**
+ * Let the pool move on past a task whose results have been used.
+ * Tasks must be retired in order, and only once they have run.
+ *
+ * @param pool             InOut
+ * @param task             In
+ */
+void workPoolRetire(work_pool_t *pool, size_t task);
+
+/**
+ * Stop starting tasks; those already running still finish
+ *
+ * @param pool             InOut
+ */
+void workPoolCancel(work_pool_t *pool);
+
+/**
+ * Wait for the workers to run out of tasks, or to be cancelled,
+ * and free the pool
+ *
+ * @param pool             InOut
+ */
+void workPoolFinish(work_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WORK_POOL_H */
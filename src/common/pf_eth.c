@@ -19,9 +19,20 @@
  *
  * The frame id map is used to quickly find the function responsible for
  * handling a frame with a specific frame id.
- * Clients may add or remove entries on the fly, but there is no locking of the
- * table. ToDo: This may be a problem in the future. Note that frames may arrive
- * at any time.
+ * Clients may add or remove entries on the fly, from one thread at a time,
+ * while frames arrive on the receive threads at any time.
+ *
+ * Entries are found through an index, a hash table keyed by frame id.
+ * There are two of them, and the receive threads only read the one that is
+ * published in eth_id_current. A change is made by building the other one
+ * from the entries, publishing it, and then waiting for the receive threads
+ * still in the old one to leave it, after which it is free for the next
+ * change, and a removed entry is no longer seen by anyone.
+ * The receive threads never wait, and the wait of the thread making the
+ * change is that of a lookup.
+ *
+ * Without atomics (see PF_ETH_ID_INDEX) there is no index, and the receive
+ * threads search the map itself, as changes to it are not locked out.
  */
 
 #ifdef UNIT_TEST
@@ -110,6 +121,12 @@ int pf_eth_init (pnet_t * net, const pnet_cfg_t * p_cfg)
       (number_of_ports == 1) ? PNAL_ETHTYPE_ALL : PNAL_ETHTYPE_PROFINET;
 
    memset (net->eth_id_map, 0, sizeof (net->eth_id_map));
+#if PF_ETH_ID_INDEX
+   memset (net->eth_id_index, 0, sizeof (net->eth_id_index));
+   atomic_store (&net->eth_id_current, 0);
+   atomic_store (&net->eth_id_readers[0], 0);
+   atomic_store (&net->eth_id_readers[1], 0);
+#endif
 
    /* Init management port */
    if (
@@ -194,6 +211,119 @@ int pf_eth_send_on_management_port (pnet_t * net, pnal_buf_t * buf)
    return sent_len;
 }
 
+/**
+ * @internal
+ * Look up the entry of a frame id, as seen by the receive threads.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param frame_id         In:    The frame id to look for.
+ * @param p_entry          Out:   Copy of the entry, if found.
+ * @return  true  if the frame id was found.
+ *          false if not.
+ */
+static bool pf_eth_frame_id_lookup (
+   pnet_t * net,
+   uint16_t frame_id,
+   pf_eth_frame_id_map_t * p_entry)
+{
+   bool found = false;
+#if PF_ETH_ID_INDEX
+   uint32_t current;
+   uint16_t slot;
+   uint16_t entry;
+   uint16_t probes;
+
+   /* Enter the published index. If another was published meanwhile,
+    * the writer may not have seen us, so try again. */
+   do
+   {
+      current = atomic_load (&net->eth_id_current);
+      atomic_fetch_add (&net->eth_id_readers[current], 1);
+      if ((uint32_t)atomic_load (&net->eth_id_current) == current)
+      {
+         break;
+      }
+      atomic_fetch_sub (&net->eth_id_readers[current], 1);
+   } while (true);
+
+   slot = frame_id % PF_ETH_ID_INDEX_SIZE;
+   for (probes = 0; probes < PF_ETH_ID_INDEX_SIZE; probes++)
+   {
+      entry = net->eth_id_index[current][slot];
+      if (entry == 0)
+      {
+         break;
+      }
+      if (net->eth_id_map[entry - 1].frame_id == frame_id)
+      {
+         *p_entry = net->eth_id_map[entry - 1];
+         found = true;
+         break;
+      }
+      slot = (slot + 1) % PF_ETH_ID_INDEX_SIZE;
+   }
+
+   /* The handler is called after leaving, as it may change the map */
+   atomic_fetch_sub (&net->eth_id_readers[current], 1);
+#else
+   uint16_t ix = 0;
+
+   while ((ix < NELEMENTS (net->eth_id_map)) &&
+          ((net->eth_id_map[ix].in_use == false) ||
+           (net->eth_id_map[ix].frame_id != frame_id)))
+   {
+      ix++;
+   }
+   if (ix < NELEMENTS (net->eth_id_map))
+   {
+      *p_entry = net->eth_id_map[ix];
+      found = true;
+   }
+#endif
+
+   return found;
+}
+
+/**
+ * @internal
+ * Publish the entries in use to the receive threads.
+ *
+ * The index not in use is built from the entries, in the order they are
+ * in the map so that the first of several with the same frame id is found,
+ * and published. Returns once no receive thread uses the old index.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+static void pf_eth_frame_id_publish (pnet_t * net)
+{
+#if PF_ETH_ID_INDEX
+   uint32_t next = atomic_load (&net->eth_id_current) ^ 1;
+   uint16_t * p_index = net->eth_id_index[next];
+   uint16_t ix;
+   uint16_t slot;
+
+   memset (p_index, 0, sizeof (net->eth_id_index[next]));
+   for (ix = 0; ix < NELEMENTS (net->eth_id_map); ix++)
+   {
+      if (net->eth_id_map[ix].in_use)
+      {
+         slot = net->eth_id_map[ix].frame_id % PF_ETH_ID_INDEX_SIZE;
+         while (p_index[slot] != 0)
+         {
+            slot = (slot + 1) % PF_ETH_ID_INDEX_SIZE;
+         }
+         p_index[slot] = ix + 1;
+      }
+   }
+
+   atomic_store (&net->eth_id_current, next);
+   while (atomic_load (&net->eth_id_readers[next ^ 1]) != 0)
+   {
+      os_usleep (1);
+   }
+#endif
+}
+
 int pf_eth_recv (pnal_eth_handle_t * eth_handle, void * arg, pnal_buf_t * p_buf)
 {
    int ret = 0; /* Means: "Not handled" */
@@ -202,7 +332,7 @@ int pf_eth_recv (pnal_eth_handle_t * eth_handle, void * arg, pnal_buf_t * p_buf)
    uint16_t frame_id = 0;
    uint16_t frame_pos = 0;
    const uint16_t * p_data = NULL;
-   uint16_t ix = 0;
+   pf_eth_frame_id_map_t entry;
    int loc_port_num = 0;
    pnet_t * net = (pnet_t *)arg;
 
@@ -226,22 +356,15 @@ int pf_eth_recv (pnal_eth_handle_t * eth_handle, void * arg, pnal_buf_t * p_buf)
       frame_id = ntohs (p_data[0]);
 
       /* Find the associated frame handler */
-      ix = 0;
-      while ((ix < NELEMENTS (net->eth_id_map)) &&
-             ((net->eth_id_map[ix].in_use == false) ||
-              (net->eth_id_map[ix].frame_id != frame_id)))
-      {
-         ix++;
-      }
-      if (ix < NELEMENTS (net->eth_id_map))
+      if (pf_eth_frame_id_lookup (net, frame_id, &entry))
       {
          /* Call the frame handler */
-         ret = net->eth_id_map[ix].frame_handler (
+         ret = entry.frame_handler (
             net,
             frame_id,
             p_buf, /* This cannot be NULL, as seen above */
             frame_pos,
-            net->eth_id_map[ix].p_arg);
+            entry.p_arg);
       }
       break;
    case PNAL_ETHTYPE_LLDP:
@@ -289,6 +412,7 @@ void pf_eth_frame_id_map_add (
       net->eth_id_map[ix].frame_handler = frame_handler;
       net->eth_id_map[ix].p_arg = p_arg;
       net->eth_id_map[ix].in_use = true;
+      pf_eth_frame_id_publish (net);
    }
    else
    {
@@ -309,7 +433,9 @@ void pf_eth_frame_id_map_remove (pnet_t * net, uint16_t frame_id)
 
    if (ix < NELEMENTS (net->eth_id_map))
    {
+      /* Not to be reused before it is out of the published index */
       net->eth_id_map[ix].in_use = false;
+      pf_eth_frame_id_publish (net);
       LOG_DEBUG (
          PF_ETH_LOG,
          "ETH(%d): Free room for FrameIds %#x at index %u\n",
@@ -22,7 +22,11 @@
 #define pnal_udp_close    mock_pnal_udp_close
 #define pnal_udp_open     mock_pnal_udp_open
 #define pnal_udp_recvfrom mock_pnal_udp_recvfrom
+#define pnal_udp_recvmmsg mock_pnal_udp_recvmmsg
 #define pnal_udp_sendto   mock_pnal_udp_sendto
+#define pnal_udp_watch_init   mock_pnal_udp_watch_init
+#define pnal_udp_watch_add    mock_pnal_udp_watch_add
+#define pnal_udp_watch_remove mock_pnal_udp_watch_remove
 #endif
 
 #include <string.h>
@@ -68,7 +72,34 @@ int pf_udp_recvfrom (
    return pnal_udp_recvfrom (id, src_addr, src_port, data, size);
 }
 
+int pf_udp_recvmmsg (
+   pnet_t * net,
+   uint32_t id,
+   pnal_udp_msg_t * msgs,
+   int count)
+{
+   return pnal_udp_recvmmsg (id, msgs, count);
+}
+
 void pf_udp_close (pnet_t * net, uint32_t id)
 {
    pnal_udp_close (id);
 }
+
+pnal_udp_watch_t * pf_udp_watch_init (
+   pnet_t * net,
+   pnal_udp_watch_callback_t * callback,
+   void * arg)
+{
+   return pnal_udp_watch_init (&net->fspm_cfg.pnal_cfg, callback, arg);
+}
+
+int pf_udp_watch_add (pnet_t * net, pnal_udp_watch_t * watch, uint32_t id)
+{
+   return pnal_udp_watch_add (watch, id);
+}
+
+void pf_udp_watch_remove (pnet_t * net, pnal_udp_watch_t * watch, uint32_t id)
+{
+   pnal_udp_watch_remove (watch, id);
+}
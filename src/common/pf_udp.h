@@ -71,6 +71,24 @@ int pf_udp_recvfrom (
    uint8_t * data,
    int size);
 
+/**
+ * Receive the UDP datagrams waiting on a socket, up to a number of them.
+ *
+ * This is a nonblocking function, and it
+ * returns 0 immediately if no data is available.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param id               In:    Socket ID
+ * @param msgs             InOut: Buffers to receive into, filled in order
+ * @param count            In:    Number of buffers
+ * @return  The number of datagrams received, or -1 if an error occurred.
+ */
+int pf_udp_recvmmsg (
+   pnet_t * net,
+   uint32_t id,
+   pnal_udp_msg_t * msgs,
+   int count);
+
 /**
  * Close an UDP socket.
  *
@@ -79,6 +97,41 @@ int pf_udp_recvfrom (
  */
 void pf_udp_close (pnet_t * net, uint32_t id);
 
+/**
+ * Start watching UDP sockets for incoming datagrams, in a thread of the
+ * port. Not all ports support it.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param callback         In:    Called from that thread when datagrams
+ *                                have arrived. See pnal_udp_watch_callback_t.
+ * @param arg              InOut: User argument passed to the callback
+ * @return  the watch handle, or NULL if the sockets must be polled.
+ */
+pnal_udp_watch_t * pf_udp_watch_init (
+   pnet_t * net,
+   pnal_udp_watch_callback_t * callback,
+   void * arg);
+
+/**
+ * Start watching a UDP socket.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param watch            InOut: Watch handle
+ * @param id               In:    Socket ID
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred.
+ */
+int pf_udp_watch_add (pnet_t * net, pnal_udp_watch_t * watch, uint32_t id);
+
+/**
+ * Stop watching a UDP socket. Done before the socket is closed.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param watch            InOut: Watch handle
+ * @param id               In:    Socket ID
+ */
+void pf_udp_watch_remove (pnet_t * net, pnal_udp_watch_t * watch, uint32_t id);
+
 #ifdef __cplusplus
 }
 #endif
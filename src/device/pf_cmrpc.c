@@ -36,6 +36,10 @@
  *
  * The socket net->cmrpc_rpcreq_socket is used for RPC requests (connects etc)
  *
+ * The sockets are polled on every tick, unless the application has asked to
+ * be told when datagrams arrive (rpc_ready_cb). They are then watched by a
+ * thread of the port, and only read in pf_cmrpc_handle_ready().
+ *
  */
 
 #ifdef UNIT_TEST
@@ -546,6 +550,88 @@ static int pf_session_allocate (pnet_t * net, pf_session_info_t ** pp_sess)
    return ret;
 }
 
+/**
+ * @internal
+ * Stop watching the RPC sockets, so that they are polled on every tick.
+ *
+ * The watching thread can not be stopped, but with no sockets left to
+ * watch it does not call back any more.
+ *
+ * @param net              InOut: The p-net stack instance
+ */
+static void pf_cmrpc_unwatch_all (pnet_t * net)
+{
+   uint16_t ix;
+
+   if (net->cmrpc_rpcreq_socket > -1)
+   {
+      pf_udp_watch_remove (net, net->cmrpc_watch, net->cmrpc_rpcreq_socket);
+   }
+   for (ix = 0; ix < NELEMENTS (net->cmrpc_session_info); ix++)
+   {
+      if (
+         (net->cmrpc_session_info[ix].in_use == true) &&
+         (net->cmrpc_session_info[ix].from_me == true) &&
+         (net->cmrpc_session_info[ix].socket > -1))
+      {
+         pf_udp_watch_remove (
+            net,
+            net->cmrpc_watch,
+            net->cmrpc_session_info[ix].socket);
+      }
+   }
+
+   net->cmrpc_watch = NULL;
+}
+
+/**
+ * @internal
+ * Open a UDP socket for RPC, and watch it if the sockets are watched.
+ *
+ * If it can not be watched, none of the sockets are watched any more, and
+ * all of them are polled instead, so that it is still read.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param port             In:    UDP port to listen to.
+ * @return Socket ID, or -1 if an error occurred.
+ */
+static int pf_cmrpc_socket_open (pnet_t * net, pnal_ipport_t port)
+{
+   int socket = pf_udp_open (net, port);
+
+   if ((socket > -1) && (net->cmrpc_watch != NULL))
+   {
+      if (pf_udp_watch_add (net, net->cmrpc_watch, socket) != 0)
+      {
+         LOG_ERROR (
+            PF_RPC_LOG,
+            "CMRPC(%d): Failed to watch socket %d, the RPC sockets are "
+            "polled instead.\n",
+            __LINE__,
+            socket);
+         pf_cmrpc_unwatch_all (net);
+      }
+   }
+
+   return socket;
+}
+
+/**
+ * @internal
+ * Close a UDP socket for RPC.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param socket           In:    Socket ID
+ */
+static void pf_cmrpc_socket_close (pnet_t * net, int socket)
+{
+   if (net->cmrpc_watch != NULL)
+   {
+      pf_udp_watch_remove (net, net->cmrpc_watch, socket);
+   }
+   pf_udp_close (net, socket);
+}
+
 /**
  * @internal
  * Free the session_info.
@@ -564,7 +650,7 @@ static void pf_session_release (pnet_t * net, pf_session_info_t * p_sess)
          {
             if (p_sess->from_me)
             {
-               pf_udp_close (net, p_sess->socket);
+               pf_cmrpc_socket_close (net, p_sess->socket);
                p_sess->socket = -1;
             }
          }
@@ -1109,7 +1195,7 @@ static void pf_cmrpc_send_with_timeout (
             (void)pf_cmdev_cm_abort (p_net, p_sess->p_ar);
             if (p_sess->socket > -1)
             {
-               pf_udp_close (p_net, p_sess->socket);
+               pf_cmrpc_socket_close (p_net, p_sess->socket);
                p_sess->socket = -1;
             }
          }
@@ -3963,7 +4049,8 @@ int pf_cmrpc_rm_ccontrol_req (
          &start_pos);
 
       /* Open socket for CControl interchange */
-      p_sess->socket = pf_udp_open (net, PF_RPC_CCONTROL_EPHEMERAL_PORT);
+      p_sess->socket =
+         pf_cmrpc_socket_open (net, PF_RPC_CCONTROL_EPHEMERAL_PORT);
       p_sess->resend_counter = PF_CMRPC_NUMBER_OF_RESENDS;
       pf_cmrpc_send_with_timeout (net, p_sess, os_get_current_time_us());
 
@@ -5048,11 +5135,48 @@ static int pf_cmrpc_dce_packet (
    return ret;
 }
 
-void pf_cmrpc_periodic (pnet_t * net)
+/**
+ * @internal
+ * Receive the datagrams waiting on an RPC socket, up to PF_CMRPC_RECV_BATCH
+ * of them, into the input buffers.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @param socket           In:    Socket ID
+ * @param msgs             Out:   Received datagrams
+ * @return  The number of datagrams received, or -1 if an error occurred.
+ */
+static int pf_cmrpc_recv_batch (
+   pnet_t * net,
+   int socket,
+   pnal_udp_msg_t msgs[PF_CMRPC_RECV_BATCH])
 {
-   uint32_t dcerpc_addr;
-   uint16_t dcerpc_port;
-   int dcerpc_input_len;
+   uint16_t ix;
+
+   for (ix = 0; ix < PF_CMRPC_RECV_BATCH; ix++)
+   {
+      msgs[ix].data = net->cmrpc_dcerpc_input_frame[ix];
+      msgs[ix].size = sizeof (net->cmrpc_dcerpc_input_frame[ix]);
+   }
+
+   return pf_udp_recvmmsg (net, socket, msgs, PF_CMRPC_RECV_BATCH);
+}
+
+/**
+ * @internal
+ * Receive and handle the datagrams waiting on the RPC sockets, up to
+ * PF_CMRPC_RECV_BATCH of them from each.
+ *
+ * @param net              InOut: The p-net stack instance
+ * @return  true  if a socket may have more waiting, as a full batch was
+ *                taken from it.
+ *          false if the sockets are empty.
+ */
+static bool pf_cmrpc_recv_all (pnet_t * net)
+{
+   pnal_udp_msg_t msgs[PF_CMRPC_RECV_BATCH];
+   bool more = false;
+   int received;
+   int msg_ix;
    uint16_t dcerpc_resp_len = 0;
    uint16_t ix;
    bool close_socket = false;
@@ -5069,46 +5193,43 @@ void pf_cmrpc_periodic (pnet_t * net)
          (net->cmrpc_session_info[ix].from_me == true))
       {
          /* We are waiting for a response from the IO-controller */
-         dcerpc_input_len = pf_udp_recvfrom (
-            net,
-            net->cmrpc_session_info[ix].socket,
-            &dcerpc_addr,
-            &dcerpc_port,
-            net->cmrpc_dcerpc_input_frame,
-            sizeof (net->cmrpc_dcerpc_input_frame));
-         if (dcerpc_input_len > 0)
+         received =
+            pf_cmrpc_recv_batch (net, net->cmrpc_session_info[ix].socket, msgs);
+         more = more || (received == PF_CMRPC_RECV_BATCH);
+         close_socket = false;
+         for (msg_ix = 0; (msg_ix < received) && !close_socket; msg_ix++)
          {
-            pf_cmina_ip_to_string (dcerpc_addr, ip_string);
+            pf_cmina_ip_to_string (msgs[msg_ix].addr, ip_string);
             dcerpc_resp_len = PF_MAX_UDP_PAYLOAD_SIZE;
             LOG_INFO (
                PF_RPC_LOG,
                "CMRPC(%d): Received %u bytes UDP payload from remote %s:%u, on "
                "socket %d used in session with index %u\n",
                __LINE__,
-               dcerpc_input_len,
+               msgs[msg_ix].len,
                ip_string,
-               dcerpc_port,
+               msgs[msg_ix].port,
                net->cmrpc_session_info[ix].socket,
                ix);
-            close_socket = false;
             (void)pf_cmrpc_dce_packet (
                net,
-               dcerpc_addr,
-               dcerpc_port,
-               net->cmrpc_dcerpc_input_frame,
-               dcerpc_input_len,
+               msgs[msg_ix].addr,
+               msgs[msg_ix].port,
+               msgs[msg_ix].data,
+               msgs[msg_ix].len,
                net->cmrpc_dcerpc_output_frame,
                &dcerpc_resp_len,
                &close_socket);
 
             if (close_socket)
             {
+               /* Any datagrams left in the batch go with the socket */
                LOG_DEBUG (
                   PF_RPC_LOG,
                   "CMRPC(%d): Closing socket used in session with index %u\n",
                   __LINE__,
                   ix);
-               pf_udp_close (net, net->cmrpc_session_info[ix].socket);
+               pf_cmrpc_socket_close (net, net->cmrpc_session_info[ix].socket);
                net->cmrpc_session_info[ix].socket = -1;
             }
          }
@@ -5116,33 +5237,28 @@ void pf_cmrpc_periodic (pnet_t * net)
    }
 
    /* Poll RPC requests */
-   dcerpc_input_len = pf_udp_recvfrom (
-      net,
-      net->cmrpc_rpcreq_socket,
-      &dcerpc_addr,
-      &dcerpc_port,
-      net->cmrpc_dcerpc_input_frame,
-      sizeof (net->cmrpc_dcerpc_input_frame));
-   if (dcerpc_input_len > 0)
+   received = pf_cmrpc_recv_batch (net, net->cmrpc_rpcreq_socket, msgs);
+   more = more || (received == PF_CMRPC_RECV_BATCH);
+   for (msg_ix = 0; msg_ix < received; msg_ix++)
    {
-      pf_cmina_ip_to_string (dcerpc_addr, ip_string);
+      pf_cmina_ip_to_string (msgs[msg_ix].addr, ip_string);
       dcerpc_resp_len = PF_MAX_UDP_PAYLOAD_SIZE;
       LOG_INFO (
          PF_RPC_LOG,
          "CMRPC(%d): Received %u bytes UDP payload from remote %s:%u, on "
          "socket %u for incoming DCE RPC requests.\n",
          __LINE__,
-         dcerpc_input_len,
+         msgs[msg_ix].len,
          ip_string,
-         dcerpc_port,
+         msgs[msg_ix].port,
          net->cmrpc_rpcreq_socket);
       close_socket = false;
       (void)pf_cmrpc_dce_packet (
          net,
-         dcerpc_addr,
-         dcerpc_port,
-         net->cmrpc_dcerpc_input_frame,
-         dcerpc_input_len,
+         msgs[msg_ix].addr,
+         msgs[msg_ix].port,
+         msgs[msg_ix].data,
+         msgs[msg_ix].len,
          net->cmrpc_dcerpc_output_frame,
          &dcerpc_resp_len,
          &close_socket);
@@ -5156,6 +5272,40 @@ void pf_cmrpc_periodic (pnet_t * net)
             __LINE__);
       }
    }
+
+   return more;
+}
+
+/**
+ * @internal
+ * Tell the application that datagrams have arrived on the watched sockets.
+ *
+ * This is a pnal_udp_watch_callback_t, called from the watching thread.
+ *
+ * @param arg              InOut: The p-net stack instance
+ */
+static void pf_cmrpc_watch_ind (void * arg)
+{
+   pf_fspm_rpc_ready_ind ((pnet_t *)arg);
+}
+
+void pf_cmrpc_periodic (pnet_t * net)
+{
+   if (net->cmrpc_watch == NULL)
+   {
+      (void)pf_cmrpc_recv_all (net);
+   }
+}
+
+void pf_cmrpc_handle_ready (pnet_t * net)
+{
+   /* The sockets are watched edge triggered, so whatever is left in them
+    * is not reported again. Ask to be called once more instead of staying
+    * here, so that a flood of requests does not hold up the tick. */
+   if (pf_cmrpc_recv_all (net))
+   {
+      pf_fspm_rpc_ready_ind (net);
+   }
 }
 
 /*********************** Initialize ******************************************/
@@ -5173,8 +5323,23 @@ void pf_cmrpc_init (pnet_t * net)
       {
          net->cmrpc_session_info[ix].socket = -1;
       }
+      net->cmrpc_rpcreq_socket = -1;
+
+      if (net->fspm_cfg.rpc_ready_cb != NULL)
+      {
+         net->cmrpc_watch = pf_udp_watch_init (net, pf_cmrpc_watch_ind, net);
+         if (net->cmrpc_watch == NULL)
+         {
+            LOG_INFO (
+               PF_RPC_LOG,
+               "CMRPC(%d): The RPC sockets can not be watched, they are "
+               "polled instead.\n",
+               __LINE__);
+         }
+      }
 
-      net->cmrpc_rpcreq_socket = pf_udp_open (net, PF_RPC_SERVER_PORT);
+      net->cmrpc_rpcreq_socket =
+         pf_cmrpc_socket_open (net, PF_RPC_SERVER_PORT);
    }
 
    /* Save for later (put it into each session */
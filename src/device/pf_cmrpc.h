@@ -43,10 +43,18 @@ void pf_cmrpc_exit (pnet_t * net);
  * Handle periodic RPC tasks.
  * Check for DCE RPC requests.
  * Check for DCE RPC confirmations.
+ * Not done when the sockets are watched, see pf_cmrpc_handle_ready().
  * @param net              InOut: The p-net stack instance
  */
 void pf_cmrpc_periodic (pnet_t * net);
 
+/**
+ * Handle the DCE RPC requests and confirmations that have arrived on the
+ * watched sockets, when the application has been told of them.
+ * @param net              InOut: The p-net stack instance
+ */
+void pf_cmrpc_handle_ready (pnet_t * net);
+
 /**
  * Find an AR by its AREP.
  * @param net              InOut: The p-net stack instance
@@ -1424,3 +1424,11 @@ int pf_fspm_signal_led_ind (pnet_t * net, bool led_state)
 
    return ret;
 }
+
+void pf_fspm_rpc_ready_ind (pnet_t * net)
+{
+   if (net->fspm_cfg.rpc_ready_cb != NULL)
+   {
+      net->fspm_cfg.rpc_ready_cb (net, net->fspm_cfg.cb_arg);
+   }
+}
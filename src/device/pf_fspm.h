@@ -324,6 +324,17 @@ void pf_fspm_reset_ind (
  */
 int pf_fspm_signal_led_ind (pnet_t * net, bool led_state);
 
+/**
+ * Call user call-back when RPC datagrams have arrived.
+ *
+ * This uses the \a pnet_rpc_ready_ind() callback. It is called from the
+ * thread watching the RPC sockets, and from pf_cmrpc_handle_ready() when
+ * datagrams are left in them.
+ *
+ * @param net                       InOut: The p-net stack instance
+ */
+void pf_fspm_rpc_ready_ind (pnet_t * net);
+
 /**
  * Retrieve a pointer to the current configuration data.
  * @param net              InOut: The p-net stack instance
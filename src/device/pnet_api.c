@@ -174,6 +174,11 @@ void pnet_handle_periodic (pnet_t * net)
 #endif
 }
 
+void pnet_handle_rpc (pnet_t * net)
+{
+   pf_cmrpc_handle_ready (net);
+}
+
 void pnet_show (pnet_t * net, unsigned level)
 {
    if (net != NULL)
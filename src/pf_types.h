@@ -37,6 +37,37 @@ extern "C" {
 #endif
 #define ATOMIC_VAR_INIT(x) x
 
+#if defined (__GNUC__)
+/* Sequentially consistent, as those of stdatomic.h */
+#ifdef atomic_fetch_add
+#undef atomic_fetch_add
+#endif
+static inline uint32_t atomic_fetch_add (atomic_int * p, uint32_t v)
+{
+   return __atomic_fetch_add (p, v, __ATOMIC_SEQ_CST);
+}
+#ifdef atomic_fetch_sub
+#undef atomic_fetch_sub
+#endif
+static inline uint32_t atomic_fetch_sub (atomic_int * p, uint32_t v)
+{
+   return __atomic_fetch_sub (p, v, __ATOMIC_SEQ_CST);
+}
+#ifdef atomic_load
+#undef atomic_load
+#endif
+static inline uint32_t atomic_load (atomic_int * p)
+{
+   return __atomic_load_n (p, __ATOMIC_SEQ_CST);
+}
+#ifdef atomic_store
+#undef atomic_store
+#endif
+static inline void atomic_store (atomic_int * p, uint32_t v)
+{
+   __atomic_store_n (p, v, __ATOMIC_SEQ_CST);
+}
+#else
 #ifdef atomic_fetch_add
 #undef atomic_fetch_add
 #endif
@@ -58,6 +89,7 @@ static inline uint32_t atomic_fetch_sub (atomic_int * p, uint32_t v)
    return prev;
 }
 #endif
+#endif
 
 #define PF_RPC_SERVER_PORT             0x8894 /* PROFInet Context Manager */
 #define PF_UDP_UNICAST_PORT            0x8892
@@ -1041,8 +1073,15 @@ typedef struct pf_alarm_receive_queue
 #define PF_MAX_SESSION (2 * (PNET_MAX_AR) + 1) /* 2 per AR, and one spare. */
 
 /*
- * Keep this value small as it define the number of entries in the
- * frame id map and all entries are probed until a match is found.
+ * Datagrams taken from an RPC socket at a time. Each takes an input buffer
+ * of PF_FRAME_BUFFER_SIZE in pnet_t. Set to 1 on targets short of memory.
+ */
+#ifndef PF_CMRPC_RECV_BATCH
+#define PF_CMRPC_RECV_BATCH 4
+#endif
+
+/*
+ * Number of entries in the frame id map.
  *
  * Each input CR may have 2 frameIds (for RTC3)
  * Add space for DCP:     0xfefc..0xfeff.
@@ -1051,6 +1090,24 @@ typedef struct pf_alarm_receive_queue
 #define PF_ETH_MAX_MAP                                                         \
    ((PNET_MAX_API) * (PNET_MAX_AR) * (PNET_MAX_CR)*2 + 4 + 2)
 
+/*
+ * Slots in an index of the frame id map, keyed by frame id modulo this.
+ * Over twice the entries, so that a lookup ends within a probe or two.
+ * Odd, so that frame ids a power of two apart do not collide.
+ */
+#define PF_ETH_ID_INDEX_SIZE (2 * (PF_ETH_MAX_MAP) + 1)
+
+/*
+ * Whether frame ids are looked up through the index, which the receive
+ * threads share without a lock, so only with real atomics. Without them
+ * the map is searched entry by entry, as it was before the index.
+ */
+#if PNET_USE_ATOMICS || defined (__GNUC__)
+#define PF_ETH_ID_INDEX 1
+#else
+#define PF_ETH_ID_INDEX 0
+#endif
+
 /**
  * The scheduler is used by both the CPM and PPM machines.
  * The DCP uses the scheduler for responding to multi-cast messages.
@@ -2948,6 +3005,16 @@ struct pnet
    /********** Profinet frame ID mapping **********/
 
    pf_eth_frame_id_map_t eth_id_map[PF_ETH_MAX_MAP];
+
+   /* Two indexes of eth_id_map, each slot 1 + an entry or 0 if empty.
+    * The receive threads use eth_id_index[eth_id_current] without a lock,
+    * while changes are made to the other one, which is then published.
+    * See pf_eth.c. */
+#if PF_ETH_ID_INDEX
+   uint16_t eth_id_index[2][PF_ETH_ID_INDEX_SIZE];
+   atomic_int eth_id_current;
+   atomic_int eth_id_readers[2];
+#endif
    volatile pf_scheduler_timeouts_t scheduler_timeouts[PF_MAX_TIMEOUTS];
    volatile uint32_t scheduler_timeout_first;
    volatile uint32_t scheduler_timeout_free;
@@ -2994,7 +3061,10 @@ struct pnet
    /** Main socket for incoming requests */
    int cmrpc_rpcreq_socket;
 
-   uint8_t cmrpc_dcerpc_input_frame[PF_FRAME_BUFFER_SIZE];
+   /** Watches the sockets, NULL if they are polled every tick */
+   pnal_udp_watch_t * cmrpc_watch;
+
+   uint8_t cmrpc_dcerpc_input_frame[PF_CMRPC_RECV_BATCH][PF_FRAME_BUFFER_SIZE];
    uint8_t cmrpc_dcerpc_output_frame[PF_FRAME_BUFFER_SIZE];
 
    /********** ALARM *********/
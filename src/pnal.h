@@ -417,6 +417,81 @@ int pnal_udp_recvfrom (
    uint8_t * data,
    int size);
 
+/**
+ * A UDP datagram, one of a batch received on a socket.
+ */
+typedef struct pnal_udp_msg
+{
+   pnal_ipaddr_t addr; /**< Source */
+   pnal_ipport_t port; /**< Source */
+   uint8_t * data;     /**< Buffer for the payload */
+   int size;           /**< Size of buffer */
+   int len;            /**< Out: Number of bytes received */
+} pnal_udp_msg_t;
+
+/**
+ * Receive the UDP datagrams waiting on a socket, up to a number of them.
+ *
+ * This is a nonblocking function, and it
+ * returns 0 immediately if no data is available.
+ *
+ * @param id               In:    Socket ID
+ * @param msgs             InOut: Buffers to receive into, filled in order
+ * @param count            In:    Number of buffers
+ * @return  The number of datagrams received, or -1 if an error occurred.
+ */
+int pnal_udp_recvmmsg (uint32_t id, pnal_udp_msg_t * msgs, int count);
+
+/**
+ * A set of UDP sockets watched for incoming datagrams, forward declaration.
+ */
+typedef struct pnal_udp_watch pnal_udp_watch_t;
+
+/**
+ * The prototype of UDP watch call-back functions.
+ *
+ * Called from the watching thread when a datagram has arrived on one of
+ * the watched sockets. It is called again only for datagrams arriving
+ * after that, so the sockets should be read until they are empty.
+ *
+ * @param arg              InOut: User-defined (may be NULL).
+ */
+typedef void (pnal_udp_watch_callback_t) (void * arg);
+
+/**
+ * Initialize watching of UDP sockets for incoming datagrams (in separate
+ * thread)
+ *
+ * @param pnal_cfg         In:    Operating system dependent configuration
+ * @param callback         In:    Callback for arrived datagrams
+ * @param arg              InOut: User argument passed to the callback
+ *
+ * @return  the watch handle, or NULL if an error occurred or the port
+ *          does not support it. The sockets must then be polled.
+ */
+pnal_udp_watch_t * pnal_udp_watch_init (
+   const pnal_cfg_t * pnal_cfg,
+   pnal_udp_watch_callback_t * callback,
+   void * arg);
+
+/**
+ * Start watching a UDP socket
+ *
+ * @param watch            InOut: Watch handle
+ * @param id               In:    Socket ID
+ * @return  0  if the operation succeeded.
+ *          -1 if an error occurred.
+ */
+int pnal_udp_watch_add (pnal_udp_watch_t * watch, uint32_t id);
+
+/**
+ * Stop watching a UDP socket. Done before the socket is closed.
+ *
+ * @param watch            InOut: Watch handle
+ * @param id               In:    Socket ID
+ */
+void pnal_udp_watch_remove (pnal_udp_watch_t * watch, uint32_t id);
+
 /**
  * Close an UDP socket
  *
@@ -104,7 +104,46 @@ int pnal_udp_recvfrom (
    return len;
 }
 
+int pnal_udp_recvmmsg (uint32_t id, pnal_udp_msg_t * msgs, int count)
+{
+   int ix;
+
+   for (ix = 0; ix < count; ix++)
+   {
+      msgs[ix].len = pnal_udp_recvfrom (
+         id,
+         &msgs[ix].addr,
+         &msgs[ix].port,
+         msgs[ix].data,
+         msgs[ix].size);
+      if (msgs[ix].len <= 0)
+      {
+         break;
+      }
+   }
+
+   return ix;
+}
+
 void pnal_udp_close (uint32_t id)
 {
    close (id);
 }
+
+pnal_udp_watch_t * pnal_udp_watch_init (
+   const pnal_cfg_t * pnal_cfg,
+   pnal_udp_watch_callback_t * callback,
+   void * arg)
+{
+   /* Not supported, the sockets are polled */
+   return NULL;
+}
+
+int pnal_udp_watch_add (pnal_udp_watch_t * watch, uint32_t id)
+{
+   return -1;
+}
+
+void pnal_udp_watch_remove (pnal_udp_watch_t * watch, uint32_t id)
+{
+}
@@ -1,8 +1,18 @@
+#define _GNU_SOURCE /* For O_DIRECT, sync_file_range() and fallocate() */
+
 #include "app_filelogger.h"
+#if LOGGER_USE_IO_URING
+#include "app_filelogger_uring.h"
+#endif
+#if LOGGER_USE_ZSTD
+#include "app_filelogger_zstd.h"
+#endif
 
 #include "app_data.h"
+#include "app_fileutils.h"
 #include "app_gsdml.h"
 #include "app_log.h"
+#include "app_logcatalog.h"
 #include "logger_common.h"
 
 #include "osal.h"
@@ -22,26 +32,175 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
+#include <poll.h>
+#include <time.h>
 #include <dirent.h>
 #include <errno.h>
 
-static os_mutex_t *mutex;
+/* initialiseLoggerThread is only ever run once, whether or not it works */
+typedef enum logger_state
+{
+	LOGGER_NOT_STARTED,
+	LOGGER_RUNNING,
+	LOGGER_FAILED
+} logger_state_t;
+
+static logger_state_t loggerState = LOGGER_NOT_STARTED;
+static os_thread_t *log_thread;
 static os_sem_t *finishDataSemaphore;
 static entry_buffer_t entries;
 static bool bigendian = true;
+static char logDirectory[PATH_MAX] = LOG_DIRECTORY;
+/*
+The next log is created ahead of time by the housekeeping thread,
+so that starting it at rollover needs no I/O.
+Whoever the state says owns the spare may touch it:
+the logging thread when it is EMPTY or READY, otherwise the housekeeping thread.
+Those two states are left by compare and swap, as discardSpare may take them at exit.
+*/
+typedef enum spare_state
+{
+	SPARE_EMPTY,
+	SPARE_REQUESTED, /* create a log for timeframe */
+	SPARE_READY,     /* file holds a log for timeframe */
+	SPARE_REPLACE,   /* delete file, which went unused, then create a log for timeframe */
+	SPARE_DISCARDED  /* the process is exiting, no more spares */
+} spare_state_t;
+
+static struct
+{
+	atomic_int state;
+	DTL_data_t timeframe;
+	log_file_t file;
+} spare = { .file = { .fd = -1 } };
+
+/*
+Work handed from the logging thread to the housekeeping thread, in order.
+A job belongs to the housekeeping thread from when it is posted until it
+clears busy, after which the logging thread may claim it again.
+*/
+typedef enum housekeeping_type
+{
+	HOUSEKEEPING_FINISH,      /* finish log_file, then check space */
+	HOUSEKEEPING_CHECK_SPACE, /* delete old logs if space is running out */
+	HOUSEKEEPING_PREPARE,     /* act on the spare's state */
+	HOUSEKEEPING_ARCHIVE,     /* start archiving day */
+	HOUSEKEEPING_CLOSE,       /* close a log whose writes are done, see closeFinishedLog */
+	HOUSEKEEPING_STOP         /* logging did not start after all, free the queue and end */
+} housekeeping_type_t;
+
+typedef struct housekeeping_job
+{
+	atomic_bool busy;
+	housekeeping_type_t type;
+	log_file_t log_file;
+	DTL_data_t day;
+	/* for HOUSEKEEPING_CLOSE */
+	int fd;
+	off_t length;
+	bool flush;
+	log_catalog_record_t record;
+} housekeeping_job_t;
+
+static housekeeping_job_t jobs[HOUSEKEEPING_JOBS];
+static os_mbox_t *housekeepingQueue;
+
+/*
+The catalog of the log directory, see app_logcatalog.h. Logs are started,
+finished, archived and deleted from different threads, so it is only
+touched with catalogMutex held. Without it, rotation and archiving go
+through the directory as they find it.
+*/
+static log_catalog_t catalog = { .dir_fd = -1, .fd = -1 };
+static os_mutex_t *catalogMutex;
+static bool catalogOpen = false;
+
+/*
+Days with logs still open, from startLogFile until logClosed. A handed off
+log is open until housekeeping has finished it, and an io_uring log until
+its queued writes and sync are done, so the archiver checks here instead
+of counting on its job coming after theirs.
+*/
+typedef struct open_day
+{
+	uint32_t date;
+	unsigned int logs;
+} open_day_t;
+
+static open_day_t openDays[OPEN_DAYS_MAX];
+static os_mutex_t *openDaysMutex;
+
+/*
+Deleting days and archiving them go through rotationMutex, so neither
+works on a day the other has. A day is deleted with it held, and only if
+it has no logs open and is not being archived; archiving claims its day
+(archivingDate, yyyymmdd) with it held, once the day's logs are closed.
+Taken before catalogMutex and openDaysMutex.
+*/
+static os_mutex_t *rotationMutex;
+static uint32_t archivingDate = 0;
+
+static log_policy_t policy = {
+	.wake_entries = LOG_WAKE_ENTRIES,
+	.max_latency_ms = LOG_MAX_LATENCY_MS,
+	.use_io_uring = false,
+	.direct_block_size = 0,
+	.sync_interval = 0,
+	.compression_level = LOG_COMPRESSION_LEVEL,
+	.format = LOG_FORMAT_PLAIN,
+};
+
+/* compact records, encoded by the logging thread on their way out; never larger than plain ones */
+_Static_assert(LOG_RECORD_SIZE == ENTRY_RECORD_SIZE, "record sizes differ");
+static uint8_t encoded[ENTRY_BUFFER_SIZE];
 
 static void log_thread_main(void * arg);
+static void waitForEntries(entry_buffer_t *entries, size_t tail, const struct timespec *due);
+static bool indexEntry(log_file_t *log_file, const uint8_t *record, off_t position);
+static int writeFully(int fd, const uint8_t *data, size_t length);
+static int writeFullyAt(int fd, const uint8_t *data, size_t length, off_t position);
+static void trimPartialWrite(log_file_t *log_file);
+static int stageBytes(log_file_t *log_file, const uint8_t *data, size_t length);
+static int stageRecord(log_file_t *log_file, const uint8_t *data, size_t length);
+static int flushBlock(log_file_t *log_file);
+static void flushDue(log_file_t *log_file);
+static void deadlineIn(struct timespec *deadline, uint32_t ms);
+static int msUntil(const struct timespec *deadline);
+static void syncWritten(log_file_t *log_file);
 static void archive_thread_main(void *arg);
+static void housekeeping_thread_main(void *arg);
+static housekeeping_job_t *claimJob(housekeeping_type_t type);
+static bool queueJob(housekeeping_job_t *job);
+static bool postJob(housekeeping_type_t type, log_file_t *log_file, DTL_data_t *day);
+static int closeLog(int fd, off_t length, bool flush, const log_catalog_record_t *record);
+static void beginLog(log_file_t *log_file, DTL_data_t *timeframe);
+static void handOffLog(log_file_t *log_file);
+static void discardSpare(void);
+static void openCatalog(void);
+static void trackLog(const char *name);
+static void untrackLog(const char *name);
+static bool dayHasOpenLogs(uint32_t date);
+static bool dayInUse(uint32_t date);
+static void catalogAddDay(const char *date);
+static void catalogArchived(const char *directory, const char *suffix);
+static void catalogDeleted(const char *name);
+static bool catalogOldest(char *name);
+static int catalogUnarchived(uint32_t through, char (**names)[LOG_CATALOG_NAME_SIZE]);
 
 int addLogEntry(
-	DTL_data_t *timestamp,
-	uint8_t *word_data,
+	const DTL_data_t *timestamp,
+	const uint8_t *word_data,
 	uint8_t word_count)
 {
-	if(mutex == NULL) {
-		/* entry buffer is not yet initialised */
-		initialiseLoggerThread(&entries);
+	if(loggerState != LOGGER_RUNNING) {
+		/* not started yet, unless it was and failed; nothing would drain the entry */
+		if(loggerState == LOGGER_FAILED || startLogger() == -1)
+			return -1;
 	}
 	
 	uint16_t year;
@@ -61,25 +220,22 @@ int addLogEntry(
 		return -1;
 	}
 	
-	/*
-	OSAL does not wrap pthread_mutex_timedlock
-	This is running on the important thread so we'd like to fail fairly quickly
-	Could write a wrapper, or just call directly w/ cast as that's all OSAL does
-	or just ensure the logging thread doesn't hold it for too long...
-	*/
-	os_mutex_lock(mutex);
-	
 	static unsigned int drop_count = 0;
 	static unsigned int next_logged_drop = 2;
+	/* last tail we saw, so a full-looking buffer is the only time we touch the consumer's cache line */
+	static size_t tail_cache = 0;
 	
-	if((entries.end + ENTRY_SIZE)%ENTRY_BUFFER_SIZE == entries.start) {
-		/*
-		"no more" room
-		strictly speaking one more will fit,
-		but will make the buffer look empty (start = end)
-		*/
-		os_mutex_unlock(mutex);
+	/* only this thread writes head */
+	size_t head = atomic_load_explicit(&entries.head, memory_order_relaxed);
+	
+	if(head - tail_cache >= ENTRY_BUFFER_COUNT) {
+		tail_cache = atomic_load_explicit(&entries.tail, memory_order_acquire);
+	}
+	
+	if(head - tail_cache >= ENTRY_BUFFER_COUNT) {
+		/* no more room, the logging thread has fallen behind */
 		++drop_count;
+		atomic_fetch_add_explicit(&entries.dropped, 1, memory_order_relaxed);
 		if(drop_count >= next_logged_drop) {
 			APP_LOG_WARNING("Data buffer full - dropped %u entries!\n", drop_count);
 			next_logged_drop *= 5;
@@ -94,34 +250,151 @@ int addLogEntry(
 		next_logged_drop = 2;
 	}
 	
-	size_t end = entries.end;
+	/* serialise straight into the record that will be written to file */
+	uint8_t *slot = entries.buffer[head % ENTRY_BUFFER_COUNT];
+	
+	slot[0] = 0;
+	memcpy(slot+1, &year, 2);
+	slot[3] = timestamp->month;
+	slot[4] = timestamp->day;
+	slot[5] = timestamp->weekday;
+	slot[6] = timestamp->hour;
+	slot[7] = timestamp->minute;
+	slot[8] = timestamp->second;
+	memcpy(slot+9, &nano, 4);
+	
+	memcpy(slot+13, word_data, 2*word_count);
+	
+	/*
+	publish the entry; this also orders the slot contents before the new head.
+	seq_cst pairs with waitForEntries so either we see its wake_at
+	or it sees our head before going to sleep.
+	*/
+	atomic_store_explicit(&entries.head, head + 1, memory_order_seq_cst);
+	
+	if(atomic_load_explicit(&entries.wake_at, memory_order_seq_cst) == head + 1) {
+		uint64_t one = 1;
+		/* non-blocking, and the counter cannot realistically overflow */
+		if(write(entries.wake_fd, &one, sizeof(one)) == -1) {
+			APP_LOG_DEBUG("Could not wake logging thread\n");
+		}
+	}
+	
+	return 0;
+}
+
+int setLogPolicy(const log_policy_t *new_policy)
+{
+	if(new_policy->wake_entries == 0 || new_policy->wake_entries > ENTRY_BUFFER_COUNT) {
+		APP_LOG_ERROR("Wakeup threshold must be 1-%d entries\n", ENTRY_BUFFER_COUNT);
+		return -1;
+	}
+	
+	if(loggerState != LOGGER_NOT_STARTED) {
+		APP_LOG_ERROR("Logging policy must be set before logging starts\n");
+		return -1;
+	}
+	
+	if(new_policy->use_io_uring && !LOGGER_USE_IO_URING) {
+		APP_LOG_ERROR("Not built with io_uring support (LOGGER_OPTION_IO_URING)\n");
+		return -1;
+	}
+	
+	if(new_policy->direct_block_size % LOG_DIRECT_ALIGN != 0 || new_policy->direct_block_size > LOG_DIRECT_BLOCK_MAX) {
+		APP_LOG_ERROR("Direct block size must be a multiple of %d up to %d bytes\n", LOG_DIRECT_ALIGN, LOG_DIRECT_BLOCK_MAX);
+		return -1;
+	}
+	
+	/* both of these rely on the logging thread doing the writes itself */
+	if(new_policy->use_io_uring && (new_policy->direct_block_size != 0 || new_policy->sync_interval != 0)) {
+		APP_LOG_ERROR("Direct writes and writeback cadence need blocking I/O, not io_uring\n");
+		return -1;
+	}
+	
+	if(new_policy->format != LOG_FORMAT_PLAIN && new_policy->format != LOG_FORMAT_COMPACT) {
+		APP_LOG_ERROR("Log format must be %d or %d\n", LOG_FORMAT_PLAIN, LOG_FORMAT_COMPACT);
+		return -1;
+	}
 	
-	memcpy(entries.buffer+end, &year, 2);
-	entries.buffer[end+2] = timestamp->month;
-	entries.buffer[end+3] = timestamp->day;
-	entries.buffer[end+4] = timestamp->weekday;
-	entries.buffer[end+5] = timestamp->hour;
-	entries.buffer[end+6] = timestamp->minute;
-	entries.buffer[end+7] = timestamp->second;
-	memcpy(entries.buffer+end+8, &nano, 4);
+	/* io_uring writes straight from the entry buffer, so there is nowhere to encode */
+	if(new_policy->use_io_uring && new_policy->format == LOG_FORMAT_COMPACT) {
+		APP_LOG_ERROR("Compact logs need blocking I/O, not io_uring\n");
+		return -1;
+	}
 	
-	memcpy(entries.buffer+end+12, word_data, 2*word_count);
+	if(new_policy->direct_block_size != 0 && new_policy->sync_interval != 0) {
+		APP_LOG_ERROR("Writeback cadence does not apply to direct writes\n");
+		return -1;
+	}
 	
-	entries.end = (entries.end + ENTRY_SIZE) % ENTRY_BUFFER_SIZE;
+	if(new_policy->compression_level != policy.compression_level && !LOGGER_USE_ZSTD) {
+		APP_LOG_ERROR("Not built with zstd support (LOGGER_OPTION_ZSTD)\n");
+		return -1;
+	}
 	
-	os_mutex_unlock(mutex);
+	policy = *new_policy;
 	
 	return 0;
 }
 
 int initialiseLoggerThread(entry_buffer_t *entries)
 {
-	/*
-	os_timer_create will start a thread to run something at an interval
-	*/
-	mutex = os_mutex_create();
+	atomic_init(&entries->head, 0);
+	atomic_init(&entries->tail, 0);
+	atomic_init(&entries->wake_at, SIZE_MAX);
+	atomic_init(&entries->dropped, 0);
+	atomic_init(&entries->low_space, 0);
+	atomic_init(&entries->peak, 0);
+	entries->running_low = false;
+	
+	entries->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(entries->wake_fd == -1) {
+		APP_LOG_ERROR("Failed to create logging thread wakeup\n");
+		return -1;
+	}
+	
+#if LOGGER_USE_IO_URING
+	if(policy.use_io_uring && uringLogInit(entries) == -1) {
+		APP_LOG_WARNING("Falling back to blocking log writes\n");
+		policy.use_io_uring = false;
+	}
+#endif
+	
+	openDaysMutex = os_mutex_create();
+	rotationMutex = os_mutex_create();
+	if(openDaysMutex == NULL || rotationMutex == NULL) {
+		APP_LOG_ERROR("Failed to create the open log and rotation locks\n");
+		goto error;
+	}
+	
+	atomic_init(&spare.state, SPARE_EMPTY);
+	for(int i = 0; i < HOUSEKEEPING_JOBS; i++) {
+		atomic_init(&jobs[i].busy, false);
+	}
+	
+	housekeepingQueue = os_mbox_create(HOUSEKEEPING_JOBS);
+	
+	os_thread_t *housekeeping_thread = NULL;
+	if(housekeepingQueue != NULL) {
+		housekeeping_thread = os_thread_create(
+			"log_housekeeping_thread",
+			HOUSEKEEPING_PRIORITY,
+			HOUSEKEEPING_STACKSIZE,
+			housekeeping_thread_main,
+			housekeepingQueue
+		);
+	}
+	
+	if(housekeeping_thread == NULL) {
+		/* the logging thread will have to do it all itself */
+		APP_LOG_WARNING("Failed to start log housekeeping thread\n");
+		if(housekeepingQueue != NULL) {
+			os_mbox_destroy(housekeepingQueue);
+			housekeepingQueue = NULL;
+		}
+	}
 	
-	os_thread_create(
+	log_thread = os_thread_create(
 		"logger_thread",
 		LOG_THREAD_PRIORITY,
 		LOG_THREAD_STACKSIZE,
@@ -129,9 +402,98 @@ int initialiseLoggerThread(entry_buffer_t *entries)
 		(void *) entries
 	);
 	
+	if(log_thread == NULL) {
+		APP_LOG_ERROR("Failed to start logging thread\n");
+		goto error;
+	}
+	
+	atexit(discardSpare);
+	
+	return 0;
+	
+error:
+	/* undone, as it is not tried again */
+	if(housekeepingQueue != NULL) {
+		/* the thread takes the queue with it */
+		postJob(HOUSEKEEPING_STOP, NULL, NULL);
+		housekeepingQueue = NULL;
+	}
+	if(openDaysMutex != NULL) {
+		os_mutex_destroy(openDaysMutex);
+		openDaysMutex = NULL;
+	}
+	if(rotationMutex != NULL) {
+		os_mutex_destroy(rotationMutex);
+		rotationMutex = NULL;
+	}
+#if LOGGER_USE_IO_URING
+	if(policy.use_io_uring) {
+		uringLogExit();
+	}
+#endif
+	close(entries->wake_fd);
+	entries->wake_fd = -1;
+	
+	return -1;
+}
+
+int startLogger(void)
+{
+	if(loggerState == LOGGER_NOT_STARTED) {
+		loggerState = (initialiseLoggerThread(&entries) == 0) ? LOGGER_RUNNING : LOGGER_FAILED;
+	}
+	
+	return (loggerState == LOGGER_RUNNING) ? 0 : -1;
+}
+
+int setLogDirectory(const char *path)
+{
+	if(loggerState != LOGGER_NOT_STARTED) {
+		APP_LOG_ERROR("Log directory must be set before logging starts\n");
+		return -1;
+	}
+	
+	if(strlen(path) >= sizeof(logDirectory)) {
+		APP_LOG_ERROR("Log directory path is too long\n");
+		return -1;
+	}
+	
+	strcpy(logDirectory, path);
+	
 	return 0;
 }
 
+void getLogBufferStats(log_buffer_stats_t *stats)
+{
+	stats->dropped   = atomic_load_explicit(&entries.dropped, memory_order_relaxed);
+	stats->low_space = atomic_load_explicit(&entries.low_space, memory_order_relaxed);
+	stats->peak      = atomic_load_explicit(&entries.peak, memory_order_relaxed);
+	/* written first, so it never appears ahead of added */
+	stats->written   = atomic_load_explicit(&entries.tail, memory_order_acquire);
+	stats->added     = atomic_load_explicit(&entries.head, memory_order_acquire);
+}
+
+/* note how full the buffer is, given the latest head */
+static void checkBufferSpace(entry_buffer_t *entries, size_t head)
+{
+	/* slots are only free once written, which with io_uring may be behind our own tail */
+	size_t pending = head - atomic_load_explicit(&entries->tail, memory_order_relaxed);
+	
+	if(pending > atomic_load_explicit(&entries->peak, memory_order_relaxed)) {
+		atomic_store_explicit(&entries->peak, pending, memory_order_relaxed);
+	}
+	
+	if(!entries->running_low && ENTRY_BUFFER_COUNT - pending < ENTRY_BUFFER_LOW_SPACE) {
+		entries->running_low = true;
+		atomic_fetch_add_explicit(&entries->low_space, 1, memory_order_relaxed);
+		APP_LOG_DEBUG("Entry buffer running low, %u entries pending\n", (unsigned)pending);
+	}
+	/* only count it again once it has properly recovered */
+	else if(entries->running_low && pending < ENTRY_BUFFER_COUNT/2) {
+		entries->running_low = false;
+	}
+}
+
 void log_thread_main(void * arg)
 {
 	entry_buffer_t * entries = (entry_buffer_t *)arg;
@@ -141,19 +503,29 @@ void log_thread_main(void * arg)
 	
 	APP_LOG_DEBUG("\e[92mLogging thread active\e[0m\n");
 	
+	/* here, not on the thread that started the logger, as it goes through the whole log directory */
+	openCatalog();
+	
+	/*
+	next entry to look at; entries->tail follows behind it as they are written,
+	which with io_uring may be some time later
+	*/
+	size_t tail = atomic_load_explicit(&entries->tail, memory_order_relaxed);
+	
 	while(true) {
-		os_mutex_lock(mutex);
+		/* acquire pairs with the release in addLogEntry, so the slots up to head are complete */
+		size_t head = atomic_load_explicit(&entries->head, memory_order_acquire);
+		
+		checkBufferSpace(entries, head);
+		
+		/* entries from unwritten onwards are still waiting for write */
+		size_t unwritten = tail;
 		
 		/* make sure this loop is not unnecesarily slow (e.g. waits on I/O) */
-		while(entries->start != entries->end) {
-			if(entries->start % ENTRY_SIZE != 0) {
-				APP_LOG_ERROR("Log buffer does not start on an entry! %u, offset %u\n",
-					entries->start, entries->start % ENTRY_SIZE);
-				/* this doesn't happen anyway but repeating an entry (with timestamp) can't hurt */
-				entries->start = (entries->start / ENTRY_SIZE) * ENTRY_SIZE;
-			}
+		for(; tail != head; ++tail) {
 			DTL_data_t entry_ts;
-			uint8_t *entry =  entries->buffer + entries->start;
+			/* skip the record's 0 prefix */
+			uint8_t *entry = entries->buffer[tail % ENTRY_BUFFER_COUNT] + 1;
 			
 			/* investigate the timestamp */
 			memcpy(&entry_ts.year, entry, 2);
@@ -169,144 +541,1053 @@ void log_thread_main(void * arg)
 			If not, wrap it up and start a new one
 			*/
 			if(!DTLs_for_same_log(&curr_log_start, &entry_ts)) {
-				/* release the lock, so we can do IO in peace */
-				os_mutex_unlock(mutex);
-				
 				if(current_log.fd >= 0) {
-					finishLogFile(&current_log, true);
-				}
-				
-				int ret;
-				
-				/* delete old files if not much space is available */
-				struct statvfs statbuf;
-				ret = fstatvfs(getLogDir(), &statbuf);
-				if(ret == 0 && 100 * statbuf.f_bfree / statbuf.f_blocks < FREE_SPACE_PERCENT) {
-					APP_LOG_INFO("\e[33m%lu/%lu\e[0m blocks available, clearing space...\n", statbuf.f_bfree, statbuf.f_blocks);
-					deleteOldest();
+					writeLogEntries(&current_log, entries, unwritten, tail);
+					unwritten = tail;
+					
+					current_log.dropped = atomic_load_explicit(&entries->dropped, memory_order_relaxed) - current_log.dropped;
+					handOffLog(&current_log);
 				}
 				
+				DTL_data_t prev_log_start = curr_log_start;
 				curr_log_start = entry_ts;
-				ret = startLogFile(&current_log, &curr_log_start);
-				while(ret == -1) {
-					APP_LOG_WARNING("Failed to start log, retrying\n");
-					os_usleep(500);
-					ret = startLogFile(&current_log, &curr_log_start);
-				}
+				beginLog(&current_log, &curr_log_start);
+				current_log.dropped = atomic_load_explicit(&entries->dropped, memory_order_relaxed);
 				
-				/* ready to process again */
-				os_mutex_lock(mutex);
-			}
-			
-			if(current_log.fd == -1) {
-				APP_LOG_ERROR("No file?\n");
-				break;
-			}
-			
-			if(current_log.buf_end + (ENTRY_SIZE + 1) >= FILE_BUFFER_SIZE) {
-				int remaining = ((entries->end - entries->start) % ENTRY_BUFFER_SIZE) / ENTRY_SIZE;
-				/* Not losing anything yet, but the buffer needs something cleared before copying any more */
-				APP_LOG_WARNING("File buffer running low (\e[33m%d\e[0m/%d), leaving \e[93m%d\e[0m/%d entries\n",
-					current_log.buf_end, FILE_BUFFER_SIZE, remaining, ENTRY_BUFFER_SIZE / ENTRY_SIZE);
-				break;
+				/*
+				Queued after the old log is finished and any unused spare
+				from that day deleted, so the day is complete
+				*/
+				if(prev_log_start.year != 0
+					&& (prev_log_start.day != entry_ts.day
+					|| prev_log_start.month != entry_ts.month
+					|| prev_log_start.year != entry_ts.year)) {
+					postJob(HOUSEKEEPING_ARCHIVE, NULL, &prev_log_start);
+				}
 			}
-			
-			/* file format includes 0 before each entry */
-			current_log.buffer[current_log.buf_end] = 0;
-			memcpy(current_log.buffer +current_log.buf_end+1, entry, ENTRY_SIZE);
-			current_log.buf_end += (ENTRY_SIZE + 1);
-
-			entries->start = (entries->start + ENTRY_SIZE) % ENTRY_BUFFER_SIZE;
 		}
 		
-		os_mutex_unlock(mutex);
-		
-		/* write log if buffer is long enough */
-		if(current_log.fd != -1) {
-			size_t start = 0;
-			
-			while(current_log.buf_end - start >= FILE_MIN_WRITE) {
-				ssize_t written = write(current_log.fd, current_log.buffer + start, current_log.buf_end - start);
-				if(written == -1) {
-					if(errno == EDQUOT || errno == ENOSPC) {
-						APP_LOG_WARNING("Write failed, clearing space...\n");
-						deleteOldest();
-					}
-					continue;
-				}
-				start += written;
-			}
-				
-			memmove(current_log.buffer, current_log.buffer + start, current_log.buf_end - start);
-			
-			current_log.buf_end -= start;
+		/* write out everything that has been collected, straight from the entry buffer */
+		if(current_log.fd != -1 && unwritten != tail) {
+			writeLogEntries(&current_log, entries, unwritten, tail);
 		}
 		
+		/* entries staged for a direct write go out in time even if the block is not full */
+		flushDue(&current_log);
+		bool staged = (current_log.fd != -1 && current_log.direct
+			&& current_log.block_used != current_log.block_written);
+		
 		/*
-		This really needs to wait on an entry in the entry buffer,
-		clearing it as soon as there's something to use and CPU time to do it.
-		The main thread has priority so it will always be allowed to add entries
-		so long as we do not hold the mutex.
-		Lock-free queue (using atomics) could be good.
+		The main thread never waits on us, so it can keep adding entries
+		while we sleep or block on I/O.
 		*/
-		os_usleep(2000);
+		waitForEntries(entries, tail, staged ? &current_log.block_due : NULL);
 	}
 }
 
-bool DTLs_for_same_log(DTL_data_t *ts_1, DTL_data_t *ts_2)
+/* the timeframe of the log after the one containing ts */
+static void nextLogTimeframe(const DTL_data_t *ts, DTL_data_t *next)
 {
-	if(    ts_1->minute/10 == ts_2->minute/10
-		&& ts_1->hour == ts_2->hour
-		&& ts_1->day == ts_2->day
-		&& ts_1->month == ts_2->month
-		&& ts_1->year == ts_2->year
-	) {
-		return true;
+	struct tm tm = {
+		.tm_year = ts->year - 1900,
+		.tm_mon  = ts->month - 1,
+		.tm_mday = ts->day,
+		.tm_hour = ts->hour,
+		.tm_min  = 10*(ts->minute/10) + 10,
+	};
+	
+	/* the PLC's clock has no zone, this is just to carry into the next hour/day/month */
+	time_t t = timegm(&tm);
+	gmtime_r(&t, &tm);
+	
+	*next = (DTL_data_t) {
+		.year   = tm.tm_year + 1900,
+		.month  = tm.tm_mon + 1,
+		.day    = tm.tm_mday,
+		.hour   = tm.tm_hour,
+		.minute = tm.tm_min,
+	};
+}
+
+/* open the log for timeframe, using the spare if it was prepared for it, and ask for the next one */
+void beginLog(log_file_t *log_file, DTL_data_t *timeframe)
+{
+	int state = atomic_load_explicit(&spare.state, memory_order_acquire);
+	
+	if(state == SPARE_READY && DTLs_for_same_log(&spare.timeframe, timeframe)
+		&& atomic_compare_exchange_strong(&spare.state, &state, SPARE_EMPTY)) {
+		/* the spare takes over, along with its direct block */
+		free(log_file->block);
+		*log_file = spare.file;
+		spare.file.fd = -1;
+		spare.file.block = NULL;
+		
+		state = SPARE_EMPTY;
 	}
 	else {
+		/* no luck, do it the slow way */
+		while(startLogFile(log_file, timeframe) == -1) {
+			APP_LOG_WARNING("Failed to start log, retrying\n");
+			os_usleep(500);
+		}
+	}
+	
+#if LOGGER_USE_IO_URING
+	if(log_file->use_uring) {
+		uringLogOpen(log_file);
+	}
+#endif
+	
+	APP_LOG_INFO("Started %s\n", log_file->name);
+	
+	/* while the preparation thread is busy, leave it be and check the outcome at the next rollover */
+	if(state != SPARE_EMPTY && state != SPARE_READY)
+		return;
+	
+	DTL_data_t next;
+	nextLogTimeframe(timeframe, &next);
+	
+	if(state == SPARE_READY && DTLs_for_same_log(&spare.timeframe, &next))
+		return;
+	
+	spare.timeframe = next;
+	int request = (state == SPARE_READY) ? SPARE_REPLACE : SPARE_REQUESTED;
+	if(!atomic_compare_exchange_strong(&spare.state, &state, request))
+		return;
+	
+	if(!postJob(HOUSEKEEPING_PREPARE, NULL, NULL)) {
+		/* take it back, nothing will act on it */
+		atomic_compare_exchange_strong(&spare.state, &request, state);
+	}
+}
+
+/*
+Pass the finished log to the housekeeping thread, leaving log_file free for the next one.
+Only the descriptor and direct block change hands, so this costs no I/O.
+*/
+void handOffLog(log_file_t *log_file)
+{
+#if LOGGER_USE_IO_URING
+	/* already asynchronous, and io_uring is only driven from this thread */
+	if(log_file->use_uring) {
+		finishLogFile(log_file, true);
+		postJob(HOUSEKEEPING_CHECK_SPACE, NULL, NULL);
+		return;
+	}
+#endif
+	
+	if(postJob(HOUSEKEEPING_FINISH, log_file, NULL)) {
+		log_file->fd = -1;
+		log_file->block = NULL;
+		return;
+	}
+	
+	APP_LOG_WARNING("Housekeeping has fallen behind, finishing log here\n");
+	finishLogFile(log_file, true);
+}
+
+/* a free job for the housekeeping thread to be filled in, NULL if it cannot take any more */
+housekeeping_job_t *claimJob(housekeeping_type_t type)
+{
+	if(housekeepingQueue == NULL)
+		return NULL;
+	
+	for(int i = 0; i < HOUSEKEEPING_JOBS; i++) {
+		housekeeping_job_t *job = &jobs[i];
+		
+		/* acquire, so its previous use is over */
+		if(atomic_load_explicit(&job->busy, memory_order_acquire))
+			continue;
+		
+		job->type = type;
+		atomic_store_explicit(&job->busy, true, memory_order_relaxed);
+		
+		return job;
+	}
+	
+	return NULL;
+}
+
+/* pass a claimed job to the housekeeping thread, false if that failed */
+bool queueJob(housekeeping_job_t *job)
+{
+	/* never waits, there is room for every job */
+	if(os_mbox_post(housekeepingQueue, job, 0)) {
+		atomic_store_explicit(&job->busy, false, memory_order_relaxed);
 		return false;
 	}
+	
+	return true;
 }
 
-int getLogDir() {
-	static int logdir_fd = -1;
-	int ret;
+/* queue a job for the housekeeping thread, false if it cannot take any more */
+bool postJob(housekeeping_type_t type, log_file_t *log_file, DTL_data_t *day)
+{
+	housekeeping_job_t *job = claimJob(type);
+	if(job == NULL)
+		return false;
 	
-	if(logdir_fd != -1)
-		return logdir_fd;
+	if(log_file != NULL) {
+		job->log_file = *log_file;
+	}
+	if(day != NULL) {
+		job->day = *day;
+	}
 	
-	ret = open("/var/opt/pnlogger/data", O_DIRECTORY);
-	if(ret == -1) {
-		APP_LOG_ERROR("Failed to open /var/opt/pnlogger/data\n");
-		return -1;
+	return queueJob(job);
+}
+
+void closeFinishedLog(int fd, off_t length, bool flush, const log_catalog_record_t *record)
+{
+	housekeeping_job_t *job = claimJob(HOUSEKEEPING_CLOSE);
+	if(job != NULL) {
+		job->fd = fd;
+		job->length = length;
+		job->flush = flush;
+		job->record = *record;
+		
+		if(queueJob(job))
+			return;
 	}
 	
-	logdir_fd = ret;
+	APP_LOG_WARNING("Housekeeping has fallen behind, closing log here\n");
+	closeLog(fd, length, flush, record);
+}
+
+/* delete the oldest logs until there is enough space, or nothing left to delete */
+static void clearSpace(void)
+{
+	struct statvfs statbuf;
+	int ret = fstatvfs(getLogDir(), &statbuf);
 	
-	return logdir_fd;
+	while(ret == 0 && 100 * statbuf.f_bfree / statbuf.f_blocks < FREE_SPACE_PERCENT) {
+		APP_LOG_INFO("\e[33m%lu/%lu\e[0m blocks available, clearing space...\n", statbuf.f_bfree, statbuf.f_blocks);
+		if(deleteOldest() == -1)
+			break;
+		
+		ret = fstatvfs(getLogDir(), &statbuf);
+	}
 }
 
-DIR *openLogDir() {
-	int logdir_fd = getLogDir();
-	if(logdir_fd == -1)
-		return NULL;
+/* delete the log the spare holds, which went unused and only has a header */
+static void deleteSpareFile(void)
+{
+	close(spare.file.fd);
+	spare.file.fd = -1;
+	untrackLog(spare.file.name);
+	if(unlinkat(getLogDir(), spare.file.name, 0) == -1) {
+		APP_LOG_WARNING("Failed to delete unused %s\n", spare.file.name);
+	}
+	else {
+		APP_LOG_DEBUG("Deleted unused %s\n", spare.file.name);
+	}
+}
+
+/*
+At exit, delete the spare if it is ready, as it is preallocated to the
+full size of a log. One still being prepared is left to the housekeeping
+thread, which can not be waited for here.
+*/
+static void discardSpare(void)
+{
+	int state = SPARE_READY;
 	
-	int fd = openat(logdir_fd, ".", O_DIRECTORY);
-	if(fd == -1)
-		return NULL;
+	if(atomic_compare_exchange_strong(&spare.state, &state, SPARE_DISCARDED)) {
+		deleteSpareFile();
+		return;
+	}
 	
-	DIR *logdir = fdopendir(fd);
-	if(logdir == NULL)
-		return NULL;
+	/* so the logging thread asks for no more */
+	state = SPARE_EMPTY;
+	atomic_compare_exchange_strong(&spare.state, &state, SPARE_DISCARDED);
+}
+
+/* create the log the spare was asked for, first deleting the one it had if it went unused */
+static void prepareSpare(void)
+{
+	int state = atomic_load_explicit(&spare.state, memory_order_acquire);
 	
-	return logdir;
+	if(state == SPARE_REPLACE) {
+		/* the clock must have jumped */
+		deleteSpareFile();
+	}
+	else if(state != SPARE_REQUESTED) {
+		return;
+	}
+	
+	if(startLogFile(&spare.file, &spare.timeframe) == -1) {
+		APP_LOG_WARNING("Could not prepare the next log\n");
+		atomic_store_explicit(&spare.state, SPARE_EMPTY, memory_order_release);
+		return;
+	}
+	
+	APP_LOG_DEBUG("Prepared %s\n", spare.file.name);
+	atomic_store_explicit(&spare.state, SPARE_READY, memory_order_release);
 }
 
-int startLogFile(log_file_t *log_file, DTL_data_t *timeframe)
+void housekeeping_thread_main(void *arg)
 {
-	/* reusing log_file because the buffers are large */
-	log_file->buf_end = 0;
+	os_mbox_t *queue = arg;
 	
+	while(true) {
+		housekeeping_job_t *job;
+		
+		if(os_mbox_fetch(queue, (void **)&job, OS_WAIT_FOREVER))
+			continue;
+		
+		switch(job->type) {
+		case HOUSEKEEPING_FINISH:
+			if(finishLogFile(&job->log_file, true) == -1) {
+				APP_LOG_WARNING("Could not finish %s\n", job->log_file.name);
+			}
+			free(job->log_file.block);
+			/* fallthrough */
+		case HOUSEKEEPING_CHECK_SPACE:
+			/* a log's worth of space is gone, see if any needs clearing */
+			clearSpace();
+			break;
+		case HOUSEKEEPING_ARCHIVE:
+			/* on a thread of its own, as it takes a while */
+			finishLogGroup(&job->day);
+			break;
+		case HOUSEKEEPING_CLOSE:
+			closeLog(job->fd, job->length, job->flush, &job->record);
+			break;
+		case HOUSEKEEPING_PREPARE:
+			prepareSpare();
+			break;
+		case HOUSEKEEPING_STOP:
+			/* no one else has the queue any more */
+			os_mbox_destroy(queue);
+			return;
+		}
+		
+		/* release, so the logging thread sees we are done with it */
+		atomic_store_explicit(&job->busy, false, memory_order_release);
+	}
+}
+
+int writeLogEntries(
+	log_file_t *log_file,
+	entry_buffer_t *entries,
+	size_t from,
+	size_t to)
+{
+	/* where the first of them lands in the log; direct logs index them as they are staged */
+	off_t position = log_file->offset;
+	uint32_t indexed = log_file->index_count;
+	
+	if(to != from) {
+		if(log_file->entries == 0) {
+			log_file->first = logCatalogTime(entries->buffer[from % ENTRY_BUFFER_COUNT] + 1, log_file->bigendian);
+		}
+		log_file->last = logCatalogTime(entries->buffer[(to - 1) % ENTRY_BUFFER_COUNT] + 1, log_file->bigendian);
+		log_file->entries += to - from;
+	}
+	
+	if(log_file->format == LOG_FORMAT_PLAIN && !log_file->direct) {
+		for(size_t i = from; i != to; ++i) {
+			indexEntry(log_file, entries->buffer[i % ENTRY_BUFFER_COUNT], position);
+			position += ENTRY_RECORD_SIZE;
+		}
+	}
+	
+#if LOGGER_USE_IO_URING
+	if(log_file->use_uring) {
+		return uringLogWriteEntries(log_file, entries, from, to);
+	}
+#endif
+	
+	size_t count = to - from;
+	
+	if(log_file->direct) {
+		/*
+		Gather them into whole blocks, then the slots are free. Each is
+		indexed where it is staged, as a failed block moves where the
+		ones after it land.
+		*/
+		int ret = 0;
+		for(size_t i = from; i != to; ++i) {
+			const uint8_t *record = entries->buffer[i % ENTRY_BUFFER_COUNT];
+			size_t length = ENTRY_RECORD_SIZE;
+			bool indexed = indexEntry(log_file, record, log_file->offset + log_file->block_used);
+			
+			if(log_file->format == LOG_FORMAT_COMPACT) {
+				/* readers start decoding at indexed entries, so those are keys */
+				if(indexed) {
+					logCodecReset(&log_file->codec);
+				}
+				length = logEncodeRecord(&log_file->codec, record, log_file->bigendian, encoded);
+				record = encoded;
+			}
+			
+			if(stageRecord(log_file, record, length) == -1) {
+				ret = -1;
+			}
+		}
+		
+		atomic_store_explicit(&entries->tail, to, memory_order_release);
+		
+		return ret;
+	}
+	
+	if(log_file->format == LOG_FORMAT_COMPACT) {
+		/* encode them all, then the slots are free */
+		size_t length = 0;
+		for(size_t i = from; i != to; ++i) {
+			const uint8_t *record = entries->buffer[i % ENTRY_BUFFER_COUNT];
+			
+			/* readers start decoding at indexed entries, so those are keys */
+			if(indexEntry(log_file, record, position + length)) {
+				logCodecReset(&log_file->codec);
+			}
+			length += logEncodeRecord(&log_file->codec, record, log_file->bigendian, encoded + length);
+		}
+		
+		atomic_store_explicit(&entries->tail, to, memory_order_release);
+		
+		if(writeFully(log_file->fd, encoded, length) == -1) {
+			APP_LOG_ERROR("Write failed, discarding %u entries\n", (unsigned)count);
+			trimPartialWrite(log_file);
+			/* the next entry can not follow on from ones that were lost */
+			logCodecReset(&log_file->codec);
+			log_file->index_count = indexed;
+			return -1;
+		}
+		log_file->offset += length;
+		
+		syncWritten(log_file);
+		
+		return 0;
+	}
+	
+
+	size_t first = from % ENTRY_BUFFER_COUNT;
+	/* the entries may wrap around the end of the buffer */
+	size_t before_wrap = (count < ENTRY_BUFFER_COUNT - first) ? count : ENTRY_BUFFER_COUNT - first;
+	
+	struct iovec iov[2] = {
+		{ .iov_base = entries->buffer[first], .iov_len = before_wrap * ENTRY_RECORD_SIZE },
+		{ .iov_base = entries->buffer[0],     .iov_len = (count - before_wrap) * ENTRY_RECORD_SIZE },
+	};
+	struct iovec *next = iov;
+	int iovcnt = (count > before_wrap) ? 2 : 1;
+	off_t start = log_file->offset;
+	int ret = 0;
+	
+	while(iovcnt > 0) {
+		ssize_t written = writev(log_file->fd, next, iovcnt);
+		if(written == -1) {
+			if(errno == EINTR || errno == EAGAIN)
+				continue;
+			
+			if(errno == EDQUOT || errno == ENOSPC) {
+				APP_LOG_WARNING("Write failed, clearing space...\n");
+				if(deleteOldest() == 0)
+					continue;
+			}
+			
+			APP_LOG_ERROR("Write failed, discarding %u entries\n", (unsigned)count);
+			/* including any that made it, so the log ends on a whole record */
+			log_file->offset = start;
+			trimPartialWrite(log_file);
+			log_file->index_count = indexed;
+			ret = -1;
+			break;
+		}
+		
+		log_file->offset += written;
+		
+		/* step over whatever was written, which may end part way through an iovec */
+		while(iovcnt > 0 && (size_t)written >= next->iov_len) {
+			written -= next->iov_len;
+			++next;
+			--iovcnt;
+		}
+		if(iovcnt > 0) {
+			next->iov_base = (uint8_t *)next->iov_base + written;
+			next->iov_len -= written;
+		}
+	}
+	
+	/* the kernel has its own copy now, so the slots can be reused */
+	atomic_store_explicit(&entries->tail, to, memory_order_release);
+	
+	syncWritten(log_file);
+	
+	return ret;
+}
+
+/* note the entry if it starts a new second, returning whether it did */
+bool indexEntry(log_file_t *log_file, const uint8_t *record, off_t position)
+{
+	const uint8_t *dtl = record + 1;
+	uint32_t second = (dtl[5] * 60 + dtl[6]) * 60 + dtl[7];
+	
+	if(log_file->index_count == LOG_INDEX_MAX)
+		return false;
+	
+	if(log_file->index_count > 0
+		&& second <= CC_FROM_LE32(log_file->index[log_file->index_count - 1].second)) {
+		return false;
+	}
+	
+	log_index_entry_t *entry = &log_file->index[log_file->index_count++];
+	entry->second = CC_TO_LE32(second);
+	entry->offset = CC_TO_LE32((uint32_t)position);
+	
+	return true;
+}
+
+/* write all of data, clearing space when the disk is full; -1 if the file is unusable */
+int writeFully(int fd, const uint8_t *data, size_t length)
+{
+	size_t written;
+	
+	while(writeAll(fd, data, length, &written) == -1) {
+		if(errno == EDQUOT || errno == ENOSPC) {
+			APP_LOG_WARNING("Write failed, clearing space...\n");
+			if(deleteOldest() == -1)
+				return -1;
+		}
+		else if(errno != EAGAIN) {
+			return -1;
+		}
+		
+		/* carry on from where it stopped */
+		data += written;
+		length -= written;
+	}
+	
+	return 0;
+}
+
+/*
+As writeFully, but at position, as direct logs are not appended to:
+a block only partly filled is written out, then again once it fills
+*/
+int writeFullyAt(int fd, const uint8_t *data, size_t length, off_t position)
+{
+	while(length > 0) {
+		ssize_t written = pwrite(fd, data, length, position);
+		if(written == -1) {
+			if(errno == EDQUOT || errno == ENOSPC) {
+				APP_LOG_WARNING("Write failed, clearing space...\n");
+				if(deleteOldest() == -1)
+					return -1;
+			}
+			else if(errno != EINTR && errno != EAGAIN) {
+				return -1;
+			}
+			continue;
+		}
+		
+		data += written;
+		length -= written;
+		position += written;
+	}
+	
+	return 0;
+}
+
+/*
+After a write failed part way, cut the log back to its offset, the end
+of the last whole record. Logs are appended to, so the next write then
+lands there rather than in the middle of a record.
+*/
+void trimPartialWrite(log_file_t *log_file)
+{
+	if(ftruncate(log_file->fd, log_file->offset) == -1) {
+		APP_LOG_ERROR("Could not cut off a partly written record (%s)\n", strerror(errno));
+	}
+}
+
+/* add to the direct block, writing it out whenever it fills; -1 if that failed, with the rest not added */
+int stageBytes(log_file_t *log_file, const uint8_t *data, size_t length)
+{
+	while(length > 0) {
+		size_t room = policy.direct_block_size - log_file->block_used;
+		size_t n = (length < room) ? length : room;
+		
+		memcpy(log_file->block + log_file->block_used, data, n);
+		log_file->block_used += n;
+		data += n;
+		length -= n;
+		
+		if(log_file->block_used == policy.direct_block_size && flushBlock(log_file) == -1)
+			return -1;
+	}
+	
+	return 0;
+}
+
+/* add a whole record to the direct block, noting where it starts should the block fail */
+int stageRecord(log_file_t *log_file, const uint8_t *data, size_t length)
+{
+	if(log_file->block_used == log_file->block_written) {
+		/* the first of the block not yet in the file, which has max_latency_ms to get there */
+		deadlineIn(&log_file->block_due, policy.max_latency_ms);
+	}
+	
+	if(log_file->block_record == SIZE_MAX) {
+		log_file->block_record = log_file->block_used;
+	}
+	
+	return stageBytes(log_file, data, length);
+}
+
+/*
+Write out the direct block at its place in the file, padded to the
+alignment. The unaligned end stays in the block to be written again
+along with what follows it, and whatever padding is left at the end of
+a log is cut off by finishLogFile, so the file format is unaffected.
+
+If the write fails, what was staged since the last write is dropped
+back to the first record in it, so the file still goes on from a whole
+record, and the next compact record is a key.
+*/
+int flushBlock(log_file_t *log_file)
+{
+	size_t length = (log_file->block_used + LOG_DIRECT_ALIGN - 1) / LOG_DIRECT_ALIGN * LOG_DIRECT_ALIGN;
+	memset(log_file->block + log_file->block_used, 0, length - log_file->block_used);
+	
+	if(writeFullyAt(log_file->fd, log_file->block, length, log_file->offset) == -1) {
+		size_t keep = (log_file->block_record != SIZE_MAX) ? log_file->block_record : log_file->block_used;
+		if(keep != log_file->block_used) {
+			APP_LOG_ERROR("Direct write failed, discarding %u bytes\n", (unsigned)(log_file->block_used - keep));
+		}
+		
+		log_file->block_used = keep;
+		log_file->block_record = SIZE_MAX;
+		logCodecReset(&log_file->codec);
+		/* what is left is tried again later, rather than straight away */
+		deadlineIn(&log_file->block_due, policy.max_latency_ms);
+		
+		/* and the entries indexed past that are gone */
+		while(log_file->index_count > 0
+			&& (off_t)CC_FROM_LE32(log_file->index[log_file->index_count - 1].offset) >= log_file->offset + (off_t)keep) {
+			log_file->index_count--;
+		}
+		
+		return -1;
+	}
+	
+	/* move on by the whole pages written, keeping the partial one */
+	size_t done = log_file->block_used / LOG_DIRECT_ALIGN * LOG_DIRECT_ALIGN;
+	memmove(log_file->block, log_file->block + done, log_file->block_used - done);
+	log_file->offset += done;
+	log_file->block_used -= done;
+	log_file->block_written = log_file->block_used;
+	log_file->block_record = SIZE_MAX;
+	
+	return 0;
+}
+
+/* write out what a direct log has staged once it has waited max_latency_ms */
+void flushDue(log_file_t *log_file)
+{
+	if(log_file->fd == -1 || !log_file->direct || log_file->block_used == log_file->block_written)
+		return;
+	
+	if(msUntil(&log_file->block_due) > 0)
+		return;
+	
+	flushBlock(log_file);
+}
+
+/*
+Once sync_interval bytes have built up, start their writeback,
+then wait for the lot started last time, so that at most
+two intervals' worth of data is ever dirty.
+*/
+void syncWritten(log_file_t *log_file)
+{
+	if(policy.sync_interval == 0 || log_file->direct)
+		return;
+	
+	if(log_file->offset - log_file->sync_from < (off_t)policy.sync_interval)
+		return;
+	
+	if(sync_file_range(log_file->fd, log_file->sync_from, log_file->offset - log_file->sync_from, SYNC_FILE_RANGE_WRITE) == -1) {
+		APP_LOG_DEBUG("Could not start writeback (%s)\n", strerror(errno));
+	}
+	
+	if(log_file->sync_wait != log_file->sync_from
+		&& sync_file_range(log_file->fd, log_file->sync_wait, log_file->sync_from - log_file->sync_wait,
+			SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER) == -1) {
+		APP_LOG_DEBUG("Could not wait for writeback (%s)\n", strerror(errno));
+	}
+	
+	log_file->sync_wait = log_file->sync_from;
+	log_file->sync_from = log_file->offset;
+}
+
+/* the time ms from now */
+static void deadlineIn(struct timespec *deadline, uint32_t ms)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec  += ms / 1000;
+	deadline->tv_nsec += (ms % 1000) * 1000000L;
+	if(deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec  += 1;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+/* milliseconds until deadline, 0 if it has passed */
+static int msUntil(const struct timespec *deadline)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	long long ms = (long long)(deadline->tv_sec - now.tv_sec) * 1000
+		+ (deadline->tv_nsec - now.tv_nsec) / 1000000;
+	
+	return (ms > 0) ? (int)ms : 0;
+}
+
+/* block on the eventfd until signalled, or timeout_ms has passed (-1 waits forever) */
+static void sleepForEntries(entry_buffer_t *entries, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = entries->wake_fd, .events = POLLIN };
+	
+	if(poll(&pfd, 1, timeout_ms) > 0) {
+		uint64_t count;
+		/* reset the counter, we only care that something happened */
+		if(read(entries->wake_fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+			APP_LOG_DEBUG("Wakeup read failed\n");
+		}
+	}
+	
+#if LOGGER_USE_IO_URING
+	/* may have been woken by completed writes, free up their slots */
+	if(policy.use_io_uring) {
+		uringLogReap(false);
+	}
+#endif
+}
+
+/*
+Wait according to the policy:
+when idle, sleep until the first entry arrives,
+then let a batch of wake_entries build up but no longer than max_latency_ms.
+Return by due, if given, for staged data to be written out.
+*/
+void waitForEntries(entry_buffer_t *entries, size_t tail, const struct timespec *due)
+{
+	if(atomic_load_explicit(&entries->head, memory_order_relaxed) == tail) {
+		atomic_store_explicit(&entries->wake_at, tail + 1, memory_order_seq_cst);
+		
+		/* check again, in case it was added before it could see wake_at */
+		if(atomic_load_explicit(&entries->head, memory_order_seq_cst) == tail) {
+			sleepForEntries(entries, (due != NULL) ? msUntil(due) : -1);
+		}
+		
+		if(due != NULL && atomic_load_explicit(&entries->head, memory_order_seq_cst) == tail) {
+			atomic_store_explicit(&entries->wake_at, SIZE_MAX, memory_order_relaxed);
+			return;
+		}
+	}
+	
+	struct timespec deadline;
+	deadlineIn(&deadline, policy.max_latency_ms);
+	
+	atomic_store_explicit(&entries->wake_at, tail + policy.wake_entries, memory_order_seq_cst);
+	
+	while(atomic_load_explicit(&entries->head, memory_order_seq_cst) - tail < policy.wake_entries) {
+		int timeout = msUntil(&deadline);
+		if(due != NULL && msUntil(due) < timeout) {
+			timeout = msUntil(due);
+		}
+		if(timeout == 0)
+			break;
+		
+		sleepForEntries(entries, timeout);
+	}
+	
+	atomic_store_explicit(&entries->wake_at, SIZE_MAX, memory_order_relaxed);
+}
+
+bool DTLs_for_same_log(DTL_data_t *ts_1, DTL_data_t *ts_2)
+{
+	if(    ts_1->minute/10 == ts_2->minute/10
+		&& ts_1->hour == ts_2->hour
+		&& ts_1->day == ts_2->day
+		&& ts_1->month == ts_2->month
+		&& ts_1->year == ts_2->year
+	) {
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+int getLogDir() {
+	static int logdir_fd = -1;
+	int ret;
+	
+	if(logdir_fd != -1)
+		return logdir_fd;
+	
+	ret = open(logDirectory, O_DIRECTORY);
+	if(ret == -1) {
+		APP_LOG_ERROR("Failed to open %s\n", logDirectory);
+		return -1;
+	}
+	
+	logdir_fd = ret;
+	
+	return logdir_fd;
+}
+
+DIR *openLogDir() {
+	int logdir_fd = getLogDir();
+	if(logdir_fd == -1)
+		return NULL;
+	
+	int fd = openat(logdir_fd, ".", O_DIRECTORY);
+	if(fd == -1)
+		return NULL;
+	
+	DIR *logdir = fdopendir(fd);
+	if(logdir == NULL)
+		return NULL;
+	
+	return logdir;
+}
+
+/* open the catalog of the log directory, or go without */
+static void openCatalog(void)
+{
+	int logdir_fd = getLogDir();
+	if(logdir_fd == -1)
+		return;
+	
+	catalogMutex = os_mutex_create();
+	if(catalogMutex == NULL) {
+		APP_LOG_WARNING("Could not create the catalog lock\n");
+		return;
+	}
+	
+	if(logCatalogOpen(&catalog, logdir_fd) == -1) {
+		APP_LOG_WARNING("Could not bring %s up to date\n", LOG_CATALOG_NAME);
+	}
+	
+	catalogOpen = (catalog.fd != -1);
+	if(!catalogOpen) {
+		APP_LOG_WARNING("No %s, going through the log directory instead\n", LOG_CATALOG_NAME);
+		logCatalogFree(&catalog);
+	}
+}
+
+/* with catalogMutex held */
+static void catalogAppend(const log_catalog_record_t *record)
+{
+	if(logCatalogAppend(&catalog, record) == -1) {
+		APP_LOG_WARNING("Could not note %s in %s\n", record->name, LOG_CATALOG_NAME);
+	}
+}
+
+/* note the directory of a day, unless the catalog has it already */
+void catalogAddDay(const char *date)
+{
+	if(!catalogOpen)
+		return;
+	
+	os_mutex_lock(catalogMutex);
+	
+	log_catalog_day_t *day = logCatalogFindDay(&catalog, logCatalogDate(date));
+	if(day == NULL || day->state == LOG_CATALOG_DELETED) {
+		log_catalog_record_t record = { .type = LOG_CATALOG_DAY };
+		snprintf(record.name, sizeof(record.name), "%s", date);
+		catalogAppend(&record);
+	}
+	
+	os_mutex_unlock(catalogMutex);
+}
+
+void describeLog(const log_file_t *log_file, log_catalog_record_t *record)
+{
+	*record = (log_catalog_record_t) {
+		.type = LOG_CATALOG_LOG,
+		.entries = log_file->entries,
+		.dropped = log_file->dropped,
+		.first = log_file->first,
+		.last = log_file->last,
+	};
+	snprintf(record->name, sizeof(record->name), "%s", log_file->name);
+}
+
+void logClosed(const log_catalog_record_t *record, bool saved)
+{
+	untrackLog(record->name);
+	
+	if(!saved || !catalogOpen)
+		return;
+	
+	os_mutex_lock(catalogMutex);
+	catalogAppend(record);
+	os_mutex_unlock(catalogMutex);
+}
+
+void catalogArchived(const char *directory, const char *suffix)
+{
+	if(!catalogOpen)
+		return;
+	
+	log_catalog_record_t record = { .type = LOG_CATALOG_ARCHIVED };
+	snprintf(record.name, sizeof(record.name), "%s%s", directory, suffix);
+	
+	os_mutex_lock(catalogMutex);
+	catalogAppend(&record);
+	os_mutex_unlock(catalogMutex);
+}
+
+/* note that a day is gone, if it still went by that name */
+void catalogDeleted(const char *name)
+{
+	if(!catalogOpen)
+		return;
+	
+	os_mutex_lock(catalogMutex);
+	
+	log_catalog_day_t *day = logCatalogFindDay(&catalog, logCatalogDate(name));
+	if(day != NULL && day->state != LOG_CATALOG_DELETED && strcmp(day->name, name) == 0) {
+		log_catalog_record_t record = { .type = LOG_CATALOG_DELETED };
+		snprintf(record.name, sizeof(record.name), "%s", name);
+		catalogAppend(&record);
+	}
+	
+	os_mutex_unlock(catalogMutex);
+}
+
+/* copy the name of the oldest day not in use, false if the catalog has none; with rotationMutex held */
+bool catalogOldest(char *name)
+{
+	if(!catalogOpen)
+		return false;
+	
+	os_mutex_lock(catalogMutex);
+	
+	log_catalog_day_t *oldest = logCatalogOldest(&catalog);
+	log_catalog_day_t *day = NULL;
+	for(size_t i = (oldest != NULL) ? (size_t)(oldest - catalog.days) : catalog.day_count; i < catalog.day_count; i++) {
+		if(catalog.days[i].state != LOG_CATALOG_DELETED && !dayInUse(catalog.days[i].date)) {
+			day = &catalog.days[i];
+			strcpy(name, day->name);
+			break;
+		}
+	}
+	
+	os_mutex_unlock(catalogMutex);
+	
+	return day != NULL;
+}
+
+/* copy the names of the days up to through (yyyymmdd) not yet archived; -1 without a catalog */
+int catalogUnarchived(uint32_t through, char (**names)[LOG_CATALOG_NAME_SIZE])
+{
+	if(!catalogOpen)
+		return -1;
+	
+	os_mutex_lock(catalogMutex);
+	
+	log_catalog_day_t *oldest = logCatalogOldest(&catalog);
+	size_t first = (oldest != NULL) ? (size_t)(oldest - catalog.days) : catalog.day_count;
+	size_t last = first;
+	while(last < catalog.day_count && catalog.days[last].date <= through) {
+		last++;
+	}
+	
+	int count = -1;
+	*names = malloc((last - first + 1) * LOG_CATALOG_NAME_SIZE);
+	if(*names != NULL) {
+		count = 0;
+		for(size_t i = first; i < last; i++) {
+			if(catalog.days[i].state == LOG_CATALOG_DAY) {
+				strcpy((*names)[count++], catalog.days[i].name);
+			}
+		}
+	}
+	
+	os_mutex_unlock(catalogMutex);
+	
+	return count;
+}
+
+/* count a log as open against its day */
+static void trackLog(const char *name)
+{
+	uint32_t date = logCatalogDate(name);
+	open_day_t *unused = NULL;
+	
+	os_mutex_lock(openDaysMutex);
+	
+	for(int i = 0; i < OPEN_DAYS_MAX; i++) {
+		if(openDays[i].logs == 0) {
+			if(unused == NULL) {
+				unused = &openDays[i];
+			}
+		}
+		else if(openDays[i].date == date) {
+			openDays[i].logs++;
+			os_mutex_unlock(openDaysMutex);
+			return;
+		}
+	}
+	
+	if(unused != NULL) {
+		*unused = (open_day_t) { .date = date, .logs = 1 };
+	}
+	else {
+		APP_LOG_WARNING("Too many days with logs open to keep track of %s\n", name);
+	}
+	
+	os_mutex_unlock(openDaysMutex);
+}
+
+static void untrackLog(const char *name)
+{
+	uint32_t date = logCatalogDate(name);
+	
+	os_mutex_lock(openDaysMutex);
+	
+	for(int i = 0; i < OPEN_DAYS_MAX; i++) {
+		if(openDays[i].logs != 0 && openDays[i].date == date) {
+			openDays[i].logs--;
+			break;
+		}
+	}
+	
+	os_mutex_unlock(openDaysMutex);
+}
+
+static bool dayHasOpenLogs(uint32_t date)
+{
+	bool open = false;
+	
+	os_mutex_lock(openDaysMutex);
+	
+	for(int i = 0; i < OPEN_DAYS_MAX; i++) {
+		if(openDays[i].logs != 0 && openDays[i].date == date) {
+			open = true;
+		}
+	}
+	
+	os_mutex_unlock(openDaysMutex);
+	
+	return open;
+}
+
+/* whether a day must be left alone by deletion; with rotationMutex held */
+static bool dayInUse(uint32_t date)
+{
+	return date == archivingDate || dayHasOpenLogs(date);
+}
+
+int startLogFile(log_file_t *log_file, DTL_data_t *timeframe)
+{
 	char date[16];
 	sprintf(date, "%4d%02d%02d", timeframe->year, timeframe->month, timeframe->day);
 	
@@ -314,19 +1595,34 @@ int startLogFile(log_file_t *log_file, DTL_data_t *timeframe)
 	if(logdir_fd == -1)
 		return -1;
 	
+	/* counted as open from before its directory is made, so it is not deleted from under us */
+	trackLog(date);
+	
 	int ret = mkdirat(logdir_fd, date, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
 	if(ret == -1 && errno != EEXIST) {
 		APP_LOG_ERROR("Failed to create %s\n", date);
+		untrackLog(date);
 		return -1;
 	}
+	catalogAddDay(date);
 	
 	/* O_PATH requires _GNU_SOURCE */
 	int dirfd = openat(logdir_fd, date, O_DIRECTORY | O_CLOEXEC);
 	if(dirfd == -1) {
 		APP_LOG_ERROR("Failed to open %s\n", date);
+		untrackLog(date);
 		return -1;
 	}
 	
+	/*
+	io_uring writes may complete out of order, so they are positioned
+	explicitly, which O_APPEND would override
+	*/
+	int flags = O_WRONLY | O_CREAT | O_EXCL;
+	if(!policy.use_io_uring) {
+		flags |= O_APPEND;
+	}
+	
 	char fname[16];
 	sprintf(fname, "%02d-%02d.bin",
 		timeframe->hour, 10*(timeframe->minute/10)
@@ -334,7 +1630,7 @@ int startLogFile(log_file_t *log_file, DTL_data_t *timeframe)
 	
 	int fd = openat(
 		dirfd, fname,
-		O_WRONLY | O_APPEND | O_CREAT | O_EXCL,
+		flags,
 		S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH /* owner RW, others R */
 	);
 	
@@ -345,7 +1641,7 @@ int startLogFile(log_file_t *log_file, DTL_data_t *timeframe)
 		
 		fd = openat(
 			dirfd, fname,
-			O_WRONLY | O_APPEND | O_CREAT | O_EXCL,
+			flags,
 			S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH /* owner RW, others R */
 		);
 	}
@@ -356,19 +1652,67 @@ int startLogFile(log_file_t *log_file, DTL_data_t *timeframe)
 	
 	if(fd < 0) {
 		APP_LOG_ERROR("Could not start a log for %s/%02d-%02d\n", date, timeframe->hour, 10*(timeframe->minute/10));
+		untrackLog(date);
 		return -1;
 	}
 	
+	/*
+	Reserve the space the log could possibly need, so the filesystem
+	is not allocating extents as it grows. The size is kept at 0,
+	so appending works as usual and finishLogFile trims what was not used.
+	*/
+	if(fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, LOG_FILE_MAX_SIZE) == -1) {
+		APP_LOG_DEBUG("Could not preallocate %s/%s (%s)\n", date, fname, strerror(errno));
+	}
+	
+	snprintf(log_file->name, sizeof(log_file->name), "%s/%s", date, fname);
 	log_file->fd = fd;
 	log_file->bigendian = true;
+	log_file->format = policy.format;
+	logCodecReset(&log_file->codec);
+	log_file->index_count = 0;
+	log_file->use_uring = policy.use_io_uring;
+	log_file->offset = 0;
+	log_file->direct = false;
+	log_file->block_used = 0;
+	log_file->block_written = 0;
+	log_file->block_record = SIZE_MAX;
+	log_file->sync_from = 0;
+	log_file->sync_wait = 0;
+	log_file->entries = 0;
+	log_file->first = 0;
+	log_file->last = 0;
+	log_file->dropped = 0;
+	
+	if(policy.direct_block_size != 0) {
+		if(log_file->block == NULL) {
+			log_file->block = aligned_alloc(LOG_DIRECT_ALIGN, policy.direct_block_size);
+		}
+		
+		/*
+		set afterwards, so filesystems without O_DIRECT support still get a log.
+		Blocks are written at their place in the file, which O_APPEND would override
+		*/
+		int fl = fcntl(fd, F_GETFL);
+		if(log_file->block == NULL) {
+			APP_LOG_WARNING("No memory for direct writes, using the page cache\n");
+		}
+		else if(fl == -1 || fcntl(fd, F_SETFL, (fl | O_DIRECT) & ~O_APPEND) == -1) {
+			APP_LOG_WARNING("Direct writes not supported here, using the page cache\n");
+		}
+		else {
+			log_file->direct = true;
+		}
+	}
 	
 	ret = writeLogHeader(log_file);
 	if(ret == -1) {
+		close(log_file->fd);
+		log_file->fd = -1;
+		untrackLog(date);
 		return -1;
 	}
 	
-	APP_LOG_INFO("Started %s/%s\n", date, fname);
-	
 	return 0;
 }
 
@@ -395,105 +1739,141 @@ int writeLogHeader(log_file_t *log_file)
 	}
 	
 	/* version */
-	header[6] = 1;
+	header[6] = log_file->format;
 	
 	/* word count */
-	/* digital size is bytes and words are 2 */
-	header[7] = APP_GSDML_VAR64_DATA_DIGITAL_SIZE/2;
+	header[7] = LOG_WORD_COUNT;
 	
-	/* all done, write it */
-	ssize_t written = write(log_file->fd, header, header_size);
-	if(written == -1) {
-		if(errno == EDQUOT || errno == ENOSPC) {
-			APP_LOG_WARNING("Write failed, clearing space...\n");
-			deleteOldest();
-		}
-		written = 0;
+	/* it goes out with the first block */
+	if(log_file->direct) {
+		return stageBytes(log_file, header, header_size);
 	}
 	
-	if(written < header_size) {
-		APP_LOG_WARNING(
-			"Header incomplete; wrote %d/%d bytes\n",
-			written, header_size
-		);
-		
-		/* keep the rest for later */
-		size_t remnant = header_size - written;
-		memcpy(log_file->buffer, header, remnant);
-		log_file->buf_end = remnant;
+	/*
+	all done, write it; the sync when the log is finished covers it.
+	Blocking even for io_uring, as this may be before the log is handed to it
+	*/
+	if(writeFully(log_file->fd, header, header_size) == -1) {
+		APP_LOG_WARNING("Header could not be written\n");
+		return -1;
 	}
+	log_file->offset += header_size;
 	
-	while(fsync(log_file->fd) == -1) {
-		if(errno == EBADF) {
+	return 0;
+}
+
+int writeLogIndex(log_file_t *log_file)
+{
+	const uint8_t *entries = (const uint8_t *)log_file->index;
+	size_t entries_size = log_file->index_count * sizeof(log_index_entry_t);
+	uint32_t footer[2] = {
+		CC_TO_LE32(log_file->index_count),
+		CC_TO_LE32(LOG_INDEX_MAGIC),
+	};
+	
+	if(log_file->direct) {
+		if(stageBytes(log_file, entries, entries_size) == -1
+			|| stageBytes(log_file, (const uint8_t *)footer, sizeof(footer)) == -1) {
 			return -1;
 		}
-		else if(errno == ENOSPC || errno == EDQUOT) {
-			APP_LOG_WARNING("File sync failed, clearing space...\n");
-			deleteOldest();
-		}
+		return 0;
+	}
+	
+#if LOGGER_USE_IO_URING
+	if(log_file->use_uring) {
+		return uringLogWriteIndex(log_file);
+	}
+#endif
+	
+	if(writeFully(log_file->fd, entries, entries_size) == -1
+		|| writeFully(log_file->fd, (const uint8_t *)footer, sizeof(footer)) == -1) {
+		APP_LOG_WARNING("Could not index %s\n", log_file->name);
+		return -1;
 	}
+	log_file->offset += entries_size + sizeof(footer);
 	
 	return 0;
 }
 
 int finishLogFile(log_file_t *log_file, bool flush)
 {
-	while(log_file->buf_end >= FILE_BUFFER_SIZE) {
-		/* make sure there's room for one more byte! */
-		ssize_t written = write(log_file->fd, log_file->buffer, FILE_MIN_WRITE);
-		if(written == -1) {
-			if(errno == EDQUOT || errno == ENOSPC) {
-				APP_LOG_WARNING("Write failed, clearing space...\n");
-				deleteOldest();
-			}
-			continue;
-		}
-		
-		memmove(log_file->buffer, log_file->buffer+written, log_file->buf_end - written);
+#if LOGGER_USE_IO_URING
+	if(log_file->use_uring) {
+		/* the rest is queued, and the catalog hears of it once the file is closed */
+		return uringLogFinish(log_file, flush);
+	}
+#endif
+	
+	/* entries are already written, just the end marker and index are left */
+	const uint8_t end = 255;
+	off_t length;
+	if(log_file->direct) {
+		stageBytes(log_file, &end, 1);
+		writeLogIndex(log_file);
 		
-		log_file->buf_end -= written;
+		/* the last block is padded out to the alignment, so cut that off again */
+		if(log_file->block_used != log_file->block_written) {
+			flushBlock(log_file);
+		}
+		length = log_file->offset + log_file->block_written;
+	}
+	else {
+		if(writeFully(log_file->fd, &end, 1) == -1) {
+			APP_LOG_WARNING("Could not mark end of log\n");
+		}
+		else {
+			log_file->offset += 1;
+			writeLogIndex(log_file);
+		}
+		length = log_file->offset;
 	}
 	
-	log_file->buffer[log_file->buf_end] = 255;
-	log_file->buf_end += 1;
+	log_catalog_record_t record;
+	describeLog(log_file, &record);
 	
-	/* finish it off */
-	size_t start = 0;
-	while(start < log_file->buf_end) {
-		ssize_t written = write(log_file->fd, log_file->buffer + start, log_file->buf_end - start);
-		if(written == -1) {
-			if(errno == EDQUOT || errno == ENOSPC) {
-				APP_LOG_WARNING("Write failed, clearing space...\n");
-				deleteOldest();
-			}
-			continue;
-		}
-		start += written;
+	int ret = closeLog(log_file->fd, length, flush, &record);
+	log_file->fd = -1;
+	
+	return ret;
+}
+
+/*
+Trim a log whose writes are done to length, releasing the space
+preallocated beyond it, sync it if asked to, close it and tell the catalog
+*/
+int closeLog(int fd, off_t length, bool flush, const log_catalog_record_t *record)
+{
+	if(ftruncate(fd, length) == -1) {
+		APP_LOG_WARNING("Could not trim preallocated space from %s\n", record->name);
 	}
 	
 	/* close does not flush, so this does make a difference */
+	bool saved = true;
 	if(flush) {
-		int ret = fsync(log_file->fd);
+		int ret = fsync(fd);
 		while(ret == -1) {
+			bool cleared = false;
 			if(errno == EDQUOT || errno == ENOSPC) {
 				APP_LOG_WARNING("File sync failed, clearing space...\n");
-				deleteOldest();
+				cleared = (deleteOldest() == 0);
 			}
-			else {
-				return -1;
+			
+			if(!cleared) {
+				saved = false;
+				break;
 			}
-			ret = fsync(log_file->fd);
+			ret = fsync(fd);
 		}
 	}
 	
-	int ret = close(log_file->fd);
-	if(ret == -1) {
+	/* closed even if it could not be synced, or it would hold up archiving for good */
+	if(close(fd) == -1 || !saved) {
+		logClosed(record, false);
 		return -1;
 	}
 	
-	APP_LOG_INFO("Saved successfully.\n");
-	
-	log_file->fd = -1;
+	APP_LOG_INFO("Saved %s\n", record->name);
+	logClosed(record, true);
 	
 	return 0;
 }
@@ -502,22 +1882,68 @@ int finishLogGroup(DTL_data_t *timeframe)
 {
 	finishDataSemaphore = os_sem_create(0);
 	
-	os_thread_create(
+	os_thread_t *archive_thread = os_thread_create(
 		"log_archive_thread",
 		ARCHIVE_PRIORITY,
-		4096,
+		ARCHIVE_STACKSIZE,
 		archive_thread_main,
 		(void *) timeframe
 	);
 	
 	/* make sure it knows what to work on, before returning and timeframe is potentially altered */
-	os_sem_wait(finishDataSemaphore, OS_WAIT_FOREVER);
+	if(archive_thread != NULL) {
+		os_sem_wait(finishDataSemaphore, OS_WAIT_FOREVER);
+	}
 	
 	os_sem_destroy(finishDataSemaphore);
 	
 	return 0;
 }
 
+/*
+Claim the day for archiving once its logs are closed and no other day
+is being archived, false if that does not happen soon enough
+*/
+static bool claimDay(char *day, uint32_t date)
+{
+	for(int waited = 0; ; waited += 100) {
+		os_mutex_lock(rotationMutex);
+		bool busy = (archivingDate != 0 || dayHasOpenLogs(date));
+		if(!busy) {
+			archivingDate = date;
+		}
+		os_mutex_unlock(rotationMutex);
+		
+		if(!busy)
+			return true;
+		
+		if(waited >= ARCHIVE_WAIT_MS) {
+			APP_LOG_WARNING("Archiving: %s still has a log open, leaving it for next time\n", day);
+			return false;
+		}
+		os_usleep(100 * 1000);
+	}
+}
+
+/* archive the day once its logs are closed, leaving it for next time if they stay open */
+static void archiveDay(char *day)
+{
+	uint32_t date = logCatalogDate(day);
+	
+	if(!claimDay(day, date))
+		return;
+	
+	/* it may have been deleted to make space while we waited */
+	struct stat statbuf;
+	if(fstatat(getLogDir(), day, &statbuf, 0) == 0) {
+		compressDirectory(day);
+	}
+	
+	os_mutex_lock(rotationMutex);
+	archivingDate = 0;
+	os_mutex_unlock(rotationMutex);
+}
+
 void archive_thread_main(void *arg)
 {
 	DTL_data_t *timeframe = (DTL_data_t *) arg;
@@ -528,19 +1954,39 @@ void archive_thread_main(void *arg)
 	/* got the data, let the logging thread continue */
 	os_sem_signal(finishDataSemaphore);
 	
-	int logdir_fd = getLogDir();
-	if(logdir_fd == -1)
+	/*
+	Archiving is never urgent, so get out of the way of capture:
+	normal scheduling, lowered some more, and only idle disk time.
+	Settings are per thread, so the rest of the process keeps its own.
+	*/
+	struct sched_param schedparam = {0};
+	if(pthread_setschedparam(pthread_self(), SCHED_OTHER, &schedparam) != 0) {
+		APP_LOG_WARNING("Archiving: \e[33mCould not set scheduling policy\e[0m\n");
+	}
+	
+	pid_t tid = syscall(SYS_gettid);
+	setpriority(PRIO_PROCESS, tid, 10);
+	
+	/* glibc has no wrapper; IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT, for IOPRIO_WHO_PROCESS */
+	if(syscall(SYS_ioprio_set, 1, tid, 3 << 13) == -1) {
+		APP_LOG_DEBUG("Archiving: could not set I/O priority\n");
+	}
+	
+	if(getLogDir() == -1)
 		return;
-	int ret;
 	
-	/* delete old archives if not much space is available */
-	struct statvfs statbuf;
-	ret = fstatvfs(logdir_fd, &statbuf);
-	while(ret == 0 && statbuf.f_bfree * 100 / statbuf.f_blocks < FREE_SPACE_PERCENT) {
-		APP_LOG_INFO("\e[33m%lu/%lu\e[0m blocks available, clearing space...\n", statbuf.f_bfree, statbuf.f_blocks);
-		deleteOldest();
-		
-		ret = fstatvfs(logdir_fd, &statbuf);
+	/* delete old archives if not much space is available, giving up once there are none */
+	clearSpace();
+	
+	/* the catalog knows which days are left to archive, otherwise go through the directory for them */
+	char (*days)[LOG_CATALOG_NAME_SIZE];
+	int count = catalogUnarchived(year * 10000 + month * 100 + day, &days);
+	if(count != -1) {
+		for(int i = 0; i < count; i++) {
+			archiveDay(days[i]);
+		}
+		free(days);
+		return;
 	}
 	
 	DIR *logdir = openLogDir();
@@ -572,7 +2018,7 @@ void archive_thread_main(void *arg)
 			}
 		}
 
-		compressDirectory(entry->d_name);
+		archiveDay(entry->d_name);
 	}
 	
 	/* also closes fd */
@@ -581,109 +2027,195 @@ void archive_thread_main(void *arg)
 	
 }
 
-int compressDirectory(char *directory) {
-	pid_t child_pid;
-	int status;
+#if !LOGGER_USE_ZSTD
+/*
+Without zstd, the day goes into directory.tgz by tar, which the archiving
+thread forks. The child inherits its lowered priorities, so it gets out
+of the way of capture just the same.
+*/
+static int tarDirectory(int logdir_fd, const char *directory)
+{
 	char archive[24];
+	char partial[32];
+	snprintf(archive, sizeof(archive), "%s" TAR_ARCHIVE_SUFFIX, directory);
+	snprintf(partial, sizeof(partial), "%s.part", archive);
 	
-	sprintf(archive, "%s.tgz", directory);
+	pid_t child_pid = fork();
+	if(child_pid == 0) {
+		/* only a copy of this thread made it, so nothing but system calls until exec */
+		if(fchdir(logdir_fd) == -1)
+			_exit(EXIT_FAILURE);
+		
+		/* gzip, as pnet2csv reads .tgz archives in place */
+		execlp("tar", "tar", "-czf", partial, directory, (char *)NULL);
+		_exit(EXIT_FAILURE);
+	}
+	else if(child_pid == -1) {
+		APP_LOG_ERROR("Archiving: could not start tar for %s\n", directory);
+		return -1;
+	}
 	
-	int logdir_fd = getLogDir();
-	if(logdir_fd == -1)
+	int status;
+	while(waitpid(child_pid, &status, 0) == -1) {
+		if(errno != EINTR) {
+			APP_LOG_ERROR("Archiving: lost track of tar for %s\n", directory);
+			return -1;
+		}
+	}
+	
+	/* only complete archives get the real name */
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0
+		|| renameat(logdir_fd, partial, logdir_fd, archive) == -1) {
+		unlinkat(logdir_fd, partial, 0);
 		return -1;
+	}
 	
-	child_pid = fork();
-	if(child_pid == 0) {
-		/* this is the child */
+	/* tar took everything in the directory, so all of it goes */
+	int dir_fd = openat(logdir_fd, directory, O_DIRECTORY | O_CLOEXEC);
+	if(dir_fd == -1)
+		return 0;
 	
-		/* set scheduling policy to normal */
-		APP_LOG_DEBUG("Setting SCHED_OTHER\n");
-		struct sched_param schedparam = {0};
-		int ret = pthread_setschedparam(pthread_self(), SCHED_OTHER, &schedparam);
-		if(ret != 0) {
-			APP_LOG_WARNING("Archiving: \e[33mCould not set scheduling policy\e[0m\n");
-		}
-		
-		/* reduce the priority some more */
-		nice(10);
+	DIR *dirp = fdopendir(dir_fd);
+	if(dirp == NULL) {
+		close(dir_fd);
+		return 0;
+	}
+	
+	for(struct dirent *entry = readdir(dirp); entry != NULL; entry = readdir(dirp)) {
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
 		
-		if(fchdir(logdir_fd) == -1) {
-			APP_LOG_ERROR("Archiving: could not set working directory\n");
-			exit(EXIT_FAILURE);
+		if(unlinkat(dir_fd, entry->d_name, 0) == -1) {
+			APP_LOG_WARNING("Archiving: \e[31mFailed to delete %s/%s\e[0m\n", directory, entry->d_name);
 		}
-		
-		/* xz might yield better ratio,
-		   although this is not text and xz is substantially slower */
-		char *argv[] = { "tar", "-czf", archive, directory, NULL };
-		
-		/* p searches so we don't have to */
-		execvp("tar", argv);
-		
-		/* exec didn't replace us... don't want this process hanging around */
-		/* Goodbye, world! */
-		exit(EXIT_FAILURE);
 	}
-	else if(child_pid == -1) {
-		APP_LOG_ERROR("Archiving: \e[31mFailed to instantiate for %s\e[0m\n", directory);
+	
+	closedir(dirp);
+	
+	return 0;
+}
+#endif
+
+int compressDirectory(char *directory) {
+	int logdir_fd = getLogDir();
+	if(logdir_fd == -1)
 		return -1;
-	}
 	
 	APP_LOG_INFO("Archiving %s...\n", directory);
 	
-	waitpid(child_pid, &status, 0);
-	
-	if(WIFEXITED(status) && WEXITSTATUS(status) != 0) {
-		APP_LOG_ERROR("Archiving: \e[31mFailed to archive %s\e[0m\n", archive);
-		/* os_thread_create doesn't want us to return a value */
+#if LOGGER_USE_ZSTD
+	if(zstdArchiveDirectory(directory, policy.compression_level) == -1) {
+		APP_LOG_ERROR("Archiving: \e[31mFailed to archive %s\e[0m\n", directory);
+		return -1;
+	}
+	const char *archive_suffix = ZSTD_ARCHIVE_SUFFIX;
+#else
+	if(tarDirectory(logdir_fd, directory) == -1) {
+		APP_LOG_ERROR("Archiving: \e[31mFailed to archive %s\e[0m\n", directory);
 		return -1;
 	}
+	const char *archive_suffix = TAR_ARCHIVE_SUFFIX;
+#endif
+	
+	/* its logs are in the archive from here on, whatever becomes of the directory */
+	catalogArchived(directory, archive_suffix);
 	
-	/* delete the now-compressed directory */
-	int dir_fd = openat(logdir_fd, directory, O_DIRECTORY);
-	if(dir_fd == -1) {
-		APP_LOG_ERROR("Archiving: Failed to open %s\n", directory);
+	/* the archiver deleted its logs, so this only goes if nothing else was left in it */
+	if(unlinkat(logdir_fd, directory, AT_REMOVEDIR) == -1) {
+		if(errno == ENOTEMPTY || errno == EEXIST) {
+			APP_LOG_WARNING("Archiving: kept %s, it holds more than logs\n", directory);
+		}
+		else {
+			APP_LOG_WARNING("Archiving: \e[31mFailed to delete %s\e[0m\n", directory);
+		}
 		return -1;
 	}
 	
-	DIR *loggroup_dirp = fdopendir(dir_fd);
-	if(loggroup_dirp == NULL) {
-		APP_LOG_ERROR("Archiving: Failed to open %s\n", directory);
+	APP_LOG_INFO("Archiving: \e[32mArchived %s as \e[92m%s%s\e[0m\n", directory, directory, archive_suffix);
+	
+	return 0;
+}
+
+/* delete a day's directory and the logs in it, or its archive; 1 if it is not there */
+static int deleteDay(const char *oldest)
+{
+	int logdir_fd = getLogDir();
+	if(logdir_fd == -1)
+		return -1;
+	
+	struct stat statbuf;
+	if(fstatat(logdir_fd, oldest, &statbuf, 0) == -1) {
+		if(errno == ENOENT)
+			return 1;
+		APP_LOG_ERROR("%s: stat failed\n", oldest);
 		return -1;
 	}
-		
-	struct dirent *entry;
 	
-	for(entry = readdir(loggroup_dirp); entry != NULL; entry = readdir(loggroup_dirp)) {
-		if(entry->d_name[0] == '.'
-		   && (entry->d_name[1] == '\0' || (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
-			/* I'm so glad these appear in every directory listing */
-			continue;
+	if((statbuf.st_mode & S_IFMT) == S_IFDIR) {
+		/* unlink children */
+		int dir_fd = openat(logdir_fd, oldest, O_DIRECTORY);
+		if(dir_fd == -1) {
+			APP_LOG_ERROR("Rotation: Failed to open %s\n", oldest);
+			return -1;
 		}
 		
-		if(unlinkat(dir_fd, entry->d_name, 0) == -1) {
-			APP_LOG_WARNING("Archiving: \e[31mFailed to delete %s\e[0m\n", entry->d_name);
-			/* keep going anyway */
+		DIR *oldest_dirp = fdopendir(dir_fd);
+		if(oldest_dirp == NULL) {
+			APP_LOG_ERROR("Rotation: Failed to open %s\n", oldest);
+			return -1;
+		}
+			
+		struct dirent *entry;
+		
+		for(entry = readdir(oldest_dirp); entry != NULL; entry = readdir(oldest_dirp)) {
+			if(entry->d_name[0] == '.'
+			   && (entry->d_name[1] == '\0' || (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
+				/* I'm so glad these appear in every directory listing */
+				continue;
+			}
+			
+			if(unlinkat(dir_fd, entry->d_name, 0) == -1) {
+				APP_LOG_WARNING("Rotation: \e[31mFailed to delete %s\e[0m\n", entry->d_name);
+				/* keep going anyway */
+			}
 		}
+		
+		if(closedir(oldest_dirp) == -1)
+			return -1;
 	}
 	
-	if(closedir(loggroup_dirp) == -1)
-		return -1;
+	int dirflag = ((statbuf.st_mode & S_IFMT) == S_IFDIR) ? AT_REMOVEDIR : 0;
 	
-	/* use unlinkat because "rmdirat" does not exist */
-	if(unlinkat(logdir_fd, directory, AT_REMOVEDIR) == -1) {
-		APP_LOG_WARNING("Archiving: \e[31mFailed to delete %s\e[0m\n", directory);
+	if(unlinkat(logdir_fd, oldest, dirflag) == -1) {
+		APP_LOG_WARNING("Rotation: \e[31mFailed to delete %s\e[0m\n", oldest);
 		return -1;
 	}
 	
-	APP_LOG_INFO("Archiving: \e[32mArchived %s as \e[92m%s\e[0m\n", directory, archive);
+	APP_LOG_INFO("Rotation: \e[35mDeleted %s\e[0m\n", oldest);
 	
 	return 0;
 }
 
-int deleteOldest()
+/* with rotationMutex held */
+static int deleteOldestUnused(void)
 {
+	char oldest[LOG_CATALOG_NAME_SIZE];
 	int ret;
 	
+	/* the catalog knows which day is oldest, the directory only has to be gone through without it */
+	while(catalogOldest(oldest)) {
+		ret = deleteDay(oldest);
+		if(ret != 1) {
+			if(ret == 0) {
+				catalogDeleted(oldest);
+			}
+			return ret;
+		}
+		
+		/* archived since, or deleted by someone else */
+		catalogDeleted(oldest);
+	}
+	
 	DIR *dirp = openLogDir();
 	if(dirp == NULL) {
 		return -1;
@@ -691,7 +2223,6 @@ int deleteOldest()
 	
 	/* date of oldest */
 	unsigned short int year = 9999, month = 99, day = 99;
-	char oldest[16];
 	
 	struct dirent *entry;
 	
@@ -707,8 +2238,11 @@ int deleteOldest()
 		if(matches < 3)
 			continue;
 		
-		/* only accept yyyymmdd or yyyymmdd.tgz */
-		if(strlen(end) > 0 && strcmp(end, ".tgz") != 0)
+		/* only accept yyyymmdd, yyyymmdd.tgz or yyyymmdd.zst */
+		if(strlen(end) > 0 && strcmp(end, ".tgz") != 0 && strcmp(end, ".zst") != 0)
+			continue;
+		
+		if(dayInUse(_year * 10000 + _month * 100 + _day))
 			continue;
 		
 		if(_year > year)
@@ -751,58 +2285,19 @@ int deleteOldest()
 		return -1;
 	}
 	
-	int logdir_fd = getLogDir();
-	if(logdir_fd == -1)
-		return -1;
-	
-	struct stat statbuf;
-	ret = fstatat(logdir_fd, oldest, &statbuf, 0);
-	if(ret == -1) {
-		APP_LOG_ERROR("%s: stat failed\n", oldest);
-		return -1;
-	}
-	
-	if((statbuf.st_mode & S_IFMT) == S_IFDIR) {
-		/* unlink children */
-		int dir_fd = openat(logdir_fd, oldest, O_DIRECTORY);
-		if(dir_fd == -1) {
-			APP_LOG_ERROR("Rotation: Failed to open %s\n", oldest);
-			return -1;
-		}
-		
-		DIR *oldest_dirp = fdopendir(dir_fd);
-		if(oldest_dirp == NULL) {
-			APP_LOG_ERROR("Rotation: Failed to open %s\n", oldest);
-			return -1;
-		}
-			
-		struct dirent *entry;
-		
-		for(entry = readdir(oldest_dirp); entry != NULL; entry = readdir(oldest_dirp)) {
-			if(entry->d_name[0] == '.'
-			   && (entry->d_name[1] == '\0' || (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
-				/* I'm so glad these appear in every directory listing */
-				continue;
-			}
-			
-			if(unlinkat(dir_fd, entry->d_name, 0) == -1) {
-				APP_LOG_WARNING("Rotation: \e[31mFailed to delete %s\e[0m\n", entry->d_name);
-				/* keep going anyway */
-			}
-		}
-		
-		if(closedir(oldest_dirp) == -1)
-			return -1;
-	}
-	
-	int dirflag = ((statbuf.st_mode & S_IFMT) == S_IFDIR) ? AT_REMOVEDIR : 0;
-	
-	if(unlinkat(logdir_fd, oldest, dirflag) == -1) {
-		APP_LOG_WARNING("Rotation: \e[31mFailed to delete %s\e[0m\n", oldest);
-		return -1;
+	ret = deleteDay(oldest);
+	if(ret == 0) {
+		catalogDeleted(oldest);
 	}
 	
-	APP_LOG_INFO("Rotation: \e[35mDeleted %s\e[0m\n", oldest);
+	return (ret == 0) ? 0 : -1;
+}
+
+int deleteOldest()
+{
+	os_mutex_lock(rotationMutex);
+	int ret = deleteOldestUnused();
+	os_mutex_unlock(rotationMutex);
 	
-	return 0;
+	return ret;
 }
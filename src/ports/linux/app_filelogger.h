@@ -13,38 +13,200 @@ extern "C" {
 #endif
 
 #include <dirent.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <time.h>
 
 #include "app_data.h"
 #include "app_gsdml.h"
+#include "app_logcatalog.h"
+#include "app_logformat.h"
+#include "logger_common.h"
 #include "osal.h"
 
+/* io_uring log writer, see app_filelogger_uring.h */
+#ifndef LOGGER_USE_IO_URING
+#define LOGGER_USE_IO_URING 0
+#endif
+
+/* in-process archiver, see app_filelogger_zstd.h */
+#ifndef LOGGER_USE_ZSTD
+#define LOGGER_USE_ZSTD 0
+#endif
+
 #define ENTRY_SIZE (12 + APP_GSDML_VAR64_DATA_DIGITAL_SIZE)
-#define ENTRY_BUFFER_SIZE (256*ENTRY_SIZE)
+/* file format includes 0 before each entry */
+#define ENTRY_RECORD_SIZE (1 + ENTRY_SIZE)
+/* must be a power of two, so the free-running indices wrap cleanly */
+#define ENTRY_BUFFER_COUNT 512
+#define ENTRY_BUFFER_SIZE (ENTRY_BUFFER_COUNT*ENTRY_RECORD_SIZE)
+
+#define CACHE_LINE_SIZE 64
+#define PAGE_SIZE_BYTES 4096
 
-/* (circular) buffer for passing entries between threads */
+/* fewer free slots than this counts as the entry buffer running low */
+#define ENTRY_BUFFER_LOW_SPACE (ENTRY_BUFFER_COUNT/4)
+
+/*
+Single-producer/single-consumer ring for passing entries between threads.
+Slots hold complete file records, so the logging thread hands them
+to the kernel as they are, and only frees them once written.
+head is only written by addLogEntry (the cyclic thread) and tail only by the
+logging thread, so neither side ever has to wait for the other. Both indices
+run freely and are reduced modulo ENTRY_BUFFER_COUNT when used; head - tail is
+the number of entries pending. Each index lives on its own cache line so the
+two threads do not keep stealing the line from each other.
+
+When the logging thread goes to sleep it sets wake_at to the head value it
+wants to be woken at, and addLogEntry signals wake_fd (an eventfd) when it
+publishes exactly that entry.
+
+The statistics follow the same split: dropped is only written by addLogEntry,
+the rest only by the logging thread, which checks the fill level each time it
+wakes so the cyclic thread pays nothing for them.
+*/
 typedef struct entry_buffer
 {
-	size_t start;
-	size_t end;
-	uint8_t buffer[ENTRY_BUFFER_SIZE];
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+	atomic_uint dropped;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+	/* times the free slots fell below ENTRY_BUFFER_LOW_SPACE */
+	atomic_uint low_space;
+	/* most entries ever pending at once */
+	atomic_size_t peak;
+	/* whether the current low space episode has been counted */
+	bool running_low;
+	_Alignas(CACHE_LINE_SIZE) atomic_size_t wake_at;
+	int wake_fd;
+	_Alignas(PAGE_SIZE_BYTES) uint8_t buffer[ENTRY_BUFFER_COUNT][ENTRY_RECORD_SIZE];
 } entry_buffer_t;
 
-#define FILE_MIN_WRITE   4096
-#define FILE_BUFFER_SIZE 32768
-
 typedef struct log_file
 {
 	int fd;
-	uint8_t buffer[FILE_BUFFER_SIZE];
-	size_t buf_end;
-	
 	bool bigendian;
+	/* LOG_FORMAT_PLAIN or LOG_FORMAT_COMPACT */
+	uint8_t format;
+	/* previous entry, for compact logs */
+	log_codec_t codec;
+	/* where each second starts, written after the end marker */
+	uint32_t index_count;
+	log_index_entry_t index[LOG_INDEX_MAX];
+	/* date directory and file name, for messages */
+	char name[32];
+	
+	/* queue I/O through io_uring rather than blocking on it */
+	bool use_uring;
+	/* io_uring bookkeeping for this file */
+	int uring_file;
+	/* bytes written so far, where the next write goes; for direct writes, where the block goes */
+	off_t offset;
+	
+	/* opened with O_DIRECT, so only whole blocks are written */
+	bool direct;
+	/* aligned staging for direct writes, kept for the next log */
+	uint8_t *block;
+	size_t block_used;
+	/* of the block, how much is in the file already, and where the first record after that starts (SIZE_MAX if none) */
+	size_t block_written;
+	size_t block_record;
+	/* when what is staged but not in the file must be written out, by max_latency_ms */
+	struct timespec block_due;
+	
+	/* start of the data not yet passed to sync_file_range */
+	off_t sync_from;
+	/* start of the range whose writeback was started but not waited for */
+	off_t sync_wait;
+	
+	/* for its record in the catalog: entries given to it, and the times of the first and last */
+	uint32_t entries;
+	int64_t first;
+	int64_t last;
+	/* the total dropped when it was begun, then those dropped while it was current */
+	unsigned int dropped;
 } log_file_t;
 
+/* default wakeup policy for the logging thread */
+#define LOG_WAKE_ENTRIES     32  /* pending entries that wake the logging thread */
+#define LOG_MAX_LATENCY_MS   100 /* longest an entry waits before the logging thread picks it up */
+
+/* default zstd level for archiving */
+#define LOG_COMPRESSION_LEVEL 3
+
+/* direct writes must be a multiple of this, and aligned to it in memory and in the file */
+#define LOG_DIRECT_ALIGN     PAGE_SIZE_BYTES
+#define LOG_DIRECT_BLOCK_MAX (4*1024*1024)
+
+typedef struct log_policy
+{
+	size_t wake_entries;
+	uint32_t max_latency_ms;
+	/* needs LOGGER_USE_IO_URING, falls back to blocking I/O if unavailable */
+	bool use_io_uring;
+	/*
+	bypass the page cache with O_DIRECT, writing blocks of this many bytes,
+	ideally the erase block size of the card; 0 to write through the page cache.
+	A block not yet full is written as far as it goes once its first entry
+	has waited max_latency_ms, then again when it fills.
+	Falls back to the page cache where the filesystem does not support it.
+	*/
+	size_t direct_block_size;
+	/*
+	start writeback every this many bytes, waiting for the previous lot,
+	so dirty data goes out steadily rather than all at the final fsync;
+	0 to leave it to the kernel. Only applies to page cache writes.
+	*/
+	size_t sync_interval;
+	/* zstd level for archiving finished days, needs LOGGER_USE_ZSTD */
+	int compression_level;
+	/*
+	LOG_FORMAT_PLAIN, or LOG_FORMAT_COMPACT to only write what changed
+	between entries; see app_logformat.h. Compact needs blocking I/O.
+	*/
+	uint8_t format;
+} log_policy_t;
+
+typedef struct log_buffer_stats
+{
+	unsigned int dropped;
+	unsigned int low_space;
+	size_t peak;
+	/* entries taken in so far, and of those the ones handed to the kernel */
+	size_t added;
+	size_t written;
+} log_buffer_stats_t;
+
 #define LOG_THREAD_PRIORITY  12
 #define LOG_THREAD_STACKSIZE 65536 /* bytes */
 
-#define ARCHIVE_PRIORITY 8
+#define ARCHIVE_PRIORITY  8
+#define ARCHIVE_STACKSIZE 65536 /* bytes */
+/* how long archiving waits for a day's logs to be closed before leaving the day for next time */
+#define ARCHIVE_WAIT_MS   60000
+
+/* days that may have logs open at once: the current log's, the spare's and those of logs still closing */
+#define OPEN_DAYS_MAX     4
+
+/* finishes, syncs and prepares logs, and clears space, away from the logging thread */
+#define HOUSEKEEPING_PRIORITY  8
+#define HOUSEKEEPING_STACKSIZE 16384 /* bytes */
+/* jobs that may be waiting at once; the logging thread does any more itself */
+#define HOUSEKEEPING_JOBS      8
+
+/* each log covers this long, see DTLs_for_same_log */
+#define LOG_FILE_PERIOD_S 600
+/* at most one entry per tick is logged */
+#define LOG_ENTRY_INTERVAL_US (APP_TICK_INTERVAL_US * APP_TICKS_UPDATE_DATA)
+/* header, a full period of entries, the end marker and the index */
+#define LOG_FILE_MAX_SIZE \
+	(LOG_HEADER_SIZE + (off_t)LOG_FILE_PERIOD_S * 1000000 / LOG_ENTRY_INTERVAL_US * ENTRY_RECORD_SIZE + 1 \
+	+ LOG_INDEX_MAX * sizeof(log_index_entry_t) + LOG_INDEX_FOOTER_SIZE)
+
+/* where logs go unless setLogDirectory says otherwise */
+#define LOG_DIRECTORY "/var/opt/pnlogger/data"
+
+/* archives of days when built without zstd */
+#define TAR_ARCHIVE_SUFFIX ".tgz"
 
 /* delete old logs when too few blocks are available */
 #define FREE_SPACE_PERCENT 20
@@ -52,20 +214,71 @@ typedef struct log_file
 /**
  * Add a new entry to be logged.
  *
+ * Never blocks; if the logging thread has fallen behind and the entry
+ * buffer is full, the entry is dropped. Starts logging if startLogger
+ * has not, and fails if logging could not be started.
+ *
  * @param timestamp        In:    PLC timestamp of this entry
  * @param word_data        In:    Variable data array
  * @param word_count       In:    Number of words (2 bytes) in word_data
  * @return 0 on success, -1 on error
  */
 int addLogEntry(
-	DTL_data_t *timestamp,
-	uint8_t *word_data,
+	const DTL_data_t *timestamp,
+	const uint8_t *word_data,
 	uint8_t word_count);
 
 /**
- * Start a separate thread for logging I/O
+ * Set when the logging thread is woken to collect entries.
+ * It is woken once wake_entries are pending, or at the latest
+ * max_latency_ms after the first pending entry arrived.
+ * An idle logger does not wake at all.
  *
- * @param entries          In:    buffer that entries and mutex will exist in
+ * Also selects whether log files are written with blocking I/O
+ * or through io_uring, with O_DIRECT, how often writeback is started,
+ * in which format, and how hard finished days are compressed.
+ *
+ * Must be called before the first entry is added.
+ *
+ * @param policy           In:    New policy
+ * @return 0 on success, -1 on error
+ */
+int setLogPolicy(const log_policy_t *policy);
+
+/**
+ * Write logs to a directory other than LOG_DIRECTORY, which must exist.
+ * Must be called before the first entry is added.
+ *
+ * @param path             In:    the log directory
+ * @return 0 on success, -1 on error
+ */
+int setLogDirectory(const char *path);
+
+/**
+ * Read how close the entry buffer has come to overflowing.
+ * Safe to call from any thread at any time.
+ *
+ * @param stats            Out:   entries dropped, times free space
+ *                                ran low, peak entries pending, and
+ *                                how many have been added and written
+ */
+void getLogBufferStats(log_buffer_stats_t *stats);
+
+/**
+ * Start logging, after setLogPolicy and setLogDirectory, so that the
+ * first entry does not have to. addLogEntry starts it otherwise.
+ * Only tried once; after a failure, logging stays off.
+ *
+ * @return 0 if logging is running, -1 if it could not be started
+ */
+int startLogger(void);
+
+/**
+ * Start a separate thread for logging I/O. Registers an exit handler
+ * that deletes the next log if it was prepared but not used.
+ * On failure, whatever was set up is torn down again.
+ *
+ * @param entries          In:    buffer that entries will be passed through
  * @return 0 on success, -1 on error
  */
 int initialiseLoggerThread(entry_buffer_t *entries);
@@ -95,7 +308,8 @@ int getLogDir();
 DIR *openLogDir();
 
 /**
- * Start a new log in storage, assigning fd and flushing headers
+ * Start a new log in storage, assigning fd, preallocating its
+ * space and writing headers
  *
  * @param log_file         Out:   the new log
  * @return 0 on success, -1 on error
@@ -103,7 +317,7 @@ DIR *openLogDir();
 int startLogFile(log_file_t *log_file, DTL_data_t *timeframe);
 
 /**
- * Write non-repeated data into log file, attempting sync
+ * Write non-repeated data into log file
  *
  * @param log_file         In
  * @return 0 on success, -1 on error
@@ -111,7 +325,35 @@ int startLogFile(log_file_t *log_file, DTL_data_t *timeframe);
 int writeLogHeader(log_file_t *log_file);
 
 /**
- * Wrap up the current log and save/flush/sync it
+ * Write entries straight from the entry buffer into the log,
+ * or encoded first for compact logs,
+ * then hand their slots back to addLogEntry
+ *
+ * @param log_file         In
+ * @param entries          InOut: buffer holding the entries
+ * @param from             In:    index of the first entry to write
+ * @param to               In:    index after the last entry to write
+ * @return 0 on success, -1 on error
+ */
+int writeLogEntries(
+	log_file_t *log_file,
+	entry_buffer_t *entries,
+	size_t from,
+	size_t to);
+
+/**
+ * Write the index of the log, after its end marker
+ *
+ * @param log_file         In
+ * @return 0 on success, -1 on error
+ */
+int writeLogIndex(log_file_t *log_file);
+
+/**
+ * Wrap up the current log, writing its end marker and index,
+ * trimming the space preallocated
+ * but not used, and save/flush/sync it, then add it to the catalog.
+ * With io_uring this only queues the end; see logClosed
  * @param log_file         In
  * @param flush            In: whether to sync before closing
  * @return 0 on sucess, -1 on error
@@ -121,13 +363,47 @@ int finishLogFile(
 	bool flush);
 
 /**
- * Manage space by clearing old logs and compressing the new day
+ * Summarise a log for its record in the catalog
+ * @param log_file         In
+ * @param record           Out
+ */
+void describeLog(const log_file_t *log_file, log_catalog_record_t *record);
+
+/**
+ * Note that a log's descriptor has been closed, adding it to the
+ * catalog if it was saved. finishLogFile calls this itself, except
+ * with io_uring, where closeFinishedLog does
+ * @param record           In: as filled in by describeLog
+ * @param saved            In: whether its data made it to storage
+ */
+void logClosed(const log_catalog_record_t *record, bool saved);
+
+/**
+ * Trim, sync (if requested) and close a log whose writes are all done,
+ * then pass it to logClosed, all on the housekeeping thread, as they block.
+ * Done in place if housekeeping cannot take it. For io_uring
+ * @param fd               In: now owned by this
+ * @param length           In: where the log ends
+ * @param flush            In: whether to sync before closing
+ * @param record           In: as filled in by describeLog
+ */
+void closeFinishedLog(int fd, off_t length, bool flush, const log_catalog_record_t *record);
+
+/**
+ * Manage space by clearing old logs and compressing the new day,
+ * on a thread of its own with low CPU and I/O priority.
+ * A day with a log still open is waited for, up to ARCHIVE_WAIT_MS,
+ * then left for next time
  * @param timeframe        In:     The day that was finished
  */
 int finishLogGroup(DTL_data_t *timeframe);
 
 /**
- * Create a compressed archive of the directory and delete the original
+ * Create a compressed archive of the logs in the directory, directory.zst,
+ * and delete them, then the directory if nothing else is left in it.
+ * The catalog notes which archive its logs are now in.
+ * Built without LOGGER_USE_ZSTD, tar archives the whole directory as
+ * directory.tgz instead, as it always did
  * @param directory        In: Name of the directory under log directory
  *
  * @return 0 on success, -1 on error
@@ -135,7 +411,10 @@ int finishLogGroup(DTL_data_t *timeframe);
 int compressDirectory(char *directory);
 
 /**
- * Identifies the oldest archive and deletes it
+ * Identifies the oldest day, archived or not, and deletes it.
+ * The catalog says which it is; without one the log directory
+ * is gone through for it. Days with a log open, or being archived,
+ * are passed over. Safe to call from any of the logger's threads
  *
  * @return 0 on sucess, -1 on error
  */
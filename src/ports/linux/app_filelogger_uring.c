@@ -0,0 +1,375 @@
+#include "app_filelogger_uring.h"
+
+#include "app_log.h"
+
+#include <liburing.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+typedef struct uring_op
+{
+	int file;
+	off_t offset;
+	struct iovec iov[2];
+	int iovcnt;
+	/* small writes (header, end marker) are copied here */
+	uint8_t bytes[16];
+	/* entry buffer tail once this is written, SIZE_MAX if it is not entries */
+	size_t release_to;
+	bool done;
+	int res;
+} uring_op_t;
+
+typedef struct uring_file
+{
+	bool in_use;
+	int fd;
+	/* writes queued but not yet retired */
+	unsigned int writes;
+	bool finishing;
+	bool flush;
+	/* a write was lost, so the log is cut where it started and nothing more is written */
+	bool failed;
+	off_t failed_at;
+	/* where the log ends, to trim its preallocated space */
+	off_t length;
+	/* for logClosed, as the log_file has moved on by then */
+	log_catalog_record_t record;
+	/* the index is written from here, for the same reason */
+	log_index_entry_t index[LOG_INDEX_MAX];
+	uint32_t footer[2];
+} uring_file_t;
+
+static struct io_uring ring;
+static entry_buffer_t *ring_entries;
+
+/* writes, retired in the order they were queued */
+static uring_op_t ops[URING_DEPTH];
+static size_t ops_head;
+static size_t ops_tail;
+
+static uring_file_t files[URING_MAX_FILES];
+
+static void retireWrites(void);
+
+int uringLogInit(entry_buffer_t *entries)
+{
+	int ret = io_uring_queue_init(URING_DEPTH, &ring, 0);
+	if(ret < 0) {
+		APP_LOG_WARNING("io_uring unavailable (%s)\n", strerror(-ret));
+		return -1;
+	}
+
+	/* completions wake the logging thread, so it can release slots */
+	ret = io_uring_register_eventfd(&ring, entries->wake_fd);
+	if(ret < 0) {
+		APP_LOG_WARNING("io_uring could not signal the logging thread (%s)\n", strerror(-ret));
+		io_uring_queue_exit(&ring);
+		return -1;
+	}
+
+	ring_entries = entries;
+
+	return 0;
+}
+
+void uringLogExit(void)
+{
+	io_uring_queue_exit(&ring);
+	ring_entries = NULL;
+}
+
+static struct io_uring_sqe *getSqe(void)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+	while(sqe == NULL) {
+		/* submission queue is full, push it to the kernel and try again */
+		io_uring_submit(&ring);
+		sqe = io_uring_get_sqe(&ring);
+	}
+
+	return sqe;
+}
+
+int uringLogOpen(log_file_t *log_file)
+{
+	int file = -1;
+
+	while(true) {
+		for(int i = 0; i < URING_MAX_FILES; i++) {
+			if(!files[i].in_use) {
+				file = i;
+				break;
+			}
+		}
+
+		if(file != -1)
+			break;
+
+		/* previous logs are still being written */
+		APP_LOG_DEBUG("Waiting for a log to close\n");
+		uringLogReap(true);
+	}
+
+	files[file] = (uring_file_t) {
+		.in_use = true,
+		.fd = log_file->fd,
+	};
+
+	log_file->uring_file = file;
+
+	return 0;
+}
+
+/* claim the next write op, waiting for one to retire if all are in flight */
+static uring_op_t *nextWrite(log_file_t *log_file)
+{
+	while(ops_head - ops_tail >= URING_DEPTH) {
+		uringLogReap(true);
+	}
+
+	uring_op_t *op = &ops[ops_head % URING_DEPTH];
+	*op = (uring_op_t) {
+		.file = log_file->uring_file,
+		.offset = log_file->offset,
+		.release_to = SIZE_MAX,
+	};
+
+	return op;
+}
+
+static void submitWrite(log_file_t *log_file, uring_op_t *op)
+{
+	if(files[op->file].failed) {
+		/* it would only land past the end of the log; just retire it in turn */
+		op->done = true;
+		files[op->file].writes++;
+		ops_head++;
+		return;
+	}
+	
+	struct io_uring_sqe *sqe = getSqe();
+
+	io_uring_prep_writev(sqe, files[op->file].fd, op->iov, op->iovcnt, op->offset);
+	io_uring_sqe_set_data(sqe, op);
+
+	for(int i = 0; i < op->iovcnt; i++) {
+		log_file->offset += op->iov[i].iov_len;
+	}
+
+	files[op->file].writes++;
+	ops_head++;
+
+	io_uring_submit(&ring);
+}
+
+int uringLogWriteEntries(
+	log_file_t *log_file,
+	entry_buffer_t *entries,
+	size_t from,
+	size_t to)
+{
+	if(from == to)
+		return 0;
+
+	uring_op_t *op = nextWrite(log_file);
+
+	size_t count = to - from;
+	size_t first = from % ENTRY_BUFFER_COUNT;
+	/* the entries may wrap around the end of the buffer */
+	size_t before_wrap = (count < ENTRY_BUFFER_COUNT - first) ? count : ENTRY_BUFFER_COUNT - first;
+
+	op->iov[0].iov_base = entries->buffer[first];
+	op->iov[0].iov_len  = before_wrap * ENTRY_RECORD_SIZE;
+	op->iov[1].iov_base = entries->buffer[0];
+	op->iov[1].iov_len  = (count - before_wrap) * ENTRY_RECORD_SIZE;
+	op->iovcnt = (count > before_wrap) ? 2 : 1;
+	op->release_to = to;
+
+	submitWrite(log_file, op);
+
+	return 0;
+}
+
+int uringLogWriteBytes(
+	log_file_t *log_file,
+	const uint8_t *data,
+	size_t length)
+{
+	uring_op_t *op = nextWrite(log_file);
+
+	if(length > sizeof(op->bytes)) {
+		APP_LOG_ERROR("io_uring: %u bytes is too many to queue\n", (unsigned)length);
+		return -1;
+	}
+
+	memcpy(op->bytes, data, length);
+	op->iov[0].iov_base = op->bytes;
+	op->iov[0].iov_len  = length;
+	op->iovcnt = 1;
+
+	submitWrite(log_file, op);
+
+	return 0;
+}
+
+int uringLogWriteIndex(log_file_t *log_file)
+{
+	uring_file_t *file = &files[log_file->uring_file];
+	uring_op_t *op = nextWrite(log_file);
+
+	memcpy(file->index, log_file->index, log_file->index_count * sizeof(log_index_entry_t));
+	file->footer[0] = CC_TO_LE32(log_file->index_count);
+	file->footer[1] = CC_TO_LE32(LOG_INDEX_MAGIC);
+
+	op->iov[0].iov_base = file->index;
+	op->iov[0].iov_len  = log_file->index_count * sizeof(log_index_entry_t);
+	op->iov[1].iov_base = file->footer;
+	op->iov[1].iov_len  = sizeof(file->footer);
+	op->iovcnt = 2;
+
+	submitWrite(log_file, op);
+
+	return 0;
+}
+
+int uringLogFinish(log_file_t *log_file, bool flush)
+{
+	uring_file_t *file = &files[log_file->uring_file];
+
+	const uint8_t end = 255;
+	uringLogWriteBytes(log_file, &end, 1);
+	writeLogIndex(log_file);
+
+	file->finishing = true;
+	file->flush = flush;
+	file->length = log_file->offset;
+	describeLog(log_file, &file->record);
+
+	/* the rest happens once the writes complete */
+	log_file->fd = -1;
+	log_file->uring_file = -1;
+
+	return 0;
+}
+
+/* write out whatever a failed or short write left behind, the slow way; -1 if it can not be */
+static int recoverWrite(uring_op_t *op)
+{
+	size_t done = (op->res > 0) ? (size_t)op->res : 0;
+	off_t offset = op->offset + done;
+
+	if(op->res < 0) {
+		APP_LOG_WARNING("io_uring: write failed (%s), retrying\n", strerror(-op->res));
+	}
+
+	/* step over what was written, which may end part way through an iovec */
+	struct iovec *next = op->iov;
+	int iovcnt = op->iovcnt;
+	while(iovcnt > 0 && done >= next->iov_len) {
+		done -= next->iov_len;
+		++next;
+		--iovcnt;
+	}
+	if(iovcnt > 0) {
+		next->iov_base = (uint8_t *)next->iov_base + done;
+		next->iov_len -= done;
+	}
+
+	while(iovcnt > 0) {
+		ssize_t written = pwritev(files[op->file].fd, next, iovcnt, offset);
+		if(written == -1) {
+			if(errno == EDQUOT || errno == ENOSPC) {
+				APP_LOG_WARNING("Write failed, clearing space...\n");
+				if(deleteOldest() == -1) {
+					APP_LOG_ERROR("io_uring: write could not be recovered, nothing left to delete\n");
+					return -1;
+				}
+			}
+			else if(errno != EINTR && errno != EAGAIN) {
+				APP_LOG_ERROR("io_uring: write could not be recovered (%s)\n", strerror(errno));
+				return -1;
+			}
+			continue;
+		}
+
+		offset += written;
+		while(iovcnt > 0 && (size_t)written >= next->iov_len) {
+			written -= next->iov_len;
+			++next;
+			--iovcnt;
+		}
+		if(iovcnt > 0) {
+			next->iov_base = (uint8_t *)next->iov_base + written;
+			next->iov_len -= written;
+		}
+	}
+
+	return 0;
+}
+
+void retireWrites(void)
+{
+	while(ops_tail != ops_head && ops[ops_tail % URING_DEPTH].done) {
+		uring_op_t *op = &ops[ops_tail % URING_DEPTH];
+
+		size_t expected = 0;
+		for(int i = 0; i < op->iovcnt; i++) {
+			expected += op->iov[i].iov_len;
+		}
+
+		uring_file_t *file = &files[op->file];
+
+		/* after a failure, whatever follows is cut off anyway */
+		if(!file->failed && (op->res < 0 || (size_t)op->res < expected) && recoverWrite(op) == -1) {
+			/*
+			Later writes were queued at offsets past this one, and would
+			leave a hole in the log, so it ends where this write started
+			*/
+			APP_LOG_ERROR("io_uring: ending log at %lld, later entries are lost\n", (long long)op->offset);
+			file->failed = true;
+			file->failed_at = op->offset;
+		}
+
+		/* the kernel has its own copy now, or it is lost, so the slots can be reused */
+		if(op->release_to != SIZE_MAX) {
+			atomic_store_explicit(&ring_entries->tail, op->release_to, memory_order_release);
+		}
+
+		file->writes--;
+		ops_tail++;
+
+		/* trimming, syncing and closing block, so they are left to housekeeping */
+		if(file->finishing && file->writes == 0) {
+			off_t length = (file->failed && file->failed_at < file->length) ? file->failed_at : file->length;
+			closeFinishedLog(file->fd, length, file->flush, &file->record);
+			file->in_use = false;
+		}
+	}
+}
+
+void uringLogReap(bool wait)
+{
+	struct io_uring_cqe *cqe;
+
+	/* writes to a failed log never reach the kernel, so may already be done */
+	retireWrites();
+
+	if(wait && ops_tail != ops_head && io_uring_wait_cqe(&ring, &cqe) < 0)
+		return;
+
+	while(io_uring_peek_cqe(&ring, &cqe) == 0) {
+		uring_op_t *op = io_uring_cqe_get_data(cqe);
+		op->res = cqe->res;
+		op->done = true;
+		io_uring_cqe_seen(&ring, cqe);
+	}
+
+	retireWrites();
+}
@@ -0,0 +1,111 @@
+#ifndef APP_FILELOGGER_URING_H
+#define APP_FILELOGGER_URING_H
+
+/**
+ * @file
+ * @brief io_uring backend for log file I/O
+ *
+ * Queues log writes so the logging thread never waits for the storage
+ * device. Completions are reaped whenever the logging thread wakes; entry
+ * buffer slots are handed back to addLogEntry in order as their writes
+ * complete, and finished logs to the housekeeping thread to be closed.
+ * A write that can not be recovered ends its log where that write
+ * started, rather than leave a hole, and the rest of that log is dropped.
+ *
+ * Only built when LOGGER_USE_IO_URING is enabled.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "app_filelogger.h"
+
+/* queued operations, also the bound on writes in flight */
+#define URING_DEPTH     64
+/* files whose last writes may still be in flight at the same time as the current one */
+#define URING_MAX_FILES 4
+
+/**
+ * Set up the io_uring instance. Completions signal entries->wake_fd.
+ *
+ * @param entries          In:    buffer whose slots are released as writes complete
+ * @return 0 on success, -1 if io_uring is unavailable
+ */
+int uringLogInit(entry_buffer_t *entries);
+
+/**
+ * Tear down what uringLogInit set up, before any log was opened
+ */
+void uringLogExit(void);
+
+/**
+ * Start tracking a newly opened log file, whose header has already
+ * been written. Waits for a finished file's writes if all are in use.
+ *
+ * @param log_file         InOut: log with fd and offset set
+ * @return 0 on success, -1 on error
+ */
+int uringLogOpen(log_file_t *log_file);
+
+/**
+ * Queue entries from the entry buffer to be written to the log.
+ * Their slots are released once written.
+ *
+ * @param log_file         InOut
+ * @param entries          In:    buffer holding the entries
+ * @param from             In:    index of the first entry to write
+ * @param to               In:    index after the last entry to write
+ * @return 0 on success, -1 on error
+ */
+int uringLogWriteEntries(
+	log_file_t *log_file,
+	entry_buffer_t *entries,
+	size_t from,
+	size_t to);
+
+/**
+ * Queue a few bytes to be written to the log. The data is copied.
+ *
+ * @param log_file         InOut
+ * @param data             In
+ * @param length           In:    at most 16 bytes
+ * @return 0 on success, -1 on error
+ */
+int uringLogWriteBytes(
+	log_file_t *log_file,
+	const uint8_t *data,
+	size_t length);
+
+/**
+ * Queue the index of the log and its footer, written from a copy
+ * so log_file can move on to the next log straight away
+ *
+ * @param log_file         InOut
+ * @return 0 on success, -1 on error
+ */
+int uringLogWriteIndex(log_file_t *log_file);
+
+/**
+ * Queue the end of the log: once all its writes are done it is passed
+ * to closeFinishedLog. Returns straight away, with log_file->fd set to -1.
+ *
+ * @param log_file         InOut
+ * @param flush            In:    whether to sync before closing
+ * @return 0 on success, -1 on error
+ */
+int uringLogFinish(log_file_t *log_file, bool flush);
+
+/**
+ * Handle completed writes, releasing entry buffer slots
+ * and handing over finished files
+ *
+ * @param wait             In:    block until at least one completes
+ */
+void uringLogReap(bool wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APP_FILELOGGER_URING_H */
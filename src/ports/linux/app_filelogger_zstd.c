@@ -0,0 +1,235 @@
+#define _GNU_SOURCE /* For scandirat() */
+
+#include "app_filelogger_zstd.h"
+#include "app_filelogger.h"
+
+#include "app_log.h"
+#include "app_fileutils.h"
+
+#include <zstd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+static int isLog(const struct dirent *entry)
+{
+	size_t length = strlen(entry->d_name);
+
+	return length > 4
+		&& length < ZSTD_ARCHIVE_NAME_SIZE
+		&& strcmp(entry->d_name + length - 4, ".bin") == 0;
+}
+
+/* stream one log into a frame of its own, adding it to entry */
+static int compressLog(
+	ZSTD_CCtx *cctx,
+	int in_fd,
+	int out_fd,
+	uint8_t *in_buffer,
+	size_t in_size,
+	uint8_t *out_buffer,
+	size_t out_size,
+	zstd_archive_entry_t *entry)
+{
+	struct stat statbuf;
+	if(fstat(in_fd, &statbuf) == -1)
+		return -1;
+
+	ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+	/* puts the size in the frame header, which readers can use to size their buffer */
+	ZSTD_CCtx_setPledgedSrcSize(cctx, statbuf.st_size);
+
+	uint64_t size = 0;
+	uint64_t compressed_size = 0;
+	bool last = false;
+
+	while(!last) {
+		ssize_t got = read(in_fd, in_buffer, in_size);
+		if(got == -1) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		size += got;
+		last = (got == 0 || size == (uint64_t)statbuf.st_size);
+
+		ZSTD_inBuffer input = { in_buffer, got, 0 };
+		ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+		size_t remaining;
+
+		do {
+			ZSTD_outBuffer output = { out_buffer, out_size, 0 };
+			remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+			if(ZSTD_isError(remaining)) {
+				APP_LOG_ERROR("Archiving: %s\n", ZSTD_getErrorName(remaining));
+				return -1;
+			}
+
+			if(writeAll(out_fd, out_buffer, output.pos, NULL) == -1)
+				return -1;
+			compressed_size += output.pos;
+		} while(last ? remaining != 0 : input.pos != input.size);
+	}
+
+	if(size > UINT32_MAX || compressed_size > UINT32_MAX) {
+		APP_LOG_ERROR("Archiving: %s is too large\n", entry->name);
+		return -1;
+	}
+
+	entry->size = htole32((uint32_t)size);
+	entry->compressed_size = htole32((uint32_t)compressed_size);
+
+	return 0;
+}
+
+static int writeIndex(int fd, zstd_archive_entry_t *index, uint32_t count)
+{
+	uint32_t header[2] = {
+		htole32(ZSTD_ARCHIVE_SKIPPABLE_MAGIC),
+		htole32(count * sizeof(zstd_archive_entry_t) + 8),
+	};
+	uint32_t footer[2] = {
+		htole32(count),
+		htole32(ZSTD_ARCHIVE_INDEX_MAGIC),
+	};
+
+	if(writeAll(fd, header, sizeof(header), NULL) == -1
+		|| writeAll(fd, index, count * sizeof(zstd_archive_entry_t), NULL) == -1
+		|| writeAll(fd, footer, sizeof(footer), NULL) == -1) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int zstdArchiveDirectory(const char *directory, int level)
+{
+	int logdir_fd = getLogDir();
+	if(logdir_fd == -1)
+		return -1;
+
+	struct dirent **logs;
+	/* names sort in time order */
+	int count = scandirat(logdir_fd, directory, &logs, isLog, alphasort);
+	if(count == -1) {
+		APP_LOG_ERROR("Archiving: Failed to list %s\n", directory);
+		return -1;
+	}
+
+	int dir_fd = openat(logdir_fd, directory, O_DIRECTORY | O_CLOEXEC);
+
+	char archive[32];
+	char partial[40];
+	snprintf(archive, sizeof(archive), "%s" ZSTD_ARCHIVE_SUFFIX, directory);
+	snprintf(partial, sizeof(partial), "%s.part", archive);
+
+	int out_fd = openat(logdir_fd, partial, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH /* owner RW, others R */);
+
+	size_t in_size = ZSTD_CStreamInSize();
+	size_t out_size = ZSTD_CStreamOutSize();
+	uint8_t *in_buffer = malloc(in_size);
+	uint8_t *out_buffer = malloc(out_size);
+	zstd_archive_entry_t *index = calloc(count > 0 ? count : 1, sizeof(zstd_archive_entry_t));
+	ZSTD_CCtx *cctx = ZSTD_createCCtx();
+
+	int ret = -1;
+	uint64_t in_total = 0;
+	uint64_t offset = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if(dir_fd == -1 || out_fd == -1 || in_buffer == NULL || out_buffer == NULL || index == NULL || cctx == NULL) {
+		APP_LOG_ERROR("Archiving: Failed to start on %s\n", directory);
+		goto cleanup;
+	}
+
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+
+	for(int i = 0; i < count; i++) {
+		zstd_archive_entry_t *entry = &index[i];
+		strncpy(entry->name, logs[i]->d_name, sizeof(entry->name));
+		entry->offset = htole64(offset);
+
+		int in_fd = openat(dir_fd, logs[i]->d_name, O_RDONLY | O_CLOEXEC);
+		if(in_fd == -1) {
+			APP_LOG_ERROR("Archiving: Failed to open %s/%s\n", directory, logs[i]->d_name);
+			goto cleanup;
+		}
+
+		int log_ret = compressLog(cctx, in_fd, out_fd, in_buffer, in_size, out_buffer, out_size, entry);
+
+		/* it has been read once and will be deleted, no need to cache it */
+		posix_fadvise(in_fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(in_fd);
+
+		if(log_ret == -1) {
+			APP_LOG_ERROR("Archiving: Failed to compress %s/%s\n", directory, logs[i]->d_name);
+			goto cleanup;
+		}
+
+		in_total += le32toh(entry->size);
+		offset += le32toh(entry->compressed_size);
+	}
+
+	if(writeIndex(out_fd, index, count) == -1 || fsync(out_fd) == -1) {
+		APP_LOG_ERROR("Archiving: Failed to write %s\n", partial);
+		goto cleanup;
+	}
+
+	if(renameat(logdir_fd, partial, logdir_fd, archive) == -1) {
+		APP_LOG_ERROR("Archiving: Failed to rename %s\n", partial);
+		goto cleanup;
+	}
+
+	/* only the logs that went into it, anything else in the directory stays */
+	for(int i = 0; i < count; i++) {
+		if(unlinkat(dir_fd, logs[i]->d_name, 0) == -1) {
+			APP_LOG_WARNING("Archiving: \e[31mFailed to delete %s/%s\e[0m\n", directory, logs[i]->d_name);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	APP_LOG_INFO("Archiving: %d logs, %.1f MB to %.1f MB in %.1f s (%.1f MB/s)\n",
+		count,
+		in_total / 1e6,
+		offset / 1e6,
+		seconds,
+		(seconds > 0) ? in_total / 1e6 / seconds : 0.0);
+
+	ret = 0;
+
+cleanup:
+	if(ret == -1 && out_fd != -1) {
+		unlinkat(logdir_fd, partial, 0);
+	}
+	if(out_fd != -1)
+		close(out_fd);
+	if(dir_fd != -1)
+		close(dir_fd);
+
+	ZSTD_freeCCtx(cctx);
+	free(index);
+	free(out_buffer);
+	free(in_buffer);
+
+	for(int i = 0; i < count; i++) {
+		free(logs[i]);
+	}
+	free(logs);
+
+	return ret;
+}
@@ -0,0 +1,65 @@
+#ifndef APP_FILELOGGER_ZSTD_H
+#define APP_FILELOGGER_ZSTD_H
+
+/**
+ * @file
+ * @brief zstd archiver for finished days of logs
+ *
+ * Compresses a day directory in process, rather than forking tar.
+ * Each log becomes its own zstd frame, so any one of them can be
+ * decompressed without touching the rest, and the archive ends with a
+ * skippable frame indexing them:
+ *
+ *   frame per log, in name (= time) order
+ *   skippable frame:
+ *     magic    u32 LE   ZSTD_ARCHIVE_SKIPPABLE_MAGIC
+ *     size     u32 LE   bytes that follow in this frame
+ *     entries  count * zstd_archive_entry_t
+ *     count    u32 LE
+ *     magic    u32 LE   ZSTD_ARCHIVE_INDEX_MAGIC
+ *
+ * As the index is a skippable frame, `zstd -d` on an archive simply gives
+ * the logs one after another.
+ *
+ * Only built when LOGGER_USE_ZSTD is enabled.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define ZSTD_ARCHIVE_SUFFIX          ".zst"
+#define ZSTD_ARCHIVE_SKIPPABLE_MAGIC 0x184D2A5E
+#define ZSTD_ARCHIVE_INDEX_MAGIC     0x495A4E50 /* "PNZI" */
+#define ZSTD_ARCHIVE_NAME_SIZE       16
+
+/* all fields little endian */
+typedef struct zstd_archive_entry
+{
+	char name[ZSTD_ARCHIVE_NAME_SIZE]; /* NUL padded */
+	uint64_t offset;                   /* of the frame from the start of the archive */
+	uint32_t compressed_size;
+	uint32_t size;
+} zstd_archive_entry_t;
+
+/**
+ * Compress the logs of a day directory into directory.zst
+ * under the log directory.
+ *
+ * The archive is written under a temporary name and only renamed
+ * into place once complete. Then the logs it holds are deleted;
+ * the directory, and any other files in it, are left alone.
+ *
+ * @param directory        In:    Name of the directory under log directory
+ * @param level            In:    zstd compression level
+ * @return 0 on success, -1 on error
+ */
+int zstdArchiveDirectory(const char *directory, int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APP_FILELOGGER_ZSTD_H */
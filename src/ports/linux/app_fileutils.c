@@ -0,0 +1,30 @@
+#include "app_fileutils.h"
+
+#include <stdint.h>
+
+#include <unistd.h>
+#include <errno.h>
+
+int writeAll(int fd, const void *data, size_t length, size_t *written)
+{
+	const uint8_t *start = data;
+	size_t done = 0;
+	int ret = 0;
+
+	while(done < length) {
+		ssize_t count = write(fd, start + done, length - done);
+		if(count == -1) {
+			if(errno == EINTR)
+				continue;
+			ret = -1;
+			break;
+		}
+		done += count;
+	}
+
+	if(written != NULL) {
+		*written = done;
+	}
+
+	return ret;
+}
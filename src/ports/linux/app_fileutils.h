@@ -0,0 +1,31 @@
+#ifndef APP_FILEUTILS_H
+#define APP_FILEUTILS_H
+
+/**
+ * @file
+ * @brief File helpers shared by the logger, logbench and pnet2csv
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * Write all of a buffer to a file, carrying on after partial writes
+ * and interrupted system calls
+ *
+ * @param fd               In
+ * @param data             In
+ * @param length           In
+ * @param written          Out:   bytes written, also on error. May be NULL
+ * @return 0 on success, -1 on error with errno set
+ */
+int writeAll(int fd, const void *data, size_t length, size_t *written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APP_FILEUTILS_H */
@@ -0,0 +1,549 @@
+#include "app_logcatalog.h"
+#include "app_fileutils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <endian.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define NS_PER_S 1000000000LL
+#define SECONDS_PER_DAY 86400
+
+/* written in full, then renamed over the catalog */
+#define CATALOG_TEMP "catalog.tmp"
+
+_Static_assert(sizeof(log_catalog_record_t) == 64, "catalog records are not packed");
+
+static void recordToDisk(const log_catalog_record_t *record, log_catalog_record_t *out)
+{
+	*out = *record;
+	out->entries = htole32(record->entries);
+	out->dropped = htole32(record->dropped);
+	out->reserved2 = htole32(record->reserved2);
+	out->first = (int64_t)htole64((uint64_t)record->first);
+	out->last = (int64_t)htole64((uint64_t)record->last);
+}
+
+static void recordFromDisk(log_catalog_record_t *record)
+{
+	record->entries = le32toh(record->entries);
+	record->dropped = le32toh(record->dropped);
+	record->reserved2 = le32toh(record->reserved2);
+	record->first = (int64_t)le64toh((uint64_t)record->first);
+	record->last = (int64_t)le64toh((uint64_t)record->last);
+	/* whatever is in the file, the name ends */
+	record->name[LOG_CATALOG_NAME_SIZE - 1] = '\0';
+}
+
+static int readFully(int fd, void *data, size_t length)
+{
+	size_t start = 0;
+
+	while(start < length) {
+		ssize_t got = read(fd, (uint8_t *)data + start, length - start);
+		if(got == -1 && errno == EINTR)
+			continue;
+		if(got <= 0)
+			return -1;
+		start += got;
+	}
+
+	return 0;
+}
+
+/* days since 1970-01-01 of a date in the proleptic Gregorian calendar */
+static int64_t daysFromCivil(int64_t year, unsigned int month, unsigned int day)
+{
+	year -= (month <= 2);
+	int64_t era = (year >= 0 ? year : year - 399) / 400;
+	unsigned int year_of_era = (unsigned int)(year - era * 400);
+	unsigned int day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	unsigned int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+	return era * 146097 + (int64_t)day_of_era - 719468;
+}
+
+int64_t logCatalogTime(const uint8_t *dtl, bool bigendian)
+{
+	uint16_t year;
+	uint32_t nano;
+
+	memcpy(&year, dtl, 2);
+	memcpy(&nano, dtl + 8, 4);
+	year = bigendian ? be16toh(year) : le16toh(year);
+	nano = bigendian ? be32toh(nano) : le32toh(nano);
+
+	int64_t days = daysFromCivil(year, dtl[2], dtl[3]);
+	int64_t seconds = (dtl[5] * 60 + dtl[6]) * 60 + dtl[7];
+
+	return (days * SECONDS_PER_DAY + seconds) * NS_PER_S + nano;
+}
+
+uint32_t logCatalogDate(const char *name)
+{
+	unsigned int year, month, day;
+
+	for(int i = 0; i < 8; i++) {
+		if(name[i] < '0' || name[i] > '9')
+			return 0;
+	}
+
+	const char *rest = name + 8;
+
+	if(*rest != '\0' && *rest != '/' && strcmp(rest, ".zst") != 0 && strcmp(rest, ".tgz") != 0)
+		return 0;
+
+	if(sscanf(name, "%4u%2u%2u", &year, &month, &day) != 3
+		|| month < 1 || month > 12 || day < 1 || day > 31) {
+		return 0;
+	}
+
+	return year * 10000 + month * 100 + day;
+}
+
+int logCatalogRead(int dir_fd, log_catalog_record_t **records, size_t *count)
+{
+	uint32_t header[2];
+	struct stat statbuf;
+	int ret = -1;
+
+	*records = NULL;
+	*count = 0;
+
+	int fd = openat(dir_fd, LOG_CATALOG_NAME, O_RDONLY | O_CLOEXEC);
+	if(fd == -1)
+		return -1;
+
+	if(fstat(fd, &statbuf) == 0
+		&& readFully(fd, header, sizeof(header)) == 0
+		&& le32toh(header[0]) == LOG_CATALOG_MAGIC
+		&& le32toh(header[1]) == LOG_CATALOG_VERSION) {
+		/* one being appended to may end part way through a record */
+		size_t n = (statbuf.st_size - LOG_CATALOG_HEADER_SIZE) / sizeof(log_catalog_record_t);
+
+		*records = malloc((n > 0 ? n : 1) * sizeof(log_catalog_record_t));
+		if(*records != NULL && readFully(fd, *records, n * sizeof(log_catalog_record_t)) == 0) {
+			for(size_t i = 0; i < n; i++) {
+				recordFromDisk(&(*records)[i]);
+			}
+			*count = n;
+			ret = 0;
+		}
+	}
+
+	if(ret == -1) {
+		free(*records);
+		*records = NULL;
+	}
+	close(fd);
+
+	return ret;
+}
+
+void logCatalogInit(log_catalog_t *catalog)
+{
+	memset(catalog, 0, sizeof(*catalog));
+	catalog->dir_fd = -1;
+	catalog->fd = -1;
+}
+
+/* where a day is or would go */
+static size_t dayPosition(const log_catalog_t *catalog, uint32_t date)
+{
+	size_t low = 0;
+	size_t high = catalog->day_count;
+
+	while(low < high) {
+		size_t middle = low + (high - low) / 2;
+		if(catalog->days[middle].date < date) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+log_catalog_day_t *logCatalogFindDay(log_catalog_t *catalog, uint32_t date)
+{
+	size_t i = dayPosition(catalog, date);
+
+	return (i < catalog->day_count && catalog->days[i].date == date) ? &catalog->days[i] : NULL;
+}
+
+/* the day, added as deleted if there was none, NULL if out of memory */
+static log_catalog_day_t *addDay(log_catalog_t *catalog, uint32_t date)
+{
+	size_t i = dayPosition(catalog, date);
+
+	if(i < catalog->day_count && catalog->days[i].date == date)
+		return &catalog->days[i];
+
+	if(catalog->day_count == catalog->day_capacity) {
+		size_t capacity = catalog->day_capacity ? 2 * catalog->day_capacity : 64;
+		log_catalog_day_t *grown = realloc(catalog->days, capacity * sizeof(log_catalog_day_t));
+		if(grown == NULL)
+			return NULL;
+		catalog->days = grown;
+		catalog->day_capacity = capacity;
+	}
+
+	/* days mostly come in order, so this is mostly at the end */
+	memmove(&catalog->days[i + 1], &catalog->days[i], (catalog->day_count - i) * sizeof(log_catalog_day_t));
+	catalog->day_count++;
+	if(i < catalog->oldest) {
+		catalog->oldest = i;
+	}
+
+	log_catalog_day_t *day = &catalog->days[i];
+	memset(day, 0, sizeof(*day));
+	day->date = date;
+	day->state = LOG_CATALOG_DELETED;
+
+	return day;
+}
+
+int logCatalogApply(log_catalog_t *catalog, const log_catalog_record_t *record)
+{
+	uint32_t date = logCatalogDate(record->name);
+	size_t index = catalog->records;
+
+	/* of no day, so of no use */
+	if(date == 0) {
+		catalog->records++;
+		return 0;
+	}
+
+	log_catalog_day_t *day = addDay(catalog, date);
+	if(day == NULL)
+		return -1;
+	catalog->records++;
+
+	if(record->type == LOG_CATALOG_DELETED) {
+		if(day->state != LOG_CATALOG_DELETED) {
+			catalog->live -= day->records;
+			day->state = LOG_CATALOG_DELETED;
+		}
+		return 0;
+	}
+
+	/* anything else of a deleted day starts it again */
+	if(day->state == LOG_CATALOG_DELETED) {
+		memset(day, 0, sizeof(*day));
+		day->date = date;
+		day->state = LOG_CATALOG_DAY;
+		snprintf(day->name, sizeof(day->name), "%08u", (unsigned int)date);
+		day->first = INT64_MAX;
+		day->last = INT64_MIN;
+		day->since = index;
+	}
+	day->records++;
+	catalog->live++;
+
+	switch(record->type) {
+	case LOG_CATALOG_DAY:
+		if(record->flags & LOG_CATALOG_PARTIAL) {
+			day->partial = true;
+		}
+		break;
+	case LOG_CATALOG_LOG:
+		day->logs++;
+		day->entries += record->entries;
+		day->dropped += record->dropped;
+		if(record->entries > 0) {
+			day->first = (record->first < day->first) ? record->first : day->first;
+			day->last = (record->last > day->last) ? record->last : day->last;
+		}
+		break;
+	case LOG_CATALOG_ARCHIVED:
+		day->state = LOG_CATALOG_ARCHIVED;
+		memcpy(day->name, record->name, sizeof(day->name));
+		day->name[sizeof(day->name) - 1] = '\0';
+		break;
+	}
+
+	return 0;
+}
+
+static void forgetDays(log_catalog_t *catalog)
+{
+	free(catalog->days);
+	catalog->days = NULL;
+	catalog->day_count = 0;
+	catalog->day_capacity = 0;
+	catalog->oldest = 0;
+	catalog->records = 0;
+	catalog->live = 0;
+}
+
+/* a new catalog with only its header, open for appending; -1 on error */
+static int createCatalog(int dir_fd, const char *name)
+{
+	uint32_t header[2] = {
+		htole32(LOG_CATALOG_MAGIC),
+		htole32(LOG_CATALOG_VERSION),
+	};
+
+	int fd = openat(dir_fd, name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+		S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH /* owner RW, others R */);
+	if(fd == -1)
+		return -1;
+
+	if(writeAll(fd, header, sizeof(header), NULL) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+Write the catalog again, without the records of deleted days,
+and take the days from that
+*/
+static int compact(log_catalog_t *catalog)
+{
+	log_catalog_record_t *records;
+	size_t count;
+
+	if(logCatalogRead(catalog->dir_fd, &records, &count) == -1)
+		return -1;
+
+	/* going through them all leaves each day with where its records since it was last deleted start */
+	log_catalog_t all;
+	logCatalogInit(&all);
+	int ret = 0;
+	for(size_t i = 0; i < count && ret == 0; i++) {
+		ret = logCatalogApply(&all, &records[i]);
+	}
+
+	size_t kept = 0;
+	for(size_t i = 0; i < count && ret == 0; i++) {
+		log_catalog_day_t *day = logCatalogFindDay(&all, logCatalogDate(records[i].name));
+		if(day != NULL && day->state != LOG_CATALOG_DELETED && i >= day->since) {
+			records[kept++] = records[i];
+		}
+	}
+	logCatalogFree(&all);
+
+	int fd = (ret == 0) ? createCatalog(catalog->dir_fd, CATALOG_TEMP) : -1;
+	for(size_t i = 0; i < kept && fd != -1; i++) {
+		log_catalog_record_t out;
+		recordToDisk(&records[i], &out);
+		if(writeAll(fd, &out, sizeof(out), NULL) == -1) {
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	if(fd != -1 && (fdatasync(fd) == -1 || renameat(catalog->dir_fd, CATALOG_TEMP, catalog->dir_fd, LOG_CATALOG_NAME) == -1)) {
+		close(fd);
+		fd = -1;
+	}
+
+	if(fd == -1) {
+		unlinkat(catalog->dir_fd, CATALOG_TEMP, 0);
+		free(records);
+		return -1;
+	}
+
+	/* the new one is appended to from here on */
+	if(catalog->fd != -1) {
+		close(catalog->fd);
+	}
+	catalog->fd = fd;
+
+	forgetDays(catalog);
+	for(size_t i = 0; i < kept && ret == 0; i++) {
+		ret = logCatalogApply(catalog, &records[i]);
+	}
+	free(records);
+
+	return ret;
+}
+
+/* as logCatalogAppend, without writing the catalog again */
+static int appendRecord(log_catalog_t *catalog, const log_catalog_record_t *record)
+{
+	log_catalog_record_t out;
+	int ret = 0;
+
+	recordToDisk(record, &out);
+
+	off_t size = (catalog->fd != -1) ? lseek(catalog->fd, 0, SEEK_END) : -1;
+	if(size == -1 || writeAll(catalog->fd, &out, sizeof(out), NULL) == -1 || fdatasync(catalog->fd) == -1) {
+		/* not leaving part of it behind, or the records after it would be out of step */
+		if(size != -1 && ftruncate(catalog->fd, size) == -1) {
+			close(catalog->fd);
+			catalog->fd = -1;
+		}
+		ret = -1;
+	}
+
+	if(logCatalogApply(catalog, record) == -1) {
+		ret = -1;
+	}
+
+	return ret;
+}
+
+/* once the records of deleted days make up half of it */
+static void compactIfDue(log_catalog_t *catalog)
+{
+	if(catalog->records >= LOG_CATALOG_COMPACT_MIN && 2 * catalog->live <= catalog->records) {
+		compact(catalog);
+	}
+}
+
+/* whether there is something by that name in the log directory */
+static bool present(const log_catalog_t *catalog, const char *name)
+{
+	struct stat statbuf;
+
+	return fstatat(catalog->dir_fd, name, &statbuf, 0) == 0 || errno != ENOENT;
+}
+
+/*
+Bring the days in line with the log directory: ones there the catalog
+does not know of are added, and ones it has that are gone are deleted.
+A day that is not archived may hold the log that was being written
+when the logger last stopped, which never got a record, so it is
+marked partial.
+*/
+static int reconcile(log_catalog_t *catalog)
+{
+	int fd = openat(catalog->dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(fd == -1)
+		return -1;
+
+	DIR *dirp = fdopendir(fd);
+	if(dirp == NULL) {
+		close(fd);
+		return -1;
+	}
+
+	int ret = 0;
+	struct dirent *entry;
+
+	for(entry = readdir(dirp); entry != NULL; entry = readdir(dirp)) {
+		uint32_t date = logCatalogDate(entry->d_name);
+		if(date == 0)
+			continue;
+
+		log_catalog_day_t *day = logCatalogFindDay(catalog, date);
+		log_catalog_record_t record = {0};
+		bool archive = (entry->d_name[8] != '\0');
+
+		if(archive && (day == NULL || day->state != LOG_CATALOG_ARCHIVED)) {
+			record.type = LOG_CATALOG_ARCHIVED;
+		}
+		else if(!archive && (day == NULL || day->state == LOG_CATALOG_DELETED
+			|| (day->state == LOG_CATALOG_DAY && !day->partial))) {
+			record.type = LOG_CATALOG_DAY;
+			record.flags = LOG_CATALOG_PARTIAL;
+		}
+		else {
+			continue;
+		}
+
+		strcpy(record.name, entry->d_name);
+		if(appendRecord(catalog, &record) == -1) {
+			ret = -1;
+		}
+	}
+
+	closedir(dirp);
+
+	/* deleting a day adds none, so the days stay where they are */
+	for(size_t i = catalog->oldest; i < catalog->day_count; i++) {
+		log_catalog_day_t *day = &catalog->days[i];
+
+		if(day->state != LOG_CATALOG_DELETED && !present(catalog, day->name)) {
+			log_catalog_record_t record = { .type = LOG_CATALOG_DELETED };
+			strcpy(record.name, day->name);
+			if(appendRecord(catalog, &record) == -1) {
+				ret = -1;
+			}
+		}
+	}
+
+	return ret;
+}
+
+int logCatalogOpen(log_catalog_t *catalog, int dir_fd)
+{
+	log_catalog_record_t *records;
+	size_t count;
+
+	logCatalogInit(catalog);
+	catalog->dir_fd = dir_fd;
+
+	if(logCatalogRead(dir_fd, &records, &count) == 0) {
+		int ret = 0;
+		for(size_t i = 0; i < count && ret == 0; i++) {
+			ret = logCatalogApply(catalog, &records[i]);
+		}
+		free(records);
+
+		if(ret == -1) {
+			logCatalogFree(catalog);
+			return -1;
+		}
+
+		catalog->fd = openat(dir_fd, LOG_CATALOG_NAME, O_WRONLY | O_APPEND | O_CLOEXEC);
+
+		/* drop a record cut short, so the next one lands in its place */
+		if(catalog->fd != -1
+			&& ftruncate(catalog->fd, LOG_CATALOG_HEADER_SIZE + count * sizeof(log_catalog_record_t)) == -1) {
+			close(catalog->fd);
+			catalog->fd = -1;
+		}
+	}
+
+	/* none, or not one that can be read: start again from the directory */
+	if(catalog->fd == -1) {
+		forgetDays(catalog);
+		catalog->fd = createCatalog(dir_fd, LOG_CATALOG_NAME);
+		if(catalog->fd == -1)
+			return -1;
+	}
+
+	int ret = reconcile(catalog);
+	compactIfDue(catalog);
+
+	return ret;
+}
+
+int logCatalogAppend(log_catalog_t *catalog, const log_catalog_record_t *record)
+{
+	int ret = appendRecord(catalog, record);
+	compactIfDue(catalog);
+
+	return ret;
+}
+
+void logCatalogFree(log_catalog_t *catalog)
+{
+	if(catalog->fd != -1) {
+		close(catalog->fd);
+	}
+	free(catalog->days);
+	logCatalogInit(catalog);
+}
+
+log_catalog_day_t *logCatalogOldest(log_catalog_t *catalog)
+{
+	while(catalog->oldest < catalog->day_count && catalog->days[catalog->oldest].state == LOG_CATALOG_DELETED) {
+		catalog->oldest++;
+	}
+
+	return (catalog->oldest < catalog->day_count) ? &catalog->days[catalog->oldest] : NULL;
+}
@@ -0,0 +1,210 @@
+#ifndef APP_LOGCATALOG_H
+#define APP_LOGCATALOG_H
+
+/**
+ * @file
+ * @brief Catalog of the logs in the log directory
+ *
+ * The logger keeps LOG_CATALOG_NAME in the log directory, so it knows
+ * the oldest day and the days left to archive without going through the
+ * directory, and readers know the span of a log without opening it.
+ * It starts with an 8 byte header:
+ *
+ *   magic      u32 LE   LOG_CATALOG_MAGIC
+ *   version    u32 LE   LOG_CATALOG_VERSION
+ *
+ * followed by log_catalog_record_t, only ever appended, each saying
+ * what happened to a day or to one of its logs:
+ *
+ *   LOG_CATALOG_DAY       the day's directory, name yyyymmdd, was started.
+ *                         With LOG_CATALOG_PARTIAL, it was already there,
+ *                         and may hold logs the catalog does not know of
+ *   LOG_CATALOG_LOG       the log, name yyyymmdd/hh-mm.bin, was finished:
+ *                         the times of its first and last entries, how
+ *                         many it holds, and how many were dropped while
+ *                         it was being written
+ *   LOG_CATALOG_ARCHIVED  the day was archived as name, yyyymmdd.zst or
+ *                         yyyymmdd.tgz, which holds its logs from then on
+ *   LOG_CATALOG_DELETED   the day, by whatever name it had, was deleted
+ *
+ * Times are nanoseconds since 1970 by the PLC's clock, which has no zone.
+ * A record cut short by a crash is dropped when the catalog is next
+ * opened for writing. Once the records of deleted days make up half of
+ * it, the catalog is written again without them.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_CATALOG_NAME      "catalog.bin"
+#define LOG_CATALOG_MAGIC     0x43534E50 /* "PNSC" */
+#define LOG_CATALOG_VERSION   1
+#define LOG_CATALOG_HEADER_SIZE 8
+
+/* as log_file_t's, yyyymmdd/hh-mm_n.bin and the terminator */
+#define LOG_CATALOG_NAME_SIZE 32
+
+#define LOG_CATALOG_DAY       1
+#define LOG_CATALOG_LOG       2
+#define LOG_CATALOG_ARCHIVED  3
+#define LOG_CATALOG_DELETED   4
+
+/* flags of LOG_CATALOG_DAY */
+#define LOG_CATALOG_PARTIAL   0x01
+
+/* not written again for fewer records than this, however many are dead */
+#define LOG_CATALOG_COMPACT_MIN 1024
+
+/* all fields little endian on disk, host order once read */
+typedef struct log_catalog_record
+{
+	uint8_t type;
+	uint8_t flags;
+	uint8_t reserved[2];
+	uint32_t entries;
+	uint32_t dropped;
+	uint32_t reserved2;
+	int64_t first;
+	int64_t last;
+	char name[LOG_CATALOG_NAME_SIZE];
+} log_catalog_record_t;
+
+/* what the records so far say of a day */
+typedef struct log_catalog_day
+{
+	/* yyyymmdd as a number, so days sort by it */
+	uint32_t date;
+	/* LOG_CATALOG_DAY, LOG_CATALOG_ARCHIVED or LOG_CATALOG_DELETED */
+	uint8_t state;
+	/* may hold logs without a LOG_CATALOG_LOG record */
+	bool partial;
+	/* as it is in the log directory */
+	char name[LOG_CATALOG_NAME_SIZE];
+
+	/* its logs in the catalog, and the span and totals of them */
+	uint32_t logs;
+	int64_t first;
+	int64_t last;
+	uint64_t entries;
+	uint64_t dropped;
+
+	/* of the catalog, where its records since it was last deleted start, and how many */
+	size_t since;
+	size_t records;
+} log_catalog_day_t;
+
+typedef struct log_catalog
+{
+	/* the log directory, and the catalog open for appending, -1 if read only */
+	int dir_fd;
+	int fd;
+
+	/* in date order, deleted ones included until the catalog is written again */
+	log_catalog_day_t *days;
+	size_t day_count;
+	size_t day_capacity;
+	/* every day before this is deleted */
+	size_t oldest;
+
+	/* in the catalog, and of those the ones of days not deleted */
+	size_t records;
+	size_t live;
+} log_catalog_t;
+
+/**
+ * Read the records of a catalog, without its header
+ *
+ * @param dir_fd           In:    the log directory
+ * @param records          Out:   to be freed by the caller
+ * @param count            Out
+ * @return 0 on success, -1 if there is none or it is not a catalog
+ */
+int logCatalogRead(int dir_fd, log_catalog_record_t **records, size_t *count);
+
+/**
+ * Start with no days, and no catalog open
+ *
+ * @param catalog          Out
+ */
+void logCatalogInit(log_catalog_t *catalog);
+
+/**
+ * Take a record into the days, without writing it
+ *
+ * @param catalog          InOut
+ * @param record           In
+ * @return 0 on success, -1 if out of memory
+ */
+int logCatalogApply(log_catalog_t *catalog, const log_catalog_record_t *record);
+
+/**
+ * Open the catalog of a log directory for appending to, creating it if
+ * needed, and bring it in line with what is in the directory
+ *
+ * @param catalog          Out
+ * @param dir_fd           In:    the log directory, kept open by the caller
+ * @return 0 on success, -1 on error
+ */
+int logCatalogOpen(log_catalog_t *catalog, int dir_fd);
+
+/**
+ * Append a record and take it into the days. It is taken in even if it
+ * could not be written, as it still happened.
+ *
+ * @param catalog          InOut: opened with logCatalogOpen
+ * @param record           In:    host order
+ * @return 0 on success, -1 if it could not be written
+ */
+int logCatalogAppend(log_catalog_t *catalog, const log_catalog_record_t *record);
+
+/**
+ * Close the catalog and forget the days
+ *
+ * @param catalog          InOut
+ */
+void logCatalogFree(log_catalog_t *catalog);
+
+/**
+ * Find a day
+ *
+ * @param catalog          In
+ * @param date             In:    as logCatalogDate
+ * @return the day, NULL if the catalog has no records of it
+ */
+log_catalog_day_t *logCatalogFindDay(log_catalog_t *catalog, uint32_t date);
+
+/**
+ * The oldest day that is not deleted
+ *
+ * @param catalog          InOut
+ * @return the day, NULL if there is none
+ */
+log_catalog_day_t *logCatalogOldest(log_catalog_t *catalog);
+
+/**
+ * The day a name in the log directory belongs to
+ *
+ * @param name             In:    yyyymmdd, yyyymmdd/..., yyyymmdd.zst or yyyymmdd.tgz
+ * @return yyyymmdd as a number, 0 if it is none of those
+ */
+uint32_t logCatalogDate(const char *name);
+
+/**
+ * Time of a DTL timestamp, as the catalog holds it
+ *
+ * @param dtl              In:    LOG_DTL_SIZE bytes
+ * @param bigendian        In:    byte order of the log
+ * @return nanoseconds since 1970
+ */
+int64_t logCatalogTime(const uint8_t *dtl, bool bigendian);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APP_LOGCATALOG_H */
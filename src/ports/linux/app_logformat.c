@@ -0,0 +1,200 @@
+#include "app_logformat.h"
+
+#include <string.h>
+#include <endian.h>
+
+#define NS_PER_S 1000000000ULL
+
+static uint32_t getNano(const uint8_t *dtl, bool bigendian)
+{
+	uint32_t nano;
+	memcpy(&nano, dtl + 8, 4);
+
+	return bigendian ? be32toh(nano) : le32toh(nano);
+}
+
+static void setNano(uint8_t *dtl, uint32_t nano, bool bigendian)
+{
+	nano = bigendian ? htobe32(nano) : htole32(nano);
+	memcpy(dtl + 8, &nano, 4);
+}
+
+static uint64_t timeOfDay(const uint8_t *dtl, bool bigendian)
+{
+	uint64_t seconds = (dtl[5] * 60 + dtl[6]) * 60 + dtl[7];
+
+	return seconds * NS_PER_S + getNano(dtl, bigendian);
+}
+
+static size_t varintSize(uint64_t value)
+{
+	size_t size = 1;
+	while(value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+void logCodecReset(log_codec_t *codec)
+{
+	codec->started = false;
+	codec->time_ns = 0;
+}
+
+/* remember the record as the one to continue from */
+static void keep(log_codec_t *codec, const uint8_t *dtl, const uint8_t *words, bool bigendian)
+{
+	codec->started = true;
+	memcpy(codec->date, dtl, sizeof(codec->date));
+	codec->time_ns = timeOfDay(dtl, bigendian);
+	memcpy(codec->words, words, sizeof(codec->words));
+}
+
+size_t logEncodeRecord(
+	log_codec_t *codec,
+	const uint8_t *record,
+	bool bigendian,
+	uint8_t *out)
+{
+	const uint8_t *dtl = record + 1;
+	const uint8_t *words = dtl + LOG_DTL_SIZE;
+	uint64_t time_ns = timeOfDay(dtl, bigendian);
+
+	uint8_t groups = 0;
+	uint8_t masks[8] = {0};
+	size_t changed = 0;
+
+	if(codec->started) {
+		for(int w = 0; w < LOG_WORD_COUNT; w++) {
+			if(memcmp(words + 2*w, codec->words + 2*w, 2) != 0) {
+				masks[w/8] |= 1 << (w%8);
+				groups |= 1 << (w/8);
+				changed++;
+			}
+		}
+	}
+
+	/* only a delta from a record of the same day, earlier in it, has a size to compare */
+	bool key = !codec->started
+		|| memcmp(dtl, codec->date, sizeof(codec->date)) != 0
+		|| time_ns < codec->time_ns;
+
+	if(!key) {
+		size_t size = 1 + varintSize(time_ns - codec->time_ns) + 1
+			+ __builtin_popcount(groups) + 2*changed;
+		key = (size > LOG_RECORD_SIZE);
+	}
+
+	if(key) {
+		out[0] = LOG_RECORD_KEY;
+		memcpy(out + 1, dtl, LOG_RECORD_SIZE - 1);
+		keep(codec, dtl, words, bigendian);
+		return LOG_RECORD_SIZE;
+	}
+
+	uint8_t *next = out;
+	*next++ = LOG_RECORD_DELTA;
+
+	uint64_t delta = time_ns - codec->time_ns;
+	while(delta >= 0x80) {
+		*next++ = (uint8_t)delta | 0x80;
+		delta >>= 7;
+	}
+	*next++ = (uint8_t)delta;
+
+	*next++ = groups;
+	for(int g = 0; g < 8; g++) {
+		if(groups & (1 << g)) {
+			*next++ = masks[g];
+		}
+	}
+
+	for(int w = 0; w < LOG_WORD_COUNT; w++) {
+		if(masks[w/8] & (1 << (w%8))) {
+			*next++ = words[2*w];
+			*next++ = words[2*w + 1];
+		}
+	}
+
+	codec->time_ns = time_ns;
+	memcpy(codec->words, words, sizeof(codec->words));
+
+	return next - out;
+}
+
+int logDecodeRecord(
+	log_codec_t *codec,
+	const uint8_t *in,
+	size_t length,
+	bool bigendian,
+	uint8_t *record)
+{
+	if(length < 1)
+		return -1;
+
+	if(in[0] == LOG_END)
+		return 0;
+
+	uint8_t *dtl = record + 1;
+	record[0] = 0;
+
+	if(in[0] == LOG_RECORD_KEY) {
+		if(length < LOG_RECORD_SIZE)
+			return -1;
+
+		memcpy(dtl, in + 1, LOG_RECORD_SIZE - 1);
+		keep(codec, dtl, dtl + LOG_DTL_SIZE, bigendian);
+		return LOG_RECORD_SIZE;
+	}
+
+	if(in[0] != LOG_RECORD_DELTA || !codec->started)
+		return -1;
+
+	const uint8_t *next = in + 1;
+	const uint8_t *end = in + length;
+
+	uint64_t delta = 0;
+	for(int shift = 0; ; shift += 7) {
+		if(next == end || shift > 63)
+			return -1;
+		delta |= (uint64_t)(*next & 0x7F) << shift;
+		if(!(*next++ & 0x80))
+			break;
+	}
+
+	if(next == end)
+		return -1;
+	uint8_t groups = *next++;
+
+	uint8_t masks[8] = {0};
+	for(int g = 0; g < 8; g++) {
+		if(groups & (1 << g)) {
+			if(next == end)
+				return -1;
+			masks[g] = *next++;
+		}
+	}
+
+	for(int w = 0; w < LOG_WORD_COUNT; w++) {
+		if(masks[w/8] & (1 << (w%8))) {
+			if(end - next < 2)
+				return -1;
+			codec->words[2*w]     = *next++;
+			codec->words[2*w + 1] = *next++;
+		}
+	}
+
+	codec->time_ns += delta;
+
+	uint64_t seconds = codec->time_ns / NS_PER_S;
+	memcpy(dtl, codec->date, sizeof(codec->date));
+	dtl[5] = seconds / 3600;
+	dtl[6] = seconds / 60 % 60;
+	dtl[7] = seconds % 60;
+	setNano(dtl, codec->time_ns % NS_PER_S, bigendian);
+	memcpy(dtl + LOG_DTL_SIZE, codec->words, sizeof(codec->words));
+
+	return next - in;
+}
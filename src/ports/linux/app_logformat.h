@@ -0,0 +1,147 @@
+#ifndef APP_LOGFORMAT_H
+#define APP_LOGFORMAT_H
+
+/**
+ * @file
+ * @brief Log file format
+ *
+ * Every log starts with an 8 byte header:
+ *
+ *   magic      61 0B E7 EC
+ *   endian     50 4E big endian, 4E 50 little endian
+ *   version    LOG_FORMAT_PLAIN or LOG_FORMAT_COMPACT
+ *   words      number of 2 byte words per entry
+ *
+ * followed by records, and 255 once the log is finished.
+ * A finished log may carry an index after that, see below.
+ *
+ * Version 1 records are all the same size:
+ *
+ *   0, DTL timestamp (12 bytes), words
+ *
+ * where the DTL is year (2 bytes), month, day, weekday, hour, minute,
+ * second, nanosecond (4 bytes), multi-byte fields in the header's byte order.
+ *
+ * Version 2 records only hold what changed since the previous entry.
+ * A key record is the version 1 record with a different first byte:
+ *
+ *   LOG_RECORD_KEY, DTL timestamp, words
+ *
+ * A delta record continues from the previous record, on the same date:
+ *
+ *   LOG_RECORD_DELTA,
+ *   nanoseconds since the previous entry (unsigned LEB128 varint),
+ *   group mask: bit g set if any of words 8g..8g+7 changed,
+ *   word mask for each set group, bit w set if word 8g+w changed,
+ *   new value of each changed word, in word order
+ *
+ * The first record of a log is always a key, as is any entry whose date
+ * differs from, or whose time is earlier than, the previous one.
+ * Decoding turns either kind back into a version 1 record, so version 1
+ * readers only need the decoder in front of them.
+ *
+ * The index after the end marker holds where each second starts,
+ * so readers can find a time without going through the whole log:
+ *
+ *   entries  count * log_index_entry_t
+ *   count    u32 LE
+ *   magic    u32 LE   LOG_INDEX_MAGIC
+ *
+ * Entries are in increasing order of second; an entry whose time went
+ * back to a second already passed is not indexed. In version 2 logs an
+ * indexed entry is always a key record, so decoding can start there.
+ * Readers that stop at the end marker never see the index.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_gsdml.h"
+
+#define LOG_HEADER_SIZE    8
+#define LOG_FORMAT_PLAIN   1
+#define LOG_FORMAT_COMPACT 2
+
+#define LOG_WORD_COUNT     (APP_GSDML_VAR64_DATA_DIGITAL_SIZE/2)
+#define LOG_DTL_SIZE       12
+/* version 1 record, and the largest version 2 record */
+#define LOG_RECORD_SIZE    (1 + LOG_DTL_SIZE + APP_GSDML_VAR64_DATA_DIGITAL_SIZE)
+
+#define LOG_RECORD_DELTA   0
+#define LOG_RECORD_KEY     1
+#define LOG_END            255
+
+#define LOG_INDEX_MAGIC    0x49534E50 /* "PNSI" */
+/* seconds indexed per log, well over the 600 a log normally covers */
+#define LOG_INDEX_MAX      1024
+/* count and magic */
+#define LOG_INDEX_FOOTER_SIZE 8
+
+/* all fields little endian */
+typedef struct log_index_entry
+{
+	uint32_t second; /* of the day */
+	uint32_t offset; /* of the first entry with that second, from the start of the log */
+} log_index_entry_t;
+
+/* what the previous record left behind, for either direction */
+typedef struct log_codec
+{
+	bool started;
+	/* year, month, day, weekday as stored */
+	uint8_t date[5];
+	/* time of day */
+	uint64_t time_ns;
+	uint8_t words[APP_GSDML_VAR64_DATA_DIGITAL_SIZE];
+} log_codec_t;
+
+/**
+ * Forget the previous record, as at the start of a log
+ *
+ * @param codec            Out
+ */
+void logCodecReset(log_codec_t *codec);
+
+/**
+ * Encode a version 1 record as a version 2 record
+ *
+ * @param codec            InOut: state after the previous record
+ * @param record           In:    version 1 record
+ * @param bigendian        In:    byte order of the log
+ * @param out              Out:   at least LOG_RECORD_SIZE bytes
+ * @return bytes written to out
+ */
+size_t logEncodeRecord(
+	log_codec_t *codec,
+	const uint8_t *record,
+	bool bigendian,
+	uint8_t *out);
+
+/**
+ * Decode a version 2 record back into a version 1 record
+ *
+ * @param codec            InOut: state after the previous record
+ * @param in               In:    the record
+ * @param length           In:    bytes available at in
+ * @param bigendian        In:    byte order of the log
+ * @param record           Out:   LOG_RECORD_SIZE bytes
+ * @return bytes used from in, 0 at the end of the log,
+ *         -1 if it is malformed or cut short
+ */
+int logDecodeRecord(
+	log_codec_t *codec,
+	const uint8_t *in,
+	size_t length,
+	bool bigendian,
+	uint8_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* APP_LOGFORMAT_H */
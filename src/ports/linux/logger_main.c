@@ -16,6 +16,7 @@
 #define _GNU_SOURCE /* For asprintf() */
 
 #include "logger_common.h"
+#include "app_filelogger.h"
 #include "app_gsdml.h"
 #include "app_log.h"
 #include "app_utils.h"
@@ -30,6 +31,8 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -47,8 +50,13 @@
 #define APP_SNMP_THREAD_STACKSIZE      256 * 1024 /* bytes */
 #define APP_ETH_THREAD_PRIORITY        10
 #define APP_ETH_THREAD_STACKSIZE       4096 /* bytes */
+#define APP_ETH_RING_BLOCK_SIZE        64 * 1024 /* bytes */
+#define APP_ETH_RING_BLOCK_COUNT       16
+#define APP_ETH_RING_RETIRE_MS         1
 #define APP_BG_WORKER_THREAD_PRIORITY  5
 #define APP_BG_WORKER_THREAD_STACKSIZE 4096 /* bytes */
+#define APP_UDP_WATCH_THREAD_PRIORITY  10
+#define APP_UDP_WATCH_THREAD_STACKSIZE 4096 /* bytes */
 
 /* Note that this sample application uses os_timer_create() for the timer
    that controls the ticks. It is implemented in OSAL, and the Linux
@@ -94,6 +102,43 @@ void show_usage()
    printf ("                if not already available in storage file.\n");
    printf ("   -p PATH      Absolute path to storage directory. Defaults to "
            "/var/opt/pnlogger\n");
+   printf (
+      "   -w ENTRIES   Wake the logging thread when this many entries are\n"
+      "                pending. Defaults to %d\n",
+      LOG_WAKE_ENTRIES);
+   printf (
+      "   -l MS        Longest time an entry may wait before the logging\n"
+      "                thread picks it up. Defaults to %d\n",
+      LOG_MAX_LATENCY_MS);
+#if LOGGER_USE_IO_URING
+   printf ("   -u           Write log files through io_uring.\n");
+#endif
+   printf (
+      "   -o BYTES     Write log files with O_DIRECT, in blocks of BYTES.\n"
+      "                Should be the erase block size of the card, a\n"
+      "                multiple of %d. Defaults to off\n",
+      LOG_DIRECT_ALIGN);
+   printf (
+      "   -y KIB       Start writing out log data every KIB kilobytes,\n"
+      "                rather than leaving it to the kernel. Defaults to "
+      "off\n");
+   printf (
+      "   -c           Write compact logs (format %d), holding only what\n"
+      "                changed between entries. Not with -u\n",
+      LOG_FORMAT_COMPACT);
+#if LOGGER_USE_ZSTD
+   printf (
+      "   -z LEVEL     zstd level (1-19) for archiving finished days.\n"
+      "                Defaults to %d\n",
+      LOG_COMPRESSION_LEVEL);
+#endif
+   printf (
+      "   -e           Receive Ethernet frames through a mmap'd ring of\n"
+      "                %d blocks of %d KiB, which the kernel hands over\n"
+      "                within %d ms. Falls back to recv() if not possible\n",
+      APP_ETH_RING_BLOCK_COUNT,
+      APP_ETH_RING_BLOCK_SIZE / 1024,
+      APP_ETH_RING_RETIRE_MS);
 #if PNET_OPTION_DRIVER_ENABLE
    printf ("   -m MODE      Application offload mode. Only used if P-Net is\n");
    printf ("                built with hw offload enabled "
@@ -136,8 +181,16 @@ app_args_t parse_commandline_arguments (int argc, char * argv[])
    output_arguments.factory_reset = false;
    output_arguments.remove_files = false;
    output_arguments.mode = MODE_HW_OFFLOAD_NONE;
-
-   while ((option = getopt (argc, argv, "hvgfri:s:b:d:p:m:")) != -1)
+   output_arguments.log_wake_entries = LOG_WAKE_ENTRIES;
+   output_arguments.log_max_latency_ms = LOG_MAX_LATENCY_MS;
+   output_arguments.log_use_io_uring = false;
+   output_arguments.log_direct_block_size = 0;
+   output_arguments.log_sync_interval_kib = 0;
+   output_arguments.log_compression_level = LOG_COMPRESSION_LEVEL;
+   output_arguments.log_compact = false;
+   output_arguments.eth_recv_ring = false;
+
+   while ((option = getopt (argc, argv, "hvgfri:s:b:d:p:m:w:l:uo:y:cz:e")) != -1)
    {
       switch (option)
       {
@@ -172,6 +225,72 @@ app_args_t parse_commandline_arguments (int argc, char * argv[])
          }
          strcpy (output_arguments.path_storage_directory, optarg);
          break;
+      case 'w':
+         output_arguments.log_wake_entries = atoi (optarg);
+         if (
+            output_arguments.log_wake_entries < 1 ||
+            output_arguments.log_wake_entries > ENTRY_BUFFER_COUNT)
+         {
+            printf (
+               "Error: The argument to -w must be 1-%d.\n",
+               ENTRY_BUFFER_COUNT);
+            exit (EXIT_FAILURE);
+         }
+         break;
+      case 'l':
+         output_arguments.log_max_latency_ms = atoi (optarg);
+         if (output_arguments.log_max_latency_ms < 1)
+         {
+            printf ("Error: The argument to -l must be positive.\n");
+            exit (EXIT_FAILURE);
+         }
+         break;
+      case 'o':
+         output_arguments.log_direct_block_size = atoi (optarg);
+         if (
+            output_arguments.log_direct_block_size < LOG_DIRECT_ALIGN ||
+            output_arguments.log_direct_block_size > LOG_DIRECT_BLOCK_MAX ||
+            output_arguments.log_direct_block_size % LOG_DIRECT_ALIGN != 0)
+         {
+            printf (
+               "Error: The argument to -o must be a multiple of %d, up to "
+               "%d.\n",
+               LOG_DIRECT_ALIGN,
+               LOG_DIRECT_BLOCK_MAX);
+            exit (EXIT_FAILURE);
+         }
+         break;
+      case 'y':
+         output_arguments.log_sync_interval_kib = atoi (optarg);
+         if (output_arguments.log_sync_interval_kib < 1)
+         {
+            printf ("Error: The argument to -y must be positive.\n");
+            exit (EXIT_FAILURE);
+         }
+         break;
+      case 'c':
+         output_arguments.log_compact = true;
+         break;
+#if LOGGER_USE_ZSTD
+      case 'z':
+         output_arguments.log_compression_level = atoi (optarg);
+         if (
+            output_arguments.log_compression_level < 1 ||
+            output_arguments.log_compression_level > 19)
+         {
+            printf ("Error: The argument to -z must be 1-19.\n");
+            exit (EXIT_FAILURE);
+         }
+         break;
+#endif
+#if LOGGER_USE_IO_URING
+      case 'u':
+         output_arguments.log_use_io_uring = true;
+         break;
+#endif
+      case 'e':
+         output_arguments.eth_recv_ring = true;
+         break;
 #if PNET_OPTION_DRIVER_ENABLE
       case 'm':
          if (strcmp ("none", optarg) == 0)
@@ -289,6 +408,14 @@ int main (int argc, char * argv[])
    app_utils_netif_namelist_t netif_name_list;
    pnet_if_cfg_t netif_cfg = {0};
    uint16_t number_of_ports = 1;
+   sigset_t stop_signals;
+
+   /* Taken by the main loop alone, so block them before any thread
+      is started, as those inherit the mask */
+   sigemptyset (&stop_signals);
+   sigaddset (&stop_signals, SIGINT);
+   sigaddset (&stop_signals, SIGTERM);
+   pthread_sigmask (SIG_BLOCK, &stop_signals, NULL);
 
    /* Enable line buffering for printouts, especially when logging to
       the journal (which is default when running as a systemd job) */
@@ -303,6 +430,20 @@ int main (int argc, char * argv[])
    app_log_set_log_level (app_log_level);
    printf ("\n** Starting data acquisition program **\n");
 
+   log_policy_t log_policy = {
+      .wake_entries = app_args.log_wake_entries,
+      .max_latency_ms = app_args.log_max_latency_ms,
+      .use_io_uring = app_args.log_use_io_uring,
+      .direct_block_size = app_args.log_direct_block_size,
+      .sync_interval = (size_t)app_args.log_sync_interval_kib * 1024,
+      .compression_level = app_args.log_compression_level,
+      .format = app_args.log_compact ? LOG_FORMAT_COMPACT : LOG_FORMAT_PLAIN,
+   };
+   if (setLogPolicy (&log_policy) != 0)
+   {
+      exit (EXIT_FAILURE);
+   }
+
    APP_LOG_INFO (
       "Number of slots:      %u (incl slot for DAP module)\n",
       PNET_MAX_SLOTS);
@@ -337,6 +478,16 @@ int main (int argc, char * argv[])
    pnet_cfg.pnal_cfg.bg_worker_thread.prio = APP_BG_WORKER_THREAD_PRIORITY;
    pnet_cfg.pnal_cfg.bg_worker_thread.stack_size =
       APP_BG_WORKER_THREAD_STACKSIZE;
+   pnet_cfg.pnal_cfg.udp_watch_thread.prio = APP_UDP_WATCH_THREAD_PRIORITY;
+   pnet_cfg.pnal_cfg.udp_watch_thread.stack_size =
+      APP_UDP_WATCH_THREAD_STACKSIZE;
+   if (app_args.eth_recv_ring)
+   {
+      pnet_cfg.pnal_cfg.eth_recv_ring.block_size = APP_ETH_RING_BLOCK_SIZE;
+      pnet_cfg.pnal_cfg.eth_recv_ring.block_count = APP_ETH_RING_BLOCK_COUNT;
+      pnet_cfg.pnal_cfg.eth_recv_ring.retire_timeout_ms =
+         APP_ETH_RING_RETIRE_MS;
+   }
 
    ret = app_pnet_cfg_init_storage (&pnet_cfg, &app_args);
    if (ret != 0)
@@ -390,6 +541,14 @@ int main (int argc, char * argv[])
       exit (EXIT_SUCCESS);
    }
 
+   /* Before the cyclic data starts, so that it does not have to */
+   if (startLogger() != 0)
+   {
+      printf ("Failed to start logging\n");
+      printf ("Aborting application\n");
+      exit (EXIT_FAILURE);
+   }
+
    /* Start main loop */
    if (app_start (sample_app, RUN_IN_SEPARATE_THREAD) != 0)
    {
@@ -398,10 +557,50 @@ int main (int argc, char * argv[])
       exit (EXIT_FAILURE);
    }
 
+   log_buffer_stats_t reported = {0};
+   pnal_buf_pool_stats_t pool_reported = {0};
+   const struct timespec main_sleeptime = {
+      .tv_sec = APP_MAIN_SLEEPTIME_US / 1000000,
+      .tv_nsec = (APP_MAIN_SLEEPTIME_US % 1000000) * 1000,
+   };
+
    for (;;)
    {
-      os_usleep (APP_MAIN_SLEEPTIME_US);
+      /* Sleep, unless asked to stop */
+      if (sigtimedwait (&stop_signals, NULL, &main_sleeptime) > 0)
+      {
+         break;
+      }
+
+      /* Report whenever the logging thread has had trouble keeping up */
+      log_buffer_stats_t stats;
+      getLogBufferStats (&stats);
+      if (stats.low_space != reported.low_space)
+      {
+         APP_LOG_WARNING (
+            "Entry buffer ran low %u times (peak %u/%d pending, %u dropped)\n",
+            stats.low_space,
+            (unsigned)stats.peak,
+            ENTRY_BUFFER_COUNT,
+            stats.dropped);
+         reported = stats;
+      }
+
+      /* And whenever frame buffers had to come from the heap */
+      pnal_buf_pool_stats_t pool;
+      pnal_buf_pool_stats (&pool);
+      if (pool.exhausted != pool_reported.exhausted)
+      {
+         APP_LOG_WARNING (
+            "Frame buffer pool ran out %u times (peak %u/%u in use)\n",
+            pool.exhausted,
+            pool.high_water,
+            pool.size);
+         pool_reported = pool;
+      }
    }
 
+   /* Returning runs the exit handlers, which delete the unused next log */
+   printf ("Exit application\n");
    return 0;
 }
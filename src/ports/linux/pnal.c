@@ -20,6 +20,7 @@
 #include "options.h"
 #include "osal.h"
 #include "osal_log.h"
+#include "pnal_eth_ring.h"
 #include "pnal_filetools.h"
 
 #include <arpa/inet.h>
@@ -39,6 +40,8 @@
 #include <limits.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -186,25 +189,303 @@ uint32_t pnal_get_system_uptime_10ms (void)
    return systeminfo.uptime * 100;
 }
 
-uint32_t pnal_buf_alloc_cnt = 0; /* Count outstanding buffers */
+/* Buffers of PNAL_BUF_MAX_SIZE come from a pool set aside once, so that
+ * receiving and sending frames makes no heap calls. Free buffers are kept
+ * on a lock-free stack, and each thread keeps a few of its own in front
+ * of it, so most calls touch no shared state but the counters.
+ * Larger buffers, and any the pool is out of, come from the heap.
+ */
+#ifndef PNAL_BUF_POOL_SIZE
+#define PNAL_BUF_POOL_SIZE 256
+#endif
+#define PNAL_BUF_POOL_NONE 0xFFFF
+/* The head of the stack is a slot index in the low half, a tag in the high */
+#define PNAL_BUF_POOL_HEAD_IX(head) ((uint16_t)((head) & 0xFFFFFFFF))
+#define PNAL_BUF_POOL_HEAD_NEXT(head, ix)                                      \
+   ((((head) & ~(uint64_t)0xFFFFFFFF) + ((uint64_t)1 << 32)) | (ix))
+#define PNAL_BUF_POOL_SLOT_SIZE                                                \
+   ((sizeof (pnal_buf_t) + PNAL_BUF_MAX_SIZE + 63) & ~(size_t)63)
+
+/* Per thread. Refilled and emptied by half, so that a thread that frees
+   what another allocates goes to the shared stack once every few frames */
+#define PNAL_BUF_CACHE_SIZE 16
+
+#if PNAL_BUF_POOL_SIZE >= PNAL_BUF_POOL_NONE
+#error "PNAL_BUF_POOL_SIZE must fit in 16 bits"
+#endif
+
+typedef struct pnal_buf_cache
+{
+   uint32_t count;
+   bool registered;
+   uint16_t slots[PNAL_BUF_CACHE_SIZE];
+} pnal_buf_cache_t;
+
+static struct
+{
+   /* Index of the top free slot, and a count of changes in the upper half
+      so that a slot taken and put back between a load and a
+      compare-exchange is noticed. 32 bits of count, as 16 wrap in well
+      under a second of frames. */
+   atomic_uint_least64_t head;
+   atomic_uint_least16_t next[PNAL_BUF_POOL_SIZE];
+   atomic_uint high_water;
+   atomic_uint exhausted;
+   atomic_uint oversize;
+   pthread_key_t cache_key;
+   uint8_t memory[PNAL_BUF_POOL_SIZE * PNAL_BUF_POOL_SLOT_SIZE]
+      __attribute__ ((aligned (64)));
+} pnal_buf_pool;
+
+static pthread_once_t pnal_buf_pool_once = PTHREAD_ONCE_INIT;
+static __thread pnal_buf_cache_t pnal_buf_cache;
+
+atomic_uint pnal_buf_alloc_cnt = 0; /* Count outstanding buffers */
+
+/**
+ * @internal
+ * Take a slot off the shared stack.
+ *
+ * @return Index of the slot, or PNAL_BUF_POOL_NONE if the stack is empty
+ */
+static uint16_t pnal_buf_pool_pop (void)
+{
+   uint64_t head =
+      atomic_load_explicit (&pnal_buf_pool.head, memory_order_acquire);
+   uint64_t next;
+   uint16_t ix;
+
+   do
+   {
+      ix = PNAL_BUF_POOL_HEAD_IX (head);
+      if (ix == PNAL_BUF_POOL_NONE)
+      {
+         return PNAL_BUF_POOL_NONE;
+      }
+      next = PNAL_BUF_POOL_HEAD_NEXT (
+         head,
+         atomic_load_explicit (&pnal_buf_pool.next[ix], memory_order_relaxed));
+   } while (!atomic_compare_exchange_weak_explicit (
+      &pnal_buf_pool.head,
+      &head,
+      next,
+      memory_order_acquire,
+      memory_order_acquire));
+
+   return ix;
+}
+
+/**
+ * @internal
+ * Put a chain of slots, linked through next, on the shared stack.
+ *
+ * @param first            In:    First slot of the chain
+ * @param last             In:    Last slot of the chain
+ */
+static void pnal_buf_pool_push (uint16_t first, uint16_t last)
+{
+   uint64_t head =
+      atomic_load_explicit (&pnal_buf_pool.head, memory_order_relaxed);
+   uint64_t next;
+
+   do
+   {
+      atomic_store_explicit (
+         &pnal_buf_pool.next[last],
+         PNAL_BUF_POOL_HEAD_IX (head),
+         memory_order_relaxed);
+      next = PNAL_BUF_POOL_HEAD_NEXT (head, first);
+   } while (!atomic_compare_exchange_weak_explicit (
+      &pnal_buf_pool.head,
+      &head,
+      next,
+      memory_order_release,
+      memory_order_relaxed));
+}
+
+/**
+ * @internal
+ * Put the last \a count slots of a thread's cache on the shared stack.
+ *
+ * @param cache            InOut: Cache of the calling thread
+ * @param count            In:    Slots to give up, at most cache->count
+ */
+static void pnal_buf_cache_flush (pnal_buf_cache_t * cache, uint32_t count)
+{
+   uint32_t first = cache->count - count;
+   uint32_t i;
+
+   if (count == 0)
+   {
+      return;
+   }
+
+   for (i = first; i + 1 < cache->count; i++)
+   {
+      atomic_store_explicit (
+         &pnal_buf_pool.next[cache->slots[i]],
+         cache->slots[i + 1],
+         memory_order_relaxed);
+   }
+   pnal_buf_pool_push (cache->slots[first], cache->slots[cache->count - 1]);
+   cache->count = first;
+}
+
+/**
+ * @internal
+ * Give the cache of a thread back to the pool as the thread exits.
+ *
+ * @param arg              InOut: Cache of the exiting thread
+ */
+static void pnal_buf_cache_exit (void * arg)
+{
+   pnal_buf_cache_t * cache = arg;
+
+   pnal_buf_cache_flush (cache, cache->count);
+}
+
+/**
+ * @internal
+ * Put every slot on the shared stack, and touch the memory so that it is
+ * not first faulted in while frames are handled.
+ */
+static void pnal_buf_pool_init (void)
+{
+   uint16_t ix;
+
+   memset (pnal_buf_pool.memory, 0, sizeof (pnal_buf_pool.memory));
+   for (ix = 0; ix < PNAL_BUF_POOL_SIZE; ix++)
+   {
+      atomic_init (
+         &pnal_buf_pool.next[ix],
+         (ix + 1 < PNAL_BUF_POOL_SIZE) ? ix + 1 : PNAL_BUF_POOL_NONE);
+   }
+   atomic_store (
+      &pnal_buf_pool.head,
+      (PNAL_BUF_POOL_SIZE > 0) ? 0 : PNAL_BUF_POOL_NONE);
+   (void)pthread_key_create (&pnal_buf_pool.cache_key, pnal_buf_cache_exit);
+}
+
+/**
+ * @internal
+ * Take a buffer from the pool, through the cache of the calling thread.
+ *
+ * @return The buffer, or NULL if the pool is out of them
+ */
+static pnal_buf_t * pnal_buf_pool_get (void)
+{
+   pnal_buf_cache_t * cache = &pnal_buf_cache;
+   uint16_t ix;
+
+   if (cache->count == 0)
+   {
+      (void)pthread_once (&pnal_buf_pool_once, pnal_buf_pool_init);
+      if (!cache->registered)
+      {
+         (void)pthread_setspecific (pnal_buf_pool.cache_key, cache);
+         cache->registered = true;
+      }
+
+      while (cache->count < PNAL_BUF_CACHE_SIZE / 2)
+      {
+         ix = pnal_buf_pool_pop();
+         if (ix == PNAL_BUF_POOL_NONE)
+         {
+            break;
+         }
+         cache->slots[cache->count++] = ix;
+      }
+
+      if (cache->count == 0)
+      {
+         return NULL;
+      }
+   }
+
+   ix = cache->slots[--cache->count];
+   return (pnal_buf_t *)&pnal_buf_pool.memory[ix * PNAL_BUF_POOL_SLOT_SIZE];
+}
+
+/**
+ * @internal
+ * Put a buffer back in the pool, through the cache of the calling thread.
+ *
+ * @param p                In:    Buffer from the pool
+ */
+static void pnal_buf_pool_put (pnal_buf_t * p)
+{
+   pnal_buf_cache_t * cache = &pnal_buf_cache;
+
+   if (cache->count == PNAL_BUF_CACHE_SIZE)
+   {
+      pnal_buf_cache_flush (cache, PNAL_BUF_CACHE_SIZE / 2);
+   }
+   if (!cache->registered)
+   {
+      (void)pthread_setspecific (pnal_buf_pool.cache_key, cache);
+      cache->registered = true;
+   }
+
+   cache->slots[cache->count++] =
+      ((uint8_t *)p - pnal_buf_pool.memory) / PNAL_BUF_POOL_SLOT_SIZE;
+}
 
 pnal_buf_t * pnal_buf_alloc (uint16_t length)
 {
-   pnal_buf_t * p = malloc (sizeof (pnal_buf_t) + length);
+   pnal_buf_t * p = NULL;
+   unsigned int in_use;
+   unsigned int high_water;
 
-   if (p != NULL)
+   if (length <= PNAL_BUF_MAX_SIZE)
    {
-#if 1
-      p->payload = (void *)((uint8_t *)p + sizeof (pnal_buf_t)); /* Payload
-                                                                  follows header
-                                                                  struct */
-      p->len = length;
-#endif
-      pnal_buf_alloc_cnt++;
+      p = pnal_buf_pool_get();
+      if (p == NULL)
+      {
+         atomic_fetch_add_explicit (
+            &pnal_buf_pool.exhausted,
+            1,
+            memory_order_relaxed);
+      }
    }
    else
    {
-      assert ("malloc() failed\n");
+      atomic_fetch_add_explicit (
+         &pnal_buf_pool.oversize,
+         1,
+         memory_order_relaxed);
+   }
+
+   if (p == NULL)
+   {
+      p = malloc (sizeof (pnal_buf_t) + length);
+      if (p == NULL)
+      {
+         assert ("malloc() failed\n");
+         return NULL;
+      }
+   }
+
+   p->payload = (void *)((uint8_t *)p + sizeof (pnal_buf_t)); /* Payload
+                                                               follows header
+                                                               struct */
+   p->len = length;
+   p->ring_block = NULL;
+
+   in_use = atomic_fetch_add_explicit (
+               &pnal_buf_alloc_cnt,
+               1,
+               memory_order_relaxed) +
+            1;
+   high_water =
+      atomic_load_explicit (&pnal_buf_pool.high_water, memory_order_relaxed);
+   while (in_use > high_water &&
+          !atomic_compare_exchange_weak_explicit (
+             &pnal_buf_pool.high_water,
+             &high_water,
+             in_use,
+             memory_order_relaxed,
+             memory_order_relaxed))
+   {
    }
 
    return p;
@@ -212,9 +493,37 @@ pnal_buf_t * pnal_buf_alloc (uint16_t length)
 
 void pnal_buf_free (pnal_buf_t * p)
 {
-   free (p);
-   pnal_buf_alloc_cnt--;
-   return;
+   if (p == NULL)
+   {
+      return;
+   }
+
+   if (p->ring_block != NULL)
+   {
+      pnal_eth_ring_release (p);
+      return;
+   }
+
+   if (
+      (uint8_t *)p >= pnal_buf_pool.memory &&
+      (uint8_t *)p < pnal_buf_pool.memory + sizeof (pnal_buf_pool.memory))
+   {
+      pnal_buf_pool_put (p);
+   }
+   else
+   {
+      free (p);
+   }
+   atomic_fetch_sub_explicit (&pnal_buf_alloc_cnt, 1, memory_order_relaxed);
+}
+
+void pnal_buf_pool_stats (pnal_buf_pool_stats_t * stats)
+{
+   stats->size = PNAL_BUF_POOL_SIZE;
+   stats->in_use = atomic_load (&pnal_buf_alloc_cnt);
+   stats->high_water = atomic_load (&pnal_buf_pool.high_water);
+   stats->exhausted = atomic_load (&pnal_buf_pool.exhausted);
+   stats->oversize = atomic_load (&pnal_buf_pool.oversize);
 }
 
 uint8_t pnal_buf_header (pnal_buf_t * p, int16_t header_size_increment)
@@ -40,11 +40,31 @@ typedef struct pnal_thread_cfg
    size_t stack_size;
 } pnal_thread_cfg_t;
 
+/**
+ * Receive ring of the Ethernet receive thread
+ *
+ * With block_count 0, frames are read one recv() at a time. Otherwise the
+ * kernel fills a TPACKET_V3 ring of block_count blocks of block_size bytes,
+ * a multiple of the page size, and hands a block over once it is full or
+ * retire_timeout_ms after it was started. The timeout is latency added to
+ * every frame, rounded up to the kernel's tick. 0 leaves it to the kernel.
+ */
+typedef struct pnal_eth_ring_cfg
+{
+   uint32_t block_size;
+   uint32_t block_count;
+   uint32_t retire_timeout_ms;
+} pnal_eth_ring_cfg_t;
+
 typedef struct pnal_cfg
 {
    pnal_thread_cfg_t snmp_thread;
    pnal_thread_cfg_t eth_recv_thread;
    pnal_thread_cfg_t bg_worker_thread;
+   /* Waits for datagrams on the RPC sockets, if the stack is told of them
+      by pnet_cfg_t::rpc_ready_cb */
+   pnal_thread_cfg_t udp_watch_thread;
+   pnal_eth_ring_cfg_t eth_recv_ring;
 } pnal_cfg_t;
 
 #ifdef __cplusplus
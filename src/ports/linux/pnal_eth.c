@@ -18,28 +18,105 @@
  * @brief Linux Ethernet related functions that use \a pnal_eth_handle_t
  */
 
+#define _GNU_SOURCE /* For recvmmsg() */
+
 #include "pnal.h"
 
 #include "pnet_options.h"
 #include "options.h"
 #include "osal_log.h"
+#include "pnal_eth_ring.h"
 
+#include <linux/if_packet.h>
 #include <net/ethernet.h>
 #include <net/if.h>
-#include <netpacket/packet.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* Largest number of frames a block may hold, as minimum size frames.
+   Frames beyond that, should there be any, are copied. */
+#define PNAL_ETH_RING_FRAMES(block_size)                                       \
+   ((block_size) / TPACKET_ALIGN (TPACKET3_HDRLEN + ETH_ZLEN))
+
+/* Only checked by the kernel for TPACKET_V3, where frames are packed */
+#define PNAL_ETH_RING_FRAME_SIZE 2048
+
+/* Frames per recvmmsg() call. Kept below the buffers a thread
+   caches of the pool, so the receive thread does not drain it. */
+#define PNAL_ETH_MMSG_MAX 8
+
+typedef struct pnal_eth_ring pnal_eth_ring_t;
+
+/**
+ * A block of the receive ring.
+ *
+ * The stack may keep a frame it was handed after the callback returns,
+ * and free it later from another thread, so a block goes back to the kernel
+ * only once the receive thread is through it and every frame in it that
+ * was handed over is freed.
+ */
+struct pnal_eth_ring_block
+{
+   struct tpacket_block_desc * desc;
+   pnal_eth_ring_t * ring;
+   /* One for the receive thread, and one per frame the stack holds */
+   atomic_uint refs;
+   /* Taken from the kernel, and not yet given back */
+   atomic_bool owned;
+   /* Headers of the frames handed over */
+   pnal_buf_t * bufs;
+};
+
+struct pnal_eth_ring
+{
+   uint8_t * map;
+   size_t map_size;
+   uint32_t block_count;
+   uint32_t frames_max;
+   struct pnal_eth_ring_block * blocks;
+   /* Blocks taken from the kernel and not yet given back */
+   atomic_uint held;
+   /* Edge triggered on the socket, as it stays readable while a block is
+      held */
+   int epoll_fd;
+};
+
 struct pnal_eth_handle
 {
    pnal_eth_callback_t * callback;
    void * arg;
    int socket;
    os_thread_t * thread;
+   pnal_eth_ring_t * ring; /* NULL if frames are read with recv() */
 };
 
+/**
+ * @internal
+ * Hand a received frame to the callback.
+ *
+ * @param eth_handle     In:    Ethernet handle
+ * @param p              In:    Received frame
+ * @return 1 if the callback took the frame, 0 if not
+ */
+static int pnal_eth_deliver (pnal_eth_handle_t * eth_handle, pnal_buf_t * p)
+{
+   if (eth_handle->callback == NULL)
+   {
+      return 0; /* Message not handled */
+   }
+
+   return eth_handle->callback (eth_handle, eth_handle->arg, p);
+}
+
 /**
  * @internal
  * Run a thread that listens to incoming raw Ethernet sockets.
@@ -53,36 +130,312 @@ struct pnal_eth_handle
 static void os_eth_task (void * thread_arg)
 {
    pnal_eth_handle_t * eth_handle = thread_arg;
-   ssize_t readlen;
+   pnal_buf_t * bufs[PNAL_ETH_MMSG_MAX];
+   struct mmsghdr hdrs[PNAL_ETH_MMSG_MAX];
+   struct iovec iovs[PNAL_ETH_MMSG_MAX];
+   int received;
    int handled = 0;
+   int ix;
 
-   pnal_buf_t * p = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
-   assert (p != NULL);
+   for (ix = 0; ix < PNAL_ETH_MMSG_MAX; ix++)
+   {
+      bufs[ix] = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
+      assert (bufs[ix] != NULL);
+   }
 
    while (1)
    {
-      readlen = recv (eth_handle->socket, p->payload, PNAL_BUF_MAX_SIZE, 0);
-      if (readlen == -1)
+      memset (hdrs, 0, sizeof (hdrs));
+      for (ix = 0; ix < PNAL_ETH_MMSG_MAX; ix++)
+      {
+         iovs[ix].iov_base = bufs[ix]->payload;
+         iovs[ix].iov_len = PNAL_BUF_MAX_SIZE;
+         hdrs[ix].msg_hdr.msg_iov = &iovs[ix];
+         hdrs[ix].msg_hdr.msg_iovlen = 1;
+      }
+
+      /* Wait for one frame, and take those queued behind it */
+      received = recvmmsg (
+         eth_handle->socket,
+         hdrs,
+         PNAL_ETH_MMSG_MAX,
+         MSG_WAITFORONE,
+         NULL);
+      if (received <= 0)
          continue;
-      p->len = readlen;
 
-      if (eth_handle->callback != NULL)
+      for (ix = 0; ix < received; ix++)
+      {
+         bufs[ix]->len = hdrs[ix].msg_len;
+
+         handled = pnal_eth_deliver (eth_handle, bufs[ix]);
+
+         if (handled == 1)
+         {
+            bufs[ix] = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
+            assert (bufs[ix] != NULL);
+         }
+      }
+   }
+}
+
+/**
+ * @internal
+ * Drop a reference to a block of the receive ring, and give the block back
+ * to the kernel if it was the last one.
+ *
+ * @param block          InOut: Block taken from the kernel
+ */
+static void pnal_eth_ring_put (struct pnal_eth_ring_block * block)
+{
+   if (atomic_fetch_sub (&block->refs, 1) == 1)
+   {
+      /* The kernel must not see it before we are done reading it, nor the
+         receive thread see it as ours after the kernel has it */
+      atomic_thread_fence (memory_order_release);
+      block->desc->hdr.bh1.block_status = TP_STATUS_KERNEL;
+      atomic_fetch_sub (&block->ring->held, 1);
+      atomic_store (&block->owned, false);
+   }
+}
+
+void pnal_eth_ring_release (pnal_buf_t * p)
+{
+   pnal_eth_ring_put (p->ring_block);
+}
+
+/**
+ * @internal
+ * Hand the frames of a block the kernel is done with to the callback.
+ *
+ * Frames are handed over as they lie in the ring, unless half the blocks
+ * are already held by frames the stack kept, when they are copied to
+ * \a spare so that the kernel does not run out of blocks.
+ *
+ * @param eth_handle     In:    Ethernet handle
+ * @param block          InOut: Block with TP_STATUS_USER set
+ * @param spare          InOut: Buffer to copy to, replaced if taken
+ */
+static void pnal_eth_ring_walk (
+   pnal_eth_handle_t * eth_handle,
+   struct pnal_eth_ring_block * block,
+   pnal_buf_t ** spare)
+{
+   pnal_eth_ring_t * ring = eth_handle->ring;
+   struct tpacket_hdr_v1 * bh = &block->desc->hdr.bh1;
+   struct tpacket3_hdr * hdr;
+   pnal_buf_t * p;
+   uint32_t ix;
+   bool lend;
+
+   atomic_thread_fence (memory_order_acquire);
+   lend = bh->num_pkts <= ring->frames_max &&
+          atomic_load (&ring->held) < ring->block_count / 2;
+
+   atomic_store (&block->owned, true);
+   atomic_store (&block->refs, 1);
+   atomic_fetch_add (&ring->held, 1);
+
+   hdr = (struct tpacket3_hdr *)((uint8_t *)block->desc + bh->offset_to_first_pkt);
+   for (ix = 0; ix < bh->num_pkts; ix++)
+   {
+      if (lend)
       {
-         handled = eth_handle->callback (eth_handle, eth_handle->arg, p);
+         p = &block->bufs[ix];
+         p->payload = (uint8_t *)hdr + hdr->tp_mac;
+         p->len = hdr->tp_snaplen;
+         p->ring_block = block;
+
+         /* Before the callback, which may free it at once */
+         atomic_fetch_add (&block->refs, 1);
+         if (pnal_eth_deliver (eth_handle, p) != 1)
+         {
+            pnal_eth_ring_put (block);
+         }
       }
       else
       {
-         handled = 0; /* Message not handled */
+         p = *spare;
+         p->len = (hdr->tp_snaplen < PNAL_BUF_MAX_SIZE) ? hdr->tp_snaplen
+                                                        : PNAL_BUF_MAX_SIZE;
+         memcpy (p->payload, (uint8_t *)hdr + hdr->tp_mac, p->len);
+
+         if (pnal_eth_deliver (eth_handle, p) == 1)
+         {
+            *spare = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
+            assert (*spare != NULL);
+         }
       }
 
-      if (handled == 1)
+      hdr = (struct tpacket3_hdr *)((uint8_t *)hdr + hdr->tp_next_offset);
+   }
+
+   pnal_eth_ring_put (block);
+}
+
+/**
+ * @internal
+ * Run a thread that takes incoming frames from the receive ring, a block
+ * at a time, and hands them to thread_arg->callback.
+ *
+ * Blocks are taken in the order the kernel fills them. One that is not
+ * ready is either still being filled, or still held by frames the stack
+ * kept, in which case the kernel waits for it too.
+ *
+ * This is a function to be passed into os_thread_create()
+ * Do not change the argument types.
+ *
+ * @param thread_arg     InOut: Will be converted to pnal_eth_handle_t
+ */
+static void os_eth_ring_task (void * thread_arg)
+{
+   pnal_eth_handle_t * eth_handle = thread_arg;
+   pnal_eth_ring_t * ring = eth_handle->ring;
+   struct pnal_eth_ring_block * block;
+   struct epoll_event event;
+   uint32_t next = 0;
+
+   pnal_buf_t * spare = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
+   assert (spare != NULL);
+
+   while (1)
+   {
+      block = &ring->blocks[next];
+      if (
+         !atomic_load (&block->owned) &&
+         (block->desc->hdr.bh1.block_status & TP_STATUS_USER) != 0)
+      {
+         pnal_eth_ring_walk (eth_handle, block, &spare);
+         next = (next + 1) % ring->block_count;
+      }
+      else
       {
-         p = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
-         assert (p != NULL);
+         (void)epoll_wait (ring->epoll_fd, &event, 1, -1);
       }
    }
 }
 
+/**
+ * @internal
+ * Set up a TPACKET_V3 receive ring on a socket.
+ *
+ * @param socket         In:    Packet socket
+ * @param cfg            In:    Ring configuration, block_count not 0
+ * @return The ring, or NULL if it could not be set up, in which case the
+ *         socket is left to be read with recv()
+ */
+static pnal_eth_ring_t * pnal_eth_ring_init (
+   int socket,
+   const pnal_eth_ring_cfg_t * cfg)
+{
+   pnal_eth_ring_t * ring;
+   struct tpacket_req3 req;
+   struct epoll_event event;
+   int version = TPACKET_V3;
+   uint32_t ix;
+
+   ring = calloc (1, sizeof (*ring));
+   if (ring == NULL)
+   {
+      return NULL;
+   }
+   ring->block_count = cfg->block_count;
+   ring->frames_max = PNAL_ETH_RING_FRAMES (cfg->block_size);
+   ring->map = MAP_FAILED;
+   ring->epoll_fd = -1;
+
+   memset (&req, 0, sizeof (req));
+   req.tp_block_size = cfg->block_size;
+   req.tp_block_nr = cfg->block_count;
+   req.tp_frame_size = PNAL_ETH_RING_FRAME_SIZE;
+   req.tp_frame_nr = cfg->block_size / PNAL_ETH_RING_FRAME_SIZE *
+                     cfg->block_count;
+   req.tp_retire_blk_tov = cfg->retire_timeout_ms;
+
+   if (
+      setsockopt (
+         socket,
+         SOL_PACKET,
+         PACKET_VERSION,
+         &version,
+         sizeof (version)) != 0 ||
+      setsockopt (socket, SOL_PACKET, PACKET_RX_RING, &req, sizeof (req)) !=
+         0)
+   {
+      LOG_WARNING (
+         PF_PNAL_LOG,
+         "PNAL(%d): Failed to set up receive ring: %s\n",
+         __LINE__,
+         strerror (errno));
+      free (ring);
+      return NULL;
+   }
+
+   ring->map_size = (size_t)cfg->block_size * cfg->block_count;
+   ring->map = mmap (
+      NULL,
+      ring->map_size,
+      PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE,
+      socket,
+      0);
+   ring->blocks = calloc (cfg->block_count, sizeof (*ring->blocks));
+   ring->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+   event.events = EPOLLIN | EPOLLET;
+   event.data.ptr = ring;
+   if (
+      ring->map == MAP_FAILED || ring->blocks == NULL || ring->epoll_fd == -1 ||
+      epoll_ctl (ring->epoll_fd, EPOLL_CTL_ADD, socket, &event) != 0)
+   {
+      LOG_WARNING (
+         PF_PNAL_LOG,
+         "PNAL(%d): Failed to map receive ring: %s\n",
+         __LINE__,
+         strerror (errno));
+      goto error;
+   }
+
+   for (ix = 0; ix < cfg->block_count; ix++)
+   {
+      ring->blocks[ix].desc =
+         (struct tpacket_block_desc *)(ring->map + (size_t)ix * cfg->block_size);
+      ring->blocks[ix].ring = ring;
+      atomic_init (&ring->blocks[ix].refs, 0);
+      atomic_init (&ring->blocks[ix].owned, false);
+      ring->blocks[ix].bufs = calloc (ring->frames_max, sizeof (pnal_buf_t));
+      if (ring->blocks[ix].bufs == NULL)
+      {
+         goto error;
+      }
+   }
+   atomic_init (&ring->held, 0);
+
+   return ring;
+
+error:
+   if (ring->blocks != NULL)
+   {
+      for (ix = 0; ix < cfg->block_count; ix++)
+      {
+         free (ring->blocks[ix].bufs);
+      }
+      free (ring->blocks);
+   }
+   if (ring->epoll_fd != -1)
+   {
+      close (ring->epoll_fd);
+   }
+   if (ring->map != MAP_FAILED)
+   {
+      munmap (ring->map, ring->map_size);
+   }
+   /* Back to recv() */
+   memset (&req, 0, sizeof (req));
+   setsockopt (socket, SOL_PACKET, PACKET_RX_RING, &req, sizeof (req));
+   free (ring);
+   return NULL;
+}
+
 pnal_eth_handle_t * pnal_eth_init (
    const char * if_name,
    pnal_ethertype_t receive_type,
@@ -109,6 +462,7 @@ pnal_eth_handle_t * pnal_eth_init (
 
    handle->arg = arg;
    handle->callback = callback;
+   handle->ring = NULL;
    handle->socket = socket (PF_PACKET, SOCK_RAW, htons (linux_receive_type));
 
    /* Adjust send timeout */
@@ -170,11 +524,17 @@ pnal_eth_handle_t * pnal_eth_init (
 
    if (handle->socket > -1)
    {
+      if (pnal_cfg->eth_recv_ring.block_count > 0)
+      {
+         handle->ring =
+            pnal_eth_ring_init (handle->socket, &pnal_cfg->eth_recv_ring);
+      }
+
       handle->thread = os_thread_create (
          "os_eth_task",
          pnal_cfg->eth_recv_thread.prio,
          pnal_cfg->eth_recv_thread.stack_size,
-         os_eth_task,
+         (handle->ring != NULL) ? os_eth_ring_task : os_eth_task,
          handle);
       return handle;
    }
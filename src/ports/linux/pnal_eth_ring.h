@@ -0,0 +1,44 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+/**
+ * @file
+ * @brief Linux Ethernet receive ring, as seen by the buffer functions
+ */
+
+#ifndef PNAL_ETH_RING_H
+#define PNAL_ETH_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "pnal.h"
+
+/**
+ * @internal
+ * Free a frame that was handed over from the receive ring, giving its
+ * block back to the kernel if it was the last one held.
+ * May be called from any thread.
+ *
+ * @param p                In:    Buffer with ring_block set
+ */
+void pnal_eth_ring_release (pnal_buf_t * p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PNAL_ETH_RING_H */
@@ -26,12 +26,38 @@ extern "C" {
 
 #define PNAL_BUF_MAX_SIZE 1522
 
+struct pnal_eth_ring_block;
+
 typedef struct os_buf
 {
    void * payload;
    uint16_t len;
+   /* Block of the receive ring the payload lies in, NULL if allocated */
+   struct pnal_eth_ring_block * ring_block;
 } pnal_buf_t;
 
+/**
+ * Counters of the pool pnal_buf_alloc() takes buffers from
+ */
+typedef struct pnal_buf_pool_stats
+{
+   uint32_t size;       /* Buffers in the pool */
+   uint32_t in_use;     /* Allocated and not yet freed, pool or heap */
+   uint32_t high_water; /* Most in use at once */
+   uint32_t exhausted;  /* Allocations the pool had no buffer for */
+   uint32_t oversize;   /* Allocations larger than PNAL_BUF_MAX_SIZE */
+} pnal_buf_pool_stats_t;
+
+/**
+ * Read the counters of the buffer pool. Buffers taken from the heap,
+ * when the pool was out of them or they were too large, count towards
+ * in_use and high_water too. Up to 16 buffers per thread may be kept
+ * aside for that thread, so the pool may run out with fewer in use.
+ *
+ * @param stats            Out:   Counters
+ */
+void pnal_buf_pool_stats (pnal_buf_pool_stats_t * stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,12 +13,32 @@
  * full license information.
  ********************************************************************/
 
+#define _GNU_SOURCE /* For recvmmsg() */
+
 #include "pnal.h"
 #include "pf_includes.h"
 
+#include <sys/epoll.h>
+
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+/* Datagrams per recvmmsg() call */
+#define PNAL_UDP_MMSG_MAX 16
+
+/* Events taken per epoll_wait() call by the watching thread */
+#define PNAL_UDP_WATCH_EVENTS 8
+
+struct pnal_udp_watch
+{
+   pnal_udp_watch_callback_t * callback;
+   void * arg;
+   int epoll_fd;
+   os_thread_t * thread;
+};
+
 int pnal_udp_open (pnal_ipaddr_t addr, pnal_ipport_t port)
 {
    struct sockaddr_in local;
@@ -106,7 +126,132 @@ int pnal_udp_recvfrom (
    return len;
 }
 
+int pnal_udp_recvmmsg (uint32_t id, pnal_udp_msg_t * msgs, int count)
+{
+   struct mmsghdr hdrs[PNAL_UDP_MMSG_MAX];
+   struct iovec iovs[PNAL_UDP_MMSG_MAX];
+   struct sockaddr_in remotes[PNAL_UDP_MMSG_MAX];
+   int ret;
+   int ix;
+
+   if (count > PNAL_UDP_MMSG_MAX)
+   {
+      count = PNAL_UDP_MMSG_MAX;
+   }
+
+   memset (hdrs, 0, count * sizeof (hdrs[0]));
+   for (ix = 0; ix < count; ix++)
+   {
+      memset (&remotes[ix], 0, sizeof (remotes[ix]));
+      iovs[ix].iov_base = msgs[ix].data;
+      iovs[ix].iov_len = msgs[ix].size;
+      hdrs[ix].msg_hdr.msg_name = &remotes[ix];
+      hdrs[ix].msg_hdr.msg_namelen = sizeof (remotes[ix]);
+      hdrs[ix].msg_hdr.msg_iov = &iovs[ix];
+      hdrs[ix].msg_hdr.msg_iovlen = 1;
+   }
+
+   ret = recvmmsg (id, hdrs, count, MSG_DONTWAIT, NULL);
+   if (ret < 0)
+   {
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+   }
+
+   for (ix = 0; ix < ret; ix++)
+   {
+      msgs[ix].addr = ntohl (remotes[ix].sin_addr.s_addr);
+      msgs[ix].port = ntohs (remotes[ix].sin_port);
+      msgs[ix].len = hdrs[ix].msg_len;
+   }
+
+   return ret;
+}
+
 void pnal_udp_close (uint32_t id)
 {
    close (id);
 }
+
+/**
+ * @internal
+ * Run a thread that waits for datagrams on the watched sockets, and calls
+ * watch->callback when any have arrived.
+ *
+ * The sockets are watched edge triggered, so they are not read here, and
+ * a socket left with datagrams in it is not reported again until another
+ * arrives.
+ *
+ * This is a function to be passed into os_thread_create()
+ * Do not change the argument types.
+ *
+ * @param thread_arg     InOut: Will be converted to pnal_udp_watch_t
+ */
+static void os_udp_watch_task (void * thread_arg)
+{
+   pnal_udp_watch_t * watch = thread_arg;
+   struct epoll_event events[PNAL_UDP_WATCH_EVENTS];
+   int ready;
+
+   while (1)
+   {
+      ready = epoll_wait (watch->epoll_fd, events, PNAL_UDP_WATCH_EVENTS, -1);
+      if (ready > 0)
+      {
+         watch->callback (watch->arg);
+      }
+   }
+}
+
+pnal_udp_watch_t * pnal_udp_watch_init (
+   const pnal_cfg_t * pnal_cfg,
+   pnal_udp_watch_callback_t * callback,
+   void * arg)
+{
+   pnal_udp_watch_t * watch;
+
+   watch = malloc (sizeof (pnal_udp_watch_t));
+   if (watch == NULL)
+   {
+      return NULL;
+   }
+
+   watch->callback = callback;
+   watch->arg = arg;
+   watch->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+   if (watch->epoll_fd == -1)
+   {
+      free (watch);
+      return NULL;
+   }
+
+   watch->thread = os_thread_create (
+      "os_udp_watch_task",
+      pnal_cfg->udp_watch_thread.prio,
+      pnal_cfg->udp_watch_thread.stack_size,
+      os_udp_watch_task,
+      watch);
+   if (watch->thread == NULL)
+   {
+      close (watch->epoll_fd);
+      free (watch);
+      return NULL;
+   }
+
+   return watch;
+}
+
+int pnal_udp_watch_add (pnal_udp_watch_t * watch, uint32_t id)
+{
+   struct epoll_event event;
+
+   memset (&event, 0, sizeof (event));
+   event.events = EPOLLIN | EPOLLET;
+   event.data.fd = id;
+
+   return epoll_ctl (watch->epoll_fd, EPOLL_CTL_ADD, id, &event);
+}
+
+void pnal_udp_watch_remove (pnal_udp_watch_t * watch, uint32_t id)
+{
+   epoll_ctl (watch->epoll_fd, EPOLL_CTL_DEL, id, NULL);
+}
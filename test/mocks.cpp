@@ -28,6 +28,13 @@ struct pnal_eth_handle
    void * arg;
 };
 
+struct pnal_udp_watch
+{
+   pnal_udp_watch_callback_t * callback;
+   void * arg;
+   bool add_fails;
+};
+
 uint8_t pnet_log_level;
 
 os_mutex_t * mock_mutex;
@@ -36,6 +43,7 @@ mock_lldp_data_t mock_lldp_data;
 mock_file_data_t mock_file_data;
 mock_fspm_data_t mock_fspm_data;
 pnal_eth_handle_t mock_eth_handle;
+pnal_udp_watch_t mock_udp_watch;
 
 void mock_clear (void)
 {
@@ -51,6 +59,7 @@ void mock_clear (void)
 void mock_init (void)
 {
    mock_mutex = os_mutex_create();
+   memset (&mock_udp_watch, 0, sizeof (mock_udp_watch));
    mock_clear();
 }
 
@@ -208,10 +217,63 @@ int mock_pnal_udp_recvfrom (
    return len;
 }
 
+int mock_pnal_udp_recvmmsg (uint32_t id, pnal_udp_msg_t * msgs, int count)
+{
+   int received = 0;
+
+   if (count > 0)
+   {
+      msgs[0].addr = 0;
+      msgs[0].port = 0;
+      msgs[0].len = mock_pnal_udp_recvfrom (
+         id,
+         &msgs[0].addr,
+         &msgs[0].port,
+         msgs[0].data,
+         msgs[0].size);
+      received = (msgs[0].len > 0) ? 1 : 0;
+   }
+
+   return received;
+}
+
 void mock_pnal_udp_close (uint32_t id)
 {
 }
 
+pnal_udp_watch_t * mock_pnal_udp_watch_init (
+   const pnal_cfg_t * pnal_cfg,
+   pnal_udp_watch_callback_t * callback,
+   void * arg)
+{
+   mock_udp_watch.callback = callback;
+   mock_udp_watch.arg = arg;
+
+   return &mock_udp_watch;
+}
+
+int mock_pnal_udp_watch_add (pnal_udp_watch_t * watch, uint32_t id)
+{
+   return watch->add_fails ? -1 : 0;
+}
+
+void mock_pnal_udp_watch_remove (pnal_udp_watch_t * watch, uint32_t id)
+{
+}
+
+void mock_set_pnal_udp_watch_add_fails (bool fails)
+{
+   mock_udp_watch.add_fails = fails;
+}
+
+void mock_pnal_udp_watch_trigger (void)
+{
+   if (mock_udp_watch.callback != NULL)
+   {
+      mock_udp_watch.callback (mock_udp_watch.arg);
+   }
+}
+
 int mock_pnal_get_interface_index (const char * interface_name)
 {
    return mock_os_data.interface_index;
@@ -98,6 +98,12 @@ void mock_init (void);
 void mock_clear (void);
 void mock_set_pnal_udp_recvfrom_buffer (uint8_t * p_src, uint16_t len);
 
+/** Report datagrams as arrived on the watched UDP sockets */
+void mock_pnal_udp_watch_trigger (void);
+
+/** Fail to watch UDP sockets, until mock_init() */
+void mock_set_pnal_udp_watch_add_fails (bool fails);
+
 pnal_eth_handle_t * mock_pnal_eth_init (
    const char * if_name,
    const pnal_cfg_t * pnal_cfg,
@@ -128,7 +134,14 @@ int mock_pnal_udp_recvfrom (
    pnal_ipport_t * dst_port,
    uint8_t * data,
    int size);
+int mock_pnal_udp_recvmmsg (uint32_t id, pnal_udp_msg_t * msgs, int count);
 void mock_pnal_udp_close (uint32_t id);
+pnal_udp_watch_t * mock_pnal_udp_watch_init (
+   const pnal_cfg_t * pnal_cfg,
+   pnal_udp_watch_callback_t * callback,
+   void * arg);
+int mock_pnal_udp_watch_add (pnal_udp_watch_t * watch, uint32_t id);
+void mock_pnal_udp_watch_remove (pnal_udp_watch_t * watch, uint32_t id);
 int mock_pnal_set_ip_suite (
    const char * interface_name,
    const pnal_ipaddr_t * p_ipaddr,
@@ -0,0 +1,64 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#ifndef PNET2CSV_TEST_UTILS_H
+#define PNET2CSV_TEST_UTILS_H
+
+#include "utils_for_testing.h"
+
+#include "byte_buffer.h"
+#include "column_table.h"
+#include "entry_filter.h"
+
+/* Logs and tables of entries. 2024-05-06T10:00:00, in ns since 1970 */
+#define TEST_LOG_START  (1714989600LL * 1000000000LL)
+#define TEST_TABLE_ROWS 10
+
+/** Words 3 and 10 of TEST_TABLE_ROWS rows, a millisecond apart from
+ *  TEST_LOG_START, for the writers of pnet2csv to write to out */
+class ColumnTableUnitTest : public PnetUnitTest
+{
+ protected:
+   entry_filter_t filter;
+   column_table_t table;
+   byte_buffer_t out;
+
+   /** Set the words of a row, whose time may be changed too */
+   virtual void fill_row (size_t row) = 0;
+
+   virtual void SetUp() override
+   {
+      memset (&out, 0, sizeof (out));
+
+      filterInit (&filter);
+      ASSERT_EQ (0, filterParseWords (&filter, "3,10"));
+      ASSERT_EQ (0, columnTableInit (&table, TEST_TABLE_ROWS, 2));
+
+      table.count = TEST_TABLE_ROWS;
+      for (size_t i = 0; i < TEST_TABLE_ROWS; i++)
+      {
+         table.time[i] = TEST_LOG_START + i * 1000000;
+         fill_row (i);
+      }
+   };
+
+   virtual void TearDown() override
+   {
+      columnTableFree (&table);
+      bufferFree (&out);
+   };
+};
+
+#endif /* PNET2CSV_TEST_UTILS_H */
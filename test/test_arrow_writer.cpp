@@ -0,0 +1,330 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "pnet2csv_test_utils.h"
+
+#include "arrow_writer.h"
+
+#include <gtest/gtest.h>
+
+#include <endian.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+/* Schema.fbs and Message.fbs, the values checked */
+#define HEADER_SCHEMA        1
+#define HEADER_RECORD_BATCH  3
+#define TYPE_INT             2
+#define TYPE_TIMESTAMP       10
+#define TIME_UNIT_NANOSECOND 3
+
+/* rows of the second batch */
+#define TEST_ROWS_SHORT 5
+
+/* reads the tables, vectors and strings of a flatbuffer, positions from its start */
+class flat_reader
+{
+ public:
+   const uint8_t * data;
+   size_t size;
+   bool failed = false;
+
+   flat_reader (const uint8_t * data, size_t size) : data (data), size (size)
+   {
+   }
+
+   uint64_t le (size_t pos, size_t bytes)
+   {
+      uint64_t value = 0;
+      if (pos + bytes > size)
+      {
+         failed = true;
+         return 0;
+      }
+      for (size_t b = 0; b < bytes; b++)
+      {
+         value |= (uint64_t)data[pos + b] << (8 * b);
+      }
+      return value;
+   }
+
+   /* what the offset at a position points to */
+   size_t follow (size_t pos)
+   {
+      return pos + le (pos, 4);
+   }
+
+   size_t root()
+   {
+      return follow (0);
+   }
+
+   /* where a field of a table is, 0 if it is absent */
+   size_t field (size_t table, int id)
+   {
+      size_t vtable = table - (int32_t)le (table, 4);
+      if (4 + 2 * (uint64_t)id >= le (vtable, 2))
+      {
+         return 0;
+      }
+      size_t offset = le (vtable + 4 + 2 * id, 2);
+      return offset ? table + offset : 0;
+   }
+
+   uint64_t scalar (size_t table, int id, size_t bytes)
+   {
+      size_t pos = field (table, id);
+      return pos ? le (pos, bytes) : 0;
+   }
+
+   /* the table, vector or string a field points to */
+   size_t child (size_t table, int id)
+   {
+      size_t pos = field (table, id);
+      if (pos == 0)
+      {
+         failed = true;
+         return 0;
+      }
+      return follow (pos);
+   }
+
+   size_t length (size_t vector)
+   {
+      return le (vector, 4);
+   }
+
+   std::string string (size_t table, int id)
+   {
+      size_t pos = child (table, id);
+      size_t length = this->length (pos);
+      if (pos + 4 + length > size)
+      {
+         failed = true;
+         return "";
+      }
+      return std::string ((const char *)data + pos + 4, length);
+   }
+};
+
+class ArrowWriterUnitTest : public ColumnTableUnitTest
+{
+ protected:
+   std::vector<arrow_block_t> blocks;
+
+   virtual void fill_row (size_t row) override
+   {
+      table.words[0][row] = 0x0100 + row;
+      table.words[1][row] = 0xFF00 - row;
+   };
+
+   /* a file of the whole table, then of its first rows */
+   void write_file()
+   {
+      arrow_file_t file;
+      arrow_block_t block;
+
+      ASSERT_EQ (0, arrowFileStart (&file, &filter.projection, &out));
+      for (size_t rows : {TEST_TABLE_ROWS, TEST_ROWS_SHORT})
+      {
+         size_t start = out.size;
+         table.count = rows;
+         ASSERT_EQ (0, arrowEncodeBatch (&table, &out, &block));
+         EXPECT_EQ (out.size - start, block.metadata_size + block.body_size);
+         ASSERT_EQ (0, arrowFileAdd (&file, &block));
+      }
+      ASSERT_EQ (0, arrowFileFinish (&file, &out));
+
+      blocks.assign (file.blocks, file.blocks + file.block_count);
+      arrowFileFree (&file);
+   }
+
+   uint32_t le32 (size_t pos)
+   {
+      uint32_t value;
+      memcpy (&value, out.data + pos, 4);
+      return le32toh (value);
+   }
+
+   /* the flatbuffer of the message at an offset in the file */
+   flat_reader message (size_t offset)
+   {
+      EXPECT_EQ (0u, offset % 8);
+      EXPECT_EQ (0xFFFFFFFFu, le32 (offset));
+      size_t size = le32 (offset + 4);
+      EXPECT_EQ (0u, size % 8);
+      EXPECT_LE (offset + 8 + size, out.size);
+
+      return flat_reader (out.data + offset + 8, size);
+   }
+
+   void check_schema (flat_reader & fb, size_t schema)
+   {
+      const char * names[] = {"time", "word3", "word10"};
+
+      size_t fields = fb.child (schema, 1);
+      ASSERT_EQ (3u, fb.length (fields));
+      for (size_t c = 0; c < 3; c++)
+      {
+         size_t field = fb.follow (fields + 4 + 4 * c);
+         EXPECT_EQ (names[c], fb.string (field, 0));
+         EXPECT_EQ (0u, fb.scalar (field, 1, 1));
+         EXPECT_EQ (0u, fb.length (fb.child (field, 5)));
+
+         size_t type = fb.child (field, 3);
+         if (c == 0)
+         {
+            EXPECT_EQ ((uint64_t)TYPE_TIMESTAMP, fb.scalar (field, 2, 1));
+            EXPECT_EQ ((uint64_t)TIME_UNIT_NANOSECOND, fb.scalar (type, 0, 2));
+            /* no time zone */
+            EXPECT_EQ (0u, fb.field (type, 1));
+         }
+         else
+         {
+            EXPECT_EQ ((uint64_t)TYPE_INT, fb.scalar (field, 2, 1));
+            EXPECT_EQ (16u, fb.scalar (type, 0, 4));
+            EXPECT_EQ (0u, fb.scalar (type, 1, 1));
+         }
+      }
+      EXPECT_FALSE (fb.failed);
+   }
+
+   void check_batch (const arrow_block_t & block, size_t rows)
+   {
+      flat_reader fb = message (block.offset);
+      EXPECT_EQ (block.metadata_size, 8 + fb.size);
+
+      size_t root = fb.root();
+      EXPECT_EQ ((uint64_t)HEADER_RECORD_BATCH, fb.scalar (root, 1, 1));
+      EXPECT_EQ (block.body_size, fb.scalar (root, 3, 8));
+
+      size_t batch = fb.child (root, 2);
+      EXPECT_EQ (rows, fb.scalar (batch, 0, 8));
+
+      /* each column all there, nothing null */
+      size_t nodes = fb.child (batch, 1);
+      ASSERT_EQ (3u, fb.length (nodes));
+      EXPECT_EQ (0u, (nodes + 4) % 8);
+      for (size_t c = 0; c < 3; c++)
+      {
+         EXPECT_EQ (rows, fb.le (nodes + 4 + 16 * c, 8));
+         EXPECT_EQ (0u, fb.le (nodes + 4 + 16 * c + 8, 8));
+      }
+
+      /* an empty validity buffer, then the values, each aligned in the body */
+      size_t buffers = fb.child (batch, 2);
+      ASSERT_EQ (6u, fb.length (buffers));
+      EXPECT_EQ (0u, (buffers + 4) % 8);
+      const uint8_t * body = out.data + block.offset + block.metadata_size;
+      for (size_t c = 0; c < 3; c++)
+      {
+         size_t validity = buffers + 4 + 32 * c;
+         uint64_t offset = fb.le (validity + 16, 8);
+         uint64_t length = fb.le (validity + 24, 8);
+
+         EXPECT_EQ (0u, fb.le (validity + 8, 8));
+         EXPECT_EQ (0u, offset % 64);
+         EXPECT_EQ (rows * ((c == 0) ? 8 : 2), length);
+         ASSERT_LE (offset + length, block.body_size);
+
+         for (size_t i = 0; i < rows; i++)
+         {
+            if (c == 0)
+            {
+               int64_t time;
+               memcpy (&time, body + offset + 8 * i, 8);
+               EXPECT_EQ (table.time[i], (int64_t)le64toh (time));
+            }
+            else
+            {
+               uint16_t word;
+               memcpy (&word, body + offset + 2 * i, 2);
+               EXPECT_EQ (table.words[c - 1][i], le16toh (word));
+            }
+         }
+      }
+      EXPECT_FALSE (fb.failed);
+   }
+};
+
+TEST_F (ArrowWriterUnitTest, ArrowWriterSchemaMessage)
+{
+   write_file();
+
+   ASSERT_GE (out.size, 8u);
+   EXPECT_EQ (0, memcmp (out.data, "ARROW1\0\0", 8));
+
+   flat_reader fb = message (8);
+   size_t root = fb.root();
+   EXPECT_EQ ((uint64_t)HEADER_SCHEMA, fb.scalar (root, 1, 1));
+   EXPECT_EQ (0u, fb.scalar (root, 3, 8));
+   check_schema (fb, fb.child (root, 2));
+
+   /* the first batch right after it */
+   ASSERT_EQ (2u, blocks.size());
+   EXPECT_EQ (8 + 8 + fb.size, blocks[0].offset);
+}
+
+TEST_F (ArrowWriterUnitTest, ArrowWriterFooter)
+{
+   write_file();
+
+   ASSERT_GE (out.size, 18u);
+   EXPECT_EQ (0, memcmp (out.data + out.size - 6, "ARROW1", 6));
+   size_t footer_size = le32 (out.size - 10);
+   ASSERT_LE (footer_size + 18, out.size);
+   size_t footer_start = out.size - 10 - footer_size;
+
+   /* the end of stream marker before it */
+   EXPECT_EQ (0xFFFFFFFFu, le32 (footer_start - 8));
+   EXPECT_EQ (0u, le32 (footer_start - 4));
+
+   flat_reader fb (out.data + footer_start, footer_size);
+   size_t footer = fb.root();
+   check_schema (fb, fb.child (footer, 1));
+   EXPECT_EQ (0u, fb.length (fb.child (footer, 2)));
+
+   /* the blocks, as they were added */
+   size_t batches = fb.child (footer, 3);
+   ASSERT_EQ (2u, fb.length (batches));
+   EXPECT_EQ (0u, (batches + 4) % 8);
+   for (size_t b = 0; b < 2; b++)
+   {
+      size_t block = batches + 4 + 24 * b;
+      EXPECT_EQ (blocks[b].offset, fb.le (block, 8));
+      EXPECT_EQ (blocks[b].metadata_size, fb.le (block + 8, 4));
+      EXPECT_EQ (blocks[b].body_size, fb.le (block + 16, 8));
+   }
+   EXPECT_FALSE (fb.failed);
+
+   /* the second batch right after the first, the marker after that */
+   EXPECT_EQ (
+      blocks[0].offset + blocks[0].metadata_size + blocks[0].body_size,
+      blocks[1].offset);
+   EXPECT_EQ (
+      blocks[1].offset + blocks[1].metadata_size + blocks[1].body_size,
+      footer_start - 8);
+}
+
+TEST_F (ArrowWriterUnitTest, ArrowWriterRecordBatches)
+{
+   write_file();
+   ASSERT_EQ (2u, blocks.size());
+
+   check_batch (blocks[0], TEST_TABLE_ROWS);
+   check_batch (blocks[1], TEST_ROWS_SHORT);
+}
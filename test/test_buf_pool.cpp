@@ -0,0 +1,177 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+
+#include "pnal.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class BufPoolUnitTest : public PnetUnitTest
+{
+ protected:
+   pnal_buf_pool_stats_t before;
+
+   virtual void SetUp()
+   {
+      pnal_buf_pool_stats (&before);
+   };
+
+   pnal_buf_pool_stats_t now()
+   {
+      pnal_buf_pool_stats_t stats;
+      pnal_buf_pool_stats (&stats);
+      return stats;
+   }
+};
+
+TEST_F (BufPoolUnitTest, BufPoolReuse)
+{
+   pnal_buf_t * p = pnal_buf_alloc (1500);
+   ASSERT_NE (nullptr, p);
+   EXPECT_EQ (1500, p->len);
+   EXPECT_EQ ((uint8_t *)p + sizeof (pnal_buf_t), p->payload);
+   EXPECT_EQ (before.in_use + 1, now().in_use);
+   memset (p->payload, 0xA5, PNAL_BUF_MAX_SIZE);
+
+   /* the one just freed comes back, whatever size is asked for */
+   pnal_buf_free (p);
+   EXPECT_EQ (before.in_use, now().in_use);
+   pnal_buf_t * q = pnal_buf_alloc (10);
+   EXPECT_EQ (p, q);
+   EXPECT_EQ (10, q->len);
+   pnal_buf_free (q);
+
+   pnal_buf_free (NULL);
+   EXPECT_EQ (before.in_use, now().in_use);
+   EXPECT_EQ (before.exhausted, now().exhausted);
+}
+
+TEST_F (BufPoolUnitTest, BufPoolOversize)
+{
+   pnal_buf_t * p = pnal_buf_alloc (PNAL_BUF_MAX_SIZE + 100);
+   ASSERT_NE (nullptr, p);
+   EXPECT_EQ (PNAL_BUF_MAX_SIZE + 100, p->len);
+   memset (p->payload, 0xA5, p->len);
+   EXPECT_EQ (before.oversize + 1, now().oversize);
+   EXPECT_EQ (before.in_use + 1, now().in_use);
+   pnal_buf_free (p);
+   EXPECT_EQ (before.in_use, now().in_use);
+}
+
+TEST_F (BufPoolUnitTest, BufPoolExhausted)
+{
+   std::vector<pnal_buf_t *> bufs;
+
+   /* more than there are, from the heap once the pool is out */
+   for (uint32_t i = 0; i < before.size + 10; i++)
+   {
+      pnal_buf_t * p = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
+      ASSERT_NE (nullptr, p);
+      memset (p->payload, i & 0xFF, PNAL_BUF_MAX_SIZE);
+      bufs.push_back (p);
+   }
+   EXPECT_GE (now().exhausted, before.exhausted + 10);
+   EXPECT_GE (now().high_water, before.in_use + before.size + 10);
+
+   for (uint32_t i = 0; i < bufs.size(); i++)
+   {
+      EXPECT_EQ (i & 0xFF, ((uint8_t *)bufs[i]->payload)[PNAL_BUF_MAX_SIZE - 1]);
+      pnal_buf_free (bufs[i]);
+   }
+   EXPECT_EQ (before.in_use, now().in_use);
+
+   /* and all back */
+   pnal_buf_pool_stats_t after = now();
+   bufs.clear();
+   for (uint32_t i = 0; i < before.size / 2; i++)
+   {
+      bufs.push_back (pnal_buf_alloc (PNAL_BUF_MAX_SIZE));
+   }
+   EXPECT_EQ (after.exhausted, now().exhausted);
+   for (pnal_buf_t * p : bufs)
+   {
+      pnal_buf_free (p);
+   }
+}
+
+TEST_F (BufPoolUnitTest, BufPoolThreads)
+{
+   const int rounds = 20000;
+   std::mutex lock;
+   std::vector<pnal_buf_t *> handed;
+   std::vector<std::thread> threads;
+   int errors = 0;
+
+   /* each allocates, marks and checks its buffers, and frees half of
+      them and hands the rest to the others to free, as a receive thread
+      hands frames to the main thread */
+   for (int t = 0; t < 4; t++)
+   {
+      threads.push_back (std::thread ([&, t]() {
+         pnal_buf_t * own[4];
+         int bad = 0;
+
+         for (int round = 0; round < rounds; round++)
+         {
+            uint32_t mark = (t << 24) | round;
+
+            for (pnal_buf_t *& p : own)
+            {
+               p = pnal_buf_alloc (PNAL_BUF_MAX_SIZE);
+               memcpy (p->payload, &mark, sizeof (mark));
+            }
+            std::this_thread::yield();
+            for (pnal_buf_t * p : own)
+            {
+               bad += memcmp (p->payload, &mark, sizeof (mark)) != 0;
+            }
+
+            pnal_buf_free (own[0]);
+            pnal_buf_free (own[1]);
+
+            std::lock_guard<std::mutex> guard (lock);
+            handed.push_back (own[2]);
+            handed.push_back (own[3]);
+            while (handed.size() > 8)
+            {
+               pnal_buf_free (handed.front());
+               handed.erase (handed.begin());
+            }
+         }
+
+         std::lock_guard<std::mutex> guard (lock);
+         errors += bad;
+      }));
+   }
+   for (std::thread & thread : threads)
+   {
+      thread.join();
+   }
+   for (pnal_buf_t * p : handed)
+   {
+      pnal_buf_free (p);
+   }
+
+   EXPECT_EQ (0, errors);
+   EXPECT_EQ (before.in_use, now().in_use);
+   EXPECT_EQ (before.exhausted, now().exhausted);
+}
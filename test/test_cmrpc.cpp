@@ -40,6 +40,50 @@ class CmrpcTest : public PnetIntegrationTest
 {
 };
 
+static uint16_t rpc_ready_calls;
+
+static void my_rpc_ready_ind (pnet_t * net, void * arg)
+{
+   rpc_ready_calls++;
+}
+
+/* The RPC sockets are watched, and read when the application is told */
+class CmrpcWatchTest : public PnetIntegrationTestBase
+{
+ protected:
+   bool watch_add_fails = false;
+
+   virtual void SetUp() override
+   {
+      mock_init();
+      mock_set_pnal_udp_watch_add_fails (watch_add_fails);
+      cfg_init();
+      pnet_default_cfg.rpc_ready_cb = my_rpc_ready_ind;
+      appdata_init();
+      available_modules_and_submodules_init();
+
+      callcounter_reset();
+      rpc_ready_calls = 0;
+
+      pnet_init_only (net, &pnet_default_cfg);
+
+      pf_pdport_update_eth_status (net);
+
+      mock_clear(); /* lldp sends a frame at init */
+   };
+};
+
+/* The RPC sockets can not be watched after all, so they are polled */
+class CmrpcWatchFailTest : public CmrpcWatchTest
+{
+ protected:
+   virtual void SetUp() override
+   {
+      watch_add_fails = true;
+      CmrpcWatchTest::SetUp();
+   };
+};
+
 // clang-format off
 
 /**
@@ -421,6 +465,42 @@ TEST_F (CmrpcTest, CmrpcConnectReleaseTest)
    EXPECT_EQ (mock_os_data.udp_sendto_len, 132);
 }
 
+TEST_F (CmrpcWatchTest, CmrpcWatchConnectTest)
+{
+   EXPECT_NE (net->cmrpc_watch, nullptr);
+
+   /* Not read on the tick */
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 0);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 0);
+
+   mock_pnal_udp_watch_trigger();
+   EXPECT_EQ (rpc_ready_calls, 1);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 0);
+
+   pnet_handle_rpc (net);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+
+   /* Less than a batch was waiting, so nothing more to tell */
+   EXPECT_EQ (rpc_ready_calls, 1);
+   pnet_handle_rpc (net);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+}
+
+TEST_F (CmrpcWatchFailTest, CmrpcWatchFailConnectTest)
+{
+   EXPECT_EQ (net->cmrpc_watch, nullptr);
+
+   /* Read on the tick, as when not watched at all */
+   mock_set_pnal_udp_recvfrom_buffer (connect_req, sizeof (connect_req));
+   run_stack (TEST_UDP_DELAY);
+   EXPECT_EQ (appdata.call_counters.connect_calls, 1);
+   EXPECT_EQ (mock_os_data.udp_sendto_count, 1);
+   EXPECT_EQ (rpc_ready_calls, 0);
+}
+
 TEST_F (CmrpcTest, CmrpcConnectionTimeoutTest)
 {
    int ret;
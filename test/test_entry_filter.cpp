@@ -0,0 +1,166 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+
+#include "entry_filter.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+class EntryFilterUnitTest : public PnetUnitTest
+{
+ protected:
+   entry_filter_t filter;
+   record_block_t block;
+   previous_entry_t previous;
+   uint16_t selected[RECORD_BLOCK];
+
+   virtual void SetUp()
+   {
+      filterInit (&filter);
+      memset (&block, 0, sizeof (block));
+      memset (&previous, 0, sizeof (previous));
+   };
+
+   /* word 7 counts up every fourth entry, word 3 has bit 4 on every fifth */
+   void fill_block (size_t count, size_t first)
+   {
+      block.count = count;
+      for (size_t i = 0; i < count; i++)
+      {
+         block.words[1][i] = first + i;
+         block.words[7][i] = (first + i) / 4;
+         block.words[3][i] = ((first + i) % 5 == 0) ? 0x10 : 0x01;
+      }
+   }
+};
+
+TEST_F (EntryFilterUnitTest, EntryFilterParseWords)
+{
+   EXPECT_EQ (LOG_WORD_COUNT, filter.projection.count);
+
+   ASSERT_EQ (0, filterParseWords (&filter, "12,1, 7"));
+   ASSERT_EQ (3, filter.projection.count);
+   EXPECT_EQ (12, filter.projection.words[0]);
+   EXPECT_EQ (1, filter.projection.words[1]);
+   EXPECT_EQ (7, filter.projection.words[2]);
+
+   ASSERT_EQ (0, filterParseWords (&filter, "0-3,9"));
+   ASSERT_EQ (5, filter.projection.count);
+   EXPECT_EQ (3, filter.projection.words[3]);
+   EXPECT_EQ (9, filter.projection.words[4]);
+
+   /* a failed parse leaves the projection as it was */
+   EXPECT_EQ (-1, filterParseWords (&filter, ""));
+   EXPECT_EQ (-1, filterParseWords (&filter, "1,"));
+   EXPECT_EQ (-1, filterParseWords (&filter, "3-1"));
+   EXPECT_EQ (-1, filterParseWords (&filter, "64"));
+   EXPECT_EQ (-1, filterParseWords (&filter, "1;2"));
+   EXPECT_EQ (5, filter.projection.count);
+}
+
+TEST_F (EntryFilterUnitTest, EntryFilterParsePredicate)
+{
+   ASSERT_EQ (0, filterParsePredicate (&filter, "W7 != prev"));
+   EXPECT_EQ (7, filter.predicates[0].word);
+   EXPECT_EQ (PREDICATE_NOT_EQUAL, filter.predicates[0].op);
+   EXPECT_TRUE (filter.predicates[0].previous);
+   EXPECT_TRUE (filter.uses_previous);
+
+   ASSERT_EQ (0, filterParsePredicate (&filter, "w3&0x10"));
+   EXPECT_EQ (PREDICATE_BITS, filter.predicates[1].op);
+   EXPECT_EQ (0x10, filter.predicates[1].value);
+
+   ASSERT_EQ (0, filterParsePredicate (&filter, "W1 <= 100"));
+   EXPECT_EQ (PREDICATE_LESS_EQUAL, filter.predicates[2].op);
+   EXPECT_EQ (100, filter.predicates[2].value);
+   EXPECT_EQ (3, filter.predicate_count);
+
+   EXPECT_EQ (-1, filterParsePredicate (&filter, "X1 == 2"));
+   EXPECT_EQ (-1, filterParsePredicate (&filter, "W64 == 2"));
+   EXPECT_EQ (-1, filterParsePredicate (&filter, "W1 = 2"));
+   EXPECT_EQ (-1, filterParsePredicate (&filter, "W1 == 65536"));
+   EXPECT_EQ (-1, filterParsePredicate (&filter, "W1 & prev"));
+   EXPECT_EQ (-1, filterParsePredicate (&filter, "W1 == 2 extra"));
+   EXPECT_EQ (3, filter.predicate_count);
+}
+
+TEST_F (EntryFilterUnitTest, EntryFilterEverything)
+{
+   fill_block (RECORD_BLOCK, 0);
+
+   ASSERT_EQ (RECORD_BLOCK, filterEntries (&filter, &block, &previous, selected));
+   for (size_t i = 0; i < RECORD_BLOCK; i++)
+   {
+      EXPECT_EQ (i, selected[i]);
+   }
+   EXPECT_TRUE (previous.set);
+   EXPECT_EQ (RECORD_BLOCK - 1, previous.words[1]);
+}
+
+TEST_F (EntryFilterUnitTest, EntryFilterChangesAcrossBlocks)
+{
+   ASSERT_EQ (0, filterParsePredicate (&filter, "W7 != prev"));
+
+   /* nothing before the first, which is taken */
+   fill_block (10, 0);
+   ASSERT_EQ (3u, filterEntries (&filter, &block, &previous, selected));
+   EXPECT_EQ (0, selected[0]);
+   EXPECT_EQ (4, selected[1]);
+   EXPECT_EQ (8, selected[2]);
+
+   /* the next block continues from the last entry of this one */
+   fill_block (10, 10);
+   ASSERT_EQ (2u, filterEntries (&filter, &block, &previous, selected));
+   EXPECT_EQ (2, selected[0]);
+   EXPECT_EQ (6, selected[1]);
+
+   /* an empty block keeps the entry before */
+   fill_block (0, 20);
+   EXPECT_EQ (0u, filterEntries (&filter, &block, &previous, selected));
+   fill_block (1, 20);
+   EXPECT_EQ (1u, filterEntries (&filter, &block, &previous, selected));
+}
+
+TEST_F (EntryFilterUnitTest, EntryFilterAllPredicates)
+{
+   ASSERT_EQ (0, filterParsePredicate (&filter, "W3 & 0x10"));
+   ASSERT_EQ (0, filterParsePredicate (&filter, "W1 >= 10"));
+   ASSERT_EQ (0, filterParsePredicate (&filter, "W1 < 40"));
+
+   fill_block (RECORD_BLOCK, 0);
+   ASSERT_EQ (6u, filterEntries (&filter, &block, &previous, selected));
+   for (size_t i = 0; i < 6; i++)
+   {
+      EXPECT_EQ (10 + 5 * i, selected[i]);
+   }
+}
+
+TEST_F (EntryFilterUnitTest, EntryFilterPreviousFromRecord)
+{
+   uint8_t words[2 * LOG_WORD_COUNT] = {0};
+
+   words[2 * 7] = 0x12;
+   words[2 * 7 + 1] = 0x34;
+
+   previousEntrySet (&previous, words, true);
+   EXPECT_TRUE (previous.set);
+   EXPECT_EQ (0x1234, previous.words[7]);
+
+   previousEntrySet (&previous, words, false);
+   EXPECT_EQ (0x3412, previous.words[7]);
+}
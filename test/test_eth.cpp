@@ -20,10 +20,192 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 class EthTest : public PnetIntegrationTest
 {
 };
 
+/* Of the frame each thread received last */
+static thread_local uint16_t handled_frame_id;
+static thread_local void * handled_arg;
+
+static int test_frame_handler (
+   pnet_t * net,
+   uint16_t frame_id,
+   pnal_buf_t * p_buf,
+   uint16_t frame_id_pos,
+   void * p_arg)
+{
+   handled_frame_id = frame_id;
+   handled_arg = p_arg;
+   pnal_buf_free (p_buf);
+   return 1;
+}
+
+static int recv_profinet_frame (pnet_t * net, uint16_t frame_id)
+{
+   uint8_t frame[] = {
+      0x01, 0x0e, 0xcf, 0x00, 0x00, 0x00, /* Destination */
+      0x02, 0x00, 0x00, 0x00, 0x00, 0x01, /* Source */
+      0x88, 0x92,                         /* Ethertype */
+      0x00, 0x00,                         /* Frame id */
+   };
+   pnal_buf_t * p_buf;
+   int ret;
+
+   frame[14] = frame_id >> 8;
+   frame[15] = frame_id & 0xff;
+   p_buf = pnal_buf_alloc (PF_FRAME_BUFFER_SIZE);
+   memcpy (p_buf->payload, frame, sizeof (frame));
+   p_buf->len = sizeof (frame);
+
+   handled_frame_id = 0;
+   handled_arg = NULL;
+   ret = pf_eth_recv (mock_os_data.eth_if_handle, net, p_buf);
+   if (ret == 0)
+   {
+      pnal_buf_free (p_buf);
+   }
+
+   return ret;
+}
+
 TEST_F (EthTest, EthRunTest)
 {
 }
+
+TEST_F (EthTest, EthFrameIdMapTest)
+{
+   /* Same slot in the index */
+   const uint16_t first = 0x7000;
+   const uint16_t second = first + PF_ETH_ID_INDEX_SIZE;
+   int arg_first = 0;
+   int arg_second = 0;
+
+   EXPECT_EQ (recv_profinet_frame (net, first), 0);
+
+   pf_eth_frame_id_map_add (net, first, test_frame_handler, &arg_first);
+   pf_eth_frame_id_map_add (net, second, test_frame_handler, &arg_second);
+
+   EXPECT_EQ (recv_profinet_frame (net, first), 1);
+   EXPECT_EQ (handled_frame_id, first);
+   EXPECT_EQ (handled_arg, &arg_first);
+   EXPECT_EQ (recv_profinet_frame (net, second), 1);
+   EXPECT_EQ (handled_frame_id, second);
+   EXPECT_EQ (handled_arg, &arg_second);
+
+   /* The second is found past the free slot of the first */
+   pf_eth_frame_id_map_remove (net, first);
+   EXPECT_EQ (recv_profinet_frame (net, first), 0);
+   EXPECT_EQ (recv_profinet_frame (net, second), 1);
+   EXPECT_EQ (handled_arg, &arg_second);
+
+   /* The entry of the first is reused */
+   pf_eth_frame_id_map_add (net, first, test_frame_handler, &arg_second);
+   EXPECT_EQ (recv_profinet_frame (net, first), 1);
+   EXPECT_EQ (handled_arg, &arg_second);
+
+   pf_eth_frame_id_map_remove (net, first);
+   pf_eth_frame_id_map_remove (net, second);
+   EXPECT_EQ (recv_profinet_frame (net, first), 0);
+   EXPECT_EQ (recv_profinet_frame (net, second), 0);
+}
+
+#if PF_ETH_ID_INDEX
+TEST_F (EthTest, EthFrameIdMapThreadsTest)
+{
+   /* All in the same slot, the steady one found past some of the others */
+   const uint16_t steady = 0x7000;
+   const uint16_t changing[] = {
+      (uint16_t)(steady + PF_ETH_ID_INDEX_SIZE),
+      (uint16_t)(steady + 2 * PF_ETH_ID_INDEX_SIZE),
+      (uint16_t)(steady + 3 * PF_ETH_ID_INDEX_SIZE),
+   };
+   int arg_steady = 0;
+   int arg_changing[3] = {0};
+   std::atomic<bool> stop (false);
+   std::atomic<int> errors (0);
+   std::atomic<int> received (0);
+   std::atomic<int> started (0);
+   std::vector<std::thread> threads;
+
+   pf_eth_frame_id_map_add (net, changing[0], test_frame_handler, &arg_changing[0]);
+   pf_eth_frame_id_map_add (net, steady, test_frame_handler, &arg_steady);
+   pf_eth_frame_id_map_add (net, changing[1], test_frame_handler, &arg_changing[1]);
+
+   /* Receive threads, as the steady frame id is never removed it is
+      always found, and any other is found with its own handler or not */
+   for (int t = 0; t < 3; t++)
+   {
+      threads.push_back (std::thread ([&]() {
+         int bad = 0;
+         int count = 0;
+
+         while (!stop)
+         {
+            if (
+               recv_profinet_frame (net, steady) != 1 ||
+               handled_arg != &arg_steady)
+            {
+               bad++;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+               if (
+                  recv_profinet_frame (net, changing[k]) == 1 &&
+                  (handled_frame_id != changing[k] ||
+                   handled_arg != &arg_changing[k]))
+               {
+                  bad++;
+               }
+            }
+            if (count++ == 0)
+            {
+               started++;
+            }
+         }
+
+         errors += bad;
+         received += count;
+      }));
+   }
+
+   /* Not before they all receive, or the changes may be over first */
+   while (started < 3)
+   {
+      std::this_thread::yield();
+   }
+
+   /* Meanwhile the main thread adds and removes the others, moving them
+      about in the map and in the index */
+   for (int round = 0; round < 2000; round++)
+   {
+      int k = round % 3;
+
+      /* One of them is out of the map at a time */
+      pf_eth_frame_id_map_remove (net, changing[k]);
+      pf_eth_frame_id_map_add (
+         net,
+         changing[(k + 2) % 3],
+         test_frame_handler,
+         &arg_changing[(k + 2) % 3]);
+   }
+
+   stop = true;
+   for (std::thread & thread : threads)
+   {
+      thread.join();
+   }
+
+   EXPECT_EQ (errors, 0);
+   EXPECT_GT (received, 0);
+
+   pf_eth_frame_id_map_remove (net, steady);
+   pf_eth_frame_id_map_remove (net, changing[2000 % 3]);
+   pf_eth_frame_id_map_remove (net, changing[(2000 + 1) % 3]);
+   EXPECT_EQ (recv_profinet_frame (net, steady), 0);
+}
+#endif
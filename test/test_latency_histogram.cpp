@@ -0,0 +1,88 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+
+#include "latency_histogram.h"
+
+#include <gtest/gtest.h>
+
+class LatencyHistogramUnitTest : public PnetUnitTest
+{
+ protected:
+   latency_histogram_t histogram;
+
+   virtual void SetUp()
+   {
+      histogramInit (&histogram);
+   };
+};
+
+TEST_F (LatencyHistogramUnitTest, LatencyHistogramEmpty)
+{
+   EXPECT_EQ (0, histogramPercentile (&histogram, 99.9));
+   EXPECT_EQ (0.0, histogramMean (&histogram));
+}
+
+TEST_F (LatencyHistogramUnitTest, LatencyHistogramSmallValues)
+{
+   /* below the sub-buckets, every value is exact */
+   for (int64_t value = 1; value <= 10; value++)
+   {
+      histogramAdd (&histogram, value);
+   }
+   histogramAdd (&histogram, -5);
+
+   EXPECT_EQ (11u, histogram.total);
+   EXPECT_EQ (0, histogram.min);
+   EXPECT_EQ (10, histogram.max);
+   EXPECT_EQ (5, histogramPercentile (&histogram, 50.0));
+   EXPECT_EQ (10, histogramPercentile (&histogram, 100.0));
+   EXPECT_EQ (0, histogramPercentile (&histogram, 0.0));
+   EXPECT_DOUBLE_EQ (5.0, histogramMean (&histogram));
+}
+
+TEST_F (LatencyHistogramUnitTest, LatencyHistogramPercentiles)
+{
+   /* 1 us to 1 ms, one of each */
+   for (int64_t value = 1000; value <= 1000000; value += 1000)
+   {
+      histogramAdd (&histogram, value);
+   }
+
+   int64_t p50 = histogramPercentile (&histogram, 50.0);
+   int64_t p999 = histogramPercentile (&histogram, 99.9);
+
+   /* the top of the bucket, so at or above the value, and within its width */
+   EXPECT_GE (p50, 500000);
+   EXPECT_LT (p50, 500000 * 33 / 32);
+   EXPECT_GE (p999, 999000);
+   EXPECT_LE (p999, 1000000);
+   EXPECT_EQ (1000000, histogramPercentile (&histogram, 100.0));
+}
+
+TEST_F (LatencyHistogramUnitTest, LatencyHistogramOutlier)
+{
+   /* one in a thousand is what p99.9 is there to catch */
+   for (int i = 0; i < 999; i++)
+   {
+      histogramAdd (&histogram, 100);
+   }
+   histogramAdd (&histogram, 50000000);
+
+   EXPECT_LE (histogramPercentile (&histogram, 99.8), 103);
+   EXPECT_EQ (50000000, histogramPercentile (&histogram, 99.95));
+   EXPECT_EQ (50000000, histogram.max);
+}
@@ -0,0 +1,248 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "pnet2csv_test_utils.h"
+
+#include "app_logcatalog.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class LogCatalogUnitTest : public PnetUnitTest
+{
+ protected:
+   char dir[32];
+   int dir_fd;
+   log_catalog_t catalog;
+
+   virtual void SetUp()
+   {
+      strcpy (dir, "/tmp/logcatalogXXXXXX");
+      ASSERT_NE (nullptr, mkdtemp (dir));
+      dir_fd = open (dir, O_RDONLY | O_DIRECTORY);
+      logCatalogInit (&catalog);
+   };
+
+   virtual void TearDown()
+   {
+      logCatalogFree (&catalog);
+      close (dir_fd);
+      std::string command = std::string ("rm -rf ") + dir;
+      EXPECT_EQ (0, system (command.c_str()));
+   };
+
+   void append (uint8_t type, const char * name)
+   {
+      log_catalog_record_t record = {};
+      record.type = type;
+      strcpy (record.name, name);
+      EXPECT_EQ (0, logCatalogAppend (&catalog, &record));
+   }
+
+   void append_log (const char * name, uint32_t entries, int64_t first, int64_t last)
+   {
+      log_catalog_record_t record = {};
+      record.type = LOG_CATALOG_LOG;
+      record.entries = entries;
+      record.dropped = 1;
+      record.first = first;
+      record.last = last;
+      strcpy (record.name, name);
+      EXPECT_EQ (0, logCatalogAppend (&catalog, &record));
+   }
+
+   void reopen()
+   {
+      logCatalogFree (&catalog);
+      ASSERT_EQ (0, logCatalogOpen (&catalog, dir_fd));
+   }
+
+   off_t catalog_size()
+   {
+      struct stat statbuf;
+      EXPECT_EQ (0, fstatat (dir_fd, LOG_CATALOG_NAME, &statbuf, 0));
+      return statbuf.st_size;
+   }
+};
+
+TEST_F (LogCatalogUnitTest, LogCatalogNames)
+{
+   EXPECT_EQ (20240506u, logCatalogDate ("20240506"));
+   EXPECT_EQ (20240506u, logCatalogDate ("20240506/10-00.bin"));
+   EXPECT_EQ (20240506u, logCatalogDate ("20240506.zst"));
+   EXPECT_EQ (20240506u, logCatalogDate ("20240506.tgz"));
+   EXPECT_EQ (0u, logCatalogDate ("20240506.tar"));
+   EXPECT_EQ (0u, logCatalogDate ("2024050"));
+   EXPECT_EQ (0u, logCatalogDate ("20241306"));
+   EXPECT_EQ (0u, logCatalogDate (LOG_CATALOG_NAME));
+
+   /* 2024-05-06 10:00:00.000000123, big endian */
+   const uint8_t dtl[12] = {0x07, 0xE8, 5, 6, 1, 10, 0, 0, 0, 0, 0, 123};
+   EXPECT_EQ (TEST_LOG_START + 123, logCatalogTime (dtl, true));
+}
+
+TEST_F (LogCatalogUnitTest, LogCatalogDays)
+{
+   ASSERT_EQ (0, logCatalogOpen (&catalog, dir_fd));
+   EXPECT_EQ (nullptr, logCatalogOldest (&catalog));
+
+   ASSERT_EQ (0, mkdirat (dir_fd, "20240506", 0755));
+   ASSERT_EQ (0, mkdirat (dir_fd, "20240507", 0755));
+   append (LOG_CATALOG_DAY, "20240507");
+   append (LOG_CATALOG_DAY, "20240506");
+   append_log (
+      "20240506/10-00.bin",
+      100,
+      TEST_LOG_START,
+      TEST_LOG_START + 1000);
+   append_log (
+      "20240506/10-10.bin",
+      50,
+      TEST_LOG_START + 2000,
+      TEST_LOG_START + 3000);
+
+   /* in date order, whatever order they came in */
+   log_catalog_day_t * day = logCatalogOldest (&catalog);
+   ASSERT_NE (nullptr, day);
+   EXPECT_STREQ ("20240506", day->name);
+   EXPECT_EQ (2u, day->logs);
+   EXPECT_EQ (150u, day->entries);
+   EXPECT_EQ (2u, day->dropped);
+   EXPECT_EQ (TEST_LOG_START, day->first);
+   EXPECT_EQ (TEST_LOG_START + 3000, day->last);
+   EXPECT_FALSE (day->partial);
+
+   ASSERT_EQ (0, renameat (dir_fd, "20240506", dir_fd, "20240506.zst"));
+   append (LOG_CATALOG_ARCHIVED, "20240506.zst");
+   day = logCatalogOldest (&catalog);
+   EXPECT_STREQ ("20240506.zst", day->name);
+   EXPECT_EQ (LOG_CATALOG_ARCHIVED, day->state);
+
+   ASSERT_EQ (0, unlinkat (dir_fd, "20240506.zst", AT_REMOVEDIR));
+   append (LOG_CATALOG_DELETED, "20240506.zst");
+   day = logCatalogOldest (&catalog);
+   ASSERT_NE (nullptr, day);
+   EXPECT_STREQ ("20240507", day->name);
+
+   /* the days are read back, and the one left may hold a log left unfinished */
+   reopen();
+   day = logCatalogOldest (&catalog);
+   ASSERT_NE (nullptr, day);
+   EXPECT_STREQ ("20240507", day->name);
+   EXPECT_TRUE (day->partial);
+   day = logCatalogFindDay (&catalog, 20240506);
+   ASSERT_NE (nullptr, day);
+   EXPECT_EQ (LOG_CATALOG_DELETED, day->state);
+}
+
+TEST_F (LogCatalogUnitTest, LogCatalogFromDirectory)
+{
+   /* what was there before the catalog */
+   ASSERT_EQ (0, mkdirat (dir_fd, "20240506", 0755));
+   int fd = openat (dir_fd, "20240505.tgz", O_WRONLY | O_CREAT, 0644);
+   ASSERT_NE (-1, fd);
+   close (fd);
+   ASSERT_EQ (0, mkdirat (dir_fd, "notaday", 0755));
+
+   reopen();
+   log_catalog_day_t * day = logCatalogOldest (&catalog);
+   ASSERT_NE (nullptr, day);
+   EXPECT_STREQ ("20240505.tgz", day->name);
+   EXPECT_EQ (LOG_CATALOG_ARCHIVED, day->state);
+   day = logCatalogFindDay (&catalog, 20240506);
+   ASSERT_NE (nullptr, day);
+   EXPECT_EQ (LOG_CATALOG_DAY, day->state);
+   EXPECT_TRUE (day->partial);
+   EXPECT_EQ (2u, catalog.day_count);
+
+   /* one deleted behind its back is noticed */
+   ASSERT_EQ (0, unlinkat (dir_fd, "20240505.tgz", 0));
+   reopen();
+   day = logCatalogOldest (&catalog);
+   ASSERT_NE (nullptr, day);
+   EXPECT_STREQ ("20240506", day->name);
+}
+
+TEST_F (LogCatalogUnitTest, LogCatalogCutShort)
+{
+   ASSERT_EQ (0, mkdirat (dir_fd, "20240506", 0755));
+   ASSERT_EQ (0, logCatalogOpen (&catalog, dir_fd));
+   append_log (
+      "20240506/10-00.bin",
+      100,
+      TEST_LOG_START,
+      TEST_LOG_START + 1000);
+   off_t size = catalog_size();
+
+   /* part of a record, as a crash might leave */
+   int fd = openat (dir_fd, LOG_CATALOG_NAME, O_WRONLY | O_APPEND);
+   ASSERT_NE (-1, fd);
+   ASSERT_EQ (10, write (fd, "2024050610", 10));
+   close (fd);
+
+   log_catalog_record_t * records;
+   size_t count;
+   ASSERT_EQ (0, logCatalogRead (dir_fd, &records, &count));
+   EXPECT_EQ ((size_t)(size - LOG_CATALOG_HEADER_SIZE) / sizeof (log_catalog_record_t), count);
+   EXPECT_STREQ ("20240506/10-00.bin", records[count - 1].name);
+   EXPECT_EQ (TEST_LOG_START + 1000, records[count - 1].last);
+   free (records);
+
+   /* it is dropped, and the next one goes where it was */
+   reopen();
+   append_log (
+      "20240506/10-10.bin",
+      100,
+      TEST_LOG_START + 2000,
+      TEST_LOG_START + 3000);
+   ASSERT_EQ (0, logCatalogRead (dir_fd, &records, &count));
+   EXPECT_STREQ ("20240506/10-10.bin", records[count - 1].name);
+   free (records);
+}
+
+TEST_F (LogCatalogUnitTest, LogCatalogCompact)
+{
+   char name[LOG_CATALOG_NAME_SIZE];
+
+   ASSERT_EQ (0, logCatalogOpen (&catalog, dir_fd));
+
+   /* days that come and go, with one kept all along */
+   ASSERT_EQ (0, mkdirat (dir_fd, "20240101", 0755));
+   append (LOG_CATALOG_DAY, "20240101");
+   append_log ("20240101/10-00.bin", 1, TEST_LOG_START, TEST_LOG_START);
+   for (int day = 0; day < LOG_CATALOG_COMPACT_MIN; day++)
+   {
+      sprintf (name, "%04d%02d%02d", 2025 + day / 336, 1 + day / 28 % 12, 1 + day % 28);
+      append (LOG_CATALOG_DAY, name);
+      append (LOG_CATALOG_DELETED, name);
+   }
+
+   /* written again long before it got to all of those */
+   EXPECT_LT (catalog.records, (size_t)LOG_CATALOG_COMPACT_MIN);
+   EXPECT_LT (catalog_size(), (off_t)(LOG_CATALOG_COMPACT_MIN * sizeof (log_catalog_record_t)));
+
+   reopen();
+   log_catalog_day_t * day = logCatalogOldest (&catalog);
+   ASSERT_NE (nullptr, day);
+   EXPECT_STREQ ("20240101", day->name);
+   EXPECT_EQ (1u, day->logs);
+}
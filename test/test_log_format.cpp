@@ -0,0 +1,358 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+
+#include "app_logformat.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+class LogFormatUnitTest : public PnetUnitTest
+{
+ protected:
+   log_codec_t encoder;
+   log_codec_t decoder;
+   uint8_t encoded[LOG_RECORD_SIZE];
+   uint8_t decoded[LOG_RECORD_SIZE];
+
+   virtual void SetUp()
+   {
+      logCodecReset (&encoder);
+      logCodecReset (&decoder);
+   };
+
+   /* a version 1 record, with every word set from seed */
+   void make_record (
+      uint8_t * record,
+      uint8_t day,
+      uint8_t hour,
+      uint8_t minute,
+      uint8_t second,
+      uint32_t nano,
+      uint16_t seed,
+      bool bigendian)
+   {
+      uint8_t * dtl = record + 1;
+
+      record[0] = 0;
+      dtl[0] = bigendian ? 0x07 : 0xE8; /* 2024 */
+      dtl[1] = bigendian ? 0xE8 : 0x07;
+      dtl[2] = 5;
+      dtl[3] = day;
+      dtl[4] = 1;
+      dtl[5] = hour;
+      dtl[6] = minute;
+      dtl[7] = second;
+      for (int i = 0; i < 4; i++)
+      {
+         int shift = bigendian ? 24 - 8 * i : 8 * i;
+         dtl[8 + i] = (nano >> shift) & 0xFF;
+      }
+
+      for (int w = 0; w < LOG_WORD_COUNT; w++)
+      {
+         record[1 + LOG_DTL_SIZE + 2 * w] = (seed + w) >> 8;
+         record[1 + LOG_DTL_SIZE + 2 * w + 1] = (seed + w) & 0xFF;
+      }
+   }
+
+   void set_word (uint8_t * record, int word, uint16_t value)
+   {
+      record[1 + LOG_DTL_SIZE + 2 * word] = value >> 8;
+      record[1 + LOG_DTL_SIZE + 2 * word + 1] = value & 0xFF;
+   }
+
+   /* encode the record, then decode it again and check it came back the same */
+   size_t round_trip (const uint8_t * record, bool bigendian)
+   {
+      size_t size = logEncodeRecord (&encoder, record, bigendian, encoded);
+      EXPECT_LE (size, (size_t)LOG_RECORD_SIZE);
+
+      EXPECT_EQ (
+         (int)size,
+         logDecodeRecord (&decoder, encoded, size, bigendian, decoded));
+      EXPECT_EQ (0, memcmp (record, decoded, LOG_RECORD_SIZE));
+
+      return size;
+   }
+};
+
+TEST_F (LogFormatUnitTest, LogFormatRoundTrip)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+
+   for (bool bigendian : {true, false})
+   {
+      logCodecReset (&encoder);
+      logCodecReset (&decoder);
+
+      make_record (record, 6, 10, 0, 0, 0, 1000, bigendian);
+      EXPECT_EQ ((size_t)LOG_RECORD_SIZE, round_trip (record, bigendian));
+      EXPECT_EQ (LOG_RECORD_KEY, encoded[0]);
+
+      /* the same words a millisecond later: no groups at all */
+      make_record (record, 6, 10, 0, 0, 1000000, 1000, bigendian);
+      size_t size = round_trip (record, bigendian);
+      EXPECT_EQ (LOG_RECORD_DELTA, encoded[0]);
+      EXPECT_EQ (1u + 3 + 1, size);
+      EXPECT_EQ (0, encoded[4]);
+
+      /* over a second boundary, with a few words changed */
+      make_record (record, 6, 10, 0, 1, 500, 1000, bigendian);
+      set_word (record, 3, 0xBEEF);
+      set_word (record, 20, 0x1234);
+      size = round_trip (record, bigendian);
+      EXPECT_EQ (LOG_RECORD_DELTA, encoded[0]);
+      EXPECT_LT (size, (size_t)LOG_RECORD_SIZE);
+   }
+}
+
+TEST_F (LogFormatUnitTest, LogFormatKeyOnDateChange)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+
+   make_record (record, 6, 23, 59, 59, 900000000, 1000, true);
+   round_trip (record, true);
+
+   /* a tenth of a second later, but on the next day */
+   make_record (record, 7, 0, 0, 0, 0, 1000, true);
+   EXPECT_EQ ((size_t)LOG_RECORD_SIZE, round_trip (record, true));
+   EXPECT_EQ (LOG_RECORD_KEY, encoded[0]);
+
+   /* and it carries on from there */
+   make_record (record, 7, 0, 0, 0, 1000000, 1000, true);
+   round_trip (record, true);
+   EXPECT_EQ (LOG_RECORD_DELTA, encoded[0]);
+}
+
+TEST_F (LogFormatUnitTest, LogFormatKeyOnTimeGoingBack)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+
+   make_record (record, 6, 10, 0, 5, 0, 1000, false);
+   round_trip (record, false);
+
+   make_record (record, 6, 10, 0, 4, 999999999, 1000, false);
+   EXPECT_EQ ((size_t)LOG_RECORD_SIZE, round_trip (record, false));
+   EXPECT_EQ (LOG_RECORD_KEY, encoded[0]);
+
+   /* the same time again is not going back */
+   round_trip (record, false);
+   EXPECT_EQ (LOG_RECORD_DELTA, encoded[0]);
+}
+
+TEST_F (LogFormatUnitTest, LogFormatFirstWord)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+
+   make_record (record, 6, 10, 0, 0, 0, 1000, true);
+   round_trip (record, true);
+
+   set_word (record, 0, 0xFFFF);
+   EXPECT_EQ (1u + 1 + 1 + 1 + 2, round_trip (record, true));
+   EXPECT_EQ (LOG_RECORD_DELTA, encoded[0]);
+   EXPECT_EQ (0, encoded[1]); /* no time passed */
+   EXPECT_EQ (0x01, encoded[2]);
+   EXPECT_EQ (0x01, encoded[3]);
+   EXPECT_EQ (0xFF, encoded[4]);
+   EXPECT_EQ (0xFF, encoded[5]);
+}
+
+TEST_F (LogFormatUnitTest, LogFormatLastWord)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+
+   make_record (record, 6, 10, 0, 0, 0, 1000, true);
+   round_trip (record, true);
+
+   set_word (record, LOG_WORD_COUNT - 1, 0xA5A5);
+   EXPECT_EQ (1u + 1 + 1 + 1 + 2, round_trip (record, true));
+   EXPECT_EQ (0x80, encoded[2]);
+   EXPECT_EQ (0x80, encoded[3]);
+   EXPECT_EQ (0xA5, encoded[4]);
+   EXPECT_EQ (0xA5, encoded[5]);
+}
+
+TEST_F (LogFormatUnitTest, LogFormatAllWords)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+
+   make_record (record, 6, 10, 0, 0, 0, 1000, false);
+   round_trip (record, false);
+
+   /* every word changes, a millisecond later, which only just fits a delta */
+   make_record (record, 6, 10, 0, 0, 1000000, 2000, false);
+   EXPECT_EQ ((size_t)LOG_RECORD_SIZE, round_trip (record, false));
+   EXPECT_EQ (LOG_RECORD_DELTA, encoded[0]);
+   EXPECT_EQ (0xFF, encoded[4]);
+   for (int g = 0; g < 8; g++)
+   {
+      EXPECT_EQ (0xFF, encoded[5 + g]);
+   }
+
+   /* a second later the time takes a byte more, so it is a key instead */
+   make_record (record, 6, 10, 0, 1, 1000000, 3000, false);
+   EXPECT_EQ ((size_t)LOG_RECORD_SIZE, round_trip (record, false));
+   EXPECT_EQ (LOG_RECORD_KEY, encoded[0]);
+}
+
+TEST_F (LogFormatUnitTest, LogFormatLongestTime)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+
+   make_record (record, 6, 0, 0, 0, 0, 1000, true);
+   round_trip (record, true);
+
+   /* the whole day, the most a delta ever holds */
+   make_record (record, 6, 23, 59, 59, 999999999, 1000, true);
+   EXPECT_EQ (1u + 7 + 1, round_trip (record, true));
+   for (int i = 1; i < 7; i++)
+   {
+      EXPECT_EQ (0x80, encoded[i] & 0x80);
+   }
+   EXPECT_EQ (0, encoded[7] & 0x80);
+}
+
+TEST_F (LogFormatUnitTest, LogFormatLongestVarint)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+   uint8_t key[LOG_RECORD_SIZE];
+
+   make_record (record, 6, 10, 0, 0, 0, 1000, true);
+   logEncodeRecord (&encoder, record, true, key);
+   ASSERT_EQ (
+      LOG_RECORD_SIZE,
+      logDecodeRecord (&decoder, key, LOG_RECORD_SIZE, true, decoded));
+
+   /* no time passed, padded out to the ten bytes a 64 bit varint can take */
+   uint8_t delta[] = {
+      LOG_RECORD_DELTA,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x00,
+      0x00};
+   EXPECT_EQ (
+      (int)sizeof (delta),
+      logDecodeRecord (&decoder, delta, sizeof (delta), true, decoded));
+   EXPECT_EQ (0, memcmp (record, decoded, LOG_RECORD_SIZE));
+
+   /* an eleventh is one too many */
+   uint8_t too_long[] = {
+      LOG_RECORD_DELTA,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x80,
+      0x00,
+      0x00};
+   EXPECT_EQ (
+      -1,
+      logDecodeRecord (&decoder, too_long, sizeof (too_long), true, decoded));
+}
+
+TEST_F (LogFormatUnitTest, LogFormatTruncated)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+   uint8_t key[LOG_RECORD_SIZE];
+   uint8_t delta[LOG_RECORD_SIZE];
+   log_codec_t started;
+
+   make_record (record, 6, 10, 0, 0, 0, 1000, true);
+   size_t key_size = logEncodeRecord (&encoder, record, true, key);
+   make_record (record, 6, 10, 0, 0, 2000000, 1000, true);
+   set_word (record, 9, 0x0102);
+   set_word (record, 40, 0x0304);
+   size_t delta_size = logEncodeRecord (&encoder, record, true, delta);
+   ASSERT_EQ (LOG_RECORD_DELTA, delta[0]);
+
+   for (size_t length = 0; length < key_size; length++)
+   {
+      logCodecReset (&decoder);
+      EXPECT_EQ (-1, logDecodeRecord (&decoder, key, length, true, decoded))
+         << "key cut to " << length;
+   }
+
+   ASSERT_EQ (
+      (int)key_size,
+      logDecodeRecord (&decoder, key, key_size, true, decoded));
+   started = decoder;
+
+   for (size_t length = 0; length < delta_size; length++)
+   {
+      decoder = started;
+      EXPECT_EQ (-1, logDecodeRecord (&decoder, delta, length, true, decoded))
+         << "delta cut to " << length;
+   }
+
+   decoder = started;
+   EXPECT_EQ (
+      (int)delta_size,
+      logDecodeRecord (&decoder, delta, delta_size, true, decoded));
+   EXPECT_EQ (0, memcmp (record, decoded, LOG_RECORD_SIZE));
+}
+
+TEST_F (LogFormatUnitTest, LogFormatMalformed)
+{
+   uint8_t record[LOG_RECORD_SIZE];
+   uint8_t key[LOG_RECORD_SIZE];
+
+   /* a delta with nothing to continue from */
+   uint8_t delta[] = {LOG_RECORD_DELTA, 0x01, 0x00};
+   EXPECT_EQ (
+      -1,
+      logDecodeRecord (&decoder, delta, sizeof (delta), true, decoded));
+
+   make_record (record, 6, 10, 0, 0, 0, 1000, true);
+   logEncodeRecord (&encoder, record, true, key);
+   ASSERT_EQ (
+      LOG_RECORD_SIZE,
+      logDecodeRecord (&decoder, key, LOG_RECORD_SIZE, true, decoded));
+
+   /* neither kind of record */
+   uint8_t unknown[] = {7, 0x01, 0x00};
+   EXPECT_EQ (
+      -1,
+      logDecodeRecord (&decoder, unknown, sizeof (unknown), true, decoded));
+
+   /* a group with its mask, but not the word the mask names */
+   uint8_t missing_word[] = {LOG_RECORD_DELTA, 0x01, 0x02, 0x01};
+   EXPECT_EQ (
+      -1,
+      logDecodeRecord (
+         &decoder,
+         missing_word,
+         sizeof (missing_word),
+         true,
+         decoded));
+
+   /* the end of the log is not an error */
+   uint8_t end[] = {LOG_END};
+   EXPECT_EQ (0, logDecodeRecord (&decoder, end, sizeof (end), true, decoded));
+}
@@ -0,0 +1,296 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+
+#include "log_reader.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+#define NS_PER_S 1000000000ULL
+
+/* 2024-05-06 */
+static const uint32_t test_date = 2024 << 16 | 5 << 8 | 6;
+
+/* a few entries each second, then back into a second already passed */
+static const uint64_t going_back[] = {
+   36000 * NS_PER_S,
+   36000 * NS_PER_S + 500000000,
+   36001 * NS_PER_S,
+   36001 * NS_PER_S + 500000000,
+   36002 * NS_PER_S,
+   36001 * NS_PER_S + 200000000,
+   36001 * NS_PER_S + 700000000,
+   36002 * NS_PER_S + 500000000,
+   36003 * NS_PER_S,
+   36003 * NS_PER_S + 1,
+};
+
+class LogReaderUnitTest : public PnetUnitTest
+{
+ protected:
+   std::vector<uint8_t> log;
+   std::vector<uint64_t> times;
+
+   virtual void SetUp()
+   {
+      times.clear();
+      for (int i = 0; i < 40; i++)
+      {
+         /* four a second, from 10:00:00 */
+         times.push_back (36000 * NS_PER_S + i * 250000000ULL);
+      }
+   };
+
+   /* version 1 record for the time, numbered in its first word */
+   void make_record (uint8_t * record, uint64_t time_ns, uint16_t number)
+   {
+      uint64_t seconds = time_ns / NS_PER_S;
+      uint32_t nano = time_ns % NS_PER_S;
+      uint8_t * dtl = record + 1;
+
+      memset (record, 0, LOG_RECORD_SIZE);
+      dtl[0] = 2024 >> 8;
+      dtl[1] = 2024 & 0xFF;
+      dtl[2] = 5;
+      dtl[3] = 6;
+      dtl[4] = 1;
+      dtl[5] = seconds / 3600;
+      dtl[6] = seconds / 60 % 60;
+      dtl[7] = seconds % 60;
+      dtl[8] = nano >> 24;
+      dtl[9] = nano >> 16;
+      dtl[10] = nano >> 8;
+      dtl[11] = nano;
+      dtl[LOG_DTL_SIZE] = number >> 8;
+      dtl[LOG_DTL_SIZE + 1] = number & 0xFF;
+   }
+
+   void append_le32 (uint32_t value)
+   {
+      for (int i = 0; i < 4; i++)
+      {
+         log.push_back ((value >> (8 * i)) & 0xFF);
+      }
+   }
+
+   /*
+    * A big endian log of the times, as pn_dev writes them: each second
+    * indexed at its first entry, unless time went back to it, and in
+    * compact logs an indexed entry is a key
+    */
+   void build_log (uint8_t format, bool indexed, bool finished)
+   {
+      log_codec_t codec;
+      std::vector<log_index_entry_t> index;
+      uint8_t record[LOG_RECORD_SIZE];
+      uint8_t encoded[LOG_RECORD_SIZE];
+
+      log = {0x61, 0x0B, 0xE7, 0xEC, 0x50, 0x4E, format, LOG_WORD_COUNT};
+      logCodecReset (&codec);
+
+      for (size_t i = 0; i < times.size(); i++)
+      {
+         uint32_t second = times[i] / NS_PER_S;
+         bool key = index.empty() || second > index.back().second;
+         if (key)
+         {
+            index.push_back ({second, (uint32_t)log.size()});
+            logCodecReset (&codec);
+         }
+
+         make_record (record, times[i], i);
+         if (format == LOG_FORMAT_PLAIN)
+         {
+            log.insert (log.end(), record, record + LOG_RECORD_SIZE);
+         }
+         else
+         {
+            size_t size = logEncodeRecord (&codec, record, true, encoded);
+            log.insert (log.end(), encoded, encoded + size);
+         }
+      }
+
+      if (!finished)
+      {
+         /* cut off part way through a record, as it is being written */
+         make_record (record, times.back() + NS_PER_S, times.size());
+         logCodecReset (&codec);
+         size_t size = (format == LOG_FORMAT_PLAIN)
+                          ? LOG_RECORD_SIZE
+                          : logEncodeRecord (&codec, record, true, encoded);
+         const uint8_t * written =
+            (format == LOG_FORMAT_PLAIN) ? record : encoded;
+         log.insert (log.end(), written, written + size / 2);
+         return;
+      }
+
+      log.push_back (LOG_END);
+      if (indexed)
+      {
+         for (const log_index_entry_t & entry : index)
+         {
+            append_le32 (entry.second);
+            append_le32 (entry.offset);
+         }
+         append_le32 (index.size());
+         append_le32 (LOG_INDEX_MAGIC);
+      }
+   }
+
+   /* number of the first entry in the log at or after the time, -1 if none */
+   long expected_entry (const log_time_t * time)
+   {
+      for (size_t i = 0; i < times.size(); i++)
+      {
+         log_time_t entry_time = {test_date, times[i]};
+         if (logTimeCompare (&entry_time, time) >= 0)
+         {
+            return i;
+         }
+      }
+
+      return -1;
+   }
+
+   /* number of the entry the reader gives next, -1 if it gives none */
+   long entry_after_seek (log_reader_t * reader, const log_time_t * time)
+   {
+      logReaderSeek (reader, time);
+
+      const uint8_t * record = logReaderNext (reader);
+      if (record == NULL)
+      {
+         return -1;
+      }
+
+      return record[1 + LOG_DTL_SIZE] << 8 | record[1 + LOG_DTL_SIZE + 1];
+   }
+
+   /* times around each entry, and before and after the whole log */
+   std::vector<log_time_t> seek_times()
+   {
+      std::vector<log_time_t> seek = {
+         {test_date - 1, 0},
+         {test_date, 0},
+         {test_date, times.back() + NS_PER_S},
+         {test_date + 1, 0},
+      };
+
+      for (uint64_t t : times)
+      {
+         seek.push_back ({test_date, t - 1});
+         seek.push_back ({test_date, t});
+         seek.push_back ({test_date, t + 1});
+      }
+
+      return seek;
+   }
+
+   void check_seek (uint8_t format, bool indexed, bool finished)
+   {
+      log_reader_t reader;
+
+      build_log (format, indexed, finished);
+      ASSERT_EQ (0, logReaderInit (&reader, "test", log.data(), log.size()));
+      EXPECT_EQ (indexed && finished, reader.index != NULL);
+
+      for (const log_time_t & time : seek_times())
+      {
+         EXPECT_EQ (expected_entry (&time), entry_after_seek (&reader, &time))
+            << "format " << (int)format << (indexed ? " indexed" : "")
+            << (finished ? "" : " unfinished") << ", seeking "
+            << time.date << " " << time.time_ns;
+         EXPECT_FALSE (reader.failed);
+      }
+
+      logReaderClose (&reader);
+   }
+};
+
+TEST_F (LogReaderUnitTest, LogReaderSeekIndexed)
+{
+   check_seek (LOG_FORMAT_PLAIN, true, true);
+   check_seek (LOG_FORMAT_COMPACT, true, true);
+}
+
+TEST_F (LogReaderUnitTest, LogReaderSeekWithoutIndex)
+{
+   check_seek (LOG_FORMAT_PLAIN, false, true);
+   check_seek (LOG_FORMAT_COMPACT, false, true);
+}
+
+TEST_F (LogReaderUnitTest, LogReaderSeekUnfinished)
+{
+   check_seek (LOG_FORMAT_PLAIN, false, false);
+   check_seek (LOG_FORMAT_COMPACT, false, false);
+}
+
+TEST_F (LogReaderUnitTest, LogReaderSeekTimeGoingBack)
+{
+   times.assign (
+      going_back,
+      going_back + sizeof (going_back) / sizeof (going_back[0]));
+
+   /*
+    * The index leaves out the second time went back to, so seeking
+    * still finds the first entry at or after the time
+    */
+   check_seek (LOG_FORMAT_PLAIN, true, true);
+   check_seek (LOG_FORMAT_COMPACT, true, true);
+
+   /* as does reading a compact log through */
+   check_seek (LOG_FORMAT_COMPACT, false, true);
+}
+
+TEST_F (LogReaderUnitTest, LogReaderSeekTimeGoingBackBisected)
+{
+   log_reader_t reader;
+
+   times.assign (
+      going_back,
+      going_back + sizeof (going_back) / sizeof (going_back[0]));
+   build_log (LOG_FORMAT_PLAIN, false, true);
+   ASSERT_EQ (0, logReaderInit (&reader, "test", log.data(), log.size()));
+
+   /*
+    * Bisecting entries that are out of order can land on any place where
+    * time crosses the one sought, so just check that it is such a place
+    */
+   for (const log_time_t & time : seek_times())
+   {
+      long found = entry_after_seek (&reader, &time);
+      if (found == -1)
+      {
+         log_time_t last = {test_date, times.back()};
+         EXPECT_LT (logTimeCompare (&last, &time), 0);
+         continue;
+      }
+
+      log_time_t found_time = {test_date, times[found]};
+      EXPECT_GE (logTimeCompare (&found_time, &time), 0);
+      if (found > 0)
+      {
+         log_time_t before = {test_date, times[found - 1]};
+         EXPECT_LT (logTimeCompare (&before, &time), 0);
+      }
+   }
+
+   logReaderClose (&reader);
+}
@@ -0,0 +1,518 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "pnet2csv_test_utils.h"
+
+#include "parquet_writer.h"
+
+#include <gtest/gtest.h>
+
+#include <endian.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/* parquet.thrift, the values checked */
+#define TYPE_INT32                   1
+#define TYPE_INT64                   2
+#define CONVERTED_UINT_16            12
+#define PAGE_DATA                    0
+#define PAGE_DICTIONARY              2
+#define ENCODING_PLAIN               0
+#define ENCODING_DELTA_BINARY_PACKED 5
+#define ENCODING_RLE_DICTIONARY      8
+
+#define THRIFT_TRUE   1
+#define THRIFT_FALSE  2
+#define THRIFT_BYTE   3
+#define THRIFT_I16    4
+#define THRIFT_I32    5
+#define THRIFT_I64    6
+#define THRIFT_BINARY 8
+#define THRIFT_LIST   9
+#define THRIFT_STRUCT 12
+
+
+/* a value in the Thrift compact protocol, as far as the writer uses it */
+struct thrift_value
+{
+   int64_t number = 0;
+   std::string binary;
+   std::vector<thrift_value> list;
+   std::map<int, thrift_value> fields;
+
+   const thrift_value & operator[] (int id) const
+   {
+      static const thrift_value absent;
+      auto found = fields.find (id);
+      return (found == fields.end()) ? absent : found->second;
+   }
+
+   bool has (int id) const
+   {
+      return fields.count (id) != 0;
+   }
+};
+
+/* reads a Thrift compact struct, and the other encodings made of varints and bits */
+class byte_reader
+{
+ public:
+   const uint8_t * data;
+   size_t size;
+   size_t pos = 0;
+   bool failed = false;
+
+   byte_reader (const uint8_t * data, size_t size) : data (data), size (size)
+   {
+   }
+
+   uint8_t byte()
+   {
+      if (pos >= size)
+      {
+         failed = true;
+         return 0;
+      }
+      return data[pos++];
+   }
+
+   uint64_t varint()
+   {
+      uint64_t value = 0;
+      for (int shift = 0; shift < 64; shift += 7)
+      {
+         uint8_t b = byte();
+         value |= (uint64_t)(b & 0x7F) << shift;
+         if (!(b & 0x80))
+         {
+            break;
+         }
+      }
+      return value;
+   }
+
+   int64_t zigzag()
+   {
+      uint64_t value = varint();
+      return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+   }
+
+   /* count values of width bits, the lowest bits first */
+   std::vector<uint64_t> bits (size_t count, int width)
+   {
+      std::vector<uint64_t> values (count);
+      for (size_t k = 0; k < count; k++)
+      {
+         for (int j = 0; j < width; j++)
+         {
+            size_t bit = k * width + j;
+            if (pos + bit / 8 >= size)
+            {
+               failed = true;
+               return values;
+            }
+            values[k] |= (uint64_t)((data[pos + bit / 8] >> (bit % 8)) & 1)
+                         << j;
+         }
+      }
+      pos += (count * width + 7) / 8;
+      return values;
+   }
+
+   thrift_value value (uint8_t type)
+   {
+      thrift_value value;
+
+      switch (type)
+      {
+      case THRIFT_TRUE:
+         value.number = 1;
+         break;
+      case THRIFT_FALSE:
+         value.number = 0;
+         break;
+      case THRIFT_BYTE:
+         value.number = (int8_t)byte();
+         break;
+      case THRIFT_I16:
+      case THRIFT_I32:
+      case THRIFT_I64:
+         value.number = zigzag();
+         break;
+      case THRIFT_BINARY:
+      {
+         size_t length = varint();
+         for (size_t i = 0; i < length; i++)
+         {
+            value.binary.push_back (byte());
+         }
+         break;
+      }
+      case THRIFT_LIST:
+      {
+         uint8_t header = byte();
+         size_t count = header >> 4;
+         if (count == 15)
+         {
+            count = varint();
+         }
+         for (size_t i = 0; i < count && !failed; i++)
+         {
+            value.list.push_back (this->value (header & 0x0F));
+         }
+         break;
+      }
+      case THRIFT_STRUCT:
+         return thrift_struct();
+      default:
+         failed = true;
+         break;
+      }
+
+      return value;
+   }
+
+   thrift_value thrift_struct()
+   {
+      thrift_value value;
+      int last = 0;
+
+      while (!failed)
+      {
+         uint8_t header = byte();
+         if (header == 0)
+         {
+            break;
+         }
+         int id = (header >> 4) ? last + (header >> 4) : (int)zigzag();
+         value.fields[id] = this->value (header & 0x0F);
+         last = id;
+      }
+
+      return value;
+   }
+};
+
+/* a word that hardly changes, and one that climbs steadily */
+class ParquetWriterUnitTest : public ColumnTableUnitTest
+{
+ protected:
+   virtual void fill_row (size_t row) override
+   {
+      /* every millisecond, but for one entry a little late */
+      if (row == 7)
+      {
+         table.time[row] += 123;
+      }
+      table.words[0][row] = (row < 8) ? 7 : 9;
+      table.words[1][row] = 1000 + row * 3;
+   };
+
+   /* a file of the table, in as many row groups as asked for */
+   void write_file (int groups)
+   {
+      parquet_file_t file;
+      parquet_row_group_t group;
+
+      parquetFileStart (&file, &filter.projection, &out);
+      for (int g = 0; g < groups; g++)
+      {
+         ASSERT_EQ (0, parquetEncodeRowGroup (&table, &out, &group));
+         ASSERT_EQ (0, parquetFileAdd (&file, &group));
+      }
+      ASSERT_EQ (0, parquetFileFinish (&file, &out));
+      parquetFileFree (&file);
+   }
+
+   thrift_value read_footer()
+   {
+      uint32_t length = 0;
+      EXPECT_GE (out.size, 12u);
+      EXPECT_EQ (0, memcmp (out.data, "PAR1", 4));
+      EXPECT_EQ (0, memcmp (out.data + out.size - 4, "PAR1", 4));
+      memcpy (&length, out.data + out.size - 8, 4);
+      length = le32toh (length);
+      EXPECT_LE (length + 12, out.size);
+
+      byte_reader footer (out.data + out.size - 8 - length, length);
+      thrift_value metadata = footer.thrift_struct();
+      EXPECT_FALSE (footer.failed);
+      EXPECT_EQ (length, footer.pos);
+
+      return metadata;
+   }
+
+   /* the page header at an offset in the file, leaving reader at the page */
+   thrift_value read_page_header (byte_reader & reader, uint64_t offset)
+   {
+      reader.pos = offset;
+      thrift_value header = reader.thrift_struct();
+      EXPECT_FALSE (reader.failed);
+      EXPECT_EQ (header[2].number, header[3].number);
+      EXPECT_LE (reader.pos + header[3].number, out.size);
+
+      return header;
+   }
+
+   std::vector<int64_t> decode_delta (byte_reader & reader)
+   {
+      uint64_t block = reader.varint();
+      uint64_t miniblocks = reader.varint();
+      uint64_t count = reader.varint();
+      int64_t value = reader.zigzag();
+      std::vector<int64_t> values = {value};
+
+      EXPECT_EQ (0u, block % (miniblocks * 32));
+      while (values.size() < count && !reader.failed)
+      {
+         int64_t min = reader.zigzag();
+         std::vector<int> widths;
+         for (uint64_t m = 0; m < miniblocks; m++)
+         {
+            widths.push_back (reader.byte());
+         }
+
+         for (uint64_t m = 0; m < miniblocks && values.size() < count; m++)
+         {
+            for (uint64_t delta : reader.bits (block / miniblocks, widths[m]))
+            {
+               if (values.size() < count)
+               {
+                  value += min + (int64_t)delta;
+                  values.push_back (value);
+               }
+            }
+         }
+      }
+
+      return values;
+   }
+
+   std::vector<uint64_t> decode_hybrid (byte_reader & reader, size_t count, int width)
+   {
+      std::vector<uint64_t> values;
+
+      while (values.size() < count && !reader.failed)
+      {
+         uint64_t header = reader.varint();
+         if (header & 1)
+         {
+            for (uint64_t v : reader.bits ((header >> 1) * 8, width))
+            {
+               if (values.size() < count)
+               {
+                  values.push_back (v);
+               }
+            }
+         }
+         else
+         {
+            uint64_t value = 0;
+            for (int b = 0; b < width; b += 8)
+            {
+               value |= (uint64_t)reader.byte() << b;
+            }
+            values.insert (values.end(), header >> 1, value);
+         }
+      }
+
+      EXPECT_EQ (count, values.size());
+      return values;
+   }
+
+   /* the values of a column chunk, whichever way it was encoded */
+   std::vector<int64_t> decode_chunk (const thrift_value & chunk)
+   {
+      const thrift_value & metadata = chunk[3];
+      byte_reader reader (out.data, out.size);
+      std::vector<int64_t> dictionary;
+
+      if (metadata.has (11))
+      {
+         thrift_value header = read_page_header (reader, metadata[11].number);
+         EXPECT_EQ (PAGE_DICTIONARY, header[1].number);
+         EXPECT_EQ (ENCODING_PLAIN, header[7][2].number);
+         for (int64_t k = 0; k < header[7][1].number; k++)
+         {
+            uint32_t value = 0;
+            for (int b = 0; b < 32; b += 8)
+            {
+               value |= (uint32_t)reader.byte() << b;
+            }
+            dictionary.push_back (value);
+         }
+      }
+
+      thrift_value header = read_page_header (reader, metadata[9].number);
+      EXPECT_EQ (PAGE_DATA, header[1].number);
+      EXPECT_EQ (TEST_TABLE_ROWS, header[5][1].number);
+      size_t page_end = reader.pos + header[3].number;
+
+      std::vector<int64_t> values;
+      if (header[5][2].number == ENCODING_RLE_DICTIONARY)
+      {
+         int width = reader.byte();
+         for (uint64_t index : decode_hybrid (reader, TEST_TABLE_ROWS, width))
+         {
+            EXPECT_LT (index, dictionary.size());
+            values.push_back (
+               (index < dictionary.size()) ? dictionary[index] : -1);
+         }
+      }
+      else
+      {
+         EXPECT_EQ (ENCODING_DELTA_BINARY_PACKED, header[5][2].number);
+         values = decode_delta (reader);
+      }
+
+      EXPECT_FALSE (reader.failed);
+      EXPECT_EQ (page_end, reader.pos);
+
+      /* the chunk is exactly its pages */
+      uint64_t start = metadata.has (11) ? metadata[11].number
+                                         : metadata[9].number;
+      EXPECT_EQ ((uint64_t)chunk[2].number, start);
+      EXPECT_EQ (start + metadata[6].number, page_end);
+
+      return values;
+   }
+};
+
+TEST_F (ParquetWriterUnitTest, ParquetWriterFooter)
+{
+   write_file (2);
+   thrift_value metadata = read_footer();
+
+   EXPECT_EQ (1, metadata[1].number);
+   EXPECT_EQ (2 * TEST_TABLE_ROWS, metadata[3].number);
+   EXPECT_EQ ("pnet2csv", metadata[6].binary);
+
+   /* the root, then a column for the time and each word */
+   const std::vector<thrift_value> & schema = metadata[2].list;
+   ASSERT_EQ (4u, schema.size());
+   EXPECT_EQ ("schema", schema[0][4].binary);
+   EXPECT_EQ (3, schema[0][5].number);
+
+   EXPECT_EQ ("time", schema[1][4].binary);
+   EXPECT_EQ (TYPE_INT64, schema[1][1].number);
+   /* TIMESTAMP, not adjusted to UTC, in NANOS */
+   ASSERT_TRUE (schema[1][10].has (8));
+   EXPECT_EQ (0, schema[1][10][8][1].number);
+   EXPECT_TRUE (schema[1][10][8][2].has (3));
+
+   EXPECT_EQ ("word3", schema[2][4].binary);
+   EXPECT_EQ ("word10", schema[3][4].binary);
+   for (int c = 2; c < 4; c++)
+   {
+      EXPECT_EQ (TYPE_INT32, schema[c][1].number);
+      EXPECT_EQ (CONVERTED_UINT_16, schema[c][6].number);
+      /* INTEGER, 16 bits, unsigned */
+      EXPECT_EQ (16, schema[c][10][10][1].number);
+      EXPECT_EQ (0, schema[c][10][10][2].number);
+   }
+
+   const std::vector<thrift_value> & groups = metadata[4].list;
+   ASSERT_EQ (2u, groups.size());
+   int64_t expected_offset = 4;
+   for (const thrift_value & group : groups)
+   {
+      EXPECT_EQ (TEST_TABLE_ROWS, group[3].number);
+      EXPECT_EQ (expected_offset, group[5].number);
+
+      /* each chunk right after the one before */
+      const std::vector<thrift_value> & chunks = group[1].list;
+      ASSERT_EQ (3u, chunks.size());
+      int64_t chunk_offset = expected_offset;
+      for (const thrift_value & chunk : chunks)
+      {
+         EXPECT_EQ (chunk_offset, chunk[2].number);
+         EXPECT_EQ (TEST_TABLE_ROWS, chunk[3][5].number);
+         chunk_offset += chunk[3][6].number;
+      }
+      EXPECT_EQ (expected_offset + group[2].number, chunk_offset);
+
+      expected_offset += group[2].number;
+   }
+
+   /* the minimum and maximum of the time, and of each word */
+   const thrift_value & time = groups[0][1].list[0][3];
+   EXPECT_EQ (TYPE_INT64, time[1].number);
+   ASSERT_EQ (1u, time[3].list.size());
+   EXPECT_EQ ("time", time[3].list[0].binary);
+   int64_t min;
+   int64_t max;
+   ASSERT_EQ (8u, time[12][6].binary.size());
+   memcpy (&min, time[12][6].binary.data(), 8);
+   memcpy (&max, time[12][5].binary.data(), 8);
+   EXPECT_EQ (table.time[0], (int64_t)le64toh (min));
+   EXPECT_EQ (table.time[TEST_TABLE_ROWS - 1], (int64_t)le64toh (max));
+
+   const thrift_value & word = groups[0][1].list[1][3];
+   EXPECT_EQ ("word3", word[3].list[0].binary);
+   ASSERT_EQ (4u, word[12][6].binary.size());
+   EXPECT_EQ (std::string ("\x07\0\0\0", 4), word[12][6].binary);
+   EXPECT_EQ (std::string ("\x09\0\0\0", 4), word[12][5].binary);
+
+   /* and the words are ordered unsigned */
+   ASSERT_EQ (3u, metadata[7].list.size());
+}
+
+TEST_F (ParquetWriterUnitTest, ParquetWriterColumnChunks)
+{
+   write_file (1);
+   thrift_value metadata = read_footer();
+   ASSERT_EQ (1u, metadata[4].list.size());
+   const std::vector<thrift_value> & chunks = metadata[4].list[0][1].list;
+   ASSERT_EQ (3u, chunks.size());
+
+   /* the time, delta-encoded */
+   const thrift_value & time = chunks[0];
+   ASSERT_EQ (1u, time[3][2].list.size());
+   EXPECT_EQ (ENCODING_DELTA_BINARY_PACKED, time[3][2].list[0].number);
+   EXPECT_FALSE (time[3].has (11));
+   std::vector<int64_t> times = decode_chunk (time);
+   ASSERT_EQ ((size_t)TEST_TABLE_ROWS, times.size());
+   for (size_t i = 0; i < TEST_TABLE_ROWS; i++)
+   {
+      EXPECT_EQ (table.time[i], times[i]) << "row " << i;
+   }
+
+   /* the word that hardly changes, from a dictionary */
+   const thrift_value & steady = chunks[1];
+   ASSERT_EQ (2u, steady[3][2].list.size());
+   EXPECT_EQ (ENCODING_PLAIN, steady[3][2].list[0].number);
+   EXPECT_EQ (ENCODING_RLE_DICTIONARY, steady[3][2].list[1].number);
+   EXPECT_EQ (steady[2].number, steady[3][11].number);
+   std::vector<int64_t> words = decode_chunk (steady);
+   ASSERT_EQ ((size_t)TEST_TABLE_ROWS, words.size());
+   for (size_t i = 0; i < TEST_TABLE_ROWS; i++)
+   {
+      EXPECT_EQ (table.words[0][i], words[i]) << "row " << i;
+   }
+
+   /* the one that climbs, delta-encoded too */
+   const thrift_value & climbing = chunks[2];
+   ASSERT_EQ (1u, climbing[3][2].list.size());
+   EXPECT_EQ (ENCODING_DELTA_BINARY_PACKED, climbing[3][2].list[0].number);
+   words = decode_chunk (climbing);
+   ASSERT_EQ ((size_t)TEST_TABLE_ROWS, words.size());
+   for (size_t i = 0; i < TEST_TABLE_ROWS; i++)
+   {
+      EXPECT_EQ (table.words[1][i], words[i]) << "row " << i;
+   }
+}
@@ -0,0 +1,153 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+
+#include "record_decode.h"
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* enough to cover every kernel's groups and what is left after them */
+static const size_t test_counts[] =
+   {0, 1, 7, 8, 9, 15, 16, 17, 24, 31, 33, RECORD_BLOCK - 1, RECORD_BLOCK};
+
+class RecordDecodeUnitTest : public PnetUnitTest
+{
+ protected:
+   /* one spare byte in front, so the records are not aligned */
+   uint8_t buffer[1 + RECORD_BLOCK * LOG_RECORD_SIZE];
+   uint8_t * records = buffer + 1;
+   record_block_t block;
+
+   virtual void SetUp()
+   {
+      srand (1);
+      for (size_t i = 0; i < sizeof (buffer); i++)
+      {
+         buffer[i] = rand() & 0xFF;
+      }
+   };
+
+   /* byte by byte, independent of the kernels */
+   uint16_t expected_word (size_t record, int word, bool bigendian)
+   {
+      const uint8_t * bytes = records + record * LOG_RECORD_SIZE + 1 +
+                              LOG_DTL_SIZE + 2 * word;
+      return bigendian ? (bytes[0] << 8 | bytes[1])
+                       : (bytes[1] << 8 | bytes[0]);
+   }
+
+   void check_block (size_t count, bool bigendian, const char * decoder)
+   {
+      ASSERT_EQ (count, block.count) << decoder;
+
+      for (size_t r = 0; r < count; r++)
+      {
+         const uint8_t * dtl = records + r * LOG_RECORD_SIZE + 1;
+         uint16_t year = bigendian ? (dtl[0] << 8 | dtl[1])
+                                   : (dtl[1] << 8 | dtl[0]);
+         uint32_t nano =
+            bigendian
+               ? ((uint32_t)dtl[8] << 24 | dtl[9] << 16 | dtl[10] << 8 |
+                  dtl[11])
+               : ((uint32_t)dtl[11] << 24 | dtl[10] << 16 | dtl[9] << 8 |
+                  dtl[8]);
+
+         EXPECT_EQ (year, block.year[r]) << decoder << " entry " << r;
+         EXPECT_EQ (dtl[2], block.month[r]) << decoder << " entry " << r;
+         EXPECT_EQ (dtl[3], block.day[r]) << decoder << " entry " << r;
+         EXPECT_EQ (dtl[5], block.hour[r]) << decoder << " entry " << r;
+         EXPECT_EQ (dtl[6], block.minute[r]) << decoder << " entry " << r;
+         EXPECT_EQ (dtl[7], block.second[r]) << decoder << " entry " << r;
+         EXPECT_EQ (nano, block.nano[r]) << decoder << " entry " << r;
+
+         for (int w = 0; w < LOG_WORD_COUNT; w++)
+         {
+            ASSERT_EQ (expected_word (r, w, bigendian), block.words[w][r])
+               << decoder << " entry " << r << " word " << w << " of "
+               << count << (bigendian ? " big endian" : " little endian");
+         }
+      }
+   }
+};
+
+TEST_F (RecordDecodeUnitTest, RecordDecodeEveryKernel)
+{
+   int tested = 0;
+
+   for (int d = 0; d < RECORD_DECODER_COUNT; d++)
+   {
+      record_decoder_t decoder = (record_decoder_t)d;
+      if (!recordDecoderAvailable (decoder))
+      {
+         continue;
+      }
+      tested++;
+
+      for (size_t count : test_counts)
+      {
+         for (bool bigendian : {true, false})
+         {
+            memset (&block, 0, sizeof (block));
+            decodeRecordsWith (decoder, records, count, bigendian, &block);
+            check_block (count, bigendian, recordDecoderName (decoder));
+         }
+      }
+   }
+
+   /* at least the scalar one */
+   EXPECT_GE (tested, 1);
+}
+
+TEST_F (RecordDecodeUnitTest, RecordDecodeBestKernel)
+{
+   for (size_t count : test_counts)
+   {
+      for (bool bigendian : {true, false})
+      {
+         memset (&block, 0, sizeof (block));
+         decodeRecords (records, count, bigendian, &block);
+         check_block (count, bigendian, "best");
+      }
+   }
+}
+
+TEST_F (RecordDecodeUnitTest, RecordDecodeLeavesRestOfBlock)
+{
+   /* a kernel working in groups must not write past the entries asked for */
+   for (int d = 0; d < RECORD_DECODER_COUNT; d++)
+   {
+      record_decoder_t decoder = (record_decoder_t)d;
+      if (!recordDecoderAvailable (decoder))
+      {
+         continue;
+      }
+
+      memset (&block, 0xA5, sizeof (block));
+      decodeRecordsWith (decoder, records, 9, true, &block);
+
+      for (int w = 0; w < LOG_WORD_COUNT; w++)
+      {
+         for (size_t r = 9; r < RECORD_BLOCK; r++)
+         {
+            ASSERT_EQ (0xA5A5, block.words[w][r])
+               << recordDecoderName (decoder) << " word " << w;
+         }
+      }
+   }
+}
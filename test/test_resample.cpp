@@ -0,0 +1,167 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "pnet2csv_test_utils.h"
+
+#include "column_table.h"
+#include "resample.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#define MS 1000000
+
+class ResampleUnitTest : public PnetUnitTest
+{
+ protected:
+   resampler_t resampler;
+   aggregate_t aggregates[RESAMPLE_AGGREGATES] = {
+      AGGREGATE_MIN,
+      AGGREGATE_MAX,
+      AGGREGATE_LAST};
+
+   /* one word, its value at milliseconds since TEST_LOG_START */
+   void take (int64_t ms, uint16_t value)
+   {
+      int64_t time = TEST_LOG_START + ms * MS;
+
+      EXPECT_FALSE (resamplerFill (&resampler, time));
+      resamplerTake (&resampler, time, &value);
+   }
+
+   void check_row (size_t row, int64_t ms, uint16_t min, uint16_t max, uint16_t last)
+   {
+      ASSERT_LT (row, resampler.rows.count);
+      EXPECT_EQ (
+         TEST_LOG_START + ms * MS,
+         columnTableTime (&resampler.rows, row))
+         << "row " << row;
+      EXPECT_EQ (min, resampler.rows.words[0][row]) << "row " << row;
+      EXPECT_EQ (max, resampler.rows.words[1][row]) << "row " << row;
+      EXPECT_EQ (last, resampler.rows.words[2][row]) << "row " << row;
+   }
+};
+
+TEST_F (ResampleUnitTest, ResampleParse)
+{
+   int64_t period;
+   int count;
+
+   EXPECT_EQ (0, resampleParsePeriod ("1ms", &period));
+   EXPECT_EQ (MS, period);
+   EXPECT_EQ (0, resampleParsePeriod ("250us", &period));
+   EXPECT_EQ (250000, period);
+   EXPECT_EQ (0, resampleParsePeriod ("10s", &period));
+   EXPECT_EQ (10000LL * MS, period);
+   EXPECT_EQ (0, resampleParsePeriod ("5", &period));
+   EXPECT_EQ (5 * MS, period);
+   EXPECT_EQ (-1, resampleParsePeriod ("0ms", &period));
+   EXPECT_EQ (-1, resampleParsePeriod ("ms", &period));
+   EXPECT_EQ (-1, resampleParsePeriod ("1h", &period));
+   EXPECT_EQ (-1, resampleParsePeriod ("-1ms", &period));
+
+   EXPECT_EQ (0, resampleParseAggregates ("max,min", aggregates, &count));
+   ASSERT_EQ (2, count);
+   EXPECT_EQ (AGGREGATE_MAX, aggregates[0]);
+   EXPECT_EQ (AGGREGATE_MIN, aggregates[1]);
+   EXPECT_EQ (-1, resampleParseAggregates ("min,min", aggregates, &count));
+   EXPECT_EQ (-1, resampleParseAggregates ("mean", aggregates, &count));
+   EXPECT_EQ (-1, resampleParseAggregates ("min,", aggregates, &count));
+}
+
+TEST_F (ResampleUnitTest, ResampleColumns)
+{
+   entry_filter_t filter;
+   projection_t columns;
+   char name[COLUMN_NAME_MAX];
+
+   filterInit (&filter);
+   ASSERT_EQ (0, filterParseWords (&filter, "7,63"));
+   ASSERT_EQ (0, resampleColumns (&columns, &filter.projection, aggregates, 3));
+   ASSERT_EQ (6, columns.count);
+
+   projectionColumnName (&columns, 0, name);
+   EXPECT_STREQ ("word7_min", name);
+   projectionColumnName (&columns, 5, name);
+   EXPECT_STREQ ("word63_last", name);
+
+   /* two aggregates of every word would be too many */
+   filterInit (&filter);
+   EXPECT_EQ (-1, resampleColumns (&columns, &filter.projection, aggregates, 2));
+}
+
+TEST_F (ResampleUnitTest, ResampleForwardFill)
+{
+   resamplerInit (&resampler, MS, 1, aggregates, 3, 0, INT64_MAX);
+
+   /* rows start at the first entry, and hold each until the next */
+   take (2, 10);
+   take (5, 20);
+   take (5, 30);
+   EXPECT_FALSE (resamplerFinish (&resampler));
+
+   ASSERT_EQ (4u, resampler.rows.count);
+   check_row (0, 2, 10, 10, 10);
+   check_row (1, 3, 10, 10, 10);
+   check_row (2, 4, 10, 10, 10);
+   check_row (3, 5, 10, 30, 30);
+}
+
+TEST_F (ResampleUnitTest, ResampleAggregates)
+{
+   resamplerInit (
+      &resampler,
+      10 * MS,
+      1,
+      aggregates,
+      3,
+      TEST_LOG_START,
+      TEST_LOG_START + 40 * MS);
+
+   /* before the window, only what is held when it starts counts */
+   take (-30, 1);
+   take (-15, 50);
+   take (3, 40);
+   take (7, 5);
+   take (10, 60);
+   take (31, 2);
+   EXPECT_FALSE (resamplerFinish (&resampler));
+
+   ASSERT_EQ (4u, resampler.rows.count);
+   check_row (0, 0, 50, 50, 50);
+   check_row (1, 10, 5, 60, 60);
+   check_row (2, 20, 60, 60, 60);
+   check_row (3, 30, 60, 60, 60);
+}
+
+TEST_F (ResampleUnitTest, ResampleFullRows)
+{
+   resamplerInit (&resampler, MS, 1, aggregates, 3, 0, INT64_MAX);
+
+   take (0, 1);
+
+   /* a long gap fills more rows than a block holds */
+   int64_t time = TEST_LOG_START + (2 * RECORD_BLOCK + 10) * (int64_t)MS;
+   size_t rows = 0;
+   while (resamplerFill (&resampler, time))
+   {
+      ASSERT_EQ ((size_t)RECORD_BLOCK, resampler.rows.count);
+      rows += resampler.rows.count;
+      resampler.rows.count = 0;
+   }
+   rows += resampler.rows.count;
+   EXPECT_EQ ((size_t)(2 * RECORD_BLOCK + 10), rows);
+}
@@ -0,0 +1,108 @@
+/*********************************************************************
+ *        _       _         _
+ *  _ __ | |_  _ | |  __ _ | |__   ___
+ * | '__|| __|(_)| | / _` || '_ \ / __|
+ * | |   | |_  _ | || (_| || |_) |\__ \
+ * |_|    \__|(_)|_| \__,_||_.__/ |___/
+ *
+ * www.rt-labs.com
+ * Copyright 2018 rt-labs AB, Sweden.
+ *
+ * This software is dual-licensed under GPLv3 and a commercial
+ * license. See the file LICENSE.md distributed with this software for
+ * full license information.
+ ********************************************************************/
+
+#include "utils_for_testing.h"
+
+#include "work_pool.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#define TEST_TASKS 64
+
+class WorkPoolUnitTest : public PnetUnitTest
+{
+ protected:
+   work_pool_t pool;
+   std::atomic<int> runs[TEST_TASKS];
+   /* tasks started beyond the window */
+   std::atomic<int> early;
+
+   virtual void SetUp()
+   {
+      for (int i = 0; i < TEST_TASKS; i++)
+      {
+         runs[i] = 0;
+      }
+      early = 0;
+   };
+
+   /* a work_function_t, noting that the task ran and whether it could */
+   static void run_task (void * context, size_t task)
+   {
+      WorkPoolUnitTest * test = (WorkPoolUnitTest *)context;
+      work_pool_t * pool = &test->pool;
+
+      pthread_mutex_lock (&pool->lock);
+      if (pool->window != 0 && task >= pool->retired + pool->window)
+      {
+         test->early++;
+      }
+      pthread_mutex_unlock (&pool->lock);
+
+      test->runs[task]++;
+
+      /* so that the others get to steal */
+      std::this_thread::yield();
+   }
+};
+
+TEST_F (WorkPoolUnitTest, WorkPoolRunsEveryTask)
+{
+   ASSERT_EQ (0, workPoolStart (&pool, TEST_TASKS, 4, 0, run_task, this));
+   workPoolFinish (&pool);
+
+   for (int i = 0; i < TEST_TASKS; i++)
+   {
+      EXPECT_EQ (1, runs[i]) << "task " << i;
+   }
+}
+
+TEST_F (WorkPoolUnitTest, WorkPoolWindow)
+{
+   ASSERT_EQ (0, workPoolStart (&pool, TEST_TASKS, 4, 3, run_task, this));
+
+   /* results used in order, each only once it has run */
+   for (size_t task = 0; task < TEST_TASKS; task++)
+   {
+      workPoolWaitFor (&pool, task);
+      EXPECT_EQ (1, runs[task]) << "task " << task;
+      workPoolRetire (&pool, task);
+   }
+   workPoolFinish (&pool);
+
+   EXPECT_EQ (0, early);
+}
+
+TEST_F (WorkPoolUnitTest, WorkPoolCancel)
+{
+   ASSERT_EQ (0, workPoolStart (&pool, TEST_TASKS, 2, 4, run_task, this));
+
+   /* nothing retired, so only the first tasks may start */
+   for (size_t task = 0; task < 4; task++)
+   {
+      workPoolWaitFor (&pool, task);
+   }
+   workPoolCancel (&pool);
+   workPoolFinish (&pool);
+
+   EXPECT_EQ (0, early);
+   for (int i = 0; i < TEST_TASKS; i++)
+   {
+      EXPECT_EQ ((i < 4) ? 1 : 0, runs[i]) << "task " << i;
+   }
+}
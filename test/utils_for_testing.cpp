@@ -478,6 +478,7 @@ void PnetIntegrationTestBase::cfg_init()
    pnet_default_cfg.alarm_cnf_cb = my_alarm_cnf;
    pnet_default_cfg.signal_led_cb = my_signal_led_ind;
    pnet_default_cfg.reset_cb = NULL;
+   pnet_default_cfg.rpc_ready_cb = NULL;
    pnet_default_cfg.cb_arg = &appdata;
 
    /* Device configuration */